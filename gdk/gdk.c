@@ -439,3 +439,134 @@ gdk_source_set_static_name_by_id (guint           tag,
 
   g_source_set_static_name (source, name);
 }
+
+/* Other threads use gdk_main_thread_invoke() to run code on the main
+ * thread, like GL calls. The main thread must not block waiting for such
+ * a thread without handling those calls, or both end up waiting for each
+ * other. gdk_main_thread_wait_until() is the way to wait that does.
+ */
+typedef struct _MainThreadCall MainThreadCall;
+
+struct _MainThreadCall
+{
+  GSourceFunc func;
+  gpointer data;
+  gboolean done;
+};
+
+static GMutex main_thread_mutex;
+static GCond main_thread_cond;
+static GQueue main_thread_calls = G_QUEUE_INIT;
+
+/* must be called with main_thread_mutex held */
+static void
+gdk_main_thread_run_calls (void)
+{
+  MainThreadCall *call;
+
+  while ((call = g_queue_pop_head (&main_thread_calls)))
+    {
+      g_mutex_unlock (&main_thread_mutex);
+      call->func (call->data);
+      g_mutex_lock (&main_thread_mutex);
+
+      call->done = TRUE;
+      g_cond_broadcast (&main_thread_cond);
+    }
+}
+
+static gboolean
+gdk_main_thread_run_calls_cb (gpointer data)
+{
+  g_mutex_lock (&main_thread_mutex);
+  gdk_main_thread_run_calls ();
+  g_mutex_unlock (&main_thread_mutex);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * gdk_main_thread_invoke:
+ * @func: function to call
+ * @data: data to pass to @func
+ *
+ * Calls @func in the thread owning the default main context and waits
+ * for it to return. Like g_main_context_invoke(), @func is called right
+ * away if the current thread owns or can acquire that context.
+ */
+void
+gdk_main_thread_invoke (GSourceFunc func,
+                        gpointer    data)
+{
+  MainThreadCall call = { func, data, FALSE };
+  guint id;
+
+  if (g_main_context_is_owner (NULL))
+    {
+      func (data);
+      return;
+    }
+
+  if (g_main_context_acquire (NULL))
+    {
+      func (data);
+      g_main_context_release (NULL);
+      return;
+    }
+
+  g_mutex_lock (&main_thread_mutex);
+  g_queue_push_tail (&main_thread_calls, &call);
+  g_cond_broadcast (&main_thread_cond);
+  g_mutex_unlock (&main_thread_mutex);
+
+  id = g_idle_add_full (G_PRIORITY_DEFAULT, gdk_main_thread_run_calls_cb, NULL, NULL);
+  gdk_source_set_static_name_by_id (id, "[gtk] gdk_main_thread_run_calls_cb");
+
+  g_mutex_lock (&main_thread_mutex);
+  while (!call.done)
+    g_cond_wait (&main_thread_cond, &main_thread_mutex);
+  g_mutex_unlock (&main_thread_mutex);
+}
+
+/*
+ * gdk_main_thread_wait_until:
+ * @check: function returning %TRUE once waiting is done
+ * @data: data to pass to @check
+ *
+ * Blocks until @check returns %TRUE. When called from the main thread,
+ * calls from gdk_main_thread_invoke() are handled while waiting.
+ *
+ * @check is called with an internal lock held, so it must be quick
+ * and not call into GDK. Whoever makes it return %TRUE must call
+ * gdk_main_thread_wakeup() afterwards.
+ */
+void
+gdk_main_thread_wait_until (GdkMainThreadCheckFunc check,
+                            gpointer               data)
+{
+  gboolean is_main_thread = g_main_context_is_owner (NULL);
+
+  g_mutex_lock (&main_thread_mutex);
+  while (!check (data))
+    {
+      if (is_main_thread && !g_queue_is_empty (&main_thread_calls))
+        gdk_main_thread_run_calls ();
+      else
+        g_cond_wait (&main_thread_cond, &main_thread_mutex);
+    }
+  g_mutex_unlock (&main_thread_mutex);
+}
+
+/*
+ * gdk_main_thread_wakeup:
+ *
+ * Wakes up threads in gdk_main_thread_wait_until() so they call
+ * their check function again.
+ */
+void
+gdk_main_thread_wakeup (void)
+{
+  g_mutex_lock (&main_thread_mutex);
+  g_cond_broadcast (&main_thread_cond);
+  g_mutex_unlock (&main_thread_mutex);
+}
@@ -48,6 +48,7 @@ struct _GdkDrawContextPrivate {
   GdkSurface *surface;
 
   cairo_region_t *frame_region;
+  guint resize_pending : 1;
 };
 
 enum {
@@ -234,10 +235,22 @@ gdk_draw_context_is_in_frame (GdkDrawContext *context)
  *
  * Called by the surface the @context belongs to when the size of the surface
  * changes.
+ *
+ * If this happens while a frame is in progress, which is possible when the
+ * frame is rendered in another thread, the resize is applied once the frame
+ * ends.
  */
 void
 gdk_draw_context_surface_resized (GdkDrawContext *context)
 {
+  GdkDrawContextPrivate *priv = gdk_draw_context_get_instance_private (context);
+
+  if (priv->frame_region)
+    {
+      priv->resize_pending = TRUE;
+      return;
+    }
+
   GDK_DRAW_CONTEXT_GET_CLASS (context)->surface_resized (context);
 }
 
@@ -451,6 +464,12 @@ gdk_draw_context_end_frame (GdkDrawContext *context)
 
   g_clear_pointer (&priv->frame_region, cairo_region_destroy);
   g_clear_object (&priv->surface->paint_context);
+
+  if (priv->resize_pending)
+    {
+      priv->resize_pending = FALSE;
+      gdk_draw_context_surface_resized (context);
+    }
 }
 
 /**
@@ -24,6 +24,7 @@
 #include "gdkglcontextprivate.h"
 #include "gdkmemoryformatprivate.h"
 #include "gdkmemorytextureprivate.h"
+#include "gdkprivate.h"
 
 #include <epoxy/gl.h>
 
@@ -86,7 +87,6 @@ typedef void (* GLFunc) (GdkGLTexture *self,
 typedef struct _InvokeData
 {
   GdkGLTexture *self;
-  volatile int spinlock;
   GLFunc func;
   gpointer data;
 } InvokeData;
@@ -109,8 +109,6 @@ gdk_gl_texture_invoke_callback (gpointer data)
 
   invoke->func (invoke->self, context, invoke->data);
 
-  g_atomic_int_set (&invoke->spinlock, 1);
-
   if (previous)
     gdk_gl_context_make_current (previous);
   else
@@ -124,11 +122,9 @@ gdk_gl_texture_run (GdkGLTexture *self,
                     GLFunc        func,
                     gpointer      data)
 {
-  InvokeData invoke = { self, 0, func, data };
-
-  g_main_context_invoke (NULL, gdk_gl_texture_invoke_callback, &invoke);
+  InvokeData invoke = { self, func, data };
 
-  while (g_atomic_int_get (&invoke.spinlock) == 0);
+  gdk_main_thread_invoke (gdk_gl_texture_invoke_callback, &invoke);
 }
 
 typedef struct _Download Download;
@@ -18,6 +18,14 @@ PangoDirection gdk_find_base_dir     (const char *text,
 void gdk_source_set_static_name_by_id (guint       tag,
                                        const char *name);
 
+typedef gboolean (* GdkMainThreadCheckFunc) (gpointer data);
+
+void gdk_main_thread_invoke     (GSourceFunc            func,
+                                 gpointer               data);
+void gdk_main_thread_wait_until (GdkMainThreadCheckFunc check,
+                                 gpointer               data);
+void gdk_main_thread_wakeup     (void);
+
 #ifndef I_
 #define I_(string) g_intern_static_string (string)
 #endif
@@ -47,23 +47,186 @@ gsk_gl_buffer_init (GskGLBuffer *self,
   self->element_size = element_size;
 }
 
+/**
+ * gsk_gl_buffer_set_persistent:
+ * @persistent: whether to use a persistently mapped buffer
+ *
+ * Makes the buffer stream its contents through a persistently mapped
+ * GL buffer instead of reallocating the GL buffer on every submit.
+ *
+ * This requires buffer storage and sync object support from the
+ * GL context and must be called before the first submit.
+ */
+void
+gsk_gl_buffer_set_persistent (GskGLBuffer *self,
+                              gboolean     persistent)
+{
+  g_assert (self->id == 0);
+
+  self->persistent = !!persistent;
+}
+
+static void
+gsk_gl_buffer_release (GskGLBuffer *buffer,
+                       guint       *n_calls)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (buffer->fences); i++)
+    {
+      if (buffer->fences[i])
+        {
+          glDeleteSync (buffer->fences[i]);
+          buffer->fences[i] = NULL;
+          *n_calls += 1;
+        }
+    }
+
+  if (buffer->mapped)
+    {
+      glBindBuffer (buffer->target, buffer->id);
+      glUnmapBuffer (buffer->target);
+      buffer->mapped = NULL;
+      *n_calls += 2;
+    }
+
+  if (buffer->id)
+    {
+      glDeleteBuffers (1, &buffer->id);
+      buffer->id = 0;
+      *n_calls += 1;
+    }
+
+  buffer->region_size = 0;
+  buffer->region = 0;
+}
+
+static gboolean
+gsk_gl_buffer_allocate_persistent (GskGLBuffer *buffer,
+                                   gsize        region_size,
+                                   guint       *n_calls)
+{
+  const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  gsk_gl_buffer_release (buffer, n_calls);
+
+  glGenBuffers (1, &buffer->id);
+  glBindBuffer (buffer->target, buffer->id);
+  glBufferStorage (buffer->target, region_size * GSK_GL_BUFFER_N_REGIONS, NULL, flags);
+  buffer->mapped = glMapBufferRange (buffer->target, 0, region_size * GSK_GL_BUFFER_N_REGIONS, flags);
+  *n_calls += 4;
+
+  if (buffer->mapped == NULL)
+    {
+      gsk_gl_buffer_release (buffer, n_calls);
+      return FALSE;
+    }
+
+  buffer->region_size = region_size;
+
+  return TRUE;
+}
+
+/**
+ * gsk_gl_buffer_submit:
+ * @offset: (out): return location for the byte offset of the data
+ *   within the returned buffer
+ * @n_calls: (inout): counter for the number of GL calls made
+ *
+ * Uploads the contents of the buffer to the GPU and resets it, so that
+ * it can be filled for the next frame.
+ *
+ * The returned GL buffer is bound and owned by @buffer.
+ *
+ * Returns: the id of the GL buffer containing the data
+ */
 GLuint
-gsk_gl_buffer_submit (GskGLBuffer *buffer)
+gsk_gl_buffer_submit (GskGLBuffer *buffer,
+                      gsize       *offset,
+                      guint       *n_calls)
 {
-  GLuint id;
+  if (buffer->persistent)
+    {
+      if (buffer->mapped == NULL || buffer->buffer_pos > buffer->region_size)
+        {
+          /* Size the regions like our staging buffer, which grows
+           * as needed and never shrinks.
+           */
+          if (!gsk_gl_buffer_allocate_persistent (buffer, buffer->buffer_len, n_calls))
+            {
+              buffer->persistent = FALSE;
+              return gsk_gl_buffer_submit (buffer, offset, n_calls);
+            }
+        }
+      else
+        {
+          buffer->region = (buffer->region + 1) % GSK_GL_BUFFER_N_REGIONS;
 
-  glGenBuffers (1, &id);
-  glBindBuffer (buffer->target, id);
-  glBufferData (buffer->target, buffer->buffer_pos, buffer->buffer, GL_STATIC_DRAW);
+          glBindBuffer (buffer->target, buffer->id);
+          *n_calls += 1;
+
+          /* Make sure the GPU is done with the frame that used this region */
+          if (buffer->fences[buffer->region])
+            {
+              glClientWaitSync (buffer->fences[buffer->region], GL_SYNC_FLUSH_COMMANDS_BIT, G_MAXINT64);
+              glDeleteSync (buffer->fences[buffer->region]);
+              buffer->fences[buffer->region] = NULL;
+              *n_calls += 2;
+            }
+        }
+
+      *offset = buffer->region * buffer->region_size;
+      memcpy (buffer->mapped + *offset, buffer->buffer, buffer->buffer_pos);
+    }
+  else
+    {
+      if (buffer->id == 0)
+        {
+          glGenBuffers (1, &buffer->id);
+          *n_calls += 1;
+        }
+
+      /* Respecifying the data store lets the driver orphan the old one
+       * if it is still in use, instead of waiting for it.
+       */
+      glBindBuffer (buffer->target, buffer->id);
+      glBufferData (buffer->target, buffer->buffer_pos, buffer->buffer, GL_STREAM_DRAW);
+      *n_calls += 2;
+
+      *offset = 0;
+    }
 
   buffer->buffer_pos = 0;
   buffer->count = 0;
 
-  return id;
+  return buffer->id;
+}
+
+/**
+ * gsk_gl_buffer_fence:
+ * @n_calls: (inout): counter for the number of GL calls made
+ *
+ * Marks the end of the commands that use the data of the last submit.
+ *
+ * For persistently mapped buffers, this inserts a fence, so that the
+ * region is not overwritten while the GPU still reads from it.
+ */
+void
+gsk_gl_buffer_fence (GskGLBuffer *buffer,
+                     guint       *n_calls)
+{
+  if (!buffer->persistent || buffer->mapped == NULL)
+    return;
+
+  g_assert (buffer->fences[buffer->region] == NULL);
+
+  buffer->fences[buffer->region] = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  *n_calls += 1;
 }
 
 void
 gsk_gl_buffer_destroy (GskGLBuffer *buffer)
 {
+  guint n_calls = 0;
+
+  gsk_gl_buffer_release (buffer, &n_calls);
   g_clear_pointer (&buffer->buffer, g_free);
 }
@@ -24,6 +24,8 @@
 
 G_BEGIN_DECLS
 
+#define GSK_GL_BUFFER_N_REGIONS 3
+
 typedef struct _GskGLBuffer
 {
   guint8 *buffer;
@@ -32,13 +34,31 @@ typedef struct _GskGLBuffer
   guint   count;
   GLenum  target;
   gsize   element_size;
+
+  /* The GL buffer object we stream into. It is kept around across
+   * frames. When persistently mapped, it is split into
+   * GSK_GL_BUFFER_N_REGIONS regions that are used in turn, each
+   * guarded by a fence until the GPU is done with it.
+   */
+  GLuint  id;
+  gsize   region_size;
+  guint8 *mapped;
+  guint   region;
+  GLsync  fences[GSK_GL_BUFFER_N_REGIONS];
+  guint   persistent : 1;
 } GskGLBuffer;
 
-void   gsk_gl_buffer_init    (GskGLBuffer *self,
-                              GLenum       target,
-                              guint        element_size);
-void   gsk_gl_buffer_destroy (GskGLBuffer *buffer);
-GLuint gsk_gl_buffer_submit  (GskGLBuffer *buffer);
+void   gsk_gl_buffer_init           (GskGLBuffer *self,
+                                     GLenum       target,
+                                     guint        element_size);
+void   gsk_gl_buffer_set_persistent (GskGLBuffer *self,
+                                     gboolean     persistent);
+void   gsk_gl_buffer_destroy        (GskGLBuffer *buffer);
+GLuint gsk_gl_buffer_submit         (GskGLBuffer *buffer,
+                                     gsize       *offset,
+                                     guint       *n_calls);
+void   gsk_gl_buffer_fence          (GskGLBuffer *buffer,
+                                     guint       *n_calls);
 
 static inline gpointer
 gsk_gl_buffer_advance (GskGLBuffer *buffer,
@@ -143,7 +143,8 @@ print_uniform (GskGLUniformFormat format,
 
 G_GNUC_UNUSED static inline void
 gsk_gl_command_queue_print_batch (GskGLCommandQueue       *self,
-                                  const GskGLCommandBatch *batch)
+                                  const GskGLCommandBatch *batch,
+                                  guint                    n_merged)
 {
   static const char *command_kinds[] = { "Clear", "Draw", };
   guint framebuffer_id;
@@ -167,6 +168,8 @@ gsk_gl_command_queue_print_batch (GskGLCommandQueue       *self,
     {
       g_printerr ("      Program: %d\n", batch->any.program);
       g_printerr ("     Vertices: %d\n", batch->draw.vbo_count);
+      if (n_merged > 1)
+        g_printerr ("       Merged: %u draws\n", n_merged);
 
       for (guint i = 0; i < batch->draw.bind_count; i++)
         {
@@ -323,9 +326,9 @@ snapshot_uniforms (GskGLUniformState    *state,
 }
 
 static inline gboolean
-snapshots_equal (GskGLCommandQueue *self,
-                 GskGLCommandBatch *first,
-                 GskGLCommandBatch *second)
+snapshots_equal (GskGLCommandQueue       *self,
+                 const GskGLCommandBatch *first,
+                 const GskGLCommandBatch *second)
 {
   if (first->draw.bind_count != second->draw.bind_count ||
       first->draw.uniform_count != second->draw.uniform_count)
@@ -413,6 +416,23 @@ snapshots_equal (GskGLCommandQueue *self,
   return TRUE;
 }
 
+/* Checks if @second can be drawn together with @first, because it
+ * would not change any state that applying @first left behind.
+ */
+static inline gboolean
+can_merge_draws (GskGLCommandQueue       *self,
+                 const GskGLCommandBatch *first,
+                 const GskGLCommandBatch *second)
+{
+  return second->any.kind == GSK_GL_COMMAND_KIND_DRAW &&
+         first->any.program == second->any.program &&
+         first->any.viewport.width == second->any.viewport.width &&
+         first->any.viewport.height == second->any.viewport.height &&
+         first->draw.blend == second->draw.blend &&
+         first->draw.framebuffer == second->draw.framebuffer &&
+         snapshots_equal (self, first, second);
+}
+
 static void
 gsk_gl_command_queue_dispose (GObject *object)
 {
@@ -502,6 +522,12 @@ gsk_gl_command_queue_new (GdkGLContext      *context,
 
   self->has_samplers = gdk_gl_context_check_version (context, "3.3", "3.0");
   self->can_swizzle = gdk_gl_context_check_version (context, "3.0", "3.0");
+  self->has_multi_draw = epoxy_is_desktop_gl () || epoxy_has_gl_extension ("GL_EXT_multi_draw_arrays");
+
+  /* Stream vertices through a persistently mapped buffer if we can */
+  gsk_gl_buffer_set_persistent (&self->vertices,
+                                gdk_gl_context_has_feature (context, GDK_GL_FEATURE_BUFFER_STORAGE) &&
+                                gdk_gl_context_has_feature (context, GDK_GL_FEATURE_SYNC));
 
   /* create the samplers */
   if (self->has_samplers)
@@ -812,13 +838,15 @@ static inline void
 apply_viewport (guint *current_width,
                 guint *current_height,
                 guint  width,
-                guint  height)
+                guint  height,
+                guint *n_calls)
 {
   if G_UNLIKELY (*current_width != width || *current_height != height)
     {
       *current_width = width;
       *current_height = height;
       glViewport (0, 0, width, height);
+      *n_calls += 1;
     }
 }
 
@@ -827,7 +855,8 @@ apply_scissor (gboolean              *state,
                guint                  framebuffer,
                const graphene_rect_t *scissor,
                gboolean               has_scissor,
-               guint                  default_framebuffer)
+               guint                  default_framebuffer,
+               guint                 *n_calls)
 {
   g_assert (framebuffer != (guint)-1);
 
@@ -837,6 +866,7 @@ apply_scissor (gboolean              *state,
         {
           glDisable (GL_SCISSOR_TEST);
           *state = FALSE;
+          *n_calls += 1;
         }
     }
   else
@@ -849,18 +879,21 @@ apply_scissor (gboolean              *state,
                      scissor->size.width,
                      scissor->size.height);
           *state = TRUE;
+          *n_calls += 2;
         }
     }
 }
 
 static inline gboolean
 apply_framebuffer (int   *framebuffer,
-                   guint  new_framebuffer)
+                   guint  new_framebuffer,
+                   guint *n_calls)
 {
   if G_UNLIKELY (new_framebuffer != *framebuffer)
     {
       *framebuffer = new_framebuffer;
       glBindFramebuffer (GL_FRAMEBUFFER, new_framebuffer);
+      *n_calls += 1;
       return TRUE;
     }
 
@@ -1042,8 +1075,13 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
   G_GNUC_UNUSED unsigned int n_fbos = 0;
   G_GNUC_UNUSED unsigned int n_uniforms = 0;
   G_GNUC_UNUSED unsigned int n_programs = 0;
+  G_GNUC_UNUSED unsigned int n_draws = 0;
+  G_GNUC_UNUSED unsigned int n_merged = 0;
+  GLint merged_firsts[64];
+  GLsizei merged_counts[64];
+  guint n_gl_calls = 0;
   guint vao_id;
-  guint vbo_id;
+  gsize vbo_offset;
   int textures[GSK_GL_MAX_TEXTURES_PER_PROGRAM];
   int samplers[GSK_GL_MAX_TEXTURES_PER_PROGRAM];
   int framebuffer = -1;
@@ -1074,38 +1112,41 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
   glEnable (GL_BLEND);
   glBlendFunc (GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
   glBlendEquation (GL_FUNC_ADD);
+  n_gl_calls += 4;
 
   if (gdk_gl_context_has_vertex_arrays (self->context))
     {
       glGenVertexArrays (1, &vao_id);
       glBindVertexArray (vao_id);
+      n_gl_calls += 2;
     }
 
-  vbo_id = gsk_gl_buffer_submit (&self->vertices);
+  gsk_gl_buffer_submit (&self->vertices, &vbo_offset, &n_gl_calls);
 
   /* 0 = position location */
   glEnableVertexAttribArray (0);
   glVertexAttribPointer (0, 2, GL_FLOAT, GL_FALSE,
                          sizeof (GskGLDrawVertex),
-                         (void *) G_STRUCT_OFFSET (GskGLDrawVertex, position));
+                         (void *) (vbo_offset + G_STRUCT_OFFSET (GskGLDrawVertex, position)));
 
   /* 1 = texture coord location */
   glEnableVertexAttribArray (1);
   glVertexAttribPointer (1, 2, GL_FLOAT, GL_FALSE,
                          sizeof (GskGLDrawVertex),
-                         (void *) G_STRUCT_OFFSET (GskGLDrawVertex, uv));
+                         (void *) (vbo_offset + G_STRUCT_OFFSET (GskGLDrawVertex, uv)));
 
   /* 2 = color location */
   glEnableVertexAttribArray (2);
   glVertexAttribPointer (2, 4, GL_HALF_FLOAT, GL_FALSE,
                          sizeof (GskGLDrawVertex),
-                         (void *) G_STRUCT_OFFSET (GskGLDrawVertex, color));
+                         (void *) (vbo_offset + G_STRUCT_OFFSET (GskGLDrawVertex, color)));
 
   /* 3 = color2 location */
   glEnableVertexAttribArray (3);
   glVertexAttribPointer (3, 4, GL_HALF_FLOAT, GL_FALSE,
                          sizeof (GskGLDrawVertex),
-                         (void *) G_STRUCT_OFFSET (GskGLDrawVertex, color2));
+                         (void *) (vbo_offset + G_STRUCT_OFFSET (GskGLDrawVertex, color2)));
+  n_gl_calls += 8;
 
   /* Setup initial scissor clip */
   if (scissor != NULL && cairo_region_num_rectangles (scissor) > 0)
@@ -1136,19 +1177,21 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
       switch (batch->any.kind)
         {
         case GSK_GL_COMMAND_KIND_CLEAR:
-          if (apply_framebuffer (&framebuffer, batch->clear.framebuffer))
+          if (apply_framebuffer (&framebuffer, batch->clear.framebuffer, &n_gl_calls))
             {
-              apply_scissor (&scissor_state, framebuffer, &scissor_test, has_scissor, default_framebuffer);
+              apply_scissor (&scissor_state, framebuffer, &scissor_test, has_scissor, default_framebuffer, &n_gl_calls);
               n_fbos++;
             }
 
           apply_viewport (&width,
                           &height,
                           batch->any.viewport.width,
-                          batch->any.viewport.height);
+                          batch->any.viewport.height,
+                          &n_gl_calls);
 
           glClearColor (0, 0, 0, 0);
           glClear (batch->clear.bits);
+          n_gl_calls += 2;
         break;
 
         case GSK_GL_COMMAND_KIND_DRAW:
@@ -1156,20 +1199,22 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
             {
               program = batch->any.program;
               glUseProgram (program);
+              n_gl_calls++;
 
               n_programs++;
             }
 
-          if (apply_framebuffer (&framebuffer, batch->draw.framebuffer))
+          if (apply_framebuffer (&framebuffer, batch->draw.framebuffer, &n_gl_calls))
             {
-              apply_scissor (&scissor_state, framebuffer, &scissor_test, has_scissor, default_framebuffer);
+              apply_scissor (&scissor_state, framebuffer, &scissor_test, has_scissor, default_framebuffer, &n_gl_calls);
               n_fbos++;
             }
 
           apply_viewport (&width,
                           &height,
                           batch->any.viewport.width,
-                          batch->any.viewport.height);
+                          batch->any.viewport.height,
+                          &n_gl_calls);
 
           if G_UNLIKELY (batch->draw.bind_count > 0)
             {
@@ -1186,6 +1231,7 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
                         {
                           active = bind->texture;
                           glActiveTexture (GL_TEXTURE0 + bind->texture);
+                          n_gl_calls++;
                         }
 
                       s = gsk_gl_syncs_get_sync (&self->syncs, bind->id);
@@ -1193,6 +1239,7 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
                         {
                           glWaitSync ((GLsync) s->sync, 0, GL_TIMEOUT_IGNORED);
                           s->sync = NULL;
+                          n_gl_calls++;
                         }
 
                       if (bind->sampler == SAMPLER_EXTERNAL)
@@ -1200,8 +1247,10 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
                       else
                         glBindTexture (GL_TEXTURE_2D, bind->id);
                       textures[bind->texture] = bind->id;
+                      n_gl_calls++;
                       if (!self->has_samplers)
                         {
+                          n_gl_calls += 2;
                           if (bind->sampler == SAMPLER_EXTERNAL)
                             {
                               glTexParameteri (GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -1218,9 +1267,13 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
                   if (samplers[bind->texture] != bind->sampler)
                     {
                       if (self->has_samplers)
-                        glBindSampler (bind->texture, self->samplers[bind->sampler]);
+                        {
+                          glBindSampler (bind->texture, self->samplers[bind->sampler]);
+                          n_gl_calls++;
+                        }
                       else
                         {
+                          n_gl_calls += 2;
                           if (bind->sampler == SAMPLER_EXTERNAL)
                             {
                               glTexParameteri (GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -1246,18 +1299,56 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
               const GskGLCommandUniform *u = &self->batch_uniforms.items[batch->draw.uniform_offset];
 
               for (guint i = 0; i < batch->draw.uniform_count; i++, u++)
-                gsk_gl_uniform_state_apply (self->uniforms, program, u->location, u->info);
+                gsk_gl_uniform_state_apply (self->uniforms, program, u->location, u->info, &n_gl_calls);
 
               n_uniforms += batch->draw.uniform_count;
             }
 
+          /* Sorting may have put batches next to each other that share
+           * all of their state, but not their vertices. Draw them with
+           * a single call.
+           */
+          n_merged = 1;
+          if (self->has_multi_draw)
+            {
+              merged_firsts[0] = batch->draw.vbo_offset;
+              merged_counts[0] = batch->draw.vbo_count;
+
+              while (batch->any.next_batch_index >= 0 &&
+                     n_merged < G_N_ELEMENTS (merged_firsts))
+                {
+                  const GskGLCommandBatch *next = &self->batches.items[batch->any.next_batch_index];
+
+                  if (!can_merge_draws (self, batch, next))
+                    break;
+
+                  merged_firsts[n_merged] = next->draw.vbo_offset;
+                  merged_counts[n_merged] = next->draw.vbo_count;
+                  n_merged++;
+
+                  next_batch_index = batch->any.next_batch_index;
+                  batch = next;
+                }
+            }
+
           if (batch->draw.blend == 0)
-            glDisable (GL_BLEND);
+            {
+              glDisable (GL_BLEND);
+              n_gl_calls++;
+            }
 
-          glDrawArrays (GL_TRIANGLES, batch->draw.vbo_offset, batch->draw.vbo_count);
+          if (n_merged > 1)
+            glMultiDrawArrays (GL_TRIANGLES, merged_firsts, merged_counts, n_merged);
+          else
+            glDrawArrays (GL_TRIANGLES, batch->draw.vbo_offset, batch->draw.vbo_count);
+          n_gl_calls++;
+          n_draws++;
 
           if (batch->draw.blend == 0)
-            glEnable (GL_BLEND);
+            {
+              glEnable (GL_BLEND);
+              n_gl_calls++;
+            }
         break;
 
         default:
@@ -1278,16 +1369,20 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
                       framebuffer,
                       gdk_gl_context_get_current ());
           gsk_gl_command_queue_capture_png (self, filename, width, height, TRUE);
-          gsk_gl_command_queue_print_batch (self, batch);
+          gsk_gl_command_queue_print_batch (self, batch, batch->any.kind == GSK_GL_COMMAND_KIND_DRAW ? n_merged : 0);
         }
 #endif
 
       next_batch_index = batch->any.next_batch_index;
     }
 
-  glDeleteBuffers (1, &vbo_id);
+  gsk_gl_buffer_fence (&self->vertices, &n_gl_calls);
+
   if (gdk_gl_context_has_vertex_arrays (self->context))
-    glDeleteVertexArrays (1, &vao_id);
+    {
+      glDeleteVertexArrays (1, &vao_id);
+      n_gl_calls++;
+    }
 
   gdk_profiler_set_int_counter (self->metrics.n_binds, n_binds);
   gdk_profiler_set_int_counter (self->metrics.n_uniforms, n_uniforms);
@@ -1295,6 +1390,8 @@ gsk_gl_command_queue_execute (GskGLCommandQueue    *self,
   gdk_profiler_set_int_counter (self->metrics.n_programs, n_programs);
   gdk_profiler_set_int_counter (self->metrics.n_uploads, self->n_uploads);
   gdk_profiler_set_int_counter (self->metrics.queue_depth, self->batches.len);
+  gdk_profiler_set_int_counter (self->metrics.n_draws, n_draws);
+  gdk_profiler_set_int_counter (self->metrics.n_gl_calls, n_gl_calls);
 
   {
     gint64 start_time G_GNUC_UNUSED = gsk_profiler_timer_get_start (self->profiler, self->metrics.cpu_time);
@@ -1640,6 +1737,8 @@ gsk_gl_command_queue_do_upload_texture_chunk (GskGLCommandQueue *self,
 
   glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
 
+  gsk_gl_command_queue_add_upload_bytes (self, (gsize) width * height * bpp);
+
   /* Only apply swizzle if really needed, might not even be
    * supported if default values are set
    */
@@ -1660,6 +1759,16 @@ gsk_gl_command_queue_do_upload_texture_chunk (GskGLCommandQueue *self,
                             "Tile %dx%d Size %dx%d", x, y, width, height);
 }
 
+void
+gsk_gl_command_queue_add_upload_bytes (GskGLCommandQueue *self,
+                                       gsize              n_bytes)
+{
+  g_assert (GSK_IS_GL_COMMAND_QUEUE (self));
+
+  if (self->profiler)
+    gsk_profiler_counter_add (self->profiler, self->metrics.upload_bytes, n_bytes);
+}
+
 int
 gsk_gl_command_queue_upload_texture_chunks (GskGLCommandQueue    *self,
                                             gboolean              ensure_mipmap,
@@ -1765,6 +1874,8 @@ gsk_gl_command_queue_set_profiler (GskGLCommandQueue *self,
       self->metrics.n_frames = gsk_profiler_add_counter (profiler, "frames", "Frames", FALSE);
       self->metrics.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU Time", FALSE, TRUE);
       self->metrics.gpu_time = gsk_profiler_add_timer (profiler, "gpu-time", "GPU Time", FALSE, TRUE);
+      /* Added by GskRenderer, see gsk_renderer_add_upload_bytes() */
+      self->metrics.upload_bytes = g_quark_from_static_string ("upload-bytes");
 
       self->metrics.n_binds = gdk_profiler_define_int_counter ("attachments", "Number of texture attachments");
       self->metrics.n_fbos = gdk_profiler_define_int_counter ("fbos", "Number of framebuffers attached");
@@ -1772,5 +1883,7 @@ gsk_gl_command_queue_set_profiler (GskGLCommandQueue *self,
       self->metrics.n_uploads = gdk_profiler_define_int_counter ("uploads", "Number of texture uploads");
       self->metrics.n_programs = gdk_profiler_define_int_counter ("programs", "Number of program changes");
       self->metrics.queue_depth = gdk_profiler_define_int_counter ("gl-queue-depth", "Depth of GL command batches");
+      self->metrics.n_draws = gdk_profiler_define_int_counter ("draws", "Number of draw calls");
+      self->metrics.n_gl_calls = gdk_profiler_define_int_counter ("gl-calls", "Number of GL calls while executing");
     }
 }
@@ -196,8 +196,8 @@ struct _GskGLCommandQueue
   GskGLCommandBatches batches;
 
   /* Contains array of vertices and some wrapper code to help upload them
-   * to the GL driver. We can also tweak this to use double buffered arrays
-   * if we find that to be faster on some hardware and/or drivers.
+   * to the GL driver. If the context supports it, the vertices are streamed
+   * through a persistently mapped ring buffer.
    */
   GskGLBuffer vertices;
 
@@ -272,12 +272,15 @@ struct _GskGLCommandQueue
     GQuark n_frames;
     GQuark cpu_time;
     GQuark gpu_time;
+    GQuark upload_bytes;
     guint n_binds;
     guint n_fbos;
     guint n_uniforms;
     guint n_uploads;
     guint n_programs;
     guint queue_depth;
+    guint n_draws;
+    guint n_gl_calls;
   } metrics;
 
   /* Counter for uploads on the frame */
@@ -289,6 +292,9 @@ struct _GskGLCommandQueue
   /* If the GL context is new enough to support swizzling (ie is not GLES2) */
   guint can_swizzle : 1;
 
+  /* If the GL context supports glMultiDrawArrays() */
+  guint has_multi_draw : 1;
+
   /* If we're inside a begin/end_frame pair */
   guint in_frame : 1;
 
@@ -316,6 +322,8 @@ int                 gsk_gl_command_queue_upload_texture       (GskGLCommandQueue
                                                                GdkTexture           *texture,
                                                                gboolean              ensure_mipmap,
                                                                gboolean             *out_can_mipmap);
+void                gsk_gl_command_queue_add_upload_bytes     (GskGLCommandQueue    *self,
+                                                               gsize                 n_bytes);
 int                 gsk_gl_command_queue_create_texture       (GskGLCommandQueue    *self,
                                                                int                   width,
                                                                int                   height,
@@ -206,6 +206,7 @@ gsk_gl_icon_library_add (GskGLIconLibrary     *self,
   g_free (free_data);
 
   tl->driver->command_queue->n_uploads++;
+  gsk_gl_command_queue_add_upload_bytes (tl->driver->command_queue, (gsize) width * height * 4);
 
   if (gdk_profiler_is_running ())
     {
@@ -721,6 +721,7 @@ gsk_gl_uniform_state_fmix (guint program,
  * @location: the location of the uniform
  * @offset: the offset of the data within the buffer
  * @info: the uniform info
+ * @n_calls: (inout): counter for the number of GL calls made
  *
  * This function can be used to apply state that was previously recorded
  * by the `GskGLUniformState`.
@@ -732,7 +733,8 @@ static inline void
 gsk_gl_uniform_state_apply (GskGLUniformState *state,
                             guint              program,
                             guint              location,
-                            GskGLUniformInfo   info)
+                            GskGLUniformInfo   info,
+                            guint             *n_calls)
 {
   guint index = gsk_gl_uniform_state_fmix (program, location) % G_N_ELEMENTS (state->apply_hash);
   gconstpointer dataptr = GSK_GL_UNIFORM_VALUE (state->values_buf, info.offset);
@@ -742,6 +744,7 @@ gsk_gl_uniform_state_apply (GskGLUniformState *state,
     return;
 
   state->apply_hash[index] = info;
+  *n_calls += 1;
 
   /* TODO: We could do additional comparisons here to make sure we are
    *       changing state.
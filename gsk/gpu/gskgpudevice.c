@@ -2,16 +2,21 @@
 
 #include "gskgpudeviceprivate.h"
 
+#include "gskgpublitopprivate.h"
 #include "gskgpuframeprivate.h"
 #include "gskgpuimageprivate.h"
 #include "gskgpuuploadopprivate.h"
 
 #include "gdk/gdkdisplayprivate.h"
+#include "gdk/gdkmemoryformatprivate.h"
 #include "gdk/gdktextureprivate.h"
 #include "gdk/gdkprofilerprivate.h"
+#include "gdk/gdkprivate.h"
 
 #include "gsk/gskdebugprivate.h"
+#include "gsk/gskpathprivate.h"
 #include "gsk/gskprivate.h"
+#include "gsk/gskstrokeprivate.h"
 
 #define MAX_SLICES_PER_ATLAS 64
 
@@ -21,15 +26,28 @@
 
 #define MAX_DEAD_PIXELS (ATLAS_SIZE * ATLAS_SIZE / 2)
 
+/* Once an atlas has this many dead pixels, glyphs that are still in use
+ * get copied to the current atlas on the GPU, so they don't need to be
+ * uploaded again when the atlas gets collected.
+ */
+#define MOVE_DEAD_PIXELS (ATLAS_SIZE * ATLAS_SIZE / 4)
+
 #define CACHE_TIMEOUT 15  /* seconds */
 
+/* Upper limit for pixels held by rasterized paths, so that animated
+ * paths don't fill up memory until the gc catches up with them.
+ */
+#define MAX_CACHED_PATH_PIXELS (4 * ATLAS_SIZE * ATLAS_SIZE)
+
 G_STATIC_ASSERT (MAX_ATLAS_ITEM_SIZE < ATLAS_SIZE);
 G_STATIC_ASSERT (MAX_DEAD_PIXELS < ATLAS_SIZE * ATLAS_SIZE);
+G_STATIC_ASSERT (MOVE_DEAD_PIXELS < MAX_DEAD_PIXELS);
 
 typedef struct _GskGpuCached GskGpuCached;
 typedef struct _GskGpuCachedClass GskGpuCachedClass;
 typedef struct _GskGpuCachedAtlas GskGpuCachedAtlas;
 typedef struct _GskGpuCachedGlyph GskGpuCachedGlyph;
+typedef struct _GskGpuCachedPath GskGpuCachedPath;
 typedef struct _GskGpuCachedTexture GskGpuCachedTexture;
 typedef struct _GskGpuDevicePrivate GskGpuDevicePrivate;
 
@@ -45,10 +63,15 @@ struct _GskGpuDevicePrivate
 
   GHashTable *texture_cache;
   GHashTable *glyph_cache;
+  GHashTable *path_cache;
+  gsize path_cache_pixels;
 
   GskGpuCachedAtlas *current_atlas;
+  guint n_moved_glyphs;
 
   /* atomic */ gsize dead_texture_pixels;
+  /* atomic */ GThread *lock_owner;
+  guint lock_depth;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GskGpuDevice, gsk_gpu_device, G_TYPE_OBJECT)
@@ -236,6 +259,18 @@ gsk_gpu_cached_atlas_new (GskGpuDevice *device)
   return self;
 }
 
+static gsize
+gsk_gpu_cached_atlas_get_allocated_pixels (GskGpuCachedAtlas *self)
+{
+  gsize i, result;
+
+  result = 0;
+  for (i = 0; i < self->n_slices; i++)
+    result += self->slices[i].width * self->slices[i].height;
+
+  return result;
+}
+
 /* }}} */
 /* {{{ CachedTexture */
 
@@ -434,6 +469,88 @@ static const GskGpuCachedClass GSK_GPU_CACHED_GLYPH_CLASS =
   gsk_gpu_cached_glyph_should_collect
 };
 
+/* }}} */
+/* {{{ CachedPath */
+
+struct _GskGpuCachedPath
+{
+  GskGpuCached parent;
+
+  GskPath *path;
+  GskFillRule fill_rule;
+  GskStroke stroke; /* line_width == 0 for fills */
+  float scale_x;
+  float scale_y;
+  graphene_rect_t viewport;
+
+  GskGpuImage *image;
+};
+
+static void
+gsk_gpu_cached_path_free (GskGpuDevice *device,
+                          GskGpuCached *cached)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (device);
+  GskGpuCachedPath *self = (GskGpuCachedPath *) cached;
+
+  g_hash_table_remove (priv->path_cache, self);
+  priv->path_cache_pixels -= cached->pixels;
+
+  gsk_path_unref (self->path);
+  gsk_stroke_clear (&self->stroke);
+  g_object_unref (self->image);
+
+  g_free (self);
+}
+
+static gboolean
+gsk_gpu_cached_path_should_collect (GskGpuDevice *device,
+                                    GskGpuCached *cached,
+                                    gint64        timestamp)
+{
+  return gsk_gpu_cached_is_old (device, cached, timestamp);
+}
+
+static guint
+gsk_gpu_cached_path_hash (gconstpointer data)
+{
+  const GskGpuCachedPath *path = data;
+  guint hash;
+
+  hash = GPOINTER_TO_UINT (path->path) ^ path->fill_rule;
+  hash = (hash << 5) - hash + (guint) (path->stroke.line_width * 256);
+  hash = (hash << 5) - hash + (guint) (path->scale_x * 256);
+  hash = (hash << 5) - hash + (guint) (path->scale_y * 256);
+  hash = (hash << 5) - hash + (int) path->viewport.origin.x;
+  hash = (hash << 5) - hash + (int) path->viewport.origin.y;
+  hash = (hash << 5) - hash + (int) path->viewport.size.width;
+  hash = (hash << 5) - hash + (int) path->viewport.size.height;
+
+  return hash;
+}
+
+static gboolean
+gsk_gpu_cached_path_equal (gconstpointer v1,
+                           gconstpointer v2)
+{
+  const GskGpuCachedPath *path1 = v1;
+  const GskGpuCachedPath *path2 = v2;
+
+  return path1->path == path2->path
+      && path1->fill_rule == path2->fill_rule
+      && path1->scale_x == path2->scale_x
+      && path1->scale_y == path2->scale_y
+      && graphene_rect_equal (&path1->viewport, &path2->viewport)
+      && gsk_stroke_equal (&path1->stroke, &path2->stroke);
+}
+
+static const GskGpuCachedClass GSK_GPU_CACHED_PATH_CLASS =
+{
+  sizeof (GskGpuCachedPath),
+  gsk_gpu_cached_path_free,
+  gsk_gpu_cached_path_should_collect
+};
+
 /* }}} */
 /* {{{ GskGpuDevice */
 
@@ -445,7 +562,9 @@ print_cache_stats (GskGpuDevice *self)
   guint glyphs = 0;
   guint stale_glyphs = 0;
   guint textures = 0;
+  guint paths = 0;
   guint atlases = 0;
+  gsize atlas_bytes = 0;
   GString *ratios = g_string_new ("");
 
   for (cached = priv->first_cached; cached != NULL; cached = cached->next)
@@ -460,19 +579,26 @@ print_cache_stats (GskGpuDevice *self)
         {
           textures++;
         }
+      else if (cached->class == &GSK_GPU_CACHED_PATH_CLASS)
+        {
+          paths++;
+        }
       else if (cached->class == &GSK_GPU_CACHED_ATLAS_CLASS)
         {
-          double ratio;
+          GskGpuCachedAtlas *atlas = (GskGpuCachedAtlas *) cached;
+          double ratio, used;
 
           atlases++;
+          atlas_bytes += ATLAS_SIZE * ATLAS_SIZE * gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (atlas->image));
 
           ratio = (double) cached->pixels / (double) (ATLAS_SIZE * ATLAS_SIZE);
+          used = (double) gsk_gpu_cached_atlas_get_allocated_pixels (atlas) / (double) (ATLAS_SIZE * ATLAS_SIZE) - ratio;
 
           if (ratios->len == 0)
-            g_string_append (ratios, " (ratios ");
+            g_string_append (ratios, " (dead/live ");
           else
             g_string_append (ratios, ", ");
-          g_string_append_printf (ratios, "%.2f", ratio);
+          g_string_append_printf (ratios, "%.2f/%.2f", ratio, used);
         }
     }
 
@@ -480,14 +606,18 @@ print_cache_stats (GskGpuDevice *self)
     g_string_append (ratios, ")");
 
   gdk_debug_message ("Cached items\n"
-                     "  glyphs:   %5u (%u stale)\n"
+                     "  glyphs:   %5u (%u stale, %u moved)\n"
                      "  textures: %5u (%u in hash)\n"
-                     "  atlases:  %5u%s",
-                     glyphs, stale_glyphs,
+                     "  paths:    %5u (%" G_GSIZE_FORMAT " pixels)\n"
+                     "  atlases:  %5u (%" G_GSIZE_FORMAT " kB)%s",
+                     glyphs, stale_glyphs, priv->n_moved_glyphs,
                      textures, g_hash_table_size (priv->texture_cache),
-                     atlases, ratios->str);
+                     paths, priv->path_cache_pixels,
+                     atlases, atlas_bytes / 1024, ratios->str);
 
   g_string_free (ratios, TRUE);
+
+  priv->n_moved_glyphs = 0;
 }
 
 static void
@@ -526,13 +656,63 @@ cache_gc_cb (gpointer data)
 
   GSK_DEBUG (GLYPH_CACHE, "Periodic GC");
 
+  gsk_gpu_device_lock (self);
+
   gsk_gpu_device_gc (self, g_get_monotonic_time ());
 
   priv->cache_gc_source = 0;
 
+  gsk_gpu_device_unlock (self);
+
   return G_SOURCE_REMOVE;
 }
 
+static gboolean
+gsk_gpu_device_try_lock (gpointer data)
+{
+  GskGpuDevicePrivate *priv = data;
+
+  return g_atomic_pointer_compare_and_exchange (&priv->lock_owner, NULL, g_thread_self ());
+}
+
+/* The device may be used by a renderer's render thread while the main
+ * thread works on the next frame, so everything that renders or touches
+ * the caches must hold the device lock.
+ *
+ * The lock is recursive, because rendering a dmabuf texture may end
+ * up downloading it with another renderer for the same device.
+ */
+void
+gsk_gpu_device_lock (GskGpuDevice *self)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  if (g_atomic_pointer_get (&priv->lock_owner) == g_thread_self ())
+    {
+      priv->lock_depth++;
+      return;
+    }
+
+  gdk_main_thread_wait_until (gsk_gpu_device_try_lock, priv);
+}
+
+void
+gsk_gpu_device_unlock (GskGpuDevice *self)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+
+  g_assert (g_atomic_pointer_get (&priv->lock_owner) == g_thread_self ());
+
+  if (priv->lock_depth > 0)
+    {
+      priv->lock_depth--;
+      return;
+    }
+
+  g_atomic_pointer_set (&priv->lock_owner, NULL);
+  gdk_main_thread_wakeup ();
+}
+
 void
 gsk_gpu_device_maybe_gc (GskGpuDevice *self)
 {
@@ -592,6 +772,7 @@ gsk_gpu_device_dispose (GObject *object)
 
   gsk_gpu_device_clear_cache (self);
   g_hash_table_unref (priv->glyph_cache);
+  g_hash_table_unref (priv->path_cache);
   g_hash_table_unref (priv->texture_cache);
   g_clear_handle_id (&priv->cache_gc_source, g_source_remove);
 
@@ -625,6 +806,8 @@ gsk_gpu_device_init (GskGpuDevice *self)
 
   priv->glyph_cache = g_hash_table_new (gsk_gpu_cached_glyph_hash,
                                         gsk_gpu_cached_glyph_equal);
+  priv->path_cache = g_hash_table_new (gsk_gpu_cached_path_hash,
+                                       gsk_gpu_cached_path_equal);
   priv->texture_cache = g_hash_table_new (g_direct_hash,
                                           g_direct_equal);
 }
@@ -882,6 +1065,113 @@ gsk_gpu_device_cache_texture_image (GskGpuDevice *self,
   gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
 }
 
+static gboolean
+gsk_gpu_device_should_move_glyph (GskGpuDevice      *self,
+                                  GskGpuFrame       *frame,
+                                  GskGpuCachedGlyph *glyph)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedAtlas *atlas = ((GskGpuCached *) glyph)->atlas;
+  GskGpuImageFlags flags;
+
+  if (atlas == NULL ||
+      atlas == priv->current_atlas ||
+      ((GskGpuCached *) atlas)->pixels < MOVE_DEAD_PIXELS)
+    return FALSE;
+
+  if (!gsk_gpu_frame_should_optimize (frame, GSK_GPU_OPTIMIZE_BLIT))
+    return FALSE;
+
+  flags = gsk_gpu_image_get_flags (atlas->image);
+
+  return (flags & (GSK_GPU_IMAGE_NO_BLIT | GSK_GPU_IMAGE_RENDERABLE)) == GSK_GPU_IMAGE_RENDERABLE;
+}
+
+/* Copies a glyph that is still in use out of an atlas that is mostly
+ * dead, so it survives the atlas getting collected.
+ */
+static void
+gsk_gpu_device_move_glyph (GskGpuDevice      *self,
+                           GskGpuFrame       *frame,
+                           GskGpuCachedGlyph *glyph)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCached *cached = (GskGpuCached *) glyph;
+  GskGpuImage *image;
+  gsize atlas_x, atlas_y, width, height;
+  const gsize padding = 1;
+
+  width = glyph->bounds.size.width + 2 * padding;
+  height = glyph->bounds.size.height + 2 * padding;
+
+  image = gsk_gpu_device_add_atlas_image (self, width, height, &atlas_x, &atlas_y);
+  if (image == NULL)
+    return;
+
+  gsk_gpu_blit_op (frame,
+                   glyph->image,
+                   image,
+                   &(cairo_rectangle_int_t) {
+                       .x = glyph->bounds.origin.x - padding,
+                       .y = glyph->bounds.origin.y - padding,
+                       .width = width,
+                       .height = height,
+                   },
+                   &(cairo_rectangle_int_t) {
+                       .x = atlas_x,
+                       .y = atlas_y,
+                       .width = width,
+                       .height = height,
+                   },
+                   GSK_GPU_BLIT_NEAREST);
+
+  /* The space on the old atlas is dead now, the glyph lives on the new one */
+  mark_as_stale (cached, TRUE);
+  cached->atlas = priv->current_atlas;
+  cached->stale = FALSE;
+
+  g_object_unref (glyph->image);
+  glyph->image = g_object_ref (image);
+  glyph->bounds.origin.x = atlas_x + padding;
+  glyph->bounds.origin.y = atlas_y + padding;
+
+  priv->n_moved_glyphs++;
+}
+
+typedef struct _LoadGlyph LoadGlyph;
+
+struct _LoadGlyph
+{
+  PangoFont *font;
+  PangoGlyph glyph;
+  float scale;
+
+  PangoFont *scaled_font;
+  cairo_scaled_font_t *cairo_font;
+  PangoRectangle ink_rect;
+};
+
+static gboolean
+gsk_gpu_device_load_glyph (gpointer data)
+{
+  LoadGlyph *load = data;
+  cairo_hint_metrics_t hint_metrics;
+
+  /* The combination of hint-style != none and hint-metrics == off
+   * leads to broken rendering with some fonts.
+   */
+  if (gsk_font_get_hint_style (load->font) != CAIRO_HINT_STYLE_NONE)
+    hint_metrics = CAIRO_HINT_METRICS_ON;
+  else
+    hint_metrics = CAIRO_HINT_METRICS_DEFAULT;
+
+  load->scaled_font = gsk_reload_font (load->font, load->scale, hint_metrics, CAIRO_HINT_STYLE_DEFAULT, CAIRO_ANTIALIAS_DEFAULT);
+  pango_font_get_glyph_extents (load->scaled_font, load->glyph, &load->ink_rect, NULL);
+  load->cairo_font = cairo_scaled_font_reference (pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (load->scaled_font)));
+
+  return G_SOURCE_REMOVE;
+}
+
 GskGpuImage *
 gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
                                    GskGpuFrame            *frame,
@@ -907,11 +1197,18 @@ gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
   gsize atlas_x, atlas_y, padding;
   float subpixel_x, subpixel_y;
   PangoFont *scaled_font;
-  cairo_hint_metrics_t hint_metrics;
+  LoadGlyph load = {
+    .font = font,
+    .glyph = glyph,
+    .scale = scale,
+  };
 
   cache = g_hash_table_lookup (priv->glyph_cache, &lookup);
   if (cache)
     {
+      if (gsk_gpu_device_should_move_glyph (self, frame, cache))
+        gsk_gpu_device_move_glyph (self, frame, cache);
+
       gsk_gpu_cached_use (self, (GskGpuCached *) cache, gsk_gpu_frame_get_timestamp (frame));
 
       *out_bounds = cache->bounds;
@@ -919,19 +1216,13 @@ gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
       return cache->image;
     }
 
-  /* The combination of hint-style != none and hint-metrics == off
-   * leads to broken rendering with some fonts.
-   */
-  if (gsk_font_get_hint_style (font) != CAIRO_HINT_STYLE_NONE)
-    hint_metrics = CAIRO_HINT_METRICS_ON;
-  else
-    hint_metrics = CAIRO_HINT_METRICS_DEFAULT;
-
-  scaled_font = gsk_reload_font (font, scale, hint_metrics, CAIRO_HINT_STYLE_DEFAULT, CAIRO_ANTIALIAS_DEFAULT);
+  /* Pango is not threadsafe, but we might be in a render thread */
+  gdk_main_thread_invoke (gsk_gpu_device_load_glyph, &load);
+  scaled_font = load.scaled_font;
+  ink_rect = load.ink_rect;
 
   subpixel_x = (flags & 3) / 4.f;
   subpixel_y = ((flags >> 2) & 3) / 4.f;
-  pango_font_get_glyph_extents (scaled_font, glyph, &ink_rect, NULL);
   origin.x = floor (ink_rect.x * 1.0 / PANGO_SCALE + subpixel_x);
   origin.y = floor (ink_rect.y * 1.0 / PANGO_SCALE + subpixel_y);
   rect.size.width = ceil ((ink_rect.x + ink_rect.width) * 1.0 / PANGO_SCALE + subpixel_x) - origin.x;
@@ -970,6 +1261,7 @@ gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
   gsk_gpu_upload_glyph_op (frame,
                            cache->image,
                            scaled_font,
+                           load.cairo_font,
                            glyph,
                            &(cairo_rectangle_int_t) {
                                .x = rect.origin.x - padding,
@@ -987,9 +1279,79 @@ gsk_gpu_device_lookup_glyph_image (GskGpuDevice           *self,
   *out_origin = cache->origin;
 
   g_object_unref (scaled_font);
+  cairo_scaled_font_destroy (load.cairo_font);
 
   return cache->image;
 }
 
+GskGpuImage *
+gsk_gpu_device_lookup_path_image (GskGpuDevice          *self,
+                                  gint64                 timestamp,
+                                  GskPath               *path,
+                                  GskFillRule            fill_rule,
+                                  const GskStroke       *stroke,
+                                  const graphene_vec2_t *scale,
+                                  const graphene_rect_t *viewport)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedPath lookup = {
+    .path = path,
+    .fill_rule = stroke ? GSK_FILL_RULE_WINDING : fill_rule,
+    .stroke = stroke ? *stroke : (GskStroke) { 0, },
+    .scale_x = graphene_vec2_get_x (scale),
+    .scale_y = graphene_vec2_get_y (scale),
+    .viewport = *viewport,
+  };
+  GskGpuCachedPath *cache;
+
+  cache = g_hash_table_lookup (priv->path_cache, &lookup);
+  if (cache == NULL)
+    return NULL;
+
+  gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+
+  return cache->image;
+}
+
+void
+gsk_gpu_device_cache_path_image (GskGpuDevice          *self,
+                                 gint64                 timestamp,
+                                 GskPath               *path,
+                                 GskFillRule            fill_rule,
+                                 const GskStroke       *stroke,
+                                 const graphene_vec2_t *scale,
+                                 const graphene_rect_t *viewport,
+                                 GskGpuImage           *image)
+{
+  GskGpuDevicePrivate *priv = gsk_gpu_device_get_instance_private (self);
+  GskGpuCachedPath *cache;
+  gsize pixels;
+
+  pixels = gsk_gpu_image_get_width (image) * gsk_gpu_image_get_height (image);
+  if (priv->path_cache_pixels + pixels > MAX_CACHED_PATH_PIXELS)
+    return;
+
+  cache = gsk_gpu_cached_new (self, &GSK_GPU_CACHED_PATH_CLASS, NULL);
+  cache->path = gsk_path_ref (path);
+  if (stroke)
+    {
+      cache->fill_rule = GSK_FILL_RULE_WINDING;
+      cache->stroke = GSK_STROKE_INIT_COPY (stroke);
+    }
+  else
+    {
+      cache->fill_rule = fill_rule;
+    }
+  cache->scale_x = graphene_vec2_get_x (scale);
+  cache->scale_y = graphene_vec2_get_y (scale);
+  cache->viewport = *viewport;
+  cache->image = g_object_ref (image);
+  ((GskGpuCached *) cache)->pixels = pixels;
+  priv->path_cache_pixels += pixels;
+
+  g_hash_table_insert (priv->path_cache, cache, cache);
+  gsk_gpu_cached_use (self, (GskGpuCached *) cache, timestamp);
+}
+
 /* }}} */
 /* vim:set foldmethod=marker expandtab: */
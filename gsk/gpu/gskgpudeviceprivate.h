@@ -2,6 +2,8 @@
 
 #include "gskgputypesprivate.h"
 
+#include "gsktypes.h"
+
 #include <graphene.h>
 
 G_BEGIN_DECLS
@@ -50,6 +52,8 @@ GType                   gsk_gpu_device_get_type                         (void) G
 void                    gsk_gpu_device_setup                            (GskGpuDevice           *self,
                                                                          GdkDisplay             *display,
                                                                          gsize                   max_image_size);
+void                    gsk_gpu_device_lock                             (GskGpuDevice           *self);
+void                    gsk_gpu_device_unlock                           (GskGpuDevice           *self);
 void                    gsk_gpu_device_maybe_gc                         (GskGpuDevice           *self);
 void                    gsk_gpu_device_queue_gc                         (GskGpuDevice           *self);
 GdkDisplay *            gsk_gpu_device_get_display                      (GskGpuDevice           *self);
@@ -98,6 +102,21 @@ GskGpuImage *           gsk_gpu_device_lookup_glyph_image               (GskGpuD
                                                                          graphene_rect_t        *out_bounds,
                                                                          graphene_point_t       *out_origin);
 
+GskGpuImage *           gsk_gpu_device_lookup_path_image                (GskGpuDevice           *self,
+                                                                         gint64                  timestamp,
+                                                                         GskPath                *path,
+                                                                         GskFillRule             fill_rule,
+                                                                         const GskStroke        *stroke,
+                                                                         const graphene_vec2_t  *scale,
+                                                                         const graphene_rect_t  *viewport);
+void                    gsk_gpu_device_cache_path_image                 (GskGpuDevice           *self,
+                                                                         gint64                  timestamp,
+                                                                         GskPath                *path,
+                                                                         GskFillRule             fill_rule,
+                                                                         const GskStroke        *stroke,
+                                                                         const graphene_vec2_t  *scale,
+                                                                         const graphene_rect_t  *viewport,
+                                                                         GskGpuImage            *image);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(GskGpuDevice, g_object_unref)
 
@@ -23,6 +23,13 @@
 /* GL_MAX_UNIFORM_BLOCK_SIZE is at 16384 */
 #define DEFAULT_STORAGE_BUFFER_SIZE 16 * 1024 * 64
 
+/* Every render pass walks the whole node tree again, so we'd rather
+ * draw this many pixels too much than do an extra pass.
+ */
+#define PASS_COST_PIXELS (128 * 128)
+/* Limit for the rectangles fed into the greedy clustering, which is cubic */
+#define MAX_CLUSTER_INPUT 64
+
 #define GDK_ARRAY_NAME gsk_gpu_ops
 #define GDK_ARRAY_TYPE_NAME GskGpuOps
 #define GDK_ARRAY_ELEMENT_TYPE guchar
@@ -37,10 +44,13 @@ struct _GskGpuFramePrivate
   GskGpuDevice *device;
   GskGpuOptimizations optimizations;
   gint64 timestamp;
+  gboolean needs_cleanup;
 
   GskGpuOps ops;
   GskGpuOp *first_op;
   GskGpuOp *last_op;
+  guint n_occluded_nodes;
+  gsize n_occluded_pixels;
 
   GskGpuBuffer *vertex_buffer;
   guchar *vertex_buffer_data;
@@ -73,12 +83,33 @@ gsk_gpu_frame_default_cleanup (GskGpuFrame *self)
   gsk_gpu_ops_set_size (&priv->ops, 0);
 
   priv->last_op = NULL;
-}
-
-static void
+  priv->n_occluded_nodes = 0;
+  priv->n_occluded_pixels = 0;
+}
+
+/*
+ * gsk_gpu_frame_cleanup:
+ * @self: a `GskGpuFrame`
+ *
+ * Waits for the GPU to finish the last submitted frame and frees the
+ * resources it used.
+ *
+ * This happens automatically before the frame is reused. The render
+ * thread calls it from the main thread ahead of time, so that the
+ * nodes, fonts and textures held by the ops are released there.
+ * Calling it again before the next submit does nothing.
+ */
+void
 gsk_gpu_frame_cleanup (GskGpuFrame *self)
 {
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+
+  if (!priv->needs_cleanup)
+    return;
+
   GSK_GPU_FRAME_GET_CLASS (self)->cleanup (self);
+
+  priv->needs_cleanup = FALSE;
 }
 
 static GskGpuImage *
@@ -140,6 +171,7 @@ gsk_gpu_frame_init (GskGpuFrame *self)
   GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
 
   gsk_gpu_ops_init (&priv->ops);
+  priv->needs_cleanup = TRUE;
 }
 
 void
@@ -191,6 +223,26 @@ gsk_gpu_frame_should_optimize (GskGpuFrame         *self,
   return (priv->optimizations & optimization) == optimization;
 }
 
+void
+gsk_gpu_frame_add_occluded (GskGpuFrame *self,
+                            guint        n_nodes,
+                            gsize        n_pixels)
+{
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+
+  priv->n_occluded_nodes += n_nodes;
+  priv->n_occluded_pixels += n_pixels;
+}
+
+void
+gsk_gpu_frame_add_upload_bytes (GskGpuFrame *self,
+                                gsize        n_bytes)
+{
+  GskGpuFramePrivate *priv = gsk_gpu_frame_get_instance_private (self);
+
+  gsk_renderer_add_upload_bytes (GSK_RENDERER (priv->renderer), n_bytes);
+}
+
 static void
 gsk_gpu_frame_verbose_print (GskGpuFrame *self,
                              const char  *heading)
@@ -201,17 +253,21 @@ gsk_gpu_frame_verbose_print (GskGpuFrame *self,
     {
       GskGpuOp *op;
       guint indent = 1;
+      guint n_ops = 0;
       GString *string = g_string_new (heading);
       g_string_append (string, ":\n");
 
       for (op = priv->first_op; op; op = op->next)
         {
+          n_ops++;
           if (op->op_class->stage == GSK_GPU_STAGE_END_PASS)
             indent--;
           gsk_gpu_op_print (op, self, string, indent);
           if (op->op_class->stage == GSK_GPU_STAGE_BEGIN_PASS)
             indent++;
         }
+      g_string_append_printf (string, "%u ops, %u occluded nodes skipped (%" G_GSIZE_FORMAT " pixels)\n",
+                              n_ops, priv->n_occluded_nodes, priv->n_occluded_pixels);
 
       gdk_debug_message ("%s", string->str);
       g_string_free (string, TRUE);
@@ -581,6 +637,170 @@ gsk_gpu_frame_record_rect (GskGpuFrame                 *self,
                               GSK_RENDER_PASS_PRESENT);
 }
 
+static gsize
+rect_area (const cairo_rectangle_int_t *rect)
+{
+  return (gsize) rect->width * rect->height;
+}
+
+static void
+gsk_gpu_frame_remove_cluster (cairo_rectangle_int_t *clusters,
+                              gsize                 *n_clusters,
+                              gsize                  remove,
+                              gsize                 *keep)
+{
+  (*n_clusters)--;
+  clusters[remove] = clusters[*n_clusters];
+  if (*keep == *n_clusters)
+    *keep = remove;
+}
+
+/* Merges clusters[j] into clusters[i] and then keeps swallowing
+ * everything the merged rectangle touches, so that the clusters stay
+ * disjoint and no pixel gets drawn twice.
+ */
+static void
+gsk_gpu_frame_merge_clusters (cairo_rectangle_int_t *clusters,
+                              gsize                 *n_clusters,
+                              gsize                  i,
+                              gsize                  j)
+{
+  gsize k;
+
+  gdk_rectangle_union (&clusters[i], &clusters[j], &clusters[i]);
+  gsk_gpu_frame_remove_cluster (clusters, n_clusters, j, &i);
+
+  for (k = 0; k < *n_clusters; )
+    {
+      if (k != i && gdk_rectangle_intersect (&clusters[i], &clusters[k], NULL))
+        {
+          gdk_rectangle_union (&clusters[i], &clusters[k], &clusters[i]);
+          gsk_gpu_frame_remove_cluster (clusters, n_clusters, k, &i);
+          /* the cluster grew, so look at everything again */
+          k = 0;
+        }
+      else
+        k++;
+    }
+}
+
+/* Regions store their rectangles in horizontal bands sorted from top
+ * to bottom. Merging each band and then runs of consecutive bands keeps
+ * the rectangles disjoint while reducing them to MAX_CLUSTER_INPUT.
+ */
+static gsize
+gsk_gpu_frame_merge_bands (cairo_rectangle_int_t *rects,
+                           gsize                  n_rects)
+{
+  gsize i, n, group;
+
+  n = 0;
+  for (i = 0; i < n_rects; i++)
+    {
+      if (n > 0 && rects[i].y == rects[n - 1].y)
+        gdk_rectangle_union (&rects[n - 1], &rects[i], &rects[n - 1]);
+      else
+        rects[n++] = rects[i];
+    }
+
+  if (n <= MAX_CLUSTER_INPUT)
+    return n;
+
+  n_rects = n;
+  group = (n_rects + MAX_CLUSTER_INPUT - 1) / MAX_CLUSTER_INPUT;
+  n = 0;
+  for (i = 0; i < n_rects; i++)
+    {
+      if (i % group == 0)
+        rects[n++] = rects[i];
+      else
+        gdk_rectangle_union (&rects[n - 1], &rects[i], &rects[n - 1]);
+    }
+
+  return n;
+}
+
+/*
+ * gsk_gpu_frame_cluster_region:
+ * @region: the region to draw
+ * @clusters: (out caller-allocates) (array fixed-size=GSK_GPU_FRAME_MAX_CLUSTERS):
+ *   the rectangles to draw
+ *
+ * Groups the rectangles of @region into at most
+ * GSK_GPU_FRAME_MAX_CLUSTERS disjoint rectangles that cover it.
+ *
+ * Rectangles are merged greedily, picking the pair that adds the
+ * fewest extra pixels first. Merging continues below the limit as
+ * long as doing so is cheaper than an extra render pass, so that
+ * scattered small damage like a cursor, a clock and a spinner ends
+ * up as a few small passes instead of one big one.
+ *
+ * Regions with more than MAX_CLUSTER_INPUT rectangles are first reduced
+ * by merging whole bands, to keep the cost of the search bounded.
+ *
+ * Returns: the number of clusters
+ */
+gsize
+gsk_gpu_frame_cluster_region (const cairo_region_t  *region,
+                              cairo_rectangle_int_t  clusters[GSK_GPU_FRAME_MAX_CLUSTERS])
+{
+  cairo_rectangle_int_t *rects, *rects_free = NULL;
+  gsize i, j, n_rects, best_i, best_j, best_cost;
+
+  n_rects = cairo_region_num_rectangles (region);
+  if (n_rects <= 1)
+    {
+      if (n_rects == 1)
+        cairo_region_get_rectangle (region, 0, &clusters[0]);
+      return n_rects;
+    }
+
+  if (n_rects < 128)
+    rects = g_newa (cairo_rectangle_int_t, n_rects);
+  else
+    rects = rects_free = g_new (cairo_rectangle_int_t, n_rects);
+
+  for (i = 0; i < n_rects; i++)
+    cairo_region_get_rectangle (region, i, &rects[i]);
+
+  if (n_rects > MAX_CLUSTER_INPUT)
+    n_rects = gsk_gpu_frame_merge_bands (rects, n_rects);
+
+  while (n_rects > 1)
+    {
+      best_i = best_j = 0;
+      best_cost = G_MAXSIZE;
+
+      for (i = 0; i < n_rects; i++)
+        {
+          for (j = i + 1; j < n_rects; j++)
+            {
+              cairo_rectangle_int_t merged;
+              gsize cost;
+
+              gdk_rectangle_union (&rects[i], &rects[j], &merged);
+              cost = rect_area (&merged) - rect_area (&rects[i]) - rect_area (&rects[j]);
+              if (cost < best_cost)
+                {
+                  best_cost = cost;
+                  best_i = i;
+                  best_j = j;
+                }
+            }
+        }
+
+      if (n_rects <= GSK_GPU_FRAME_MAX_CLUSTERS && best_cost > PASS_COST_PIXELS)
+        break;
+
+      gsk_gpu_frame_merge_clusters (rects, &n_rects, best_i, best_j);
+    }
+
+  memcpy (clusters, rects, sizeof (cairo_rectangle_int_t) * n_rects);
+  g_free (rects_free);
+
+  return n_rects;
+}
+
 static void
 gsk_gpu_frame_record (GskGpuFrame            *self,
                       gint64                  timestamp,
@@ -596,15 +816,13 @@ gsk_gpu_frame_record (GskGpuFrame            *self,
 
   if (clip)
     {
-      int i;
+      cairo_rectangle_int_t clusters[GSK_GPU_FRAME_MAX_CLUSTERS];
+      gsize i, n_clusters;
 
-      for (i = 0; i < cairo_region_num_rectangles (clip); i++)
-        {
-          cairo_rectangle_int_t rect;
+      n_clusters = gsk_gpu_frame_cluster_region (clip, clusters);
 
-          cairo_region_get_rectangle (clip, i, &rect);
-          gsk_gpu_frame_record_rect (self, target, &rect, node, viewport);
-        }
+      for (i = 0; i < n_clusters; i++)
+        gsk_gpu_frame_record_rect (self, target, &clusters[i], node, viewport);
     }
   else
     {
@@ -633,6 +851,8 @@ gsk_gpu_frame_submit (GskGpuFrame *self)
   gsk_gpu_frame_sort_ops (self);
   gsk_gpu_frame_verbose_print (self, "after sort");
 
+  gsk_gpu_upload_ops_prepare (priv->first_op);
+
   if (priv->vertex_buffer)
     {
       gsk_gpu_buffer_unmap (priv->vertex_buffer, priv->vertex_buffer_used);
@@ -647,6 +867,8 @@ gsk_gpu_frame_submit (GskGpuFrame *self)
       priv->storage_buffer_used = 0;
     }
 
+  priv->needs_cleanup = TRUE;
+
   GSK_GPU_FRAME_GET_CLASS (self)->submit (self,
                                           priv->vertex_buffer,
                                           priv->first_op);
@@ -12,6 +12,9 @@ G_BEGIN_DECLS
 #define GSK_IS_GPU_FRAME_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), GSK_TYPE_GPU_FRAME))
 #define GSK_GPU_FRAME_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), GSK_TYPE_GPU_FRAME, GskGpuFrameClass))
 
+/* The maximum number of render passes used to draw a damaged region */
+#define GSK_GPU_FRAME_MAX_CLUSTERS 8
+
 typedef struct _GskGpuFrameClass GskGpuFrameClass;
 
 struct _GskGpuFrame
@@ -48,11 +51,20 @@ void                    gsk_gpu_frame_setup                             (GskGpuF
                                                                          GskGpuDevice           *device,
                                                                          GskGpuOptimizations     optimizations);
 
+void                    gsk_gpu_frame_cleanup                           (GskGpuFrame            *self);
+
 GdkDrawContext *        gsk_gpu_frame_get_context                       (GskGpuFrame            *self) G_GNUC_PURE;
 GskGpuDevice *          gsk_gpu_frame_get_device                        (GskGpuFrame            *self) G_GNUC_PURE;
 gint64                  gsk_gpu_frame_get_timestamp                     (GskGpuFrame            *self) G_GNUC_PURE;
 gboolean                gsk_gpu_frame_should_optimize                   (GskGpuFrame            *self,
                                                                          GskGpuOptimizations     optimization) G_GNUC_PURE;
+gsize                   gsk_gpu_frame_cluster_region                    (const cairo_region_t   *region,
+                                                                         cairo_rectangle_int_t   clusters[GSK_GPU_FRAME_MAX_CLUSTERS]);
+void                    gsk_gpu_frame_add_occluded                      (GskGpuFrame            *self,
+                                                                         guint                   n_nodes,
+                                                                         gsize                   n_pixels);
+void                    gsk_gpu_frame_add_upload_bytes                  (GskGpuFrame            *self,
+                                                                         gsize                   n_bytes);
 
 gpointer                gsk_gpu_frame_alloc_op                          (GskGpuFrame            *self,
                                                                          gsize                   size);
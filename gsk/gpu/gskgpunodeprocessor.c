@@ -42,6 +42,7 @@
 #include "gsktransformprivate.h"
 #include "gskprivate.h"
 
+#include "gdk/gdkmemoryformatprivate.h"
 #include "gdk/gdkrgbaprivate.h"
 #include "gdk/gdksubsurfaceprivate.h"
 
@@ -50,6 +51,10 @@
  */
 #define EPSILON 0.001
 
+/* Fill and stroke masks larger than this are only rendered for the
+ * visible part of the node */
+#define MAX_PATH_MASK_PIXELS (1024 * 1024)
+
 /* A note about coordinate systems
  *
  * The rendering code keeps track of multiple coordinate systems to optimize rendering as
@@ -333,6 +338,36 @@ rect_round_to_pixels (const graphene_rect_t  *src,
       (ceilf ((src->origin.y + pixel_offset->y + src->size.height) * yscale) - y) * inv_yscale);
 }
 
+/* The opposite of rect_round_to_pixels(): Shrinks the rect to the
+ * pixels it covers completely. Returns FALSE if there are none.
+ */
+static gboolean
+rect_shrink_to_pixels (const graphene_rect_t  *src,
+                       const graphene_vec2_t  *pixel_scale,
+                       const graphene_point_t *pixel_offset,
+                       graphene_rect_t        *dest)
+{
+  float x1, y1, x2, y2, xscale, yscale, inv_xscale, inv_yscale;
+
+  xscale = graphene_vec2_get_x (pixel_scale);
+  yscale = graphene_vec2_get_y (pixel_scale);
+  inv_xscale = 1.0f / xscale;
+  inv_yscale = 1.0f / yscale;
+
+  x1 = ceilf ((src->origin.x + pixel_offset->x) * xscale);
+  y1 = ceilf ((src->origin.y + pixel_offset->y) * yscale);
+  x2 = floorf ((src->origin.x + pixel_offset->x + src->size.width) * xscale);
+  y2 = floorf ((src->origin.y + pixel_offset->y + src->size.height) * yscale);
+  if (x1 >= x2 || y1 >= y2)
+    return FALSE;
+
+  *dest = GRAPHENE_RECT_INIT (x1 * inv_xscale - pixel_offset->x,
+                              y1 * inv_yscale - pixel_offset->y,
+                              (x2 - x1) * inv_xscale,
+                              (y2 - y1) * inv_yscale);
+  return TRUE;
+}
+
 static GskGpuImage *
 gsk_gpu_node_processor_init_draw (GskGpuNodeProcessor   *self,
                                   GskGpuFrame           *frame,
@@ -2991,6 +3026,32 @@ gsk_gpu_node_processor_create_mask_pattern (GskGpuPatternWriter *self,
   return TRUE;
 }
 
+/* Large text at odd scales, like during zoom animations, is rendered
+ * at a few fixed scales per octave and scaled down when drawing, so
+ * that not every intermediate scale needs its own glyphs in the cache.
+ * Scales that are multiples of 1/4 - which includes all fractional
+ * monitor scales - are used as-is.
+ */
+#define MIN_QUANTIZED_GLYPH_SIZE 48
+#define GLYPH_SCALES_PER_OCTAVE 4
+
+static float
+gsk_gpu_node_processor_get_glyph_scale (GskRenderNode *node,
+                                        float          scale)
+{
+  float steps;
+
+  if (scale * 4 == floorf (scale * 4))
+    return scale;
+
+  if (node->bounds.size.height * scale < MIN_QUANTIZED_GLYPH_SIZE)
+    return scale;
+
+  steps = ceilf (log2f (scale) * GLYPH_SCALES_PER_OCTAVE);
+
+  return exp2f (steps / GLYPH_SCALES_PER_OCTAVE);
+}
+
 static void
 gsk_gpu_node_processor_add_glyph_node (GskGpuNodeProcessor *self,
                                        GskRenderNode       *node)
@@ -3028,6 +3089,7 @@ gsk_gpu_node_processor_add_glyph_node (GskGpuNodeProcessor *self,
   offset.y += self->offset.y;
 
   scale = MAX (graphene_vec2_get_x (&self->scale), graphene_vec2_get_y (&self->scale));
+  scale = gsk_gpu_node_processor_get_glyph_scale (node, scale);
   inv_scale = 1.f / scale;
 
   if (gsk_font_get_hint_style (font) != CAIRO_HINT_STYLE_NONE)
@@ -3141,6 +3203,7 @@ gsk_gpu_node_processor_create_glyph_pattern (GskGpuPatternWriter *self,
   offset.y += self->offset.y;
 
   scale = MAX (graphene_vec2_get_x (&self->scale), graphene_vec2_get_y (&self->scale));
+  scale = gsk_gpu_node_processor_get_glyph_scale (node, scale);
   inv_scale = 1.f / scale;
 
   gsk_gpu_pattern_writer_append_uint (self, GSK_GPU_PATTERN_GLYPHS);
@@ -3534,7 +3597,6 @@ typedef struct _FillData FillData;
 struct _FillData
 {
   GskPath *path;
-  GdkRGBA color;
   GskFillRule fill_rule;
 };
 
@@ -3566,51 +3628,105 @@ gsk_gpu_node_processor_fill_path (gpointer  data,
       break;
   }
   gsk_path_to_cairo (fill->path, cr);
-  gdk_cairo_set_source_rgba (cr, &fill->color);
+  gdk_cairo_set_source_rgba (cr, &GDK_RGBA_WHITE);
   cairo_fill (cr);
 }
 
-static void
-gsk_gpu_node_processor_add_fill_node (GskGpuNodeProcessor *self,
-                                      GskRenderNode       *node)
+/* Returns the mask for a fill or stroke node, from the cache if possible.
+ *
+ * The mask is rendered for the whole node, so that it stays valid when
+ * the node is drawn again with a different clip, for example while
+ * scrolling. Only nodes that are too large for that are rendered
+ * clipped, and those masks are only reused for the exact same clip.
+ * Takes ownership of @data. The returned image is not referenced.
+ */
+static GskGpuImage *
+gsk_gpu_node_processor_get_path_mask (GskGpuNodeProcessor   *self,
+                                      GskRenderNode         *node,
+                                      const graphene_rect_t *clip_bounds,
+                                      GskPath               *path,
+                                      GskFillRule            fill_rule,
+                                      const GskStroke       *stroke,
+                                      GskGpuCairoFunc        draw_func,
+                                      gpointer               data,
+                                      GDestroyNotify         data_free,
+                                      graphene_rect_t       *out_mask_rect)
 {
-  graphene_rect_t clip_bounds, source_rect;
-  GskGpuImage *mask_image, *source_image;
-  guint32 descriptors[2];
-  GskRenderNode *child;
+  GskGpuImage *mask_image;
+  GskGpuDevice *device;
+  gint64 timestamp;
 
-  if (!gsk_gpu_node_processor_clip_node_bounds (self, node, &clip_bounds))
-    return;
-  rect_round_to_pixels (&clip_bounds, &self->scale, &self->offset, &clip_bounds);
+  rect_round_to_pixels (&node->bounds, &self->scale, &self->offset, out_mask_rect);
+  if (out_mask_rect->size.width * graphene_vec2_get_x (&self->scale) *
+      out_mask_rect->size.height * graphene_vec2_get_y (&self->scale) > MAX_PATH_MASK_PIXELS)
+    *out_mask_rect = *clip_bounds;
+
+  device = gsk_gpu_frame_get_device (self->frame);
+  timestamp = gsk_gpu_frame_get_timestamp (self->frame);
 
-  child = gsk_fill_node_get_child (node);
+  mask_image = gsk_gpu_device_lookup_path_image (device,
+                                                 timestamp,
+                                                 path,
+                                                 fill_rule,
+                                                 stroke,
+                                                 &self->scale,
+                                                 out_mask_rect);
+  if (mask_image)
+    {
+      data_free (data);
+      return mask_image;
+    }
 
   mask_image = gsk_gpu_upload_cairo_op (self->frame,
                                         &self->scale,
-                                        &clip_bounds,
-                                        gsk_gpu_node_processor_fill_path,
-                                        g_memdup (&(FillData) {
-                                            .path = gsk_path_ref (gsk_fill_node_get_path (node)),
-                                            .color = GSK_RENDER_NODE_TYPE (child) == GSK_COLOR_NODE
-                                                   ? *gsk_color_node_get_color (child)
-                                                   : GDK_RGBA_WHITE,
-                                            .fill_rule = gsk_fill_node_get_fill_rule (node)
-                                        }, sizeof (FillData)),
-                                        (GDestroyNotify) gsk_fill_data_free);
-  g_return_if_fail (mask_image != NULL);
+                                        out_mask_rect,
+                                        draw_func,
+                                        data,
+                                        data_free);
+  g_return_val_if_fail (mask_image != NULL, NULL);
+
+  gsk_gpu_device_cache_path_image (device,
+                                   timestamp,
+                                   path,
+                                   fill_rule,
+                                   stroke,
+                                   &self->scale,
+                                   out_mask_rect,
+                                   mask_image);
+
+  return mask_image;
+}
+
+static void
+gsk_gpu_node_processor_draw_path_mask (GskGpuNodeProcessor   *self,
+                                       GskGpuImage           *mask_image,
+                                       const graphene_rect_t *mask_rect,
+                                       const graphene_rect_t *clip_bounds,
+                                       GskRenderNode         *child)
+{
+  GskGpuImage *source_image;
+  graphene_rect_t source_rect;
+  guint32 descriptors[2];
+
   if (GSK_RENDER_NODE_TYPE (child) == GSK_COLOR_NODE)
     {
-      gsk_gpu_node_processor_image_op (self,
-                                       mask_image,
-                                       &clip_bounds,
-                                       &clip_bounds);
+      descriptors[0] = gsk_gpu_node_processor_add_image (self, mask_image, GSK_GPU_SAMPLER_DEFAULT);
+
+      gsk_gpu_colorize_op (self->frame,
+                           gsk_gpu_clip_get_shader_clip (&self->clip, &self->offset, clip_bounds),
+                           self->desc,
+                           descriptors[0],
+                           clip_bounds,
+                           &self->offset,
+                           mask_rect,
+                           &GDK_RGBA_INIT_ALPHA (gsk_color_node_get_color (child), self->opacity));
       return;
     }
 
   source_image = gsk_gpu_node_processor_get_node_as_image (self,
                                                            0,
                                                            GSK_GPU_IMAGE_STRAIGHT_ALPHA,
-                                                           &clip_bounds,
+                                                           clip_bounds,
                                                            child,
                                                            &source_rect);
   if (source_image == NULL)
@@ -3623,25 +3739,63 @@ gsk_gpu_node_processor_add_fill_node (GskGpuNodeProcessor *self,
                                      descriptors);
 
   gsk_gpu_mask_op (self->frame,
-                   gsk_gpu_clip_get_shader_clip (&self->clip, &self->offset, &clip_bounds),
+                   gsk_gpu_clip_get_shader_clip (&self->clip, &self->offset, clip_bounds),
                    self->desc,
-                   &clip_bounds,
+                   clip_bounds,
                    &self->offset,
                    self->opacity,
                    GSK_MASK_MODE_ALPHA,
                    descriptors[0],
                    &source_rect,
                    descriptors[1],
-                   &clip_bounds);
+                   mask_rect);
 
   g_object_unref (source_image);
 }
 
+static void
+gsk_gpu_node_processor_add_fill_node (GskGpuNodeProcessor *self,
+                                      GskRenderNode       *node)
+{
+  graphene_rect_t clip_bounds, mask_rect;
+  GskGpuImage *mask_image;
+  GskPath *path;
+  GskFillRule fill_rule;
+
+  if (!gsk_gpu_node_processor_clip_node_bounds (self, node, &clip_bounds))
+    return;
+  rect_round_to_pixels (&clip_bounds, &self->scale, &self->offset, &clip_bounds);
+
+  path = gsk_fill_node_get_path (node);
+  fill_rule = gsk_fill_node_get_fill_rule (node);
+
+  mask_image = gsk_gpu_node_processor_get_path_mask (self,
+                                                     node,
+                                                     &clip_bounds,
+                                                     path,
+                                                     fill_rule,
+                                                     NULL,
+                                                     gsk_gpu_node_processor_fill_path,
+                                                     g_memdup (&(FillData) {
+                                                         .path = gsk_path_ref (path),
+                                                         .fill_rule = fill_rule
+                                                     }, sizeof (FillData)),
+                                                     (GDestroyNotify) gsk_fill_data_free,
+                                                     &mask_rect);
+  if (mask_image == NULL)
+    return;
+
+  gsk_gpu_node_processor_draw_path_mask (self,
+                                         mask_image,
+                                         &mask_rect,
+                                         &clip_bounds,
+                                         gsk_fill_node_get_child (node));
+}
+
 typedef struct _StrokeData StrokeData;
 struct _StrokeData
 {
   GskPath *path;
-  GdkRGBA color;
   GskStroke stroke;
 };
 
@@ -3663,7 +3817,7 @@ gsk_gpu_node_processor_stroke_path (gpointer  data,
 
   gsk_stroke_to_cairo (&stroke->stroke, cr);
   gsk_path_to_cairo (stroke->path, cr);
-  gdk_cairo_set_source_rgba (cr, &stroke->color);
+  gdk_cairo_set_source_rgba (cr, &GDK_RGBA_WHITE);
   cairo_stroke (cr);
 }
 
@@ -3671,67 +3825,39 @@ static void
 gsk_gpu_node_processor_add_stroke_node (GskGpuNodeProcessor *self,
                                         GskRenderNode       *node)
 {
-  graphene_rect_t clip_bounds, source_rect;
-  GskGpuImage *mask_image, *source_image;
-  guint32 descriptors[2];
-  GskRenderNode *child;
+  graphene_rect_t clip_bounds, mask_rect;
+  GskGpuImage *mask_image;
+  const GskStroke *stroke;
+  GskPath *path;
 
   if (!gsk_gpu_node_processor_clip_node_bounds (self, node, &clip_bounds))
     return;
   rect_round_to_pixels (&clip_bounds, &self->scale, &self->offset, &clip_bounds);
 
-  child = gsk_stroke_node_get_child (node);
-
-  mask_image = gsk_gpu_upload_cairo_op (self->frame,
-                                        &self->scale,
-                                        &clip_bounds,
-                                        gsk_gpu_node_processor_stroke_path,
-                                        g_memdup (&(StrokeData) {
-                                            .path = gsk_path_ref (gsk_stroke_node_get_path (node)),
-                                            .color = GSK_RENDER_NODE_TYPE (child) == GSK_COLOR_NODE
-                                                   ? *gsk_color_node_get_color (child)
-                                                   : GDK_RGBA_WHITE,
-                                            .stroke = GSK_STROKE_INIT_COPY (gsk_stroke_node_get_stroke (node))
-                                        }, sizeof (StrokeData)),
-                                        (GDestroyNotify) gsk_stroke_data_free);
-  g_return_if_fail (mask_image != NULL);
-  if (GSK_RENDER_NODE_TYPE (child) == GSK_COLOR_NODE)
-    {
-      gsk_gpu_node_processor_image_op (self,
-                                       mask_image,
-                                       &clip_bounds,
-                                       &clip_bounds);
-      return;
-    }
-
-  source_image = gsk_gpu_node_processor_get_node_as_image (self,
-                                                           0,
-                                                           GSK_GPU_IMAGE_STRAIGHT_ALPHA,
-                                                           &clip_bounds,
-                                                           child,
-                                                           &source_rect);
-  if (source_image == NULL)
+  path = gsk_stroke_node_get_path (node);
+  stroke = gsk_stroke_node_get_stroke (node);
+
+  mask_image = gsk_gpu_node_processor_get_path_mask (self,
+                                                     node,
+                                                     &clip_bounds,
+                                                     path,
+                                                     GSK_FILL_RULE_WINDING,
+                                                     stroke,
+                                                     gsk_gpu_node_processor_stroke_path,
+                                                     g_memdup (&(StrokeData) {
+                                                         .path = gsk_path_ref (path),
+                                                         .stroke = GSK_STROKE_INIT_COPY (stroke)
+                                                     }, sizeof (StrokeData)),
+                                                     (GDestroyNotify) gsk_stroke_data_free,
+                                                     &mask_rect);
+  if (mask_image == NULL)
     return;
 
-  gsk_gpu_node_processor_add_images (self,
-                                     2,
-                                     (GskGpuImage *[2]) { source_image, mask_image },
-                                     (GskGpuSampler[2]) { GSK_GPU_SAMPLER_DEFAULT, GSK_GPU_SAMPLER_DEFAULT },
-                                     descriptors);
-
-  gsk_gpu_mask_op (self->frame,
-                   gsk_gpu_clip_get_shader_clip (&self->clip, &self->offset, &clip_bounds),
-                   self->desc,
-                   &clip_bounds,
-                   &self->offset,
-                   self->opacity,
-                   GSK_MASK_MODE_ALPHA,
-                   descriptors[0],
-                   &source_rect,
-                   descriptors[1],
-                   &clip_bounds);
-
-  g_object_unref (source_image);
+  gsk_gpu_node_processor_draw_path_mask (self,
+                                         mask_image,
+                                         &mask_rect,
+                                         &clip_bounds,
+                                         gsk_stroke_node_get_child (node));
 }
 
 static void
@@ -3801,18 +3927,242 @@ gsk_gpu_node_processor_create_subsurface_pattern (GskGpuPatternWriter *self,
   return gsk_gpu_node_processor_create_node_pattern (self, gsk_subsurface_node_get_child (node));
 }
 
+/* How deep to look into a node to find what it covers. This keeps the
+ * cost down for deeply nested containers, which would otherwise be
+ * looked at again on every level.
+ */
+#define MAX_OPAQUE_DEPTH 4
+#define MAX_OCCLUDERS 4
+
+/*
+ * gsk_gpu_node_get_opaque_rect:
+ * @node: a node
+ * @depth: how many more levels of the tree to look at
+ * @opaque: (out): a rectangle that the node paints fully opaque
+ *
+ * Finds a rectangle that the node covers with opaque pixels.
+ * This is not necessarily the largest one.
+ *
+ * Returns: TRUE if such a rectangle was found
+ */
+static gboolean
+gsk_gpu_node_get_opaque_rect (GskRenderNode   *node,
+                              guint            depth,
+                              graphene_rect_t *opaque)
+{
+  graphene_rect_t child_opaque;
+
+  if (depth == 0)
+    return FALSE;
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_COLOR_NODE:
+      if (!gdk_rgba_is_opaque (gsk_color_node_get_color (node)))
+        return FALSE;
+      *opaque = node->bounds;
+      return TRUE;
+
+    case GSK_TEXTURE_NODE:
+      if (gdk_memory_format_alpha (gdk_texture_get_format (gsk_texture_node_get_texture (node))) != GDK_MEMORY_ALPHA_OPAQUE)
+        return FALSE;
+      *opaque = node->bounds;
+      return TRUE;
+
+    case GSK_TEXTURE_SCALE_NODE:
+      if (gdk_memory_format_alpha (gdk_texture_get_format (gsk_texture_scale_node_get_texture (node))) != GDK_MEMORY_ALPHA_OPAQUE)
+        return FALSE;
+      *opaque = node->bounds;
+      return TRUE;
+
+    case GSK_CONTAINER_NODE:
+      {
+        float best_area = 0;
+
+        for (guint i = 0; i < gsk_container_node_get_n_children (node); i++)
+          {
+            if (gsk_gpu_node_get_opaque_rect (gsk_container_node_get_child (node, i), depth - 1, &child_opaque) &&
+                child_opaque.size.width * child_opaque.size.height > best_area)
+              {
+                *opaque = child_opaque;
+                best_area = child_opaque.size.width * child_opaque.size.height;
+              }
+          }
+
+        return best_area > 0;
+      }
+
+    case GSK_TRANSFORM_NODE:
+      {
+        GskTransform *transform = gsk_transform_node_get_transform (node);
+
+        if (gsk_transform_get_category (transform) < GSK_TRANSFORM_CATEGORY_2D_AFFINE ||
+            !gsk_gpu_node_get_opaque_rect (gsk_transform_node_get_child (node), depth - 1, &child_opaque))
+          return FALSE;
+
+        gsk_transform_transform_bounds (transform, &child_opaque, opaque);
+        return TRUE;
+      }
+
+    case GSK_CLIP_NODE:
+      if (!gsk_gpu_node_get_opaque_rect (gsk_clip_node_get_child (node), depth - 1, &child_opaque))
+        return FALSE;
+      return gsk_rect_intersection (&child_opaque, gsk_clip_node_get_clip (node), opaque);
+
+    case GSK_ROUNDED_CLIP_NODE:
+      if (!gsk_gpu_node_get_opaque_rect (gsk_rounded_clip_node_get_child (node), depth - 1, &child_opaque))
+        return FALSE;
+      gsk_rounded_rect_get_largest_cover (gsk_rounded_clip_node_get_clip (node), &child_opaque, opaque);
+      return opaque->size.width > 0 && opaque->size.height > 0;
+
+    case GSK_DEBUG_NODE:
+      return gsk_gpu_node_get_opaque_rect (gsk_debug_node_get_child (node), depth - 1, opaque);
+
+    case GSK_CAIRO_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+    case GSK_CONIC_GRADIENT_NODE:
+    case GSK_BORDER_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+    case GSK_OPACITY_NODE:
+    case GSK_COLOR_MATRIX_NODE:
+    case GSK_REPEAT_NODE:
+    case GSK_SHADOW_NODE:
+    case GSK_BLEND_NODE:
+    case GSK_CROSS_FADE_NODE:
+    case GSK_TEXT_NODE:
+    case GSK_BLUR_NODE:
+    case GSK_GL_SHADER_NODE:
+    case GSK_MASK_NODE:
+    case GSK_FILL_NODE:
+    case GSK_STROKE_NODE:
+    case GSK_SUBSURFACE_NODE:
+      return FALSE;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_assert_not_reached ();
+      return FALSE;
+    }
+}
+
+/*
+ * Walks the children back to front and marks the ones that are
+ * completely hidden behind later siblings, so they don't need to be
+ * drawn. Only a few of the largest occluders are tracked.
+ *
+ * Shaders antialias edges that aren't on pixel boundaries, so an
+ * occluder only hides the pixels it covers completely, and a child is
+ * only hidden if all pixels it touches are.
+ */
+static void
+gsk_gpu_node_processor_find_occluded (GskGpuNodeProcessor *self,
+                                      GskRenderNode       *node,
+                                      gboolean            *occluded)
+{
+  graphene_rect_t occluders[MAX_OCCLUDERS];
+  guint i, j, n_children, n_occluders, n_occluded;
+  float scale_x, scale_y;
+  gsize n_pixels;
+
+  n_children = gsk_container_node_get_n_children (node);
+  n_occluders = 0;
+  n_occluded = 0;
+  n_pixels = 0;
+  scale_x = graphene_vec2_get_x (&self->scale);
+  scale_y = graphene_vec2_get_y (&self->scale);
+
+  for (i = n_children; i-- > 0; )
+    {
+      GskRenderNode *child = gsk_container_node_get_child (node, i);
+      graphene_rect_t opaque, pixels;
+
+      occluded[i] = FALSE;
+      rect_round_to_pixels (&child->bounds, &self->scale, &self->offset, &pixels);
+      for (j = 0; j < n_occluders; j++)
+        {
+          if (gsk_rect_contains_rect (&occluders[j], &pixels))
+            {
+              occluded[i] = TRUE;
+              n_occluded++;
+              n_pixels += pixels.size.width * scale_x * pixels.size.height * scale_y;
+              break;
+            }
+        }
+
+      if (occluded[i] ||
+          !gsk_gpu_node_get_opaque_rect (child, MAX_OPAQUE_DEPTH, &opaque) ||
+          !rect_shrink_to_pixels (&opaque, &self->scale, &self->offset, &opaque))
+        continue;
+
+      if (n_occluders < MAX_OCCLUDERS)
+        {
+          occluders[n_occluders++] = opaque;
+        }
+      else
+        {
+          guint smallest = 0;
+
+          for (j = 1; j < n_occluders; j++)
+            {
+              if (occluders[j].size.width * occluders[j].size.height <
+                  occluders[smallest].size.width * occluders[smallest].size.height)
+                smallest = j;
+            }
+
+          if (opaque.size.width * opaque.size.height >
+              occluders[smallest].size.width * occluders[smallest].size.height)
+            occluders[smallest] = opaque;
+        }
+    }
+
+  gsk_gpu_frame_add_occluded (self->frame, n_occluded, n_pixels);
+}
+
 static void
 gsk_gpu_node_processor_add_container_node (GskGpuNodeProcessor *self,
                                            GskRenderNode       *node)
 {
+  gboolean *occluded, *occluded_free = NULL;
+  guint i, n_children;
+
   if (self->opacity < 1.0 && !gsk_container_node_is_disjoint (node))
     {
       gsk_gpu_node_processor_add_without_opacity (self, node);
       return;
     }
 
-  for (guint i = 0; i < gsk_container_node_get_n_children (node); i++)
-    gsk_gpu_node_processor_add_node (self, gsk_container_node_get_child (node, i));
+  n_children = gsk_container_node_get_n_children (node);
+
+  /* Pixel boundaries are only axis-aligned in node space if the
+   * modelview is at most flipping things */
+  if (n_children < 2 ||
+      self->opacity < 1.0 ||
+      gsk_transform_get_category (self->modelview) < GSK_TRANSFORM_CATEGORY_2D_AFFINE ||
+      !gsk_gpu_frame_should_optimize (self->frame, GSK_GPU_OPTIMIZE_OCCLUSION))
+    {
+      for (i = 0; i < n_children; i++)
+        gsk_gpu_node_processor_add_node (self, gsk_container_node_get_child (node, i));
+      return;
+    }
+
+  if (n_children < 1024)
+    occluded = g_alloca (sizeof (gboolean) * n_children);
+  else
+    occluded = occluded_free = g_new (gboolean, n_children);
+
+  gsk_gpu_node_processor_find_occluded (self, node, occluded);
+
+  for (i = 0; i < n_children; i++)
+    {
+      if (!occluded[i])
+        gsk_gpu_node_processor_add_node (self, gsk_container_node_get_child (node, i));
+    }
+
+  g_free (occluded_free);
 }
 
 static gboolean
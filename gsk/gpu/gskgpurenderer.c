@@ -15,6 +15,7 @@
 #include "gdk/gdkdmabuftextureprivate.h"
 #include "gdk/gdkdrawcontextprivate.h"
 #include "gdk/gdkprofilerprivate.h"
+#include "gdk/gdkprivate.h"
 #include "gdk/gdktextureprivate.h"
 #include "gdk/gdktexturedownloaderprivate.h"
 #include "gdk/gdkdrawcontextprivate.h"
@@ -30,10 +31,23 @@ static const GdkDebugKey gsk_gpu_optimization_keys[] = {
   { "blit", GSK_GPU_OPTIMIZE_BLIT, "Use shaders instead of vkCmdBlit()/glBlitFramebuffer()" },
   { "gradients", GSK_GPU_OPTIMIZE_GRADIENTS, "Don't supersample gradients" },
   { "mipmap", GSK_GPU_OPTIMIZE_MIPMAP, "Avoid creating mipmaps" },
+  { "occlusion", GSK_GPU_OPTIMIZE_OCCLUSION, "Draw nodes that are hidden behind opaque nodes" },
 };
 
 typedef struct _GskGpuRendererPrivate GskGpuRendererPrivate;
 
+typedef struct _GskGpuRenderJob GskGpuRenderJob;
+
+struct _GskGpuRenderJob
+{
+  GskGpuFrame *frame;
+  GskGpuImage *backbuffer;
+  cairo_region_t *render_region;
+  GskRenderNode *root;
+  graphene_rect_t viewport;
+  gint64 timestamp;
+};
+
 struct _GskGpuRendererPrivate
 {
   GskGpuDevice *device;
@@ -41,6 +55,16 @@ struct _GskGpuRendererPrivate
   GskGpuOptimizations optimizations;
 
   GskGpuFrame *frames[GSK_GPU_MAX_FRAMES];
+
+  /* With GSK_DEBUG=render-thread, frames are recorded and submitted
+   * in this thread while the main thread prepares the next one.
+   */
+  GThreadPool *render_thread;
+  /* atomic, the job the render thread is working on */
+  GskGpuRenderJob *pending_job;
+  /* the job that was rendered but not presented yet, only
+   * touched by the main thread while pending_job is NULL */
+  GskGpuRenderJob *finished_job;
 };
 
 static void     gsk_gpu_renderer_dmabuf_downloader_init         (GdkDmabufDownloaderInterface   *iface);
@@ -109,8 +133,11 @@ gsk_gpu_renderer_dmabuf_downloader_download (GdkDmabufDownloader *downloader,
                                              gsize                stride)
 {
   GskGpuRenderer *self = GSK_GPU_RENDERER (downloader);
+  GskGpuRendererPrivate *priv = gsk_gpu_renderer_get_instance_private (self);
   GskGpuFrame *frame;
 
+  gsk_gpu_device_lock (priv->device);
+
   gsk_gpu_renderer_make_current (self);
 
   frame = gsk_gpu_renderer_create_frame (self);
@@ -123,6 +150,8 @@ gsk_gpu_renderer_dmabuf_downloader_download (GdkDmabufDownloader *downloader,
                                   stride);
 
   g_object_unref (frame);
+
+  gsk_gpu_device_unlock (priv->device);
 }
 
 static void
@@ -196,6 +225,93 @@ gsk_gpu_renderer_get_frame (GskGpuRenderer *self)
   return earliest_frame;
 }
 
+static void
+gsk_gpu_render_job_free (GskGpuRenderJob *job)
+{
+  g_object_unref (job->backbuffer);
+  cairo_region_destroy (job->render_region);
+  gsk_render_node_unref (job->root);
+  g_free (job);
+}
+
+static gboolean
+gsk_gpu_renderer_job_is_done (gpointer data)
+{
+  GskGpuRendererPrivate *priv = data;
+
+  return g_atomic_pointer_get (&priv->pending_job) == NULL;
+}
+
+/* Waits for the render thread and presents the frame it rendered.
+ *
+ * Presenting has to happen on the main thread, so it is done from an
+ * idle or, if that did not run yet, before starting the next frame.
+ */
+static void
+gsk_gpu_renderer_finish_job (GskGpuRenderer *self)
+{
+  GskGpuRendererPrivate *priv = gsk_gpu_renderer_get_instance_private (self);
+  GskGpuRenderJob *job;
+
+  if (priv->render_thread == NULL)
+    return;
+
+  gdk_main_thread_wait_until (gsk_gpu_renderer_job_is_done, priv);
+
+  job = g_steal_pointer (&priv->finished_job);
+  if (job == NULL)
+    return;
+
+  gsk_gpu_device_lock (priv->device);
+
+  gsk_gpu_device_queue_gc (priv->device);
+
+  gdk_draw_context_end_frame (priv->context);
+
+  gsk_gpu_device_unlock (priv->device);
+
+  gsk_gpu_render_job_free (job);
+}
+
+static gboolean
+gsk_gpu_renderer_present_cb (gpointer data)
+{
+  GskGpuRenderer *self = data;
+
+  gsk_gpu_renderer_finish_job (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gsk_gpu_renderer_render_thread (gpointer data,
+                                gpointer user_data)
+{
+  GskGpuRenderJob *job = data;
+  GskGpuRenderer *self = user_data;
+  GskGpuRendererPrivate *priv = gsk_gpu_renderer_get_instance_private (self);
+  guint id;
+
+  gsk_gpu_device_lock (priv->device);
+
+  gsk_gpu_frame_render (job->frame,
+                        job->timestamp,
+                        job->backbuffer,
+                        job->render_region,
+                        job->root,
+                        &job->viewport,
+                        NULL);
+
+  gsk_gpu_device_unlock (priv->device);
+
+  priv->finished_job = job;
+  g_atomic_pointer_set (&priv->pending_job, NULL);
+  gdk_main_thread_wakeup ();
+
+  id = g_idle_add_full (G_PRIORITY_HIGH_IDLE, gsk_gpu_renderer_present_cb, g_object_ref (self), g_object_unref);
+  gdk_source_set_static_name_by_id (id, "[gtk] gsk_gpu_renderer_present_cb");
+}
+
 static gboolean
 gsk_gpu_renderer_realize (GskRenderer  *renderer,
                           GdkDisplay   *display,
@@ -219,6 +335,10 @@ gsk_gpu_renderer_realize (GskRenderer  *renderer,
 
   priv->optimizations &= context_optimizations;
 
+  if (GSK_RENDERER_DEBUG_CHECK (renderer, RENDER_THREAD) &&
+      GSK_GPU_RENDERER_GET_CLASS (self)->supports_render_thread)
+    priv->render_thread = g_thread_pool_new (gsk_gpu_renderer_render_thread, self, 1, TRUE, NULL);
+
   return TRUE;
 }
 
@@ -229,6 +349,10 @@ gsk_gpu_renderer_unrealize (GskRenderer *renderer)
   GskGpuRendererPrivate *priv = gsk_gpu_renderer_get_instance_private (self);
   gsize i;
 
+  gsk_gpu_renderer_finish_job (self);
+
+  gsk_gpu_device_lock (priv->device);
+
   gsk_gpu_renderer_make_current (self);
 
   for (i = 0; i < G_N_ELEMENTS (priv->frames); i++)
@@ -240,6 +364,14 @@ gsk_gpu_renderer_unrealize (GskRenderer *renderer)
       g_clear_object (&priv->frames[i]);
     }
 
+  gsk_gpu_device_unlock (priv->device);
+
+  if (priv->render_thread)
+    {
+      g_thread_pool_free (priv->render_thread, FALSE, TRUE);
+      priv->render_thread = NULL;
+    }
+
   g_clear_object (&priv->context);
   g_clear_object (&priv->device);
 }
@@ -338,6 +470,8 @@ gsk_gpu_renderer_render_texture (GskRenderer           *renderer,
   GdkTexture *texture;
   graphene_rect_t rounded_viewport;
 
+  gsk_gpu_device_lock (priv->device);
+
   gsk_gpu_device_maybe_gc (priv->device);
 
   gsk_gpu_renderer_make_current (self);
@@ -352,7 +486,11 @@ gsk_gpu_renderer_render_texture (GskRenderer           *renderer,
                                                 rounded_viewport.size.height);
 
   if (image == NULL)
-    return gsk_gpu_renderer_fallback_render_texture (self, root, &rounded_viewport);
+    {
+      texture = gsk_gpu_renderer_fallback_render_texture (self, root, &rounded_viewport);
+      gsk_gpu_device_unlock (priv->device);
+      return texture;
+    }
 
   frame = gsk_gpu_renderer_create_frame (self);
 
@@ -370,6 +508,8 @@ gsk_gpu_renderer_render_texture (GskRenderer           *renderer,
 
   gsk_gpu_device_queue_gc (priv->device);
 
+  gsk_gpu_device_unlock (priv->device);
+
   /* check that callback setting texture was actually called, as its technically async */
   g_assert (texture);
 
@@ -386,11 +526,20 @@ gsk_gpu_renderer_render (GskRenderer          *renderer,
   GskGpuFrame *frame;
   GskGpuImage *backbuffer;
   cairo_region_t *render_region;
+  graphene_rect_t viewport;
   double scale;
 
+  /* Only one frame can be in flight, so this blocks if the render
+   * thread is still busy with the previous one.
+   */
+  gsk_gpu_renderer_finish_job (self);
+
+  gsk_gpu_device_lock (priv->device);
+
   if (cairo_region_is_empty (region))
     {
       gdk_draw_context_empty_frame (priv->context);
+      gsk_gpu_device_unlock (priv->device);
       return;
     }
 
@@ -407,23 +556,48 @@ gsk_gpu_renderer_render (GskRenderer          *renderer,
   frame = gsk_gpu_renderer_get_frame (self);
   render_region = get_render_region (self);
   scale = gsk_gpu_renderer_get_scale (self);
+  viewport = GRAPHENE_RECT_INIT (0, 0,
+                                 gsk_gpu_image_get_width (backbuffer) / scale,
+                                 gsk_gpu_image_get_height (backbuffer) / scale);
+
+  if (priv->render_thread)
+    {
+      GskGpuRenderJob *job;
+
+      /* Release what the last use of the frame held on to here,
+       * so nodes and fonts are never freed on the render thread.
+       */
+      gsk_gpu_frame_cleanup (frame);
+
+      job = g_new (GskGpuRenderJob, 1);
+      job->frame = frame;
+      job->backbuffer = g_object_ref (backbuffer);
+      job->render_region = render_region;
+      job->root = gsk_render_node_ref (root);
+      job->viewport = viewport;
+      job->timestamp = g_get_monotonic_time ();
+
+      gsk_gpu_device_unlock (priv->device);
+
+      g_atomic_pointer_set (&priv->pending_job, job);
+      g_thread_pool_push (priv->render_thread, job, NULL);
+      return;
+    }
 
   gsk_gpu_frame_render (frame,
                         g_get_monotonic_time (),
                         backbuffer,
                         render_region,
                         root,
-                        &GRAPHENE_RECT_INIT (
-                          0, 0,
-                          gsk_gpu_image_get_width (backbuffer) / scale,
-                          gsk_gpu_image_get_height (backbuffer) / scale
-                        ),
+                        &viewport,
                         NULL);
 
   gsk_gpu_device_queue_gc (priv->device);
 
   gdk_draw_context_end_frame (priv->context);
 
+  gsk_gpu_device_unlock (priv->device);
+
   g_clear_pointer (&render_region, cairo_region_destroy);
 }
 
@@ -24,6 +24,7 @@ struct _GskGpuRendererClass
 
   GType frame_type;
   GskGpuOptimizations optimizations; /* subclasses cannot override this */
+  gboolean supports_render_thread;
 
   GskGpuDevice *        (* get_device)                                  (GdkDisplay             *display,
                                                                          GError                **error);
@@ -13,7 +13,24 @@
 #endif
 
 #include "gdk/gdkglcontextprivate.h"
+#include "gdk/gdkprivate.h"
+#include "gdk/gdkprofilerprivate.h"
+#include "gdk/gdktexturedownloaderprivate.h"
 #include "gsk/gskdebugprivate.h"
+#include "gsk/gskprivate.h"
+
+#include <string.h>
+
+static void
+gsk_gpu_upload_op_add_bytes (GskGpuFrame *frame,
+                             GskGpuImage *image,
+                             gsize        width,
+                             gsize        height)
+{
+  gsize bpp = gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (image));
+
+  gsk_gpu_frame_add_upload_bytes (frame, width * height * bpp);
+}
 
 static GskGpuOp *
 gsk_gpu_upload_op_gl_command_with_area (GskGpuOp                    *op,
@@ -213,6 +230,10 @@ struct _GskGpuUploadTextureOp
   GskGpuImage *image;
   GskGpuBuffer *buffer;
   GdkTexture *texture;
+
+  /* The converted pixels if they were prepared ahead of time */
+  guchar *data;
+  gsize stride;
 };
 
 static void
@@ -223,6 +244,7 @@ gsk_gpu_upload_texture_op_finish (GskGpuOp *op)
   g_object_unref (self->image);
   g_clear_object (&self->buffer);
   g_object_unref (self->texture);
+  g_free (self->data);
 }
 
 static void
@@ -246,6 +268,17 @@ gsk_gpu_upload_texture_op_draw (GskGpuOp *op,
   GskGpuUploadTextureOp *self = (GskGpuUploadTextureOp *) op;
   GdkTextureDownloader *downloader;
 
+  if (self->data)
+    {
+      gsize y, height;
+
+      height = gsk_gpu_image_get_height (self->image);
+      for (y = 0; y < height; y++)
+        memcpy (data + y * stride, self->data + y * self->stride, self->stride);
+
+      return;
+    }
+
   downloader = gdk_texture_downloader_new (self->texture);
   gdk_texture_downloader_set_format (downloader, gsk_gpu_image_get_format (self->image));
   gdk_texture_downloader_download_into (downloader, data, stride);
@@ -338,6 +371,8 @@ gsk_gpu_upload_texture_op_try (GskGpuFrame *frame,
   self->texture = g_object_ref (texture);
   self->image = image;
 
+  gsk_gpu_upload_op_add_bytes (frame, image, gsk_gpu_image_get_width (image), gsk_gpu_image_get_height (image));
+
   return self->image;
 }
 
@@ -380,6 +415,24 @@ gsk_gpu_upload_cairo_op_print (GskGpuOp    *op,
   gsk_gpu_print_newline (string);
 }
 
+typedef struct _CairoDraw CairoDraw;
+
+struct _CairoDraw
+{
+  GskGpuUploadCairoOp *op;
+  cairo_t *cr;
+};
+
+static gboolean
+gsk_gpu_upload_cairo_op_call_func (gpointer data)
+{
+  CairoDraw *draw = data;
+
+  draw->op->func (draw->op->user_data, draw->cr);
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 gsk_gpu_upload_cairo_op_draw (GskGpuOp *op,
                               guchar   *data,
@@ -406,7 +459,11 @@ gsk_gpu_upload_cairo_op_draw (GskGpuOp *op,
   cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
   cairo_translate (cr, -self->viewport.origin.x, -self->viewport.origin.y);
 
-  self->func (self->user_data, cr);
+  /* Fallbacks draw text and other things that use pango, which is not
+   * threadsafe, but we might be in a render thread.
+   */
+  gdk_main_thread_invoke (gsk_gpu_upload_cairo_op_call_func,
+                          &(CairoDraw) { self, cr });
 
   cairo_destroy (cr);
 
@@ -477,6 +534,8 @@ gsk_gpu_upload_cairo_op (GskGpuFrame           *frame,
   self->user_data = user_data;
   self->user_destroy = user_destroy;
 
+  gsk_gpu_upload_op_add_bytes (frame, self->image, gsk_gpu_image_get_width (self->image), gsk_gpu_image_get_height (self->image));
+
   return self->image;
 }
 
@@ -489,9 +548,14 @@ struct _GskGpuUploadGlyphOp
   GskGpuImage *image;
   cairo_rectangle_int_t area;
   PangoFont *font;
+  cairo_scaled_font_t *scaled_font;
   PangoGlyph glyph;
   graphene_point_t origin;
 
+  /* The glyph if it was rasterized ahead of time */
+  guchar *data;
+  gsize stride;
+
   GskGpuBuffer *buffer;
 };
 
@@ -502,6 +566,8 @@ gsk_gpu_upload_glyph_op_finish (GskGpuOp *op)
 
   g_object_unref (self->image);
   g_object_unref (self->font);
+  cairo_scaled_font_destroy (self->scaled_font);
+  g_free (self->data);
 
   g_clear_object (&self->buffer);
 }
@@ -528,15 +594,14 @@ gsk_gpu_upload_glyph_op_print (GskGpuOp    *op,
   pango_font_description_free (desc);
 }
 
+/* Only uses cairo, which, unlike pango, is threadsafe */
 static void
-gsk_gpu_upload_glyph_op_draw (GskGpuOp *op,
-                              guchar   *data,
-                              gsize     stride)
+gsk_gpu_upload_glyph_op_rasterize (GskGpuUploadGlyphOp *self,
+                                   guchar              *data,
+                                   gsize                stride)
 {
-  GskGpuUploadGlyphOp *self = (GskGpuUploadGlyphOp *) op;
   cairo_surface_t *surface;
   cairo_t *cr;
-  PangoRectangle ink_rect = { 0, };
 
   surface = cairo_image_surface_create_for_data (data,
                                                  CAIRO_FORMAT_ARGB32,
@@ -550,17 +615,50 @@ gsk_gpu_upload_glyph_op_draw (GskGpuOp *op,
   cairo_paint (cr);
   cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
 
-  /* Make sure the entire surface is initialized to black */
-  cairo_set_source_rgba (cr, 0, 0, 0, 0);
-  cairo_rectangle (cr, 0.0, 0.0, self->area.width, self->area.height);
-  cairo_fill (cr);
+  cairo_set_source_rgba (cr, 1, 1, 1, 1);
+  cairo_set_scaled_font (cr, self->scaled_font);
+  cairo_show_glyphs (cr, &(cairo_glyph_t) { self->glyph, 0, 0 }, 1);
+  cairo_destroy (cr);
+
+  cairo_surface_finish (surface);
+  cairo_surface_destroy (surface);
+}
+
+typedef struct _HexBoxDraw HexBoxDraw;
+
+struct _HexBoxDraw
+{
+  GskGpuUploadGlyphOp *op;
+  guchar *data;
+  gsize stride;
+};
+
+/* The hex boxes for unknown glyphs are drawn by pango */
+static gboolean
+gsk_gpu_upload_glyph_op_draw_hex_box (gpointer user_data)
+{
+  HexBoxDraw *draw = user_data;
+  GskGpuUploadGlyphOp *self = draw->op;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  PangoRectangle ink_rect = { 0, };
+
+  surface = cairo_image_surface_create_for_data (draw->data,
+                                                 CAIRO_FORMAT_ARGB32,
+                                                 self->area.width,
+                                                 self->area.height,
+                                                 draw->stride);
+  cairo_surface_set_device_offset (surface, self->origin.x, self->origin.y);
+
+  cr = cairo_create (surface);
+  cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
 
-  /* Draw glyph */
   cairo_set_source_rgba (cr, 1, 1, 1, 1);
 
   /* The pango code for drawing hex boxes uses the glyph width */
-  if (self->glyph & PANGO_GLYPH_UNKNOWN_FLAG)
-    pango_font_get_glyph_extents (self->font, self->glyph, &ink_rect, NULL);
+  pango_font_get_glyph_extents (self->font, self->glyph, &ink_rect, NULL);
 
   pango_cairo_show_glyph_string (cr,
                                  self->font,
@@ -578,6 +676,38 @@ gsk_gpu_upload_glyph_op_draw (GskGpuOp *op,
 
   cairo_surface_finish (surface);
   cairo_surface_destroy (surface);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gsk_gpu_upload_glyph_op_draw (GskGpuOp *op,
+                              guchar   *data,
+                              gsize     stride)
+{
+  GskGpuUploadGlyphOp *self = (GskGpuUploadGlyphOp *) op;
+
+  if (self->data && stride == self->stride)
+    {
+      memcpy (data, self->data, self->area.height * stride);
+    }
+  else if (self->data)
+    {
+      gsize y;
+
+      for (y = 0; y < self->area.height; y++)
+        memcpy (data + y * stride, self->data + y * self->stride, self->area.width * 4);
+    }
+  else if (self->glyph & PANGO_GLYPH_UNKNOWN_FLAG)
+    {
+      /* We might be in a render thread */
+      gdk_main_thread_invoke (gsk_gpu_upload_glyph_op_draw_hex_box,
+                              &(HexBoxDraw) { self, data, stride });
+    }
+  else
+    {
+      gsk_gpu_upload_glyph_op_rasterize (self, data, stride);
+    }
 }
 
 #ifdef GDK_RENDERING_VULKAN
@@ -623,10 +753,18 @@ static const GskGpuOpClass GSK_GPU_UPLOAD_GLYPH_OP_CLASS = {
   gsk_gpu_upload_glyph_op_gl_command,
 };
 
+/*
+ * gsk_gpu_upload_glyph_op:
+ * @scaled_font: the cairo font of @font. Pango is not threadsafe, so
+ *   callers have to look it up on the main thread.
+ *
+ * Draws a glyph into @area of @image.
+ */
 void
 gsk_gpu_upload_glyph_op (GskGpuFrame                 *frame,
                          GskGpuImage                 *image,
                          PangoFont                   *font,
+                         cairo_scaled_font_t         *scaled_font,
                          const PangoGlyph             glyph,
                          const cairo_rectangle_int_t *area,
                          const graphene_point_t      *origin)
@@ -638,6 +776,141 @@ gsk_gpu_upload_glyph_op (GskGpuFrame                 *frame,
   self->image = g_object_ref (image);
   self->area = *area;
   self->font = g_object_ref (font);
+  self->scaled_font = cairo_scaled_font_reference (scaled_font);
   self->glyph = glyph;
   self->origin = *origin;
+
+  gsk_gpu_upload_op_add_bytes (frame, image, area->width, area->height);
+}
+
+/* Below this many bytes to prepare, handing work to other threads costs more than it saves */
+#define MIN_BYTES_PER_THREAD (64 * 1024)
+#define MAX_PREPARE_THREADS 8
+
+typedef struct _PrepareJob PrepareJob;
+
+struct _PrepareJob
+{
+  GskGpuOp **ops;
+  guint n_ops;
+  int next_op; /* atomic */
+};
+
+static void
+gsk_gpu_upload_glyph_op_prepare (GskGpuUploadGlyphOp *self)
+{
+  self->stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, self->area.width);
+  self->data = g_malloc (self->area.height * self->stride);
+
+  gsk_gpu_upload_glyph_op_rasterize (self, self->data, self->stride);
+}
+
+/* Memory textures are immutable, so converting them is threadsafe */
+static void
+gsk_gpu_upload_texture_op_prepare (GskGpuUploadTextureOp *self)
+{
+  GdkTextureDownloader downloader;
+  GdkMemoryFormat format;
+
+  format = gsk_gpu_image_get_format (self->image);
+  self->stride = gsk_gpu_image_get_width (self->image) * gdk_memory_format_bytes_per_pixel (format);
+  self->data = g_malloc (gsk_gpu_image_get_height (self->image) * self->stride);
+
+  gdk_texture_downloader_init (&downloader, self->texture);
+  gdk_texture_downloader_set_format (&downloader, format);
+  gdk_texture_downloader_download_into (&downloader, self->data, self->stride);
+  gdk_texture_downloader_finish (&downloader);
+}
+
+static void
+gsk_gpu_prepare_uploads_thread (gpointer data,
+                                guint    index)
+{
+  PrepareJob *job = data;
+  guint i;
+
+  while ((i = g_atomic_int_add (&job->next_op, 1)) < job->n_ops)
+    {
+      GskGpuOp *op = job->ops[i];
+
+      if (op->op_class == &GSK_GPU_UPLOAD_GLYPH_OP_CLASS)
+        gsk_gpu_upload_glyph_op_prepare ((GskGpuUploadGlyphOp *) op);
+      else if (op->op_class == &GSK_GPU_UPLOAD_TEXTURE_OP_CLASS)
+        gsk_gpu_upload_texture_op_prepare ((GskGpuUploadTextureOp *) op);
+      else
+        g_assert_not_reached ();
+    }
+}
+
+/**
+ * gsk_gpu_upload_ops_prepare:
+ * @first_op: the first op of a frame
+ *
+ * Does the CPU work for the upload ops in the frame that can be done
+ * without the GPU on multiple threads, so that executing the ops only
+ * needs to copy the results. This covers rasterizing glyphs and
+ * converting memory textures to the format of their image.
+ *
+ * Frames with little work to prepare are left alone.
+ */
+void
+gsk_gpu_upload_ops_prepare (GskGpuOp *first_op)
+{
+  PrepareJob job = { NULL, };
+  GPtrArray *ops;
+  guint n_threads;
+  gsize n_bytes;
+  GskGpuOp *op;
+  gint64 before G_GNUC_UNUSED = GDK_PROFILER_CURRENT_TIME;
+
+  ops = g_ptr_array_new ();
+  n_bytes = 0;
+
+  for (op = first_op; op; op = op->next)
+    {
+      if (op->op_class == &GSK_GPU_UPLOAD_GLYPH_OP_CLASS)
+        {
+          GskGpuUploadGlyphOp *self = (GskGpuUploadGlyphOp *) op;
+
+          /* Hex boxes are drawn by pango */
+          if (self->glyph & PANGO_GLYPH_UNKNOWN_FLAG)
+            continue;
+
+          if (cairo_scaled_font_status (self->scaled_font) != CAIRO_STATUS_SUCCESS)
+            continue;
+
+          n_bytes += self->area.width * self->area.height * 4;
+        }
+      else if (op->op_class == &GSK_GPU_UPLOAD_TEXTURE_OP_CLASS)
+        {
+          GskGpuUploadTextureOp *self = (GskGpuUploadTextureOp *) op;
+
+          /* Straight copies are limited by memory bandwidth, not by the CPU */
+          if (!GDK_IS_MEMORY_TEXTURE (self->texture) ||
+              gdk_texture_get_format (self->texture) == gsk_gpu_image_get_format (self->image))
+            continue;
+
+          n_bytes += gsk_gpu_image_get_width (self->image) *
+                     gsk_gpu_image_get_height (self->image) *
+                     gdk_memory_format_bytes_per_pixel (gsk_gpu_image_get_format (self->image));
+        }
+      else
+        continue;
+
+      g_ptr_array_add (ops, op);
+    }
+
+  n_threads = MIN (n_bytes / MIN_BYTES_PER_THREAD, MIN (g_get_num_processors (), MAX_PREPARE_THREADS));
+
+  if (n_threads > 1)
+    {
+      job.ops = (GskGpuOp **) ops->pdata;
+      job.n_ops = ops->len;
+
+      gsk_parallel_run (gsk_gpu_prepare_uploads_thread, &job, n_threads);
+
+      gdk_profiler_end_markf (before, "Prepare uploads", "%u uploads on %u threads", ops->len, n_threads);
+    }
+
+  g_ptr_array_unref (ops);
 }
@@ -23,9 +23,12 @@ GskGpuImage *           gsk_gpu_upload_cairo_op                         (GskGpuF
 void                    gsk_gpu_upload_glyph_op                         (GskGpuFrame                    *frame,
                                                                          GskGpuImage                    *image,
                                                                          PangoFont                      *font,
+                                                                         cairo_scaled_font_t            *scaled_font,
                                                                          PangoGlyph                      glyph,
                                                                          const cairo_rectangle_int_t    *area,
                                                                          const graphene_point_t         *origin);
 
+void                    gsk_gpu_upload_ops_prepare                      (GskGpuOp                       *first_op);
+
 G_END_DECLS
 
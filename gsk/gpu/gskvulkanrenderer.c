@@ -160,6 +160,7 @@ gsk_vulkan_renderer_class_init (GskVulkanRendererClass *klass)
   GskRendererClass *renderer_class = GSK_RENDERER_CLASS (klass);
 
   gpu_renderer_class->frame_type = GSK_TYPE_VULKAN_FRAME;
+  gpu_renderer_class->supports_render_thread = TRUE;
 
   gpu_renderer_class->get_device = gsk_vulkan_device_get_for_display;
   gpu_renderer_class->create_context = gsk_vulkan_renderer_create_context;
@@ -22,9 +22,15 @@
 
 #include "gskcairoblurprivate.h"
 
+#include "gskprivate.h"
+
 #include <math.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /*
  * Gets the size for a single box blur.
  *
@@ -38,38 +44,148 @@
 
 #define get_box_filter_size(radius) ((int)(GAUSSIAN_SCALE_FACTOR * (radius)))
 
-/* Sadly, clang is picky about get_box_filter_size(2) not being a
- * constant expression, thus we have to use precomputed values.
+/* Below this many pixels, handing work to other threads costs more than it saves */
+#define MIN_PIXELS_PER_THREAD (256 * 256)
+#define MAX_BLUR_THREADS 8
+
+/* Dividing by multiplying with the reciprocal as a float gives the
+ * same result as the integer division for divisors below this, see
+ * divide_row().
  */
-#define BOX_FILTER_SIZE_2 3
-#define BOX_FILTER_SIZE_3 5
-#define BOX_FILTER_SIZE_4 7
-#define BOX_FILTER_SIZE_5 9
-#define BOX_FILTER_SIZE_6 11
-#define BOX_FILTER_SIZE_7 13
-#define BOX_FILTER_SIZE_8 15
-#define BOX_FILTER_SIZE_9 16
-#define BOX_FILTER_SIZE_10 18
-
-/* This applies a single box blur pass to a horizontal range of pixels;
+#define MAX_FLOAT_DIVISOR (1 << 14)
+
+static inline void
+add_row (guint32      *sums,
+         const guchar *row,
+         int           width)
+{
+  int x = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128 ();
+
+  for (; x + 16 <= width; x += 16)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) (row + x));
+      __m128i lo = _mm_unpacklo_epi8 (pixels, zero);
+      __m128i hi = _mm_unpackhi_epi8 (pixels, zero);
+      __m128i *s = (__m128i *) (sums + x);
+
+      _mm_storeu_si128 (s + 0, _mm_add_epi32 (_mm_loadu_si128 (s + 0), _mm_unpacklo_epi16 (lo, zero)));
+      _mm_storeu_si128 (s + 1, _mm_add_epi32 (_mm_loadu_si128 (s + 1), _mm_unpackhi_epi16 (lo, zero)));
+      _mm_storeu_si128 (s + 2, _mm_add_epi32 (_mm_loadu_si128 (s + 2), _mm_unpacklo_epi16 (hi, zero)));
+      _mm_storeu_si128 (s + 3, _mm_add_epi32 (_mm_loadu_si128 (s + 3), _mm_unpackhi_epi16 (hi, zero)));
+    }
+#endif
+
+  for (; x < width; x++)
+    sums[x] += row[x];
+}
+
+static inline void
+subtract_row (guint32      *sums,
+              const guchar *row,
+              int           width)
+{
+  int x = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128 ();
+
+  for (; x + 16 <= width; x += 16)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) (row + x));
+      __m128i lo = _mm_unpacklo_epi8 (pixels, zero);
+      __m128i hi = _mm_unpackhi_epi8 (pixels, zero);
+      __m128i *s = (__m128i *) (sums + x);
+
+      _mm_storeu_si128 (s + 0, _mm_sub_epi32 (_mm_loadu_si128 (s + 0), _mm_unpacklo_epi16 (lo, zero)));
+      _mm_storeu_si128 (s + 1, _mm_sub_epi32 (_mm_loadu_si128 (s + 1), _mm_unpackhi_epi16 (lo, zero)));
+      _mm_storeu_si128 (s + 2, _mm_sub_epi32 (_mm_loadu_si128 (s + 2), _mm_unpacklo_epi16 (hi, zero)));
+      _mm_storeu_si128 (s + 3, _mm_sub_epi32 (_mm_loadu_si128 (s + 3), _mm_unpackhi_epi16 (hi, zero)));
+    }
+#endif
+
+  for (; x < width; x++)
+    sums[x] -= row[x];
+}
+
+/* Computes (sum + d / 2) / d for a row of sums.
+ *
+ * An integer division per pixel is slow and doesn't vectorize, so we
+ * multiply with 1 / d instead. A sum is at most 255 * d, so
+ * (sum + d / 2 + 0.5) / d is at least 0.5 / d away from the next
+ * integer, while the error from rounding to floats stays below 2^-15.
+ * So truncating gives the exact result as long as d < 2^14.
+ */
+static inline void
+divide_row (guchar        *row,
+            const guint32 *sums,
+            int            width,
+            int            d)
+{
+  int x = 0;
+
+  if (d < MAX_FLOAT_DIVISOR)
+    {
+      float inv = 1.0f / d;
+
+#ifdef __SSE2__
+      const __m128i round = _mm_set1_epi32 (d / 2);
+      const __m128 half = _mm_set1_ps (0.5f);
+      const __m128 inv4 = _mm_set1_ps (inv);
+
+      for (; x + 16 <= width; x += 16)
+        {
+          const __m128i *s = (const __m128i *) (sums + x);
+          __m128i q[4];
+          int j;
+
+          for (j = 0; j < 4; j++)
+            {
+              __m128 f = _mm_cvtepi32_ps (_mm_add_epi32 (_mm_loadu_si128 (s + j), round));
+              q[j] = _mm_cvttps_epi32 (_mm_mul_ps (_mm_add_ps (f, half), inv4));
+            }
+
+          _mm_storeu_si128 ((__m128i *) (row + x),
+                            _mm_packus_epi16 (_mm_packs_epi32 (q[0], q[1]),
+                                              _mm_packs_epi32 (q[2], q[3])));
+        }
+#endif
+
+      for (; x < width; x++)
+        row[x] = ((float) (sums[x] + d / 2) + 0.5f) * inv;
+    }
+
+  for (; x < width; x++)
+    row[x] = (sums[x] + d / 2) / d;
+}
+
+/* This applies a single box blur pass to the columns of a buffer;
  * since the box blur has the same weight for all pixels, we can
  * implement an efficient sliding window algorithm where we add
- * in pixels coming into the window from the right and remove
- * them when they leave the windw to the left.
+ * in rows coming into the window from the bottom and remove
+ * them when they leave the window at the top.
+ *
+ * Working on whole rows at a time keeps memory access sequential and
+ * lets us handle many columns at once with vector instructions, unlike
+ * sliding along a single row, where each pixel depends on the last.
  *
  * d is the filter width; for even d shift indicates how the blurred
  * result is aligned with the original - does ' x ' go to ' yy' (shift=1)
  * or 'yy ' (shift=-1)
  */
 static void
-blur_xspan (guchar *row,
-            guchar *tmp_buffer,
-            int     row_width,
-            int     d,
-            int     shift)
+blur_yspan (guchar       *dst_buffer,
+            const guchar *src_buffer,
+            guint32      *sums,
+            int           stride,
+            int           width,
+            int           height,
+            int           d,
+            int           shift)
 {
   int offset;
-  int sum = 0;
   int i;
 
   if (d % 2 == 1)
@@ -77,92 +193,66 @@ blur_xspan (guchar *row,
   else
     offset = (d - shift) / 2;
 
-  /* All the conditionals in here look slow, but the branches will
-   * be well predicted and there are enough different possibilities
-   * that trying to write this as a series of unconditional loops
-   * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division per pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
-   */
+  memset (sums, 0, width * sizeof (guint32));
 
-#define BLUR_ROW_KERNEL(D)                                      \
-  for (i = -(D) + offset; i < row_width + offset; i++)		\
-    {                                                           \
-      if (i >= 0 && i < row_width)                              \
-        sum += row[i];                                          \
-                                                                \
-      if (i >= offset)						\
-	{							\
-	  if (i >= (D))						\
-	    sum -= row[i - (D)];				\
-                                                                \
-	  tmp_buffer[i - offset] = (sum + (D) / 2) / (D);	\
-	}							\
-    }								\
-  break;
-
-  /* We unroll the values for d for radius 2-10 to avoid a generic
-   * divide operation (not radius 1, because its a no-op) */
-  switch (d)
+  for (i = 0; i < height + offset; i++)
     {
-    case BOX_FILTER_SIZE_2: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_2);
-    case BOX_FILTER_SIZE_3: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_3);
-    case BOX_FILTER_SIZE_4: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_4);
-    case BOX_FILTER_SIZE_5: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_5);
-    case BOX_FILTER_SIZE_6: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_6);
-    case BOX_FILTER_SIZE_7: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_7);
-    case BOX_FILTER_SIZE_8: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_8);
-    case BOX_FILTER_SIZE_9: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_9);
-    case BOX_FILTER_SIZE_10: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_10);
-    default: BLUR_ROW_KERNEL (d);
-    }
+      if (i < height)
+        add_row (sums, src_buffer + i * stride, width);
 
-  memcpy (row, tmp_buffer, row_width);
+      if (i >= offset)
+        {
+          if (i >= d)
+            subtract_row (sums, src_buffer + (i - d) * stride, width);
+
+          divide_row (dst_buffer + (i - offset) * stride, sums, width, d);
+        }
+    }
 }
 
 static void
-blur_rows (guchar *dst_buffer,
-           guchar *tmp_buffer,
-           int     buffer_width,
-           int     buffer_height,
-           int     d)
+blur_columns (guchar  *buffer,
+              guchar  *tmp_buffer,
+              guint32 *sums,
+              int      stride,
+              int      width,
+              int      height,
+              int      d)
 {
   int i;
 
-  for (i = 0; i < buffer_height; i++)
+  /* We want to produce a symmetric blur that spreads a pixel
+   * equally far to the top and bottom. If d is odd that happens
+   * naturally, but for d even, we approximate by using a blur
+   * on either side and then a centered blur of size d + 1.
+   * (technique also from the SVG specification)
+   */
+  if (d % 2 == 1)
     {
-      guchar *row = dst_buffer + i * buffer_width;
-
-      /* We want to produce a symmetric blur that spreads a pixel
-       * equally far to the left and right. If d is odd that happens
-       * naturally, but for d even, we approximate by using a blur
-       * on either side and then a centered blur of size d + 1.
-       * (technique also from the SVG specification)
-       */
-      if (d % 2 == 1)
-        {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-        }
-      else
-        {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 1);
-          blur_xspan (row, tmp_buffer, buffer_width, d, -1);
-          blur_xspan (row, tmp_buffer, buffer_width, d + 1, 0);
-        }
+      blur_yspan (tmp_buffer, buffer, sums, stride, width, height, d, 0);
+      blur_yspan (buffer, tmp_buffer, sums, stride, width, height, d, 0);
+      blur_yspan (tmp_buffer, buffer, sums, stride, width, height, d, 0);
+    }
+  else
+    {
+      blur_yspan (tmp_buffer, buffer, sums, stride, width, height, d, 1);
+      blur_yspan (buffer, tmp_buffer, sums, stride, width, height, d, -1);
+      blur_yspan (tmp_buffer, buffer, sums, stride, width, height, d + 1, 0);
     }
+
+  for (i = 0; i < height; i++)
+    memcpy (buffer + i * stride, tmp_buffer + i * stride, width);
 }
 
 /* Swaps width and height.
  */
 static void
-flip_buffer (guchar *dst_buffer,
-             guchar *src_buffer,
-             int     width,
-             int     height)
+flip_buffer (guchar       *dst_buffer,
+             int           dst_stride,
+             const guchar *src_buffer,
+             int           src_stride,
+             int           width,
+             int           height)
 {
   /* Working in blocks increases cache efficiency, compared to reading
    * or writing an entire column at once
@@ -180,11 +270,101 @@ flip_buffer (guchar *dst_buffer,
 
         for (i = i0; i < max_i; i++)
           for (j = j0; j < max_j; j++)
-            dst_buffer[i * height + j] = src_buffer[j * width + i];
+            dst_buffer[i * dst_stride + j] = src_buffer[j * src_stride + i];
       }
 #undef BLOCK_SIZE
 }
 
+typedef struct _BlurJob BlurJob;
+
+struct _BlurJob
+{
+  guchar *buffer;
+  guchar *flipped_buffer;
+  guchar *tmp_buffer;
+  int width;
+  int height;
+  int d;
+  GskBlurFlags direction;
+  /* The columns for GSK_BLUR_Y, the rows for GSK_BLUR_X */
+  int start;
+  int end;
+};
+
+static void
+blur_band (gpointer data,
+           guint    index)
+{
+  BlurJob *job = &((BlurJob *) data)[index];
+  guint32 *sums;
+  int n;
+
+  n = job->end - job->start;
+  if (n <= 0)
+    return;
+
+  sums = g_new (guint32, n);
+
+  if (job->direction == GSK_BLUR_Y)
+    {
+      blur_columns (job->buffer + job->start,
+                    job->tmp_buffer + job->start,
+                    sums,
+                    job->width, n, job->height,
+                    job->d);
+    }
+  else
+    {
+      /* Step 1: swap rows and columns */
+      flip_buffer (job->flipped_buffer + job->start, job->height,
+                   job->buffer + job->start * job->width, job->width,
+                   job->width, n);
+
+      /* Step 2: blur columns (really rows) */
+      blur_columns (job->flipped_buffer + job->start,
+                    job->tmp_buffer + job->start,
+                    sums,
+                    job->height, n, job->width,
+                    job->d);
+
+      /* Step 3: swap rows and columns */
+      flip_buffer (job->buffer + job->start * job->width, job->width,
+                   job->flipped_buffer + job->start, job->height,
+                   n, job->width);
+    }
+
+  g_free (sums);
+}
+
+/* Columns don't depend on each other, so large buffers are split into
+ * bands that are blurred on multiple threads.
+ */
+static void
+blur_threaded (const BlurJob *job,
+               int            n_lines)
+{
+  BlurJob jobs[MAX_BLUR_THREADS];
+  guint i, n_threads;
+  int band;
+
+  n_threads = MIN ((gsize) job->width * job->height / MIN_PIXELS_PER_THREAD,
+                   MIN (g_get_num_processors (), MAX_BLUR_THREADS));
+  n_threads = MAX (n_threads, 1);
+
+  /* Keep bands a multiple of the vector width */
+  band = (n_lines + n_threads - 1) / n_threads;
+  band = (band + 15) & ~15;
+
+  for (i = 0; i < n_threads; i++)
+    {
+      jobs[i] = *job;
+      jobs[i].start = MIN ((int) i * band, n_lines);
+      jobs[i].end = MIN ((int) (i + 1) * band, n_lines);
+    }
+
+  gsk_parallel_run (blur_band, jobs, n_threads);
+}
+
 static void
 _boxblur (guchar      *buffer,
           int          width,
@@ -192,30 +372,29 @@ _boxblur (guchar      *buffer,
           int          radius,
           GskBlurFlags flags)
 {
-  guchar *flipped_buffer;
-  int d = get_box_filter_size (radius);
+  BlurJob job = { NULL, };
 
-  flipped_buffer = g_malloc (width * height);
+  job.buffer = buffer;
+  job.tmp_buffer = g_malloc (width * height);
+  job.width = width;
+  job.height = height;
+  job.d = get_box_filter_size (radius);
 
   if (flags & GSK_BLUR_Y)
     {
-      /* Step 1: swap rows and columns */
-      flip_buffer (flipped_buffer, buffer, width, height);
-
-      /* Step 2: blur rows (really columns) */
-      blur_rows (flipped_buffer, buffer, height, width, d);
-
-      /* Step 3: swap rows and columns */
-      flip_buffer (buffer, flipped_buffer, height, width);
+      job.direction = GSK_BLUR_Y;
+      blur_threaded (&job, width);
     }
 
   if (flags & GSK_BLUR_X)
     {
-      /* Step 4: blur rows */
-      blur_rows (buffer, flipped_buffer, width, height, d);
+      job.direction = GSK_BLUR_X;
+      job.flipped_buffer = g_malloc (width * height);
+      blur_threaded (&job, height);
     }
 
-  g_free (flipped_buffer);
+  g_free (job.flipped_buffer);
+  g_free (job.tmp_buffer);
 }
 
 /*
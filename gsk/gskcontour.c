@@ -521,6 +521,12 @@ gsk_contour_print_default (const GskContour *contour,
 /* }}} */
 /* {{{ Standard */
 
+/* Long contours keep the bounds of every CHUNK_SIZE ops, so that
+ * queries like in-fill or closest-point can skip over the parts of
+ * the contour that are too far away.
+ */
+#define CHUNK_SIZE 16
+
 typedef struct _GskStandardContour GskStandardContour;
 struct _GskStandardContour
 {
@@ -533,9 +539,20 @@ struct _GskStandardContour
   gsize n_ops;
   gsize n_points;
   graphene_point_t *points;
+  gsize n_chunks;
+  GskBoundingBox *chunk_bounds;
   gskpathop ops[];
 };
 
+static inline gsize
+gsk_standard_contour_compute_n_chunks (gsize n_ops)
+{
+  if (n_ops <= 2 * CHUNK_SIZE)
+    return 0;
+
+  return (n_ops + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
 static gsize
 gsk_standard_contour_compute_size (gsize n_ops,
                                    gsize n_points)
@@ -545,7 +562,8 @@ gsk_standard_contour_compute_size (gsize n_ops,
                           G_ALIGNOF (GskStandardContour)));
   gsize s = sizeof (GskStandardContour)
           + sizeof (gskpathop) * n_ops
-          + sizeof (graphene_point_t) * n_points;
+          + sizeof (graphene_point_t) * n_points
+          + sizeof (GskBoundingBox) * gsk_standard_contour_compute_n_chunks (n_ops);
   return s + (align - (s % align));
 }
 
@@ -702,6 +720,18 @@ gsk_standard_contour_get_winding (const GskContour       *contour,
     {
       GskCurve c;
 
+      if (self->n_chunks > 0 && i % CHUNK_SIZE == 0)
+        {
+          const GskBoundingBox *chunk = &self->chunk_bounds[i / CHUNK_SIZE];
+
+          /* Same test as get_crossing_by_bisection(), the ray goes right */
+          if (chunk->max.y < point->y || chunk->min.y > point->y || chunk->max.x < point->x)
+            {
+              i += CHUNK_SIZE - 1;
+              continue;
+            }
+        }
+
       if (gsk_pathop_op (self->ops[i]) == GSK_PATH_MOVE)
         continue;
 
@@ -760,11 +790,21 @@ gsk_standard_contour_get_closest_point (const GskContour       *contour,
       return FALSE;
     }
 
+  if (!gsk_bounding_box_contains_point_with_epsilon (&self->bounds, point, threshold))
+    return FALSE;
+
   for (gsize i = 0; i < self->n_ops; i ++)
     {
       GskCurve c;
       float distance, t;
 
+      if (self->n_chunks > 0 && i % CHUNK_SIZE == 0 &&
+          !gsk_bounding_box_contains_point_with_epsilon (&self->chunk_bounds[i / CHUNK_SIZE], point, threshold))
+        {
+          i += CHUNK_SIZE - 1;
+          continue;
+        }
+
       if (gsk_pathop_op (self->ops[i]) == GSK_PATH_MOVE)
         continue;
 
@@ -1313,6 +1353,28 @@ gsk_standard_contour_init (GskContour             *contour,
   gsk_bounding_box_init (&self->bounds,  &self->points[0], &self->points[0]);
   for (gsize i = 1; i < self->n_points; i ++)
     gsk_bounding_box_expand (&self->bounds, &self->points[i]);
+
+  self->n_chunks = gsk_standard_contour_compute_n_chunks (n_ops);
+  self->chunk_bounds = (GskBoundingBox *) &self->points[n_points];
+  for (gsize i = 0; i < self->n_chunks; i++)
+    {
+      GskBoundingBox *chunk = &self->chunk_bounds[i];
+      const graphene_point_t *start = gsk_pathop_points (self->ops[i * CHUNK_SIZE]);
+
+      gsk_bounding_box_init (chunk, start, start);
+      for (gsize j = i * CHUNK_SIZE; j < MIN ((i + 1) * CHUNK_SIZE, n_ops); j++)
+        {
+          GskBoundingBox bounds;
+          GskCurve c;
+
+          if (gsk_pathop_op (self->ops[j]) == GSK_PATH_MOVE)
+            continue;
+
+          gsk_curve_init (&c, self->ops[j]);
+          gsk_curve_get_bounds (&c, &bounds);
+          gsk_bounding_box_union (chunk, &bounds, chunk);
+        }
+    }
 }
 
 GskContour *
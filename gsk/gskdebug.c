@@ -15,6 +15,8 @@ static const GdkDebugKey gsk_debug_keys[] = {
   { "staging", GSK_DEBUG_STAGING, "Use a staging image for texture upload (Vulkan only)" },
   { "offload-disable", GSK_DEBUG_OFFLOAD_DISABLE, "Disable graphics offload" },
   { "cairo", GSK_DEBUG_CAIRO, "Overlay error pattern over Cairo drawing (finds fallbacks)" },
+  { "no-node-arena", GSK_DEBUG_NO_NODE_ARENA, "Allocate every render node separately" },
+  { "render-thread", GSK_DEBUG_RENDER_THREAD, "Render frames in a separate thread (Vulkan only)" },
 };
 
 static guint gsk_debug_flags;
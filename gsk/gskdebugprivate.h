@@ -18,9 +18,11 @@ typedef enum {
   GSK_DEBUG_STAGING               = 1 << 10,
   GSK_DEBUG_OFFLOAD_DISABLE       = 1 << 11,
   GSK_DEBUG_CAIRO                 = 1 << 12,
+  GSK_DEBUG_NO_NODE_ARENA         = 1 << 13,
+  GSK_DEBUG_RENDER_THREAD         = 1 << 14,
 } GskDebugFlags;
 
-#define GSK_DEBUG_ANY ((1 << 13) - 1)
+#define GSK_DEBUG_ANY ((1 << 15) - 1)
 
 GskDebugFlags gsk_get_debug_flags (void);
 void          gsk_set_debug_flags (GskDebugFlags flags);
@@ -55,7 +55,7 @@
 struct _GskPath
 {
   /*< private >*/
-  guint ref_count;
+  gatomicrefcount ref_count;
 
   GskPathFlags flags;
 
@@ -92,7 +92,7 @@ gsk_path_new_from_contours (const GSList *contours)
     }
 
   path = g_malloc0 (sizeof (GskPath) + size);
-  path->ref_count = 1;
+  g_atomic_ref_count_init (&path->ref_count);
   path->flags = flags;
   path->n_contours = n_contours;
   contour_data = (guint8 *) &path->contours[n_contours];
@@ -152,7 +152,7 @@ gsk_path_ref (GskPath *self)
 {
   g_return_val_if_fail (self != NULL, NULL);
 
-  self->ref_count++;
+  g_atomic_ref_count_inc (&self->ref_count);
 
   return self;
 }
@@ -171,10 +171,8 @@ void
 gsk_path_unref (GskPath *self)
 {
   g_return_if_fail (self != NULL);
-  g_return_if_fail (self->ref_count > 0);
 
-  self->ref_count--;
-  if (self->ref_count > 0)
+  if (!g_atomic_ref_count_dec (&self->ref_count))
     return;
 
   g_free (self);
@@ -241,29 +239,56 @@ gsk_path_to_string (GskPath *self)
   return g_string_free (string, FALSE);
 }
 
+static inline void
+append_cairo_point (GArray                 *data,
+                    const graphene_point_t *pt)
+{
+  cairo_path_data_t point;
+
+  point.point.x = pt->x;
+  point.point.y = pt->y;
+  g_array_append_val (data, point);
+}
+
 static gboolean
 gsk_path_to_cairo_add_op (GskPathOperation        op,
                           const graphene_point_t *pts,
                           gsize                   n_pts,
                           float                   weight,
-                          gpointer                cr)
+                          gpointer                user_data)
 {
+  GArray *data = user_data;
+  cairo_path_data_t header;
+
   switch (op)
   {
     case GSK_PATH_MOVE:
-      cairo_move_to (cr, pts[0].x, pts[0].y);
+      header.header.type = CAIRO_PATH_MOVE_TO;
+      header.header.length = 2;
+      g_array_append_val (data, header);
+      append_cairo_point (data, &pts[0]);
       break;
 
     case GSK_PATH_CLOSE:
-      cairo_close_path (cr);
+      header.header.type = CAIRO_PATH_CLOSE_PATH;
+      header.header.length = 1;
+      g_array_append_val (data, header);
       break;
 
     case GSK_PATH_LINE:
-      cairo_line_to (cr, pts[1].x, pts[1].y);
+      header.header.type = CAIRO_PATH_LINE_TO;
+      header.header.length = 2;
+      g_array_append_val (data, header);
+      append_cairo_point (data, &pts[1]);
       break;
 
     case GSK_PATH_CUBIC:
-      cairo_curve_to (cr, pts[1].x, pts[1].y, pts[2].x, pts[2].y, pts[3].x, pts[3].y);
+      header.header.type = CAIRO_PATH_CURVE_TO;
+      header.header.length = 4;
+      g_array_append_val (data, header);
+      append_cairo_point (data, &pts[1]);
+      append_cairo_point (data, &pts[2]);
+      append_cairo_point (data, &pts[3]);
       break;
 
     case GSK_PATH_QUAD:
@@ -276,6 +301,154 @@ gsk_path_to_cairo_add_op (GskPathOperation        op,
   return TRUE;
 }
 
+/* Converting a path for cairo walks all contours and splits conics,
+ * so the results for recently drawn paths are kept. Paths are shared
+ * between threads, so this is a global cache with a lock, and it is
+ * bounded by the memory of the converted data and the number of paths
+ * it keeps alive.
+ */
+#define CAIRO_PATH_CACHE_MAX_BYTES (4 * 1024 * 1024)
+#define CAIRO_PATH_CACHE_MAX_PATHS 256
+
+typedef struct _CairoPathEntry CairoPathEntry;
+
+struct _CairoPathEntry
+{
+  gatomicrefcount ref_count;
+  GskPath *path;
+  double tolerance;
+  cairo_path_t cairo_path;
+  gsize size;
+  GList link;
+};
+
+G_LOCK_DEFINE_STATIC (cairo_path_cache);
+static GHashTable *cairo_path_cache;
+static GQueue cairo_path_lru = G_QUEUE_INIT; /* most recently used first */
+static gsize cairo_path_cache_size;
+
+static guint
+cairo_path_entry_hash (gconstpointer data)
+{
+  const CairoPathEntry *entry = data;
+
+  return g_direct_hash (entry->path) ^ g_double_hash (&entry->tolerance);
+}
+
+static gboolean
+cairo_path_entry_equal (gconstpointer a,
+                        gconstpointer b)
+{
+  const CairoPathEntry *ea = a;
+  const CairoPathEntry *eb = b;
+
+  return ea->path == eb->path && ea->tolerance == eb->tolerance;
+}
+
+static void
+cairo_path_entry_unref (CairoPathEntry *entry)
+{
+  if (!g_atomic_ref_count_dec (&entry->ref_count))
+    return;
+
+  gsk_path_unref (entry->path);
+  g_free (entry->cairo_path.data);
+  g_free (entry);
+}
+
+static CairoPathEntry *
+cairo_path_entry_new (GskPath *path,
+                      double   tolerance)
+{
+  CairoPathEntry *entry;
+  GArray *data;
+
+  data = g_array_sized_new (FALSE, FALSE, sizeof (cairo_path_data_t), 16);
+  gsk_path_foreach_with_tolerance (path,
+                                   GSK_PATH_FOREACH_ALLOW_CUBIC,
+                                   tolerance,
+                                   gsk_path_to_cairo_add_op,
+                                   data);
+
+  entry = g_new0 (CairoPathEntry, 1);
+  g_atomic_ref_count_init (&entry->ref_count);
+  entry->path = gsk_path_ref (path);
+  entry->tolerance = tolerance;
+  entry->cairo_path.status = CAIRO_STATUS_SUCCESS;
+  entry->cairo_path.num_data = data->len;
+  entry->size = data->len * sizeof (cairo_path_data_t);
+  entry->cairo_path.data = (cairo_path_data_t *) g_array_free (data, FALSE);
+  entry->link.data = entry;
+
+  return entry;
+}
+
+/* must be called with the cache lock held */
+static void
+cairo_path_cache_evict (void)
+{
+  while (cairo_path_cache_size > CAIRO_PATH_CACHE_MAX_BYTES ||
+         cairo_path_lru.length > CAIRO_PATH_CACHE_MAX_PATHS)
+    {
+      CairoPathEntry *entry = g_queue_peek_tail (&cairo_path_lru);
+
+      g_queue_unlink (&cairo_path_lru, &entry->link);
+      g_hash_table_remove (cairo_path_cache, entry);
+      cairo_path_cache_size -= entry->size;
+      cairo_path_entry_unref (entry);
+    }
+}
+
+/* Returns a reference to the converted path */
+static CairoPathEntry *
+gsk_path_lookup_cairo_path (GskPath *self,
+                            double   tolerance)
+{
+  CairoPathEntry lookup = { .path = self, .tolerance = tolerance };
+  CairoPathEntry *entry;
+
+  G_LOCK (cairo_path_cache);
+
+  if (cairo_path_cache == NULL)
+    cairo_path_cache = g_hash_table_new (cairo_path_entry_hash, cairo_path_entry_equal);
+
+  entry = g_hash_table_lookup (cairo_path_cache, &lookup);
+  if (entry)
+    {
+      g_queue_unlink (&cairo_path_lru, &entry->link);
+      g_queue_push_head_link (&cairo_path_lru, &entry->link);
+      g_atomic_ref_count_inc (&entry->ref_count);
+    }
+
+  G_UNLOCK (cairo_path_cache);
+
+  if (entry)
+    return entry;
+
+  /* Convert without holding the lock, another thread may race us,
+   * in which case its result is kept.
+   */
+  entry = cairo_path_entry_new (self, tolerance);
+
+  if (entry->size > CAIRO_PATH_CACHE_MAX_BYTES / 4)
+    return entry;
+
+  G_LOCK (cairo_path_cache);
+
+  if (!g_hash_table_contains (cairo_path_cache, entry))
+    {
+      g_atomic_ref_count_inc (&entry->ref_count);
+      g_hash_table_add (cairo_path_cache, entry);
+      g_queue_push_head_link (&cairo_path_lru, &entry->link);
+      cairo_path_cache_size += entry->size;
+      cairo_path_cache_evict ();
+    }
+
+  G_UNLOCK (cairo_path_cache);
+
+  return entry;
+}
+
 /**
  * gsk_path_to_cairo:
  * @self: a `GskPath`
@@ -296,14 +469,14 @@ void
 gsk_path_to_cairo (GskPath *self,
                    cairo_t *cr)
 {
+  CairoPathEntry *entry;
+
   g_return_if_fail (self != NULL);
   g_return_if_fail (cr != NULL);
 
-  gsk_path_foreach_with_tolerance (self,
-                                   GSK_PATH_FOREACH_ALLOW_CUBIC,
-                                   cairo_get_tolerance (cr),
-                                   gsk_path_to_cairo_add_op,
-                                   cr);
+  entry = gsk_path_lookup_cairo_path (self, cairo_get_tolerance (cr));
+  cairo_append_path (cr, &entry->cairo_path);
+  cairo_path_entry_unref (entry);
 }
 
 /**
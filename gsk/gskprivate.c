@@ -3,6 +3,8 @@
 #include "gskresources.h"
 #include "gskprivate.h"
 
+#include "gdk/gdkprivate.h"
+
 #include <cairo.h>
 #include <pango/pangocairo.h>
 #ifdef HAVE_PANGOFT
@@ -10,6 +12,8 @@
 #endif
 #include <math.h>
 
+static GQuark hint_style_quark;
+
 static gpointer
 register_resources (gpointer data)
 {
@@ -118,27 +122,176 @@ gsk_reload_font (PangoFont            *font,
   return g_object_ref (last_result);
 }
 
+static gboolean
+gsk_font_load_hint_style (gpointer data)
+{
+  PangoFont *font = data;
+  cairo_font_options_t *options;
+  cairo_scaled_font_t *sf;
+  cairo_hint_style_t style;
+
+  options = cairo_font_options_create ();
+  sf = pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (font));
+  cairo_scaled_font_get_font_options (sf, options);
+  style = cairo_font_options_get_hint_style (options);
+  cairo_font_options_destroy (options);
+
+  g_object_set_qdata (G_OBJECT (font), hint_style_quark, GUINT_TO_POINTER (style + 1));
+
+  return G_SOURCE_REMOVE;
+}
+
 /*< private >
  * gsk_font_get_hint_style:
  * @font: a `PangoFont`
  *
  * Get the hint style from the cairo font options.
  *
+ * This can be called from any thread. Pango is not threadsafe,
+ * so the first lookup for a font is done on the main thread and
+ * the result is kept on the font.
+ *
  * Returns: the hint style
  */
 cairo_hint_style_t
 gsk_font_get_hint_style (PangoFont *font)
 {
-  static cairo_font_options_t *options = NULL;
-  cairo_scaled_font_t *sf;
-  cairo_hint_style_t style;
+  gpointer style;
 
-  if (G_UNLIKELY (options == NULL))
-    options = cairo_font_options_create ();
+  if (G_UNLIKELY (hint_style_quark == 0))
+    hint_style_quark = g_quark_from_static_string ("gsk-font-hint-style");
 
-  sf = pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (font));
-  cairo_scaled_font_get_font_options (sf, options);
-  style = cairo_font_options_get_hint_style (options);
+  style = g_object_get_qdata (G_OBJECT (font), hint_style_quark);
+  if (style == NULL)
+    {
+      gdk_main_thread_invoke (gsk_font_load_hint_style, font);
+      style = g_object_get_qdata (G_OBJECT (font), hint_style_quark);
+    }
+
+  return GPOINTER_TO_UINT (style) - 1;
+}
+
+typedef struct _ParallelRun ParallelRun;
+
+struct _ParallelRun
+{
+  GskParallelFunc func;
+  gpointer data;
+  guint n_jobs;
+
+  int ref_count; /* atomic */
+  int next_job; /* atomic */
+
+  GMutex lock;
+  GCond cond;
+  guint n_done;
+};
+
+static void
+parallel_run_unref (ParallelRun *run)
+{
+  if (!g_atomic_int_dec_and_test (&run->ref_count))
+    return;
+
+  g_mutex_clear (&run->lock);
+  g_cond_clear (&run->cond);
+  g_free (run);
+}
+
+/* Runs jobs until none are left, so whoever gets there first
+ * does the work and nobody ever waits for a busy thread.
+ */
+static void
+parallel_run_jobs (ParallelRun *run)
+{
+  guint i, n_done = 0;
+
+  while ((i = g_atomic_int_add (&run->next_job, 1)) < run->n_jobs)
+    {
+      run->func (run->data, i);
+      n_done++;
+    }
+
+  if (n_done == 0)
+    return;
+
+  g_mutex_lock (&run->lock);
+  run->n_done += n_done;
+  if (run->n_done == run->n_jobs)
+    g_cond_signal (&run->cond);
+  g_mutex_unlock (&run->lock);
+}
+
+static void
+parallel_run_thread (gpointer data,
+                     gpointer user_data)
+{
+  ParallelRun *run = data;
+
+  parallel_run_jobs (run);
+  parallel_run_unref (run);
+}
+
+static gpointer
+create_parallel_pool (gpointer data)
+{
+  return g_thread_pool_new (parallel_run_thread,
+                            NULL,
+                            g_get_num_processors (),
+                            FALSE,
+                            NULL);
+}
+
+/*< private >
+ * gsk_parallel_run:
+ * @func: the function to run
+ * @data: data to pass to @func
+ * @n_jobs: how often to run @func
+ *
+ * Calls @func once for every index from 0 to @n_jobs - 1, in parallel
+ * on the calling thread and a thread pool that is shared by everything
+ * in GSK, and waits for all of them to finish.
+ *
+ * This can be called from any thread, including from @func. The calling
+ * thread takes part in running the jobs, so it never waits for the pool
+ * to have a free thread.
+ */
+void
+gsk_parallel_run (GskParallelFunc func,
+                  gpointer        data,
+                  guint           n_jobs)
+{
+  static GOnce pool_once = G_ONCE_INIT;
+  GThreadPool *pool;
+  ParallelRun *run;
+  guint i;
+
+  if (n_jobs <= 1)
+    {
+      if (n_jobs == 1)
+        func (data, 0);
+      return;
+    }
+
+  pool = g_once (&pool_once, create_parallel_pool, NULL);
+
+  run = g_new0 (ParallelRun, 1);
+  run->func = func;
+  run->data = data;
+  run->n_jobs = n_jobs;
+  run->ref_count = n_jobs;
+  g_mutex_init (&run->lock);
+  g_cond_init (&run->cond);
+
+  for (i = 1; i < n_jobs; i++)
+    g_thread_pool_push (pool, run, NULL);
+
+  parallel_run_jobs (run);
+
+  g_mutex_lock (&run->lock);
+  while (run->n_done < run->n_jobs)
+    g_cond_wait (&run->cond, &run->lock);
+  g_mutex_unlock (&run->lock);
 
-  return style;
+  parallel_run_unref (run);
 }
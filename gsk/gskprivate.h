@@ -16,5 +16,12 @@ PangoFont *gsk_reload_font (PangoFont            *font,
 
 cairo_hint_style_t gsk_font_get_hint_style (PangoFont *font);
 
+typedef void (* GskParallelFunc) (gpointer data,
+                                  guint    index);
+
+void       gsk_parallel_run      (GskParallelFunc  func,
+                                  gpointer         data,
+                                  guint            n_jobs);
+
 G_END_DECLS
 
@@ -0,0 +1,526 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gskrecordingprivate.h"
+
+#include "gskrendernodeparserprivate.h"
+
+#include "gdk/gdkprivate.h"
+
+#include <string.h>
+
+/* A recording is a sequence of frames, as recorded by the inspector.
+ *
+ * The file starts with RECORDING_MAGIC, the format version and a byte
+ * order mark. Every frame follows as a FrameHeader, the rectangles of
+ * the clip region and the node, written by a GskRenderNodeEncoder. The
+ * encoder keeps everything it wrote, so nodes that a frame shares with
+ * earlier frames only take a few bytes. Every KEYFRAME_INTERVAL frames,
+ * it starts over. That bounds the memory it needs, and lets readers
+ * seek to any frame by decoding from the keyframe before it.
+ *
+ * Frames are aligned to RECORDING_ALIGNMENT, so texture data can be
+ * used in place. There is no index at the end, so a recording that is
+ * still being written or was cut off can be read up to its last
+ * complete frame.
+ */
+
+#define RECORDING_MAGIC "\211GSKREC\n"
+#define RECORDING_MAGIC_SIZE 8
+#define RECORDING_VERSION 1
+#define RECORDING_BYTE_ORDER_MARK 0x01020304
+#define RECORDING_ALIGNMENT 16
+
+#define KEYFRAME_INTERVAL 60
+
+#define FRAME_KEYFRAME (1 << 0)
+
+typedef struct
+{
+  guint32 flags;
+  guint32 n_rects;
+  guint32 size;
+  guint32 reserved1;
+  gint64 timestamp;
+  cairo_rectangle_int_t area;
+  guint32 reserved2[2];
+} FrameHeader;
+
+G_STATIC_ASSERT (sizeof (FrameHeader) % RECORDING_ALIGNMENT == 0);
+G_STATIC_ASSERT (sizeof (cairo_rectangle_int_t) % RECORDING_ALIGNMENT == 0);
+
+static inline gsize
+align (gsize size)
+{
+  return (size + RECORDING_ALIGNMENT - 1) & ~((gsize) RECORDING_ALIGNMENT - 1);
+}
+
+struct _GskRecordingWriter
+{
+  GOutputStream *stream;
+  GskRenderNodeEncoder *encoder;
+  guint n_frames;
+  gboolean failed;
+};
+
+/*
+ * gsk_recording_writer_new:
+ * @stream: the stream to write to
+ * @error: return location for an error
+ *
+ * Creates a writer for a recording and writes the file header.
+ *
+ * Frames can be added from any thread. The writer must be freed on
+ * the main thread, since it holds references to the nodes of the
+ * frames since the last keyframe.
+ *
+ * Returns: (nullable): a new writer
+ */
+GskRecordingWriter *
+gsk_recording_writer_new (GOutputStream  *stream,
+                          GError        **error)
+{
+  GskRecordingWriter *self;
+  guint32 header[2] = { RECORDING_VERSION, RECORDING_BYTE_ORDER_MARK };
+  GOutputVector vectors[2] = {
+    { RECORDING_MAGIC, RECORDING_MAGIC_SIZE },
+    { header, sizeof (header) },
+  };
+
+  if (!g_output_stream_writev_all (stream, vectors, G_N_ELEMENTS (vectors), NULL, NULL, error))
+    return NULL;
+
+  self = g_new0 (GskRecordingWriter, 1);
+  self->stream = g_object_ref (stream);
+  self->encoder = gsk_render_node_encoder_new ();
+
+  return self;
+}
+
+void
+gsk_recording_writer_free (GskRecordingWriter *self)
+{
+  gsk_render_node_encoder_free (self->encoder);
+  g_object_unref (self->stream);
+  g_free (self);
+}
+
+static gboolean
+reset_encoder (gpointer data)
+{
+  gsk_render_node_encoder_reset (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * gsk_recording_writer_add_frame:
+ * @self: a writer
+ * @timestamp: the time of the frame, in microseconds
+ * @area: (nullable): the area of the surface the frame was drawn to
+ * @clip: (nullable): the region of the surface that was redrawn
+ * @node: the frame
+ * @error: return location for an error
+ *
+ * Appends a frame to the recording. Once this fails, the recording is
+ * incomplete and all further frames fail, too.
+ *
+ * Returns: %TRUE if the frame was written
+ */
+gboolean
+gsk_recording_writer_add_frame (GskRecordingWriter           *self,
+                                gint64                        timestamp,
+                                const cairo_rectangle_int_t  *area,
+                                const cairo_region_t         *clip,
+                                GskRenderNode                *node,
+                                GError                      **error)
+{
+  static const guchar padding[RECORDING_ALIGNMENT] = { 0, };
+  FrameHeader header = { 0, };
+  cairo_rectangle_int_t *rects;
+  GOutputVector vectors[4];
+  GBytes *bytes;
+  gboolean result;
+
+  if (self->failed)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                           "Writing an earlier frame failed");
+      return FALSE;
+    }
+
+  if (self->n_frames % KEYFRAME_INTERVAL == 0)
+    {
+      /* The encoder holds references to nodes, so it must let go of
+       * them on the main thread */
+      if (self->n_frames > 0)
+        gdk_main_thread_invoke (reset_encoder, self->encoder);
+      header.flags |= FRAME_KEYFRAME;
+    }
+
+  bytes = gsk_render_node_encoder_encode (self->encoder, node);
+
+  header.n_rects = clip ? cairo_region_num_rectangles (clip) : 0;
+  header.size = g_bytes_get_size (bytes);
+  header.timestamp = timestamp;
+  if (area)
+    header.area = *area;
+
+  rects = g_new (cairo_rectangle_int_t, header.n_rects);
+  for (guint i = 0; i < header.n_rects; i++)
+    cairo_region_get_rectangle (clip, i, &rects[i]);
+
+  vectors[0] = (GOutputVector) { &header, sizeof (header) };
+  vectors[1] = (GOutputVector) { rects, header.n_rects * sizeof (cairo_rectangle_int_t) };
+  vectors[2] = (GOutputVector) { g_bytes_get_data (bytes, NULL), header.size };
+  vectors[3] = (GOutputVector) { padding, align (header.size) - header.size };
+
+  result = g_output_stream_writev_all (self->stream, vectors, G_N_ELEMENTS (vectors), NULL, NULL, error);
+
+  g_free (rects);
+  g_bytes_unref (bytes);
+
+  if (result)
+    self->n_frames++;
+  else
+    self->failed = TRUE;
+
+  return result;
+}
+
+typedef struct
+{
+  goffset offset;
+  FrameHeader header;
+} FrameInfo;
+
+struct _GskRecordingReader
+{
+  GInputStream *stream;
+  GArray *frames;
+  /* where the frame after the last complete one starts */
+  goffset scan_offset;
+
+  GskRenderNodeDecoder *decoder;
+  /* the frame the decoder can decode next without seeking */
+  guint next_frame;
+};
+
+/*
+ * gsk_recording_reader_new:
+ * @stream: a seekable stream to read from
+ * @error: return location for an error
+ *
+ * Creates a reader for a recording, which may still be written to.
+ * If @stream does not contain a recording, G_IO_ERROR_NOT_SUPPORTED
+ * is returned.
+ *
+ * The reader must only be used on the main thread.
+ *
+ * Returns: (nullable): a new reader
+ */
+GskRecordingReader *
+gsk_recording_reader_new (GInputStream  *stream,
+                          GError       **error)
+{
+  GskRecordingReader *self;
+  char magic[RECORDING_MAGIC_SIZE];
+  guint32 header[2];
+  gsize read;
+
+  g_return_val_if_fail (G_IS_SEEKABLE (stream), NULL);
+
+  if (!g_input_stream_read_all (stream, magic, sizeof (magic), &read, NULL, error))
+    return NULL;
+
+  if (read < sizeof (magic) || memcmp (magic, RECORDING_MAGIC, RECORDING_MAGIC_SIZE) != 0)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "Not a recording");
+      return NULL;
+    }
+
+  if (!g_input_stream_read_all (stream, header, sizeof (header), &read, NULL, error))
+    return NULL;
+
+  if (read < sizeof (header))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "Unexpected end of data");
+      return NULL;
+    }
+
+  if (header[1] != RECORDING_BYTE_ORDER_MARK)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "The recording was written on a machine with a different byte order");
+      return NULL;
+    }
+
+  if (header[0] != RECORDING_VERSION)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Unsupported version %u of the recording format", header[0]);
+      return NULL;
+    }
+
+  self = g_new0 (GskRecordingReader, 1);
+  self->stream = g_object_ref (stream);
+  self->frames = g_array_new (FALSE, FALSE, sizeof (FrameInfo));
+  self->scan_offset = RECORDING_MAGIC_SIZE + sizeof (header);
+  self->decoder = gsk_render_node_decoder_new ();
+  self->next_frame = G_MAXUINT;
+
+  return self;
+}
+
+void
+gsk_recording_reader_free (GskRecordingReader *self)
+{
+  gsk_render_node_decoder_free (self->decoder);
+  g_array_unref (self->frames);
+  g_object_unref (self->stream);
+  g_free (self);
+}
+
+/* Finds the frames that were written completely since the last scan,
+ * until there are @n_frames. A frame that isn't complete yet is picked
+ * up by a later scan.
+ */
+static void
+gsk_recording_reader_scan (GskRecordingReader *self,
+                           guint               n_frames)
+{
+  goffset end;
+
+  if (self->frames->len >= n_frames)
+    return;
+
+  if (!g_seekable_seek (G_SEEKABLE (self->stream), 0, G_SEEK_END, NULL, NULL))
+    return;
+
+  end = g_seekable_tell (G_SEEKABLE (self->stream));
+
+  while (self->frames->len < n_frames &&
+         self->scan_offset + (goffset) sizeof (FrameHeader) <= end)
+    {
+      FrameInfo info;
+      guint64 frame_size;
+      gsize read;
+
+      info.offset = self->scan_offset;
+
+      if (!g_seekable_seek (G_SEEKABLE (self->stream), info.offset, G_SEEK_SET, NULL, NULL) ||
+          !g_input_stream_read_all (self->stream, &info.header, sizeof (FrameHeader), &read, NULL, NULL) ||
+          read < sizeof (FrameHeader))
+        break;
+
+      frame_size = sizeof (FrameHeader) +
+                   (guint64) info.header.n_rects * sizeof (cairo_rectangle_int_t) +
+                   align (info.header.size);
+      if (frame_size > (guint64) (end - info.offset))
+        break;
+
+      /* Nothing can be decoded without a keyframe to start from */
+      if (self->frames->len == 0 && (info.header.flags & FRAME_KEYFRAME) == 0)
+        break;
+
+      g_array_append_val (self->frames, info);
+      self->scan_offset += frame_size;
+    }
+}
+
+/*
+ * gsk_recording_reader_get_n_frames:
+ * @self: a reader
+ *
+ * Returns the number of frames that were written completely. If the
+ * recording is still being written to, later calls may return more.
+ *
+ * Returns: the number of frames
+ */
+guint
+gsk_recording_reader_get_n_frames (GskRecordingReader *self)
+{
+  gsk_recording_reader_scan (self, G_MAXUINT);
+
+  return self->frames->len;
+}
+
+static const FrameHeader *
+gsk_recording_reader_get_header (GskRecordingReader *self,
+                                 guint               frame)
+{
+  gsk_recording_reader_scan (self, frame + 1);
+
+  g_return_val_if_fail (frame < self->frames->len, NULL);
+
+  return &g_array_index (self->frames, FrameInfo, frame).header;
+}
+
+gint64
+gsk_recording_reader_get_timestamp (GskRecordingReader *self,
+                                    guint               frame)
+{
+  const FrameHeader *header = gsk_recording_reader_get_header (self, frame);
+
+  return header ? header->timestamp : 0;
+}
+
+void
+gsk_recording_reader_get_area (GskRecordingReader    *self,
+                               guint                  frame,
+                               cairo_rectangle_int_t *area)
+{
+  const FrameHeader *header = gsk_recording_reader_get_header (self, frame);
+
+  if (header)
+    *area = header->area;
+  else
+    *area = (cairo_rectangle_int_t) { 0, 0, 0, 0 };
+}
+
+/* Returns the size of the encoded node, which is small for frames
+ * that share most nodes with the ones before them.
+ */
+gsize
+gsk_recording_reader_get_size (GskRecordingReader *self,
+                               guint               frame)
+{
+  const FrameHeader *header = gsk_recording_reader_get_header (self, frame);
+
+  return header ? header->size : 0;
+}
+
+gboolean
+gsk_recording_reader_is_keyframe (GskRecordingReader *self,
+                                  guint               frame)
+{
+  const FrameHeader *header = gsk_recording_reader_get_header (self, frame);
+
+  return header ? (header->flags & FRAME_KEYFRAME) != 0 : FALSE;
+}
+
+static GskRenderNode *
+gsk_recording_reader_decode_frame (GskRecordingReader  *self,
+                                   guint                frame,
+                                   cairo_region_t     **clip,
+                                   GError             **error)
+{
+  const FrameInfo *info = &g_array_index (self->frames, FrameInfo, frame);
+  cairo_rectangle_int_t *rects;
+  GskRenderNode *node;
+  GBytes *bytes;
+  guchar *data;
+  gsize read, rects_size;
+
+  if (info->header.flags & FRAME_KEYFRAME)
+    gsk_render_node_decoder_reset (self->decoder);
+
+  if (!g_seekable_seek (G_SEEKABLE (self->stream), info->offset + sizeof (FrameHeader), G_SEEK_SET, NULL, error))
+    return NULL;
+
+  rects_size = info->header.n_rects * sizeof (cairo_rectangle_int_t);
+  rects = g_malloc (rects_size);
+  if (!g_input_stream_read_all (self->stream, rects, rects_size, &read, NULL, error))
+    {
+      g_free (rects);
+      return NULL;
+    }
+
+  if (clip)
+    *clip = cairo_region_create_rectangles (rects, info->header.n_rects);
+  g_free (rects);
+
+  data = g_malloc (info->header.size);
+  if (!g_input_stream_read_all (self->stream, data, info->header.size, &read, NULL, error))
+    {
+      g_free (data);
+      if (clip)
+        g_clear_pointer (clip, cairo_region_destroy);
+      return NULL;
+    }
+
+  bytes = g_bytes_new_take (data, info->header.size);
+  node = gsk_render_node_decoder_decode (self->decoder, bytes, error);
+  g_bytes_unref (bytes);
+
+  if (node == NULL && clip)
+    g_clear_pointer (clip, cairo_region_destroy);
+
+  return node;
+}
+
+/*
+ * gsk_recording_reader_get_frame:
+ * @self: a reader
+ * @frame: the frame to get
+ * @clip: (out) (optional): return location for the region that was redrawn
+ * @error: return location for an error
+ *
+ * Decodes the node of @frame. This needs to decode all frames from the
+ * keyframe before @frame, unless the previous call got an earlier frame
+ * after that keyframe, so stepping through frames in order is cheap.
+ *
+ * Returns: (nullable): the node
+ */
+GskRenderNode *
+gsk_recording_reader_get_frame (GskRecordingReader  *self,
+                                guint                frame,
+                                cairo_region_t     **clip,
+                                GError             **error)
+{
+  GskRenderNode *node = NULL;
+  guint keyframe, start;
+
+  gsk_recording_reader_scan (self, frame + 1);
+
+  if (frame >= self->frames->len)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "There is no frame %u", frame);
+      return NULL;
+    }
+
+  keyframe = frame;
+  while (!(g_array_index (self->frames, FrameInfo, keyframe).header.flags & FRAME_KEYFRAME))
+    keyframe--;
+
+  if (self->next_frame <= frame && self->next_frame > keyframe)
+    start = self->next_frame;
+  else
+    start = keyframe;
+
+  for (guint i = start; i <= frame; i++)
+    {
+      g_clear_pointer (&node, gsk_render_node_unref);
+
+      node = gsk_recording_reader_decode_frame (self, i, i == frame ? clip : NULL, error);
+      if (node == NULL)
+        {
+          gsk_render_node_decoder_reset (self->decoder);
+          self->next_frame = G_MAXUINT;
+          return NULL;
+        }
+
+      self->next_frame = i + 1;
+    }
+
+  return node;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <gio/gio.h>
+#include <cairo.h>
+
+#include "gskrendernode.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GskRecordingWriter GskRecordingWriter;
+
+GskRecordingWriter *    gsk_recording_writer_new                (GOutputStream                  *stream,
+                                                                 GError                        **error);
+void                    gsk_recording_writer_free               (GskRecordingWriter             *self);
+gboolean                gsk_recording_writer_add_frame          (GskRecordingWriter             *self,
+                                                                 gint64                          timestamp,
+                                                                 const cairo_rectangle_int_t    *area,
+                                                                 const cairo_region_t           *clip,
+                                                                 GskRenderNode                  *node,
+                                                                 GError                        **error);
+
+typedef struct _GskRecordingReader GskRecordingReader;
+
+GskRecordingReader *    gsk_recording_reader_new                (GInputStream                   *stream,
+                                                                 GError                        **error);
+void                    gsk_recording_reader_free               (GskRecordingReader             *self);
+guint                   gsk_recording_reader_get_n_frames       (GskRecordingReader             *self);
+gint64                  gsk_recording_reader_get_timestamp      (GskRecordingReader             *self,
+                                                                 guint                           frame);
+void                    gsk_recording_reader_get_area           (GskRecordingReader             *self,
+                                                                 guint                           frame,
+                                                                 cairo_rectangle_int_t          *area);
+gsize                   gsk_recording_reader_get_size           (GskRecordingReader             *self,
+                                                                 guint                           frame);
+gboolean                gsk_recording_reader_is_keyframe        (GskRecordingReader             *self,
+                                                                 guint                           frame);
+GskRenderNode *         gsk_recording_reader_get_frame          (GskRecordingReader             *self,
+                                                                 guint                           frame,
+                                                                 cairo_region_t                **clip,
+                                                                 GError                        **error);
+
+G_END_DECLS
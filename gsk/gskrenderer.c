@@ -80,6 +80,7 @@ typedef struct
   GskRenderNode *prev_node;
 
   GskProfiler *profiler;
+  GQuark upload_bytes;
 
   GskDebugFlags debug_flags;
 
@@ -216,6 +217,7 @@ gsk_renderer_init (GskRenderer *self)
   GskRendererPrivate *priv = gsk_renderer_get_instance_private (self);
 
   priv->profiler = gsk_profiler_new ();
+  priv->upload_bytes = gsk_profiler_add_counter (priv->profiler, "upload-bytes", "Bytes uploaded", FALSE);
   priv->debug_flags = gsk_get_debug_flags ();
 }
 
@@ -518,6 +520,42 @@ gsk_renderer_get_profiler (GskRenderer *renderer)
   return priv->profiler;
 }
 
+/*< private >
+ * gsk_renderer_add_upload_bytes:
+ * @renderer: a `GskRenderer`
+ * @n_bytes: the number of bytes
+ *
+ * Records that @n_bytes of texture data were uploaded to the GPU.
+ */
+void
+gsk_renderer_add_upload_bytes (GskRenderer *renderer,
+                               gsize        n_bytes)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+
+  gsk_profiler_counter_add (priv->profiler, priv->upload_bytes, n_bytes);
+}
+
+/*< private >
+ * gsk_renderer_get_upload_bytes:
+ * @renderer: a `GskRenderer`
+ *
+ * Returns the number of bytes of texture data the renderer uploaded
+ * to the GPU since it was created. This includes textures, glyphs and
+ * the results of cairo drawing, but not vertex data.
+ *
+ * Returns: the number of bytes uploaded
+ */
+gsize
+gsk_renderer_get_upload_bytes (GskRenderer *renderer)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+
+  g_return_val_if_fail (GSK_IS_RENDERER (renderer), 0);
+
+  return gsk_profiler_counter_get (priv->profiler, priv->upload_bytes);
+}
+
 static GType
 get_renderer_for_name (const char *renderer_name)
 {
@@ -55,6 +55,9 @@ struct _GskRendererClass
 };
 
 GskProfiler *           gsk_renderer_get_profiler               (GskRenderer    *renderer);
+void                    gsk_renderer_add_upload_bytes           (GskRenderer    *renderer,
+                                                                 gsize           n_bytes);
+gsize                   gsk_renderer_get_upload_bytes           (GskRenderer    *renderer);
 
 GskDebugFlags           gsk_renderer_get_debug_flags            (GskRenderer    *renderer);
 void                    gsk_renderer_set_debug_flags            (GskRenderer    *renderer,
@@ -42,6 +42,8 @@
 #include "gskrendererprivate.h"
 #include "gskrendernodeparserprivate.h"
 
+#include "gdk/gdkprofilerprivate.h"
+
 #include <graphene-gobject.h>
 
 #include <math.h>
@@ -139,10 +141,57 @@ value_render_node_lcopy_value (const GValue *value,
   return NULL;
 }
 
+/* Small enough that a few long-lived nodes don't keep much memory alive */
+#define NODE_CHUNK_SIZE (8 * 1024)
+#define NODE_ALIGN 16
+
+struct _GskRenderNodeChunk
+{
+  /* one reference per node, plus one while the chunk is being filled */
+  gatomicrefcount ref_count;
+  gsize used;
+};
+
+#define NODE_CHUNK_HEADER_SIZE ((sizeof (GskRenderNodeChunk) + NODE_ALIGN - 1) & ~(NODE_ALIGN - 1))
+
+typedef struct _GskRenderNodeArena GskRenderNodeArena;
+
+struct _GskRenderNodeArena
+{
+  guint depth;
+  GskRenderNodeChunk *chunk;
+
+  /* for the profiler, reset at the end of every arena */
+  guint n_arena_nodes;
+  guint n_heap_nodes;
+  guint n_chunks;
+};
+
+static void
+gsk_render_node_chunk_unref (GskRenderNodeChunk *chunk)
+{
+  if (g_atomic_ref_count_dec (&chunk->ref_count))
+    g_free (chunk);
+}
+
+static void
+gsk_render_node_arena_free (gpointer data)
+{
+  GskRenderNodeArena *arena = data;
+
+  g_clear_pointer (&arena->chunk, gsk_render_node_chunk_unref);
+  g_free (arena);
+}
+
+static GPrivate node_arena = G_PRIVATE_INIT (gsk_render_node_arena_free);
+
 static void
 gsk_render_node_finalize (GskRenderNode *self)
 {
-  g_type_free_instance ((GTypeInstance *) self);
+  if (self->chunk)
+    gsk_render_node_chunk_unref (self->chunk);
+  else
+    g_type_free_instance ((GTypeInstance *) self);
 }
 
 static void
@@ -278,11 +327,133 @@ gsk_render_node_type_register_static (const char     *node_name,
 gpointer
 gsk_render_node_alloc (GskRenderNodeType node_type)
 {
+  static gsize node_sizes[GSK_RENDER_NODE_TYPE_N_TYPES];
+  GskRenderNodeArena *arena;
+  GskRenderNode *node;
+  GTypeClass *klass;
+  gsize size;
+
   g_return_val_if_fail (node_type > GSK_NOT_A_RENDER_NODE, NULL);
   g_return_val_if_fail (node_type < GSK_RENDER_NODE_TYPE_N_TYPES, NULL);
 
   g_assert (gsk_render_node_types[node_type] != G_TYPE_INVALID);
-  return g_type_create_instance (gsk_render_node_types[node_type]);
+
+  arena = g_private_get (&node_arena);
+  if (arena == NULL || arena->depth == 0 || GSK_DEBUG_CHECK (NO_NODE_ARENA))
+    return g_type_create_instance (gsk_render_node_types[node_type]);
+
+  /* The first node of every type creates the class for us */
+  klass = g_type_class_peek_static (gsk_render_node_types[node_type]);
+  if (klass == NULL)
+    {
+      arena->n_heap_nodes++;
+      return g_type_create_instance (gsk_render_node_types[node_type]);
+    }
+
+  size = g_atomic_pointer_get (&node_sizes[node_type]);
+  if (size == 0)
+    {
+      GTypeQuery query;
+
+      g_type_query (gsk_render_node_types[node_type], &query);
+      size = (query.instance_size + NODE_ALIGN - 1) & ~(NODE_ALIGN - 1);
+      g_atomic_pointer_set (&node_sizes[node_type], size);
+    }
+
+  if (arena->chunk == NULL || arena->chunk->used + size > NODE_CHUNK_SIZE)
+    {
+      g_clear_pointer (&arena->chunk, gsk_render_node_chunk_unref);
+
+      arena->chunk = g_malloc (NODE_CHUNK_SIZE);
+      g_atomic_ref_count_init (&arena->chunk->ref_count);
+      arena->chunk->used = NODE_CHUNK_HEADER_SIZE;
+      arena->n_chunks++;
+    }
+
+  node = (GskRenderNode *) ((guchar *) arena->chunk + arena->chunk->used);
+  arena->chunk->used += size;
+  arena->n_arena_nodes++;
+
+  /* Do what g_type_create_instance() would do */
+  memset (node, 0, size);
+  ((GTypeInstance *) node)->g_class = klass;
+  g_atomic_ref_count_init (&node->ref_count);
+
+  node->chunk = arena->chunk;
+  g_atomic_ref_count_inc (&arena->chunk->ref_count);
+
+  return node;
+}
+
+/*< private >
+ * gsk_render_node_arena_begin:
+ *
+ * Makes render nodes created on the current thread be allocated
+ * from an arena until the matching gsk_render_node_arena_end().
+ *
+ * Nodes in the arena are allocated from larger chunks of memory,
+ * and a chunk is freed in one go once all its nodes are gone. Nodes
+ * that stay around longer, like ones cached by widgets, keep their
+ * chunk alive.
+ *
+ * This is meant to wrap the creation of the nodes for one frame.
+ * Calls can be nested.
+ */
+void
+gsk_render_node_arena_begin (void)
+{
+  GskRenderNodeArena *arena;
+
+  arena = g_private_get (&node_arena);
+  if (arena == NULL)
+    {
+      arena = g_new0 (GskRenderNodeArena, 1);
+      g_private_set (&node_arena, arena);
+    }
+
+  arena->depth++;
+}
+
+/*< private >
+ * gsk_render_node_arena_end:
+ *
+ * Ends allocating render nodes from the arena that was started
+ * with gsk_render_node_arena_begin().
+ */
+void
+gsk_render_node_arena_end (void)
+{
+  GskRenderNodeArena *arena;
+
+  arena = g_private_get (&node_arena);
+  g_return_if_fail (arena != NULL && arena->depth > 0);
+
+  arena->depth--;
+  if (arena->depth > 0)
+    return;
+
+  /* Don't keep the chunk alive until the next frame */
+  g_clear_pointer (&arena->chunk, gsk_render_node_chunk_unref);
+
+  if (GDK_PROFILER_IS_RUNNING)
+    {
+      static guint arena_nodes_counter, heap_nodes_counter, chunks_counter;
+
+      if (G_UNLIKELY (arena_nodes_counter == 0))
+        {
+          arena_nodes_counter = gdk_profiler_define_int_counter ("arena-nodes", "Render nodes allocated in the arena");
+          heap_nodes_counter = gdk_profiler_define_int_counter ("heap-nodes", "Render nodes allocated outside the arena");
+          chunks_counter = gdk_profiler_define_int_counter ("arena-chunks", "Memory chunks allocated for the arena");
+        }
+
+      gdk_profiler_set_int_counter (arena_nodes_counter, arena->n_arena_nodes);
+      gdk_profiler_set_int_counter (heap_nodes_counter, arena->n_heap_nodes);
+      gdk_profiler_set_int_counter (chunks_counter, arena->n_chunks);
+    }
+
+  arena->n_arena_nodes = 0;
+  arena->n_heap_nodes = 0;
+  arena->n_chunks = 0;
 }
 
 /**
@@ -522,6 +693,109 @@ gsk_render_node_diff_impossible (GskRenderNode  *node1,
   cairo_region_union_rectangle (data->region, &rect);
 }
 
+enum {
+  GSK_RENDER_NODE_HASH_UNKNOWN,
+  GSK_RENDER_NODE_HASH_COMPUTING,
+  GSK_RENDER_NODE_HASH_VALID,
+  GSK_RENDER_NODE_HASH_NONE
+};
+
+/*
+ * gsk_render_node_get_hash:
+ * @node: a `GskRenderNode`
+ * @hash: (out): the hash
+ *
+ * Computes a hash of everything that influences how @node renders,
+ * including all its children. The hash is computed on first use and
+ * cached in the node.
+ *
+ * Nodes with the same hash render identically, so the hash can be
+ * used to skip diffing identical subtrees that aren't the same node.
+ *
+ * Not every node type supports hashing. Nodes that don't, and nodes
+ * with such a child, return %FALSE.
+ *
+ * This function is threadsafe. When another thread is busy computing
+ * the hash, %FALSE is returned instead of waiting.
+ *
+ * Returns: %TRUE if @hash was set
+ */
+gboolean
+gsk_render_node_get_hash (GskRenderNode *node,
+                          guint64       *hash)
+{
+  GskRenderNodeClass *klass;
+  GskRenderNodeType node_type;
+  guint64 result;
+  gboolean valid;
+
+  switch (g_atomic_int_get (&node->hash_state))
+    {
+    case GSK_RENDER_NODE_HASH_VALID:
+      *hash = node->hash;
+      return TRUE;
+
+    case GSK_RENDER_NODE_HASH_COMPUTING:
+    case GSK_RENDER_NODE_HASH_NONE:
+      return FALSE;
+
+    case GSK_RENDER_NODE_HASH_UNKNOWN:
+    default:
+      break;
+    }
+
+  if (!g_atomic_int_compare_and_exchange (&node->hash_state,
+                                          GSK_RENDER_NODE_HASH_UNKNOWN,
+                                          GSK_RENDER_NODE_HASH_COMPUTING))
+    return gsk_render_node_get_hash (node, hash);
+
+  klass = GSK_RENDER_NODE_GET_CLASS (node);
+  node_type = klass->node_type;
+
+  result = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+  result = gsk_render_node_hash_bytes (result, &node_type, sizeof (GskRenderNodeType));
+  result = gsk_render_node_hash_bytes (result, &node->bounds, sizeof (graphene_rect_t));
+  valid = klass->hash != NULL && klass->hash (node, &result);
+
+  if (valid)
+    {
+      node->hash = result;
+      g_atomic_int_set (&node->hash_state, GSK_RENDER_NODE_HASH_VALID);
+      *hash = result;
+    }
+  else
+    {
+      g_atomic_int_set (&node->hash_state, GSK_RENDER_NODE_HASH_NONE);
+    }
+
+  return valid;
+}
+
+/*
+ * gsk_render_node_hash_equal:
+ * @node1: a `GskRenderNode`
+ * @node2: the `GskRenderNode` to compare with
+ *
+ * Checks if the two nodes are known to render identically by comparing
+ * their hashes.
+ *
+ * Returns: %TRUE if the nodes render the same. %FALSE if they
+ *   don't or if it's not known.
+ */
+gboolean
+gsk_render_node_hash_equal (GskRenderNode *node1,
+                            GskRenderNode *node2)
+{
+  guint64 hash1, hash2;
+
+  if (node1 == node2)
+    return TRUE;
+
+  return gsk_render_node_get_hash (node1, &hash1) &&
+         gsk_render_node_get_hash (node2, &hash2) &&
+         hash1 == hash2;
+}
+
 /**
  * gsk_render_node_diff:
  * @node1: a `GskRenderNode`
@@ -550,6 +824,9 @@ gsk_render_node_diff (GskRenderNode  *node1,
 
   if (_gsk_render_node_get_node_type (node1) == _gsk_render_node_get_node_type (node2))
     {
+      if (gsk_render_node_hash_equal (node1, node2))
+        return;
+
       GSK_RENDER_NODE_GET_CLASS (node1)->diff (node1, node2, data);
     }
   else if (_gsk_render_node_get_node_type (node1) == GSK_CONTAINER_NODE)
@@ -610,9 +887,11 @@ gsk_render_node_write_to_file (GskRenderNode *node,
  * @error_func: (nullable) (scope call): Callback on parsing errors
  * @user_data: (closure error_func): user_data for @error_func
  *
- * Loads data previously created via [method@Gsk.RenderNode.serialize].
+ * Loads data previously created via [method@Gsk.RenderNode.serialize]
+ * or [method@Gsk.RenderNode.serialize_binary].
  *
- * For a discussion of the supported format, see that function.
+ * The format of the data is detected automatically. For a discussion
+ * of the supported formats, see those functions.
  *
  * Returns: (nullable) (transfer full): a new `GskRenderNode`
  */
@@ -623,7 +902,10 @@ gsk_render_node_deserialize (GBytes            *bytes,
 {
   GskRenderNode *node = NULL;
 
-  node = gsk_render_node_deserialize_from_bytes (bytes, error_func, user_data);
+  if (gsk_render_node_data_is_binary (bytes))
+    node = gsk_render_node_deserialize_from_binary (bytes, error_func, user_data);
+  else
+    node = gsk_render_node_deserialize_from_bytes (bytes, error_func, user_data);
 
   return node;
 }
@@ -180,6 +180,17 @@ gsk_color_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_color_node_hash (GskRenderNode *node,
+                     guint64       *hash)
+{
+  GskColorNode *self = (GskColorNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->color, sizeof (self->color));
+
+  return TRUE;
+}
+
 static void
 gsk_color_node_class_init (gpointer g_class,
                            gpointer class_data)
@@ -190,6 +201,7 @@ gsk_color_node_class_init (gpointer g_class,
 
   node_class->draw = gsk_color_node_draw;
   node_class->diff = gsk_color_node_diff;
+  node_class->hash = gsk_color_node_hash;
 }
 
 /**
@@ -355,6 +367,19 @@ gsk_linear_gradient_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_linear_gradient_node_hash (GskRenderNode *node,
+                               guint64       *hash)
+{
+  GskLinearGradientNode *self = (GskLinearGradientNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->start, sizeof (self->start));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->end, sizeof (self->end));
+  *hash = gsk_render_node_hash_bytes (*hash, self->stops, sizeof (GskColorStop) * self->n_stops);
+
+  return TRUE;
+}
+
 static void
 gsk_linear_gradient_node_class_init (gpointer g_class,
                                      gpointer class_data)
@@ -366,6 +391,7 @@ gsk_linear_gradient_node_class_init (gpointer g_class,
   node_class->finalize = gsk_linear_gradient_node_finalize;
   node_class->draw = gsk_linear_gradient_node_draw;
   node_class->diff = gsk_linear_gradient_node_diff;
+  node_class->hash = gsk_linear_gradient_node_hash;
 }
 
 static void
@@ -379,6 +405,7 @@ gsk_repeating_linear_gradient_node_class_init (gpointer g_class,
   node_class->finalize = gsk_linear_gradient_node_finalize;
   node_class->draw = gsk_linear_gradient_node_draw;
   node_class->diff = gsk_linear_gradient_node_diff;
+  node_class->hash = gsk_linear_gradient_node_hash;
 }
 
 /**
@@ -689,6 +716,22 @@ gsk_radial_gradient_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_radial_gradient_node_hash (GskRenderNode *node,
+                               guint64       *hash)
+{
+  GskRadialGradientNode *self = (GskRadialGradientNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->center, sizeof (self->center));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->hradius, sizeof (self->hradius));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->vradius, sizeof (self->vradius));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->start, sizeof (self->start));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->end, sizeof (self->end));
+  *hash = gsk_render_node_hash_bytes (*hash, self->stops, sizeof (GskColorStop) * self->n_stops);
+
+  return TRUE;
+}
+
 static void
 gsk_radial_gradient_node_class_init (gpointer g_class,
                                      gpointer class_data)
@@ -700,6 +743,7 @@ gsk_radial_gradient_node_class_init (gpointer g_class,
   node_class->finalize = gsk_radial_gradient_node_finalize;
   node_class->draw = gsk_radial_gradient_node_draw;
   node_class->diff = gsk_radial_gradient_node_diff;
+  node_class->hash = gsk_radial_gradient_node_hash;
 }
 
 static void
@@ -713,6 +757,7 @@ gsk_repeating_radial_gradient_node_class_init (gpointer g_class,
   node_class->finalize = gsk_radial_gradient_node_finalize;
   node_class->draw = gsk_radial_gradient_node_draw;
   node_class->diff = gsk_radial_gradient_node_diff;
+  node_class->hash = gsk_radial_gradient_node_hash;
 }
 
 /**
@@ -1177,6 +1222,19 @@ gsk_conic_gradient_node_diff (GskRenderNode *node1,
     }
 }
 
+static gboolean
+gsk_conic_gradient_node_hash (GskRenderNode *node,
+                              guint64       *hash)
+{
+  GskConicGradientNode *self = (GskConicGradientNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->center, sizeof (self->center));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->rotation, sizeof (self->rotation));
+  *hash = gsk_render_node_hash_bytes (*hash, self->stops, sizeof (GskColorStop) * self->n_stops);
+
+  return TRUE;
+}
+
 static void
 gsk_conic_gradient_node_class_init (gpointer g_class,
                                     gpointer class_data)
@@ -1188,6 +1246,7 @@ gsk_conic_gradient_node_class_init (gpointer g_class,
   node_class->finalize = gsk_conic_gradient_node_finalize;
   node_class->draw = gsk_conic_gradient_node_draw;
   node_class->diff = gsk_conic_gradient_node_diff;
+  node_class->hash = gsk_conic_gradient_node_hash;
 }
 
 /**
@@ -1537,6 +1596,19 @@ gsk_border_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_border_node_hash (GskRenderNode *node,
+                      guint64       *hash)
+{
+  GskBorderNode *self = (GskBorderNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->outline, sizeof (self->outline));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->border_width, sizeof (self->border_width));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->border_color, sizeof (self->border_color));
+
+  return TRUE;
+}
+
 static void
 gsk_border_node_class_init (gpointer g_class,
                             gpointer class_data)
@@ -1547,6 +1619,7 @@ gsk_border_node_class_init (gpointer g_class,
 
   node_class->draw = gsk_border_node_draw;
   node_class->diff = gsk_border_node_diff;
+  node_class->hash = gsk_border_node_hash;
 }
 
 /**
@@ -1821,6 +1894,18 @@ gsk_texture_node_diff (GskRenderNode *node1,
   cairo_region_destroy (sub);
 }
 
+static gboolean
+gsk_texture_node_hash (GskRenderNode *node,
+                       guint64       *hash)
+{
+  GskTextureNode *self = (GskTextureNode *) node;
+
+  /* Textures are immutable, so the same texture means the same contents */
+  *hash = gsk_render_node_hash_bytes (*hash, &self->texture, sizeof (self->texture));
+
+  return TRUE;
+}
+
 static void
 gsk_texture_node_class_init (gpointer g_class,
                              gpointer class_data)
@@ -1832,6 +1917,7 @@ gsk_texture_node_class_init (gpointer g_class,
   node_class->finalize = gsk_texture_node_finalize;
   node_class->draw = gsk_texture_node_draw;
   node_class->diff = gsk_texture_node_diff;
+  node_class->hash = gsk_texture_node_hash;
 }
 
 /**
@@ -2009,6 +2095,18 @@ gsk_texture_scale_node_diff (GskRenderNode *node1,
   cairo_region_destroy (sub);
 }
 
+static gboolean
+gsk_texture_scale_node_hash (GskRenderNode *node,
+                             guint64       *hash)
+{
+  GskTextureScaleNode *self = (GskTextureScaleNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->texture, sizeof (self->texture));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->filter, sizeof (self->filter));
+
+  return TRUE;
+}
+
 static void
 gsk_texture_scale_node_class_init (gpointer g_class,
                                    gpointer class_data)
@@ -2020,6 +2118,7 @@ gsk_texture_scale_node_class_init (gpointer g_class,
   node_class->finalize = gsk_texture_scale_node_finalize;
   node_class->draw = gsk_texture_scale_node_draw;
   node_class->diff = gsk_texture_scale_node_diff;
+  node_class->hash = gsk_texture_scale_node_hash;
 }
 
 /**
@@ -2162,11 +2261,6 @@ draw_shadow (cairo_t              *cr,
   gsk_cairo_blur_finish_drawing (shadow_cr, radius, color, blur_flags);
 }
 
-typedef struct {
-  float radius;
-  graphene_size_t corner;
-} CornerMask;
-
 typedef enum {
   TOP,
   RIGHT,
@@ -2174,22 +2268,153 @@ typedef enum {
   LEFT
 } Side;
 
+/* Blurring shadow masks is expensive, so we keep the most recently
+ * used ones around. The cache is shared by all renderers and windows,
+ * so it is limited by the memory used instead of by frames.
+ */
+#define MAX_SHADOW_CACHE_SIZE (4 * 1024 * 1024)
+
+typedef struct _ShadowMask ShadowMask;
+
+struct _ShadowMask
+{
+  /* The key, compared with memcmp() */
+  GskRoundedRect outline;
+  float radius;
+  float scale_x;
+  float scale_y;
+
+  cairo_surface_t *surface;
+  gsize size;
+  GList link;
+};
+
+#define SHADOW_MASK_KEY_SIZE G_STRUCT_OFFSET (ShadowMask, surface)
+
+static GMutex shadow_cache_lock;
+static GHashTable *shadow_cache;
+static GQueue shadow_cache_lru = G_QUEUE_INIT;
+static gsize shadow_cache_size;
+
 static guint
-corner_mask_hash (CornerMask *mask)
+shadow_mask_hash (gconstpointer data)
 {
-  return ((guint)mask->radius << 24) ^
-    ((guint)(mask->corner.width*4)) << 12 ^
-    ((guint)(mask->corner.height*4)) << 0;
+  return gsk_render_node_hash_bytes (G_GUINT64_CONSTANT (0xcbf29ce484222325), data, SHADOW_MASK_KEY_SIZE);
 }
 
 static gboolean
-corner_mask_equal (CornerMask *mask1,
-                   CornerMask *mask2)
+shadow_mask_equal (gconstpointer data1,
+                   gconstpointer data2)
+{
+  return memcmp (data1, data2, SHADOW_MASK_KEY_SIZE) == 0;
+}
+
+static void
+shadow_mask_free (gpointer data)
 {
-  return
-    mask1->radius == mask2->radius &&
-    mask1->corner.width == mask2->corner.width &&
-    mask1->corner.height == mask2->corner.height;
+  ShadowMask *mask = data;
+
+  cairo_surface_destroy (mask->surface);
+  g_free (mask);
+}
+
+static void
+shadow_mask_init_key (ShadowMask           *mask,
+                      const GskRoundedRect *outline,
+                      float                 radius,
+                      float                 scale_x,
+                      float                 scale_y)
+{
+  /* Ensure the key is 15 packed floats without padding
+   * so that we can use memcmp instead of float comparisons.
+   */
+  G_STATIC_ASSERT (SHADOW_MASK_KEY_SIZE == sizeof (float) * 15);
+
+  mask->outline = *outline;
+  mask->radius = radius;
+  mask->scale_x = scale_x;
+  mask->scale_y = scale_y;
+}
+
+/* Returns a new reference to the mask, or NULL if it isn't cached */
+static cairo_surface_t *
+shadow_mask_cache_lookup (const GskRoundedRect *outline,
+                          float                 radius,
+                          float                 scale_x,
+                          float                 scale_y)
+{
+  ShadowMask key, *mask;
+  cairo_surface_t *surface = NULL;
+
+  shadow_mask_init_key (&key, outline, radius, scale_x, scale_y);
+
+  g_mutex_lock (&shadow_cache_lock);
+
+  if (shadow_cache)
+    {
+      mask = g_hash_table_lookup (shadow_cache, &key);
+      if (mask)
+        {
+          g_queue_unlink (&shadow_cache_lru, &mask->link);
+          g_queue_push_head_link (&shadow_cache_lru, &mask->link);
+          surface = cairo_surface_reference (mask->surface);
+        }
+    }
+
+  g_mutex_unlock (&shadow_cache_lock);
+
+  return surface;
+}
+
+static void
+shadow_mask_cache_insert (const GskRoundedRect *outline,
+                          float                 radius,
+                          float                 scale_x,
+                          float                 scale_y,
+                          cairo_surface_t      *surface)
+{
+  ShadowMask *mask;
+  gsize size;
+
+  size = cairo_image_surface_get_stride (surface) * cairo_image_surface_get_height (surface);
+
+  /* Don't let a single huge shadow evict everything else */
+  if (size > MAX_SHADOW_CACHE_SIZE / 4)
+    return;
+
+  mask = g_new (ShadowMask, 1);
+  shadow_mask_init_key (mask, outline, radius, scale_x, scale_y);
+  mask->surface = cairo_surface_reference (surface);
+  mask->size = size;
+  mask->link = (GList) { mask, NULL, NULL };
+
+  g_mutex_lock (&shadow_cache_lock);
+
+  if (shadow_cache == NULL)
+    shadow_cache = g_hash_table_new_full (shadow_mask_hash, shadow_mask_equal, NULL, shadow_mask_free);
+
+  /* Another thread might have been faster */
+  if (g_hash_table_contains (shadow_cache, mask))
+    {
+      g_mutex_unlock (&shadow_cache_lock);
+      shadow_mask_free (mask);
+      return;
+    }
+
+  g_hash_table_add (shadow_cache, mask);
+  g_queue_push_head_link (&shadow_cache_lru, &mask->link);
+  shadow_cache_size += size;
+
+  while (shadow_cache_size > MAX_SHADOW_CACHE_SIZE)
+    {
+      ShadowMask *old = g_queue_peek_tail (&shadow_cache_lru);
+
+      g_queue_unlink (&shadow_cache_lru, &old->link);
+      shadow_cache_size -= old->size;
+      g_hash_table_remove (shadow_cache, old);
+    }
+
+  g_mutex_unlock (&shadow_cache_lock);
 }
 
 static void
@@ -2210,9 +2435,7 @@ draw_shadow_corner (cairo_t               *cr,
   cairo_pattern_t *pattern;
   cairo_matrix_t matrix;
   float sx, sy;
-  static GHashTable *corner_mask_cache = NULL;
   float max_other;
-  CornerMask key;
   gboolean overlapped;
 
   clip_radius = gsk_cairo_blur_compute_pixels (radius);
@@ -2298,28 +2521,21 @@ draw_shadow_corner (cairo_t               *cr,
    * mask, so we cache rendered masks based on the blur radius and the
    * corner radius.
    */
-  if (corner_mask_cache == NULL)
-    corner_mask_cache = g_hash_table_new_full ((GHashFunc)corner_mask_hash,
-                                               (GEqualFunc)corner_mask_equal,
-                                               g_free, (GDestroyNotify)cairo_surface_destroy);
-
-  key.radius = radius;
-  key.corner = box->corner[corner];
+  gsk_rounded_rect_init_from_rect (&corner_box, &GRAPHENE_RECT_INIT (clip_radius, clip_radius, 2*drawn_rect->width, 2*drawn_rect->height), 0);
+  corner_box.corner[0] = box->corner[corner];
 
-  mask = g_hash_table_lookup (corner_mask_cache, &key);
+  mask = shadow_mask_cache_lookup (&corner_box, radius, 1, 1);
   if (mask == NULL)
     {
       mask = cairo_surface_create_similar_image (cairo_get_target (cr), CAIRO_FORMAT_A8,
                                                  drawn_rect->width + clip_radius,
                                                  drawn_rect->height + clip_radius);
       mask_cr = cairo_create (mask);
-      gsk_rounded_rect_init_from_rect (&corner_box, &GRAPHENE_RECT_INIT (clip_radius, clip_radius, 2*drawn_rect->width, 2*drawn_rect->height), 0);
-      corner_box.corner[0] = box->corner[corner];
       gsk_rounded_rect_path (&corner_box, mask_cr);
       cairo_fill (mask_cr);
       gsk_cairo_blur_surface (mask, radius, GSK_BLUR_X | GSK_BLUR_Y);
       cairo_destroy (mask_cr);
-      g_hash_table_insert (corner_mask_cache, g_memdup2 (&key, sizeof (key)), mask);
+      shadow_mask_cache_insert (&corner_box, radius, 1, 1, mask);
     }
 
   gdk_cairo_set_source_rgba (cr, color);
@@ -2330,6 +2546,7 @@ draw_shadow_corner (cairo_t               *cr,
   cairo_pattern_set_matrix (pattern, &matrix);
   cairo_mask (cr, pattern);
   cairo_pattern_destroy (pattern);
+  cairo_surface_destroy (mask);
 }
 
 static void
@@ -2392,6 +2609,132 @@ draw_shadow_side (cairo_t               *cr,
   draw_shadow (cr, inset, box, clip_box, radius, color, blur_flags);
 }
 
+/* Draws a blurred outset shadow from a single cached mask.
+ *
+ * Away from the corners, the blurred shadow doesn't change along the
+ * sides, so the mask is the shadow of the box with the straight parts
+ * of its sides cut down to one pixel. When drawing, the corners of the
+ * mask are used as-is and the pixels between them are stretched.
+ *
+ * Returns FALSE if the corners are too close to each other for this.
+ */
+static gboolean
+draw_shadow_nine_slice (cairo_t              *cr,
+                        const GskRoundedRect *box,
+                        float                 radius,
+                        const GdkRGBA        *color)
+{
+  GskRoundedRect mask_box;
+  cairo_surface_t *mask;
+  cairo_pattern_t *pattern;
+  double scale_x, scale_y;
+  double ax[3], bx[3], ay[3], by[3];
+  int x[4], y[4];
+  int clip_radius;
+  int mask_width, mask_height;
+  int i, j;
+
+  clip_radius = gsk_cairo_blur_compute_pixels (radius);
+
+  /* The edges of the slices: outer edge, end of the corners,
+   * start of the other corners, outer edge */
+  x[0] = floor (box->bounds.origin.x - clip_radius);
+  x[1] = ceil (box->bounds.origin.x + MAX (box->corner[GSK_CORNER_TOP_LEFT].width,
+                                           box->corner[GSK_CORNER_BOTTOM_LEFT].width) + clip_radius);
+  x[2] = floor (box->bounds.origin.x + box->bounds.size.width - MAX (box->corner[GSK_CORNER_TOP_RIGHT].width,
+                                                                     box->corner[GSK_CORNER_BOTTOM_RIGHT].width) - clip_radius);
+  x[3] = ceil (box->bounds.origin.x + box->bounds.size.width + clip_radius);
+
+  y[0] = floor (box->bounds.origin.y - clip_radius);
+  y[1] = ceil (box->bounds.origin.y + MAX (box->corner[GSK_CORNER_TOP_LEFT].height,
+                                           box->corner[GSK_CORNER_TOP_RIGHT].height) + clip_radius);
+  y[2] = floor (box->bounds.origin.y + box->bounds.size.height - MAX (box->corner[GSK_CORNER_BOTTOM_LEFT].height,
+                                                                      box->corner[GSK_CORNER_BOTTOM_RIGHT].height) - clip_radius);
+  y[3] = ceil (box->bounds.origin.y + box->bounds.size.height + clip_radius);
+
+  if (x[1] > x[2] || y[1] > y[2])
+    return FALSE;
+
+  if (has_empty_clip (cr))
+    return TRUE;
+
+  mask_width = x[3] - x[0] - (x[2] - x[1]) + 1;
+  mask_height = y[3] - y[0] - (y[2] - y[1]) + 1;
+
+  /* Keeping the position of the box relative to the pixel grid in the
+   * key means the result is the same as blurring the whole shadow */
+  gsk_rounded_rect_init_copy (&mask_box, box);
+  mask_box.bounds.origin.x -= x[0];
+  mask_box.bounds.origin.y -= y[0];
+  mask_box.bounds.size.width -= x[2] - x[1] - 1;
+  mask_box.bounds.size.height -= y[2] - y[1] - 1;
+
+  scale_x = scale_y = 1;
+  cairo_surface_get_device_scale (cairo_get_target (cr), &scale_x, &scale_y);
+
+  mask = shadow_mask_cache_lookup (&mask_box, radius, scale_x, scale_y);
+  if (mask == NULL)
+    {
+      cairo_t *mask_cr;
+
+      mask = cairo_surface_create_similar_image (cairo_get_target (cr), CAIRO_FORMAT_A8,
+                                                 ceil (scale_x * mask_width),
+                                                 ceil (scale_y * mask_height));
+      cairo_surface_set_device_scale (mask, scale_x, scale_y);
+      mask_cr = cairo_create (mask);
+      gsk_rounded_rect_path (&mask_box, mask_cr);
+      cairo_fill (mask_cr);
+      cairo_destroy (mask_cr);
+      gsk_cairo_blur_surface (mask, scale_x * radius, GSK_BLUR_X | GSK_BLUR_Y);
+      shadow_mask_cache_insert (&mask_box, radius, scale_x, scale_y, mask);
+    }
+
+  /* Map each slice to its part of the mask, stretching the middle one */
+  ax[0] = ax[2] = 1;
+  bx[0] = - x[0];
+  bx[2] = - (x[0] + x[2] - x[1] - 1);
+  ax[1] = x[2] > x[1] ? 1.0 / (x[2] - x[1]) : 1;
+  bx[1] = x[1] - x[0] - x[1] * ax[1];
+
+  ay[0] = ay[2] = 1;
+  by[0] = - y[0];
+  by[2] = - (y[0] + y[2] - y[1] - 1);
+  ay[1] = y[2] > y[1] ? 1.0 / (y[2] - y[1]) : 1;
+  by[1] = y[1] - y[0] - y[1] * ay[1];
+
+  gdk_cairo_set_source_rgba (cr, color);
+  pattern = cairo_pattern_create_for_surface (mask);
+  cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
+
+  for (j = 0; j < 3; j++)
+    {
+      if (y[j] == y[j + 1])
+        continue;
+
+      for (i = 0; i < 3; i++)
+        {
+          cairo_matrix_t matrix;
+
+          if (x[i] == x[i + 1])
+            continue;
+
+          cairo_matrix_init (&matrix, ax[i], 0, 0, ay[j], bx[i], by[j]);
+          cairo_pattern_set_matrix (pattern, &matrix);
+
+          cairo_save (cr);
+          cairo_rectangle (cr, x[i], y[j], x[i + 1] - x[i], y[j + 1] - y[j]);
+          cairo_clip (cr);
+          cairo_mask (cr, pattern);
+          cairo_restore (cr);
+        }
+    }
+
+  cairo_pattern_destroy (pattern);
+  cairo_surface_destroy (mask);
+
+  return TRUE;
+}
+
 static gboolean
 needs_blur (double radius)
 {
@@ -2520,6 +2863,22 @@ gsk_inset_shadow_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_inset_shadow_node_hash (GskRenderNode *node,
+                            guint64       *hash)
+{
+  GskInsetShadowNode *self = (GskInsetShadowNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->outline, sizeof (self->outline));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->color, sizeof (self->color));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->dx, sizeof (self->dx));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->dy, sizeof (self->dy));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->spread, sizeof (self->spread));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->blur_radius, sizeof (self->blur_radius));
+
+  return TRUE;
+}
+
 static void
 gsk_inset_shadow_node_class_init (gpointer g_class,
                                   gpointer class_data)
@@ -2530,6 +2889,7 @@ gsk_inset_shadow_node_class_init (gpointer g_class,
 
   node_class->draw = gsk_inset_shadow_node_draw;
   node_class->diff = gsk_inset_shadow_node_diff;
+  node_class->hash = gsk_inset_shadow_node_hash;
 }
 
 /**
@@ -2750,7 +3110,7 @@ gsk_outset_shadow_node_draw (GskRenderNode *node,
 
   if (!needs_blur (blur_radius))
     draw_shadow (cr, FALSE, &box, &clip_box, blur_radius, &self->color, GSK_BLUR_NONE);
-  else
+  else if (!draw_shadow_nine_slice (cr, &box, blur_radius, &self->color))
     {
       int i;
       cairo_region_t *remaining;
@@ -2833,6 +3193,22 @@ gsk_outset_shadow_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_outset_shadow_node_hash (GskRenderNode *node,
+                             guint64       *hash)
+{
+  GskOutsetShadowNode *self = (GskOutsetShadowNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->outline, sizeof (self->outline));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->color, sizeof (self->color));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->dx, sizeof (self->dx));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->dy, sizeof (self->dy));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->spread, sizeof (self->spread));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->blur_radius, sizeof (self->blur_radius));
+
+  return TRUE;
+}
+
 static void
 gsk_outset_shadow_node_class_init (gpointer g_class,
                                    gpointer class_data)
@@ -2843,6 +3219,7 @@ gsk_outset_shadow_node_class_init (gpointer g_class,
 
   node_class->draw = gsk_outset_shadow_node_draw;
   node_class->diff = gsk_outset_shadow_node_diff;
+  node_class->hash = gsk_outset_shadow_node_hash;
 }
 
 /**
@@ -3226,18 +3603,183 @@ gsk_container_node_get_diff_settings (void)
 {
   static GskDiffSettings *settings = NULL;
 
-  if (G_LIKELY (settings))
-    return settings;
+  /* This is called from the diff threads, too */
+  if (g_once_init_enter (&settings))
+    {
+      GskDiffSettings *new_settings;
+
+      new_settings = gsk_diff_settings_new (gsk_container_node_compare_func,
+                                            gsk_container_node_keep_func,
+                                            gsk_container_node_change_func,
+                                            gsk_container_node_change_func);
+      gsk_diff_settings_set_allow_abort (new_settings, TRUE);
 
-  settings = gsk_diff_settings_new (gsk_container_node_compare_func,
-                                    gsk_container_node_keep_func,
-                                    gsk_container_node_change_func,
-                                    gsk_container_node_change_func);
-  gsk_diff_settings_set_allow_abort (settings, TRUE);
+      g_once_init_leave (&settings, new_settings);
+    }
 
   return settings;
 }
 
+/* Below this many children to compare, handing work to other threads costs more than it saves */
+#define MIN_DIFFS_PER_THREAD 256
+#define MAX_DIFF_THREADS 8
+
+/* Set while diffing on multiple threads, including in the thread that
+ * started them, so that nested containers don't start more threads */
+static GPrivate in_diff_thread;
+
+typedef struct _DiffCollect DiffCollect;
+typedef struct _DiffJob DiffJob;
+typedef struct _DiffThread DiffThread;
+
+struct _DiffCollect
+{
+  GskDiffData data; /* must be first, the change func uses it */
+  GPtrArray *pairs;
+};
+
+struct _DiffJob
+{
+  GskRenderNode **pairs;
+  guint n_pairs;
+  GdkSurface *surface;
+  int aborted; /* atomic */
+};
+
+/* Each thread gets a consecutive range of children, as neighbouring
+ * children tend to have neighbouring bounds that merge into few rectangles.
+ */
+struct _DiffThread
+{
+  DiffJob *job;
+  guint start;
+  guint end;
+  cairo_region_t *region;
+};
+
+static GskDiffResult
+gsk_container_node_collect_func (gconstpointer elem1, gconstpointer elem2, gpointer user_data)
+{
+  DiffCollect *collect = user_data;
+
+  if (gsk_render_node_hash_equal ((GskRenderNode *) elem1, (GskRenderNode *) elem2))
+    return GSK_DIFF_OK;
+
+  g_ptr_array_add (collect->pairs, (gpointer) elem1);
+  g_ptr_array_add (collect->pairs, (gpointer) elem2);
+
+  return GSK_DIFF_OK;
+}
+
+static GskDiffSettings *
+gsk_container_node_get_collect_settings (void)
+{
+  static GskDiffSettings *settings = NULL;
+
+  if (g_once_init_enter (&settings))
+    {
+      GskDiffSettings *new_settings;
+
+      new_settings = gsk_diff_settings_new (gsk_container_node_compare_func,
+                                            gsk_container_node_collect_func,
+                                            gsk_container_node_change_func,
+                                            gsk_container_node_change_func);
+      gsk_diff_settings_set_allow_abort (new_settings, TRUE);
+
+      g_once_init_leave (&settings, new_settings);
+    }
+
+  return settings;
+}
+
+static void
+gsk_render_node_diff_run (DiffThread *thread)
+{
+  DiffJob *job = thread->job;
+  guint i;
+
+  for (i = thread->start; i < thread->end && !g_atomic_int_get (&job->aborted); i++)
+    {
+      gsk_render_node_diff (job->pairs[2 * i],
+                            job->pairs[2 * i + 1],
+                            &(GskDiffData) { thread->region, job->surface });
+
+      if (cairo_region_num_rectangles (thread->region) > MAX_RECTS_IN_DIFF)
+        g_atomic_int_set (&job->aborted, TRUE);
+    }
+}
+
+static void
+gsk_render_node_diff_thread (gpointer data,
+                             guint    index)
+{
+  DiffThread *threads = data;
+
+  /* Pool threads are reused, so unset it again afterwards */
+  g_private_set (&in_diff_thread, GINT_TO_POINTER (TRUE));
+
+  gsk_render_node_diff_run (&threads[index]);
+
+  g_private_set (&in_diff_thread, NULL);
+}
+
+/* Like gsk_diff() with the container settings, but the children that
+ * get compared are collected first and then diffed on multiple threads.
+ */
+static gboolean
+gsk_render_node_diff_multiple_threaded (GskRenderNode **nodes1,
+                                        gsize           n_nodes1,
+                                        GskRenderNode **nodes2,
+                                        gsize           n_nodes2,
+                                        GskDiffData    *data)
+{
+  DiffCollect collect = { *data, NULL };
+  DiffJob job = { NULL, };
+  DiffThread threads[MAX_DIFF_THREADS];
+  guint i, n_threads;
+  gboolean result;
+
+  collect.pairs = g_ptr_array_new ();
+
+  if (gsk_diff ((gconstpointer *) nodes1, n_nodes1,
+                (gconstpointer *) nodes2, n_nodes2,
+                gsk_container_node_get_collect_settings (),
+                &collect) != GSK_DIFF_OK)
+    {
+      g_ptr_array_unref (collect.pairs);
+      return FALSE;
+    }
+
+  job.pairs = (GskRenderNode **) collect.pairs->pdata;
+  job.n_pairs = collect.pairs->len / 2;
+  job.surface = data->surface;
+
+  n_threads = MIN (job.n_pairs / MIN_DIFFS_PER_THREAD, MIN (g_get_num_processors (), MAX_DIFF_THREADS));
+  n_threads = MAX (n_threads, 1);
+
+  for (i = 0; i < n_threads; i++)
+    {
+      threads[i].job = &job;
+      threads[i].start = job.n_pairs * i / n_threads;
+      threads[i].end = job.n_pairs * (i + 1) / n_threads;
+      threads[i].region = i == 0 ? data->region : cairo_region_create ();
+    }
+
+  gsk_parallel_run (gsk_render_node_diff_thread, threads, n_threads);
+
+  for (i = 1; i < n_threads; i++)
+    {
+      cairo_region_union (data->region, threads[i].region);
+      cairo_region_destroy (threads[i].region);
+    }
+
+  result = !job.aborted && cairo_region_num_rectangles (data->region) <= MAX_RECTS_IN_DIFF;
+
+  g_ptr_array_unref (collect.pairs);
+
+  return result;
+}
+
 static gboolean
 gsk_render_node_diff_multiple (GskRenderNode **nodes1,
                                gsize           n_nodes1,
@@ -3245,6 +3787,10 @@ gsk_render_node_diff_multiple (GskRenderNode **nodes1,
                                gsize           n_nodes2,
                                GskDiffData    *data)
 {
+  if (MIN (n_nodes1, n_nodes2) >= 2 * MIN_DIFFS_PER_THREAD &&
+      g_private_get (&in_diff_thread) == NULL)
+    return gsk_render_node_diff_multiple_threaded (nodes1, n_nodes1, nodes2, n_nodes2, data);
+
   return gsk_diff ((gconstpointer *) nodes1, n_nodes1,
                    (gconstpointer *) nodes2, n_nodes2,
                    gsk_container_node_get_diff_settings (),
@@ -3286,6 +3832,23 @@ gsk_container_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_container_node_hash (GskRenderNode *node,
+                         guint64       *hash)
+{
+  GskContainerNode *self = (GskContainerNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->n_children, sizeof (self->n_children));
+
+  for (guint i = 0; i < self->n_children; i++)
+    {
+      if (!gsk_render_node_hash_child (hash, self->children[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static void
 gsk_container_node_class_init (gpointer g_class,
                                gpointer class_data)
@@ -3297,6 +3860,7 @@ gsk_container_node_class_init (gpointer g_class,
   node_class->finalize = gsk_container_node_finalize;
   node_class->draw = gsk_container_node_draw;
   node_class->diff = gsk_container_node_diff;
+  node_class->hash = gsk_container_node_hash;
 }
 
 /**
@@ -3569,6 +4133,22 @@ gsk_transform_node_diff (GskRenderNode *node1,
     }
 }
 
+static gboolean
+gsk_transform_node_hash (GskRenderNode *node,
+                         guint64       *hash)
+{
+  GskTransformNode *self = (GskTransformNode *) node;
+
+  graphene_matrix_t matrix;
+  float m[16];
+
+  gsk_transform_to_matrix (self->transform, &matrix);
+  graphene_matrix_to_float (&matrix, m);
+  *hash = gsk_render_node_hash_bytes (*hash, m, sizeof (m));
+
+  return gsk_render_node_hash_child (hash, self->child);
+}
+
 static void
 gsk_transform_node_class_init (gpointer g_class,
                                gpointer class_data)
@@ -3581,6 +4161,7 @@ gsk_transform_node_class_init (gpointer g_class,
   node_class->draw = gsk_transform_node_draw;
   node_class->can_diff = gsk_transform_node_can_diff;
   node_class->diff = gsk_transform_node_diff;
+  node_class->hash = gsk_transform_node_hash;
 }
 
 /**
@@ -3729,6 +4310,17 @@ gsk_opacity_node_diff (GskRenderNode *node1,
     gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_opacity_node_hash (GskRenderNode *node,
+                       guint64       *hash)
+{
+  GskOpacityNode *self = (GskOpacityNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->opacity, sizeof (self->opacity));
+
+  return gsk_render_node_hash_child (hash, self->child);
+}
+
 static void
 gsk_opacity_node_class_init (gpointer g_class,
                              gpointer class_data)
@@ -3740,6 +4332,7 @@ gsk_opacity_node_class_init (gpointer g_class,
   node_class->finalize = gsk_opacity_node_finalize;
   node_class->draw = gsk_opacity_node_draw;
   node_class->diff = gsk_opacity_node_diff;
+  node_class->hash = gsk_opacity_node_hash;
 }
 
 /**
@@ -3951,6 +4544,22 @@ nope:
   return;
 }
 
+static gboolean
+gsk_color_matrix_node_hash (GskRenderNode *node,
+                            guint64       *hash)
+{
+  GskColorMatrixNode *self = (GskColorMatrixNode *) node;
+
+  float m[16], v[4];
+
+  graphene_matrix_to_float (&self->color_matrix, m);
+  *hash = gsk_render_node_hash_bytes (*hash, m, sizeof (m));
+  graphene_vec4_to_float (&self->color_offset, v);
+  *hash = gsk_render_node_hash_bytes (*hash, v, sizeof (v));
+
+  return gsk_render_node_hash_child (hash, self->child);
+}
+
 static void
 gsk_color_matrix_node_class_init (gpointer g_class,
                                   gpointer class_data)
@@ -3962,6 +4571,7 @@ gsk_color_matrix_node_class_init (gpointer g_class,
   node_class->finalize = gsk_color_matrix_node_finalize;
   node_class->draw = gsk_color_matrix_node_draw;
   node_class->diff = gsk_color_matrix_node_diff;
+  node_class->hash = gsk_color_matrix_node_hash;
 }
 
 /**
@@ -4249,6 +4859,17 @@ gsk_repeat_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_repeat_node_hash (GskRenderNode *node,
+                      guint64       *hash)
+{
+  GskRepeatNode *self = (GskRepeatNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->child_bounds, sizeof (self->child_bounds));
+
+  return gsk_render_node_hash_child (hash, self->child);
+}
+
 static void
 gsk_repeat_node_class_init (gpointer g_class,
                             gpointer class_data)
@@ -4260,6 +4881,7 @@ gsk_repeat_node_class_init (gpointer g_class,
   node_class->finalize = gsk_repeat_node_finalize;
   node_class->draw = gsk_repeat_node_draw;
   node_class->diff = gsk_repeat_node_diff;
+  node_class->hash = gsk_repeat_node_hash;
 }
 
 /**
@@ -4410,6 +5032,17 @@ gsk_clip_node_diff (GskRenderNode *node1,
     }
 }
 
+static gboolean
+gsk_clip_node_hash (GskRenderNode *node,
+                    guint64       *hash)
+{
+  GskClipNode *self = (GskClipNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->clip, sizeof (self->clip));
+
+  return gsk_render_node_hash_child (hash, self->child);
+}
+
 static void
 gsk_clip_node_class_init (gpointer g_class,
                                gpointer class_data)
@@ -4421,6 +5054,7 @@ gsk_clip_node_class_init (gpointer g_class,
   node_class->finalize = gsk_clip_node_finalize;
   node_class->draw = gsk_clip_node_draw;
   node_class->diff = gsk_clip_node_diff;
+  node_class->hash = gsk_clip_node_hash;
 }
 
 /**
@@ -4559,6 +5193,17 @@ gsk_rounded_clip_node_diff (GskRenderNode *node1,
     }
 }
 
+static gboolean
+gsk_rounded_clip_node_hash (GskRenderNode *node,
+                            guint64       *hash)
+{
+  GskRoundedClipNode *self = (GskRoundedClipNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->clip, sizeof (self->clip));
+
+  return gsk_render_node_hash_child (hash, self->child);
+}
+
 static void
 gsk_rounded_clip_node_class_init (gpointer g_class,
                                   gpointer class_data)
@@ -4570,6 +5215,7 @@ gsk_rounded_clip_node_class_init (gpointer g_class,
   node_class->finalize = gsk_rounded_clip_node_finalize;
   node_class->draw = gsk_rounded_clip_node_draw;
   node_class->diff = gsk_rounded_clip_node_diff;
+  node_class->hash = gsk_rounded_clip_node_hash;
 }
 
 /**
@@ -5203,6 +5849,17 @@ gsk_shadow_node_get_bounds (GskShadowNode *self,
   bounds->size.height += top + bottom;
 }
 
+static gboolean
+gsk_shadow_node_hash (GskRenderNode *node,
+                      guint64       *hash)
+{
+  GskShadowNode *self = (GskShadowNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, self->shadows, sizeof (GskShadow) * self->n_shadows);
+
+  return gsk_render_node_hash_child (hash, self->child);
+}
+
 static void
 gsk_shadow_node_class_init (gpointer g_class,
                             gpointer class_data)
@@ -5214,6 +5871,7 @@ gsk_shadow_node_class_init (gpointer g_class,
   node_class->finalize = gsk_shadow_node_finalize;
   node_class->draw = gsk_shadow_node_draw;
   node_class->diff = gsk_shadow_node_diff;
+  node_class->hash = gsk_shadow_node_hash;
 }
 
 /**
@@ -5418,6 +6076,18 @@ gsk_blend_node_diff (GskRenderNode *node1,
     }
 }
 
+static gboolean
+gsk_blend_node_hash (GskRenderNode *node,
+                     guint64       *hash)
+{
+  GskBlendNode *self = (GskBlendNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->blend_mode, sizeof (self->blend_mode));
+
+  return gsk_render_node_hash_child (hash, self->bottom) &&
+         gsk_render_node_hash_child (hash, self->top);
+}
+
 static void
 gsk_blend_node_class_init (gpointer g_class,
                            gpointer class_data)
@@ -5429,6 +6099,7 @@ gsk_blend_node_class_init (gpointer g_class,
   node_class->finalize = gsk_blend_node_finalize;
   node_class->draw = gsk_blend_node_draw;
   node_class->diff = gsk_blend_node_diff;
+  node_class->hash = gsk_blend_node_hash;
 }
 
 /**
@@ -5587,6 +6258,18 @@ gsk_cross_fade_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_cross_fade_node_hash (GskRenderNode *node,
+                          guint64       *hash)
+{
+  GskCrossFadeNode *self = (GskCrossFadeNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->progress, sizeof (self->progress));
+
+  return gsk_render_node_hash_child (hash, self->start) &&
+         gsk_render_node_hash_child (hash, self->end);
+}
+
 static void
 gsk_cross_fade_node_class_init (gpointer g_class,
                                 gpointer class_data)
@@ -5598,6 +6281,7 @@ gsk_cross_fade_node_class_init (gpointer g_class,
   node_class->finalize = gsk_cross_fade_node_finalize;
   node_class->draw = gsk_cross_fade_node_draw;
   node_class->diff = gsk_cross_fade_node_diff;
+  node_class->hash = gsk_cross_fade_node_hash;
 }
 
 /**
@@ -5780,6 +6464,35 @@ gsk_text_node_diff (GskRenderNode *node1,
   gsk_render_node_diff_impossible (node1, node2, data);
 }
 
+static gboolean
+gsk_text_node_hash (GskRenderNode *node,
+                    guint64       *hash)
+{
+  GskTextNode *self = (GskTextNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->font, sizeof (self->font));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->color, sizeof (self->color));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->offset, sizeof (self->offset));
+  *hash = gsk_render_node_hash_bytes (*hash, &self->num_glyphs, sizeof (self->num_glyphs));
+
+  for (guint i = 0; i < self->num_glyphs; i++)
+    {
+      const PangoGlyphInfo *info = &self->glyphs[i];
+      int values[6] = {
+        info->glyph,
+        info->geometry.width,
+        info->geometry.x_offset,
+        info->geometry.y_offset,
+        info->attr.is_cluster_start,
+        info->attr.is_color
+      };
+
+      *hash = gsk_render_node_hash_bytes (*hash, values, sizeof (values));
+    }
+
+  return TRUE;
+}
+
 static void
 gsk_text_node_class_init (gpointer g_class,
                           gpointer class_data)
@@ -5791,6 +6504,7 @@ gsk_text_node_class_init (gpointer g_class,
   node_class->finalize = gsk_text_node_finalize;
   node_class->draw = gsk_text_node_draw;
   node_class->diff = gsk_text_node_diff;
+  node_class->hash = gsk_text_node_hash;
 }
 
 static inline float
@@ -6229,6 +6943,17 @@ gsk_blur_node_diff (GskRenderNode *node1,
     }
 }
 
+static gboolean
+gsk_blur_node_hash (GskRenderNode *node,
+                    guint64       *hash)
+{
+  GskBlurNode *self = (GskBlurNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->radius, sizeof (self->radius));
+
+  return gsk_render_node_hash_child (hash, self->child);
+}
+
 static void
 gsk_blur_node_class_init (gpointer g_class,
                           gpointer class_data)
@@ -6240,6 +6965,7 @@ gsk_blur_node_class_init (gpointer g_class,
   node_class->finalize = gsk_blur_node_finalize;
   node_class->draw = gsk_blur_node_draw;
   node_class->diff = gsk_blur_node_diff;
+  node_class->hash = gsk_blur_node_hash;
 }
 
 /**
@@ -6460,6 +7186,18 @@ gsk_mask_node_diff (GskRenderNode *node1,
   gsk_render_node_diff (self1->mask, self2->mask, data);
 }
 
+static gboolean
+gsk_mask_node_hash (GskRenderNode *node,
+                    guint64       *hash)
+{
+  GskMaskNode *self = (GskMaskNode *) node;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &self->mask_mode, sizeof (self->mask_mode));
+
+  return gsk_render_node_hash_child (hash, self->source) &&
+         gsk_render_node_hash_child (hash, self->mask);
+}
+
 static void
 gsk_mask_node_class_init (gpointer g_class,
                           gpointer class_data)
@@ -6471,6 +7209,7 @@ gsk_mask_node_class_init (gpointer g_class,
   node_class->finalize = gsk_mask_node_finalize;
   node_class->draw = gsk_mask_node_draw;
   node_class->diff = gsk_mask_node_diff;
+  node_class->hash = gsk_mask_node_hash;
 }
 
 /**
@@ -6631,6 +7370,15 @@ gsk_debug_node_diff (GskRenderNode *node1,
   gsk_render_node_diff (self1->child, self2->child, data);
 }
 
+static gboolean
+gsk_debug_node_hash (GskRenderNode *node,
+                     guint64       *hash)
+{
+  GskDebugNode *self = (GskDebugNode *) node;
+
+  return gsk_render_node_hash_child (hash, self->child);
+}
+
 static void
 gsk_debug_node_class_init (gpointer g_class,
                            gpointer class_data)
@@ -6643,6 +7391,7 @@ gsk_debug_node_class_init (gpointer g_class,
   node_class->draw = gsk_debug_node_draw;
   node_class->can_diff = gsk_debug_node_can_diff;
   node_class->diff = gsk_debug_node_diff;
+  node_class->hash = gsk_debug_node_hash;
 }
 
 /**
@@ -35,6 +35,8 @@
 #include "gdk/gdkrgbaprivate.h"
 #include "gdk/gdktextureprivate.h"
 #include "gdk/gdkmemoryformatprivate.h"
+#include "gdk/gdkmemorytextureprivate.h"
+#include "gdk/gdkprivate.h"
 #include <gtk/css/gtkcss.h>
 #include "gtk/css/gtkcssdataurlprivate.h"
 #include "gtk/css/gtkcssparserprivate.h"
@@ -57,6 +59,7 @@
 #include <hb-subset.h>
 
 #include <glib/gstdio.h>
+#include <math.h>
 
 typedef struct _Context Context;
 
@@ -3157,7 +3160,8 @@ printer_init (Printer       *self,
   self->named_texture_counter = 0;
   self->fonts = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, font_info_free);
 
-  printer_init_duplicates_for_node (self, node);
+  if (node)
+    printer_init_duplicates_for_node (self, node);
 }
 
 static void
@@ -3208,6 +3212,30 @@ string_append_double (GString *string,
 {
   char buf[G_ASCII_DTOSTR_BUF_SIZE];
 
+  /* Most values are small integers, and formatting those by hand
+   * is a lot faster than going through the locale-aware printf.
+   * The result is identical to what %g prints.
+   */
+  if (fabs (d) < 1e6 && d == (int) d && !(d == 0 && signbit (d)))
+    {
+      char *p = buf + sizeof (buf);
+      int i = (int) d;
+      guint u = i < 0 ? - (guint) i : (guint) i;
+
+      *--p = '\0';
+      do
+        {
+          *--p = '0' + u % 10;
+          u /= 10;
+        }
+      while (u);
+      if (i < 0)
+        *--p = '-';
+
+      g_string_append (string, p);
+      return;
+    }
+
   g_ascii_formatd (buf, G_ASCII_DTOSTR_BUF_SIZE, "%g", d);
   g_string_append (string, buf);
 }
@@ -3566,6 +3594,77 @@ base64_encode_with_linebreaks (const guchar *data,
   return out;
 }
 
+/* Encoding textures is by far the most expensive part of
+ * serializing, and recordings serialize the same textures
+ * over and over, so keep the encoded data around while the
+ * texture is alive.
+ */
+#define MAX_ENCODED_TEXTURE_CACHE_SIZE (16 * 1024 * 1024)
+
+G_LOCK_DEFINE_STATIC (encoded_textures);
+static GHashTable *encoded_textures;
+static gsize encoded_textures_size;
+
+static void
+encoded_texture_finalized (gpointer  data,
+                           GObject  *texture)
+{
+  GBytes *bytes;
+
+  G_LOCK (encoded_textures);
+  if (g_hash_table_steal_extended (encoded_textures, texture, NULL, (gpointer *) &bytes))
+    {
+      encoded_textures_size -= g_bytes_get_size (bytes);
+      g_bytes_unref (bytes);
+    }
+  G_UNLOCK (encoded_textures);
+}
+
+static GBytes *
+encode_texture (GdkTexture *texture)
+{
+  GBytes *bytes;
+
+  G_LOCK (encoded_textures);
+  if (encoded_textures == NULL)
+    encoded_textures = g_hash_table_new (NULL, NULL);
+  bytes = g_hash_table_lookup (encoded_textures, texture);
+  if (bytes)
+    g_bytes_ref (bytes);
+  G_UNLOCK (encoded_textures);
+
+  if (bytes)
+    return bytes;
+
+  switch (gdk_memory_format_get_depth (gdk_texture_get_format (texture)))
+    {
+    case GDK_MEMORY_U8:
+    case GDK_MEMORY_U16:
+      bytes = gdk_texture_save_to_png_bytes (texture);
+      break;
+
+    case GDK_MEMORY_FLOAT16:
+    case GDK_MEMORY_FLOAT32:
+      bytes = gdk_texture_save_to_tiff_bytes (texture);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  G_LOCK (encoded_textures);
+  if (encoded_textures_size + g_bytes_get_size (bytes) <= MAX_ENCODED_TEXTURE_CACHE_SIZE &&
+      !g_hash_table_contains (encoded_textures, texture))
+    {
+      g_hash_table_insert (encoded_textures, texture, g_bytes_ref (bytes));
+      encoded_textures_size += g_bytes_get_size (bytes);
+      g_object_weak_ref (G_OBJECT (texture), encoded_texture_finalized, NULL);
+    }
+  G_UNLOCK (encoded_textures);
+
+  return bytes;
+}
+
 static void
 append_texture_param (Printer    *p,
                       const char *param_name,
@@ -3604,13 +3703,11 @@ append_texture_param (Printer    *p,
     {
     case GDK_MEMORY_U8:
     case GDK_MEMORY_U16:
-      bytes = gdk_texture_save_to_png_bytes (texture);
       g_string_append (p->str, "url(\"data:image/png;base64,\\\n");
       break;
 
     case GDK_MEMORY_FLOAT16:
     case GDK_MEMORY_FLOAT32:
-      bytes = gdk_texture_save_to_tiff_bytes (texture);
       g_string_append (p->str, "url(\"data:image/tiff;base64,\\\n");
       break;
 
@@ -3618,6 +3715,8 @@ append_texture_param (Printer    *p,
       g_assert_not_reached ();
     }
 
+  bytes = encode_texture (texture);
+
   b64 = base64_encode_with_linebreaks (g_bytes_get_data (bytes, NULL),
                                        g_bytes_get_size (bytes));
   append_escaping_newlines (p->str, b64);
@@ -3673,22 +3772,31 @@ gsk_text_node_serialize_font (GskRenderNode *node,
 }
 
 static void
-gsk_text_node_serialize_font_options (GskRenderNode *node,
-                                      Printer       *p)
+get_font_options (PangoFont            *font,
+                  cairo_hint_style_t   *hint_style,
+                  cairo_antialias_t    *antialias,
+                  cairo_hint_metrics_t *hint_metrics)
 {
-  PangoFont *font = gsk_text_node_get_font (node);
   cairo_scaled_font_t *sf = pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (font));
   cairo_font_options_t *options;
-  cairo_hint_style_t hint_style;
-  cairo_antialias_t antialias;
-  cairo_hint_metrics_t hint_metrics;
 
   options = cairo_font_options_create ();
   cairo_scaled_font_get_font_options (sf, options);
-  hint_style = cairo_font_options_get_hint_style (options);
-  antialias = cairo_font_options_get_antialias (options);
-  hint_metrics = cairo_font_options_get_hint_metrics (options);
+  *hint_style = cairo_font_options_get_hint_style (options);
+  *antialias = cairo_font_options_get_antialias (options);
+  *hint_metrics = cairo_font_options_get_hint_metrics (options);
   cairo_font_options_destroy (options);
+}
+
+static void
+gsk_text_node_serialize_font_options (GskRenderNode *node,
+                                      Printer       *p)
+{
+  cairo_hint_style_t hint_style;
+  cairo_antialias_t antialias;
+  cairo_hint_metrics_t hint_metrics;
+
+  get_font_options (gsk_text_node_get_font (node), &hint_style, &antialias, &hint_metrics);
 
   /* medium and full are identical in the absence of subpixel modes */
   if (hint_style == CAIRO_HINT_STYLE_MEDIUM)
@@ -4553,6 +4661,9 @@ render_node_print (Printer       *p,
  * The intended use of this functions is testing, benchmarking and debugging.
  * The format is not meant as a permanent storage format.
  *
+ * The result is human-readable text. If that is not needed, consider
+ * gsk_render_node_serialize_binary(), which is a lot faster.
+ *
  * Returns: a `GBytes` representing the node.
  **/
 GBytes *
@@ -4585,3 +4696,2379 @@ gsk_render_node_serialize (GskRenderNode *node)
 
   return res;
 }
+
+/* The binary format starts with BINARY_MAGIC, followed by the format
+ * version and a byte order mark. Numbers are written in native byte
+ * order, data written on a machine with a different byte order is
+ * rejected.
+ *
+ * Nodes that occur more than once in the tree, textures, fonts, font
+ * faces and glyph runs are written the first time they are encountered
+ * and referred to by index after that. Textures with identical pixels
+ * are only written once, too. Texture data is written as raw pixels and
+ * aligned, so the deserialized textures can use it in place.
+ *
+ * GskRenderNodeEncoder writes a sequence of nodes without the header,
+ * keeping the tables between them. It remembers every node, so subtrees
+ * that a node shares with an earlier one are written as a reference.
+ */
+
+#define BINARY_MAGIC "\211GSK\r\n\032\n"
+#define BINARY_MAGIC_SIZE 8
+#define BINARY_VERSION 1
+#define BINARY_BYTE_ORDER_MARK 0x01020304
+#define BINARY_DATA_ALIGNMENT 16
+
+/* Tags in front of each node, higher values refer to a shared node */
+#define BINARY_NODE_INLINE 0
+#define BINARY_NODE_SHARED 1
+#define BINARY_NODE_REFERENCE 2
+
+/* Tags in front of each font face, higher values refer to a face */
+#define BINARY_FACE_SYSTEM 0
+#define BINARY_FACE_INLINE 1
+
+#define BINARY_TRANSFORM_IDENTITY 0
+#define BINARY_TRANSFORM_TRANSLATE 1
+#define BINARY_TRANSFORM_STRING 2
+
+#define BINARY_PATH_END 0xff
+
+typedef struct
+{
+  const PangoGlyphInfo *glyphs;
+  guint n_glyphs;
+} GlyphRun;
+
+static guint
+glyph_run_hash (gconstpointer data)
+{
+  const GlyphRun *run = data;
+  guint hash = run->n_glyphs;
+
+  for (guint i = 0; i < run->n_glyphs; i++)
+    {
+      hash = hash * 31 + run->glyphs[i].glyph;
+      hash = hash * 31 + run->glyphs[i].geometry.width;
+    }
+
+  return hash;
+}
+
+static gboolean
+glyph_run_equal (gconstpointer a,
+                 gconstpointer b)
+{
+  const GlyphRun *run1 = a;
+  const GlyphRun *run2 = b;
+
+  if (run1->n_glyphs != run2->n_glyphs)
+    return FALSE;
+
+  for (guint i = 0; i < run1->n_glyphs; i++)
+    {
+      const PangoGlyphInfo *gi1 = &run1->glyphs[i];
+      const PangoGlyphInfo *gi2 = &run2->glyphs[i];
+
+      if (gi1->glyph != gi2->glyph ||
+          gi1->geometry.width != gi2->geometry.width ||
+          gi1->geometry.x_offset != gi2->geometry.x_offset ||
+          gi1->geometry.y_offset != gi2->geometry.y_offset ||
+          gi1->attr.is_cluster_start != gi2->attr.is_cluster_start ||
+          gi1->attr.is_color != gi2->attr.is_color)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+typedef struct
+{
+  int width;
+  int height;
+  GdkMemoryFormat format;
+  gsize stride;
+  GBytes *bytes;
+} TextureContents;
+
+static guint
+texture_contents_hash (gconstpointer data)
+{
+  const TextureContents *contents = data;
+  guint hash = g_bytes_hash (contents->bytes);
+
+  hash = hash * 31 + contents->width;
+  hash = hash * 31 + contents->height;
+  hash = hash * 31 + contents->format;
+
+  return hash;
+}
+
+static gboolean
+texture_contents_equal (gconstpointer a,
+                        gconstpointer b)
+{
+  const TextureContents *contents1 = a;
+  const TextureContents *contents2 = b;
+
+  return contents1->width == contents2->width &&
+         contents1->height == contents2->height &&
+         contents1->format == contents2->format &&
+         contents1->stride == contents2->stride &&
+         g_bytes_equal (contents1->bytes, contents2->bytes);
+}
+
+static void
+texture_contents_free (gpointer data)
+{
+  TextureContents *contents = data;
+
+  g_bytes_unref (contents->bytes);
+  g_free (contents);
+}
+
+typedef struct
+{
+  Printer printer;
+  /* Remember every node, not just the ones used more than once */
+  gboolean remember_all;
+  /* These map objects to their index + 1 and hold a reference on them */
+  GHashTable *nodes;
+  GHashTable *textures;
+  GHashTable *texture_contents;
+  GHashTable *faces;
+  GHashTable *fonts;
+  GHashTable *glyph_runs;
+  guint n_textures;
+} BinaryPrinter;
+
+static void
+binary_printer_init (BinaryPrinter *self,
+                     GskRenderNode *node)
+{
+  printer_init (&self->printer, node);
+
+  self->remember_all = FALSE;
+  self->nodes = g_hash_table_new_full (NULL, NULL, (GDestroyNotify) gsk_render_node_unref, NULL);
+  self->textures = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+  self->texture_contents = g_hash_table_new_full (texture_contents_hash, texture_contents_equal, texture_contents_free, NULL);
+  /* faces are owned by printer.fonts */
+  self->faces = g_hash_table_new (NULL, NULL);
+  self->fonts = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+  /* glyph runs point into text nodes, which are kept alive by the caller
+   * or by self->nodes */
+  self->glyph_runs = g_hash_table_new_full (glyph_run_hash, glyph_run_equal, g_free, NULL);
+  self->n_textures = 0;
+}
+
+static void
+binary_printer_clear (BinaryPrinter *self)
+{
+  g_hash_table_unref (self->glyph_runs);
+  g_hash_table_unref (self->faces);
+  g_hash_table_unref (self->fonts);
+  g_hash_table_unref (self->texture_contents);
+  g_hash_table_unref (self->textures);
+  g_hash_table_unref (self->nodes);
+
+  printer_clear (&self->printer);
+}
+
+static guint
+binary_printer_lookup (GHashTable    *table,
+                       gconstpointer  key)
+{
+  return GPOINTER_TO_UINT (g_hash_table_lookup (table, key));
+}
+
+static void
+binary_printer_remember (GHashTable *table,
+                         gpointer    key)
+{
+  g_hash_table_insert (table, key, GUINT_TO_POINTER (g_hash_table_size (table) + 1));
+}
+
+static void
+binary_append_uint (GString *str,
+                    guint32  value)
+{
+  g_string_append_len (str, (const char *) &value, sizeof (value));
+}
+
+static void
+binary_append_int (GString *str,
+                   gint32   value)
+{
+  g_string_append_len (str, (const char *) &value, sizeof (value));
+}
+
+static void
+binary_append_byte (GString *str,
+                    guint8   value)
+{
+  g_string_append_c (str, value);
+}
+
+static void
+binary_append_float (GString *str,
+                     float    value)
+{
+  g_string_append_len (str, (const char *) &value, sizeof (value));
+}
+
+static void
+binary_append_floats (GString     *str,
+                      const float *values,
+                      gsize        n_values)
+{
+  g_string_append_len (str, (const char *) values, n_values * sizeof (float));
+}
+
+static void
+binary_append_point (GString                *str,
+                     const graphene_point_t *point)
+{
+  binary_append_float (str, point->x);
+  binary_append_float (str, point->y);
+}
+
+static void
+binary_append_rect (GString               *str,
+                    const graphene_rect_t *rect)
+{
+  binary_append_float (str, rect->origin.x);
+  binary_append_float (str, rect->origin.y);
+  binary_append_float (str, rect->size.width);
+  binary_append_float (str, rect->size.height);
+}
+
+static void
+binary_append_rounded_rect (GString              *str,
+                            const GskRoundedRect *rect)
+{
+  binary_append_rect (str, &rect->bounds);
+  for (guint i = 0; i < 4; i++)
+    {
+      binary_append_float (str, rect->corner[i].width);
+      binary_append_float (str, rect->corner[i].height);
+    }
+}
+
+static void
+binary_append_rgba (GString       *str,
+                    const GdkRGBA *rgba)
+{
+  binary_append_float (str, rgba->red);
+  binary_append_float (str, rgba->green);
+  binary_append_float (str, rgba->blue);
+  binary_append_float (str, rgba->alpha);
+}
+
+static void
+binary_append_string (GString    *str,
+                      const char *string)
+{
+  gsize len;
+
+  if (string == NULL)
+    {
+      binary_append_uint (str, 0);
+      return;
+    }
+
+  len = strlen (string);
+  binary_append_uint (str, len + 1);
+  g_string_append_len (str, string, len);
+}
+
+static void
+binary_append_data (GString       *str,
+                    gconstpointer  data,
+                    gsize          size)
+{
+  binary_append_uint (str, size);
+  while (str->len % BINARY_DATA_ALIGNMENT)
+    g_string_append_c (str, 0);
+  g_string_append_len (str, data, size);
+}
+
+static void
+binary_append_bytes (GString *str,
+                     GBytes  *bytes)
+{
+  gsize size;
+  gconstpointer data;
+
+  data = g_bytes_get_data (bytes, &size);
+  binary_append_data (str, data, size);
+}
+
+static void
+binary_append_stops (GString            *str,
+                     const GskColorStop *stops,
+                     gsize               n_stops)
+{
+  binary_append_uint (str, n_stops);
+  for (gsize i = 0; i < n_stops; i++)
+    {
+      binary_append_float (str, stops[i].offset);
+      binary_append_rgba (str, &stops[i].color);
+    }
+}
+
+static gboolean
+binary_append_path_op (GskPathOperation        op,
+                       const graphene_point_t *pts,
+                       gsize                   n_pts,
+                       float                   weight,
+                       gpointer                user_data)
+{
+  GString *str = user_data;
+
+  binary_append_byte (str, op);
+
+  switch (op)
+    {
+    case GSK_PATH_MOVE:
+      binary_append_point (str, &pts[0]);
+      break;
+
+    case GSK_PATH_CLOSE:
+      break;
+
+    case GSK_PATH_LINE:
+    case GSK_PATH_QUAD:
+    case GSK_PATH_CUBIC:
+      for (gsize i = 1; i < n_pts; i++)
+        binary_append_point (str, &pts[i]);
+      break;
+
+    case GSK_PATH_CONIC:
+      binary_append_point (str, &pts[1]);
+      binary_append_point (str, &pts[2]);
+      binary_append_float (str, weight);
+      break;
+
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+
+  return TRUE;
+}
+
+static void
+binary_append_path (GString *str,
+                    GskPath *path)
+{
+  gsk_path_foreach (path,
+                    GSK_PATH_FOREACH_ALLOW_QUAD | GSK_PATH_FOREACH_ALLOW_CUBIC | GSK_PATH_FOREACH_ALLOW_CONIC,
+                    binary_append_path_op,
+                    str);
+  binary_append_byte (str, BINARY_PATH_END);
+}
+
+static void
+binary_append_transform (GString      *str,
+                         GskTransform *transform)
+{
+  float dx, dy;
+  char *s;
+
+  if (gsk_transform_get_category (transform) == GSK_TRANSFORM_CATEGORY_IDENTITY)
+    {
+      binary_append_byte (str, BINARY_TRANSFORM_IDENTITY);
+    }
+  else if (gsk_transform_get_category (transform) == GSK_TRANSFORM_CATEGORY_2D_TRANSLATE &&
+           transform->next == NULL)
+    {
+      gsk_transform_to_translate (transform, &dx, &dy);
+      binary_append_byte (str, BINARY_TRANSFORM_TRANSLATE);
+      binary_append_float (str, dx);
+      binary_append_float (str, dy);
+    }
+  else
+    {
+      /* Keep the individual steps, like the text format does */
+      s = gsk_transform_to_string (transform);
+      binary_append_byte (str, BINARY_TRANSFORM_STRING);
+      binary_append_string (str, s);
+      g_free (s);
+    }
+}
+
+typedef struct
+{
+  GdkTexture *texture;
+  TextureContents *contents;
+} TextureDownload;
+
+/* GL and dmabuf textures can only be downloaded on the main thread
+ * when the encoder runs on a different one.
+ */
+static gboolean
+binary_printer_download_texture (gpointer data)
+{
+  TextureDownload *download = data;
+  GdkTextureDownloader *downloader;
+
+  downloader = gdk_texture_downloader_new (download->texture);
+  gdk_texture_downloader_set_format (downloader, download->contents->format);
+  download->contents->bytes = gdk_texture_downloader_download_bytes (downloader, &download->contents->stride);
+  gdk_texture_downloader_free (downloader);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+binary_printer_append_texture (BinaryPrinter *self,
+                               GdkTexture    *texture)
+{
+  GString *str = self->printer.str;
+  TextureContents *contents;
+  guint index;
+
+  index = binary_printer_lookup (self->textures, texture);
+  if (index)
+    {
+      binary_append_uint (str, index);
+      return;
+    }
+
+  contents = g_new (TextureContents, 1);
+  contents->width = gdk_texture_get_width (texture);
+  contents->height = gdk_texture_get_height (texture);
+  contents->format = gdk_texture_get_format (texture);
+
+  if (GDK_IS_MEMORY_TEXTURE (texture))
+    {
+      contents->bytes = g_bytes_ref (gdk_memory_texture_get_bytes (GDK_MEMORY_TEXTURE (texture), &contents->stride));
+    }
+  else
+    {
+      TextureDownload download = { texture, contents };
+
+      gdk_main_thread_invoke (binary_printer_download_texture, &download);
+    }
+
+  /* A different texture with the same pixels was written already */
+  index = binary_printer_lookup (self->texture_contents, contents);
+  if (index)
+    {
+      binary_append_uint (str, index);
+      g_hash_table_insert (self->textures, g_object_ref (texture), GUINT_TO_POINTER (index));
+      texture_contents_free (contents);
+      return;
+    }
+
+  binary_append_uint (str, 0);
+  binary_append_uint (str, contents->width);
+  binary_append_uint (str, contents->height);
+  binary_append_uint (str, contents->format);
+  binary_append_uint (str, contents->stride);
+  binary_append_bytes (str, contents->bytes);
+
+  index = ++self->n_textures;
+  g_hash_table_insert (self->textures, g_object_ref (texture), GUINT_TO_POINTER (index));
+  g_hash_table_insert (self->texture_contents, contents, GUINT_TO_POINTER (index));
+}
+
+typedef struct
+{
+  Printer *printer;
+  PangoFont *font;
+  FontInfo *info;
+  char *desc;
+  cairo_hint_style_t hint_style;
+  cairo_antialias_t antialias;
+  cairo_hint_metrics_t hint_metrics;
+} FontQuery;
+
+/* Pango is not threadsafe, so when the encoder runs on a different
+ * thread, everything we need to know about a font is looked up on the
+ * main thread in one go.
+ */
+static gboolean
+binary_printer_query_font (gpointer data)
+{
+  FontQuery *query = data;
+  PangoFontDescription *desc;
+  hb_face_t *face;
+
+  face = hb_font_get_face (pango_font_get_hb_font (query->font));
+
+  query->info = g_hash_table_lookup (query->printer->fonts, face);
+  if (query->info == NULL)
+    {
+      /* Encoders don't collect fonts up front, and don't subset them */
+      query->info = g_new0 (FontInfo, 1);
+      query->info->face = hb_face_reference (face);
+      query->info->serialized = g_object_get_data (G_OBJECT (pango_font_get_font_map (query->font)), "font-files") == NULL;
+      g_hash_table_insert (query->printer->fonts, query->info->face, query->info);
+    }
+
+  desc = pango_font_describe_with_absolute_size (query->font);
+  query->desc = pango_font_description_to_string (desc);
+  pango_font_description_free (desc);
+
+  get_font_options (query->font, &query->hint_style, &query->antialias, &query->hint_metrics);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+binary_printer_append_face (BinaryPrinter *self,
+                            FontInfo      *info)
+{
+  GString *str = self->printer.str;
+  hb_face_t *face;
+  hb_blob_t *blob;
+  const char *data;
+  guint length;
+  guint index;
+
+  index = binary_printer_lookup (self->faces, info->face);
+  if (index)
+    {
+      binary_append_uint (str, BINARY_FACE_INLINE + index);
+      return;
+    }
+
+  if (info->serialized)
+    {
+      binary_append_uint (str, BINARY_FACE_SYSTEM);
+      return;
+    }
+
+  if (info->input)
+    face = hb_subset_or_fail (info->face, info->input);
+  else
+    face = hb_face_reference (info->face);
+
+  blob = hb_face_reference_blob (face);
+  data = hb_blob_get_data (blob, &length);
+
+  binary_append_uint (str, BINARY_FACE_INLINE);
+  binary_append_data (str, data, length);
+
+  hb_blob_destroy (blob);
+  hb_face_destroy (face);
+
+  info->serialized = TRUE;
+  binary_printer_remember (self->faces, info->face);
+}
+
+static void
+binary_printer_append_font (BinaryPrinter *self,
+                            PangoFont     *font)
+{
+  GString *str = self->printer.str;
+  FontQuery query = { &self->printer, font, };
+  guint index;
+
+  index = binary_printer_lookup (self->fonts, font);
+  if (index)
+    {
+      binary_append_uint (str, index);
+      return;
+    }
+
+  gdk_main_thread_invoke (binary_printer_query_font, &query);
+
+  binary_append_uint (str, 0);
+  binary_printer_append_face (self, query.info);
+
+  binary_append_string (str, query.desc);
+  g_free (query.desc);
+
+  binary_append_byte (str, query.hint_style);
+  binary_append_byte (str, query.antialias);
+  binary_append_byte (str, query.hint_metrics);
+
+  binary_printer_remember (self->fonts, g_object_ref (font));
+}
+
+static void
+binary_printer_append_glyphs (BinaryPrinter *self,
+                              GskRenderNode *node)
+{
+  GString *str = self->printer.str;
+  GlyphRun run;
+  guint index;
+
+  run.glyphs = gsk_text_node_get_glyphs (node, &run.n_glyphs);
+
+  index = binary_printer_lookup (self->glyph_runs, &run);
+  if (index)
+    {
+      binary_append_uint (str, index);
+      return;
+    }
+
+  binary_append_uint (str, 0);
+  binary_append_uint (str, run.n_glyphs);
+  for (guint i = 0; i < run.n_glyphs; i++)
+    {
+      const PangoGlyphInfo *gi = &run.glyphs[i];
+
+      binary_append_uint (str, gi->glyph);
+      binary_append_int (str, gi->geometry.width);
+      binary_append_int (str, gi->geometry.x_offset);
+      binary_append_int (str, gi->geometry.y_offset);
+      binary_append_byte (str, gi->attr.is_cluster_start | (gi->attr.is_color << 1));
+    }
+
+  binary_printer_remember (self->glyph_runs, g_memdup2 (&run, sizeof (GlyphRun)));
+}
+
+static void
+binary_printer_append_node (BinaryPrinter *self,
+                            GskRenderNode *node)
+{
+  GString *str = self->printer.str;
+  gboolean shared;
+  guint index;
+
+  index = binary_printer_lookup (self->nodes, node);
+  if (index)
+    {
+      binary_append_uint (str, BINARY_NODE_REFERENCE + index - 1);
+      return;
+    }
+
+  /* The printer gives a name to every node that is used more than once */
+  shared = self->remember_all || g_hash_table_lookup (self->printer.named_nodes, node) != NULL;
+  binary_append_uint (str, shared ? BINARY_NODE_SHARED : BINARY_NODE_INLINE);
+  binary_append_byte (str, gsk_render_node_get_node_type (node));
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      binary_append_uint (str, gsk_container_node_get_n_children (node));
+      for (guint i = 0; i < gsk_container_node_get_n_children (node); i++)
+        binary_printer_append_node (self, gsk_container_node_get_child (node, i));
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        cairo_surface_t *surface = gsk_cairo_node_get_surface (node);
+
+        binary_append_rect (str, &node->bounds);
+        if (surface != NULL)
+          {
+            GByteArray *array = g_byte_array_new ();
+
+            cairo_surface_write_to_png_stream (surface, cairo_write_array, array);
+            binary_append_data (str, array->data, array->len);
+            g_byte_array_free (array, TRUE);
+          }
+        else
+          {
+            binary_append_data (str, NULL, 0);
+          }
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      binary_append_rect (str, &node->bounds);
+      binary_append_rgba (str, gsk_color_node_get_color (node));
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      binary_append_rect (str, &node->bounds);
+      binary_append_point (str, gsk_linear_gradient_node_get_start (node));
+      binary_append_point (str, gsk_linear_gradient_node_get_end (node));
+      binary_append_stops (str, gsk_linear_gradient_node_get_color_stops (node, NULL),
+                                gsk_linear_gradient_node_get_n_color_stops (node));
+      break;
+
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+      binary_append_rect (str, &node->bounds);
+      binary_append_point (str, gsk_radial_gradient_node_get_center (node));
+      binary_append_float (str, gsk_radial_gradient_node_get_hradius (node));
+      binary_append_float (str, gsk_radial_gradient_node_get_vradius (node));
+      binary_append_float (str, gsk_radial_gradient_node_get_start (node));
+      binary_append_float (str, gsk_radial_gradient_node_get_end (node));
+      binary_append_stops (str, gsk_radial_gradient_node_get_color_stops (node, NULL),
+                                gsk_radial_gradient_node_get_n_color_stops (node));
+      break;
+
+    case GSK_CONIC_GRADIENT_NODE:
+      binary_append_rect (str, &node->bounds);
+      binary_append_point (str, gsk_conic_gradient_node_get_center (node));
+      binary_append_float (str, gsk_conic_gradient_node_get_rotation (node));
+      binary_append_stops (str, gsk_conic_gradient_node_get_color_stops (node, NULL),
+                                gsk_conic_gradient_node_get_n_color_stops (node));
+      break;
+
+    case GSK_BORDER_NODE:
+      {
+        const GdkRGBA *colors = gsk_border_node_get_colors (node);
+
+        binary_append_rounded_rect (str, gsk_border_node_get_outline (node));
+        binary_append_floats (str, gsk_border_node_get_widths (node), 4);
+        for (guint i = 0; i < 4; i++)
+          binary_append_rgba (str, &colors[i]);
+      }
+      break;
+
+    case GSK_TEXTURE_NODE:
+      binary_append_rect (str, &node->bounds);
+      binary_printer_append_texture (self, gsk_texture_node_get_texture (node));
+      break;
+
+    case GSK_TEXTURE_SCALE_NODE:
+      binary_append_rect (str, &node->bounds);
+      binary_printer_append_texture (self, gsk_texture_scale_node_get_texture (node));
+      binary_append_byte (str, gsk_texture_scale_node_get_filter (node));
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+      binary_append_rounded_rect (str, gsk_inset_shadow_node_get_outline (node));
+      binary_append_rgba (str, gsk_inset_shadow_node_get_color (node));
+      binary_append_float (str, gsk_inset_shadow_node_get_dx (node));
+      binary_append_float (str, gsk_inset_shadow_node_get_dy (node));
+      binary_append_float (str, gsk_inset_shadow_node_get_spread (node));
+      binary_append_float (str, gsk_inset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_OUTSET_SHADOW_NODE:
+      binary_append_rounded_rect (str, gsk_outset_shadow_node_get_outline (node));
+      binary_append_rgba (str, gsk_outset_shadow_node_get_color (node));
+      binary_append_float (str, gsk_outset_shadow_node_get_dx (node));
+      binary_append_float (str, gsk_outset_shadow_node_get_dy (node));
+      binary_append_float (str, gsk_outset_shadow_node_get_spread (node));
+      binary_append_float (str, gsk_outset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      binary_append_transform (str, gsk_transform_node_get_transform (node));
+      binary_printer_append_node (self, gsk_transform_node_get_child (node));
+      break;
+
+    case GSK_OPACITY_NODE:
+      binary_append_float (str, gsk_opacity_node_get_opacity (node));
+      binary_printer_append_node (self, gsk_opacity_node_get_child (node));
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        float matrix[16], offset[4];
+
+        graphene_matrix_to_float (gsk_color_matrix_node_get_color_matrix (node), matrix);
+        graphene_vec4_to_float (gsk_color_matrix_node_get_color_offset (node), offset);
+        binary_append_floats (str, matrix, 16);
+        binary_append_floats (str, offset, 4);
+        binary_printer_append_node (self, gsk_color_matrix_node_get_child (node));
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      binary_append_rect (str, &node->bounds);
+      binary_append_rect (str, gsk_repeat_node_get_child_bounds (node));
+      binary_printer_append_node (self, gsk_repeat_node_get_child (node));
+      break;
+
+    case GSK_CLIP_NODE:
+      binary_append_rect (str, gsk_clip_node_get_clip (node));
+      binary_printer_append_node (self, gsk_clip_node_get_child (node));
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      binary_append_rounded_rect (str, gsk_rounded_clip_node_get_clip (node));
+      binary_printer_append_node (self, gsk_rounded_clip_node_get_child (node));
+      break;
+
+    case GSK_SHADOW_NODE:
+      binary_append_uint (str, gsk_shadow_node_get_n_shadows (node));
+      for (gsize i = 0; i < gsk_shadow_node_get_n_shadows (node); i++)
+        {
+          const GskShadow *shadow = gsk_shadow_node_get_shadow (node, i);
+
+          binary_append_rgba (str, &shadow->color);
+          binary_append_float (str, shadow->dx);
+          binary_append_float (str, shadow->dy);
+          binary_append_float (str, shadow->radius);
+        }
+      binary_printer_append_node (self, gsk_shadow_node_get_child (node));
+      break;
+
+    case GSK_BLEND_NODE:
+      binary_append_byte (str, gsk_blend_node_get_blend_mode (node));
+      binary_printer_append_node (self, gsk_blend_node_get_bottom_child (node));
+      binary_printer_append_node (self, gsk_blend_node_get_top_child (node));
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      binary_append_float (str, gsk_cross_fade_node_get_progress (node));
+      binary_printer_append_node (self, gsk_cross_fade_node_get_start_child (node));
+      binary_printer_append_node (self, gsk_cross_fade_node_get_end_child (node));
+      break;
+
+    case GSK_TEXT_NODE:
+      binary_printer_append_font (self, gsk_text_node_get_font (node));
+      binary_printer_append_glyphs (self, node);
+      binary_append_rgba (str, gsk_text_node_get_color (node));
+      binary_append_point (str, gsk_text_node_get_offset (node));
+      break;
+
+    case GSK_BLUR_NODE:
+      binary_append_float (str, gsk_blur_node_get_radius (node));
+      binary_printer_append_node (self, gsk_blur_node_get_child (node));
+      break;
+
+    case GSK_DEBUG_NODE:
+      binary_append_string (str, gsk_debug_node_get_message (node));
+      binary_printer_append_node (self, gsk_debug_node_get_child (node));
+      break;
+
+    case GSK_GL_SHADER_NODE:
+      binary_append_rect (str, &node->bounds);
+      binary_append_bytes (str, gsk_gl_shader_get_source (gsk_gl_shader_node_get_shader (node)));
+      binary_append_bytes (str, gsk_gl_shader_node_get_args (node));
+      binary_append_uint (str, gsk_gl_shader_node_get_n_children (node));
+      for (guint i = 0; i < gsk_gl_shader_node_get_n_children (node); i++)
+        binary_printer_append_node (self, gsk_gl_shader_node_get_child (node, i));
+      break;
+
+    case GSK_MASK_NODE:
+      binary_append_byte (str, gsk_mask_node_get_mask_mode (node));
+      binary_printer_append_node (self, gsk_mask_node_get_source (node));
+      binary_printer_append_node (self, gsk_mask_node_get_mask (node));
+      break;
+
+    case GSK_FILL_NODE:
+      binary_append_path (str, gsk_fill_node_get_path (node));
+      binary_append_byte (str, gsk_fill_node_get_fill_rule (node));
+      binary_printer_append_node (self, gsk_fill_node_get_child (node));
+      break;
+
+    case GSK_STROKE_NODE:
+      {
+        const GskStroke *stroke = gsk_stroke_node_get_stroke (node);
+        const float *dash;
+        gsize n_dash;
+
+        binary_append_path (str, gsk_stroke_node_get_path (node));
+        binary_append_float (str, gsk_stroke_get_line_width (stroke));
+        binary_append_byte (str, gsk_stroke_get_line_cap (stroke));
+        binary_append_byte (str, gsk_stroke_get_line_join (stroke));
+        binary_append_float (str, gsk_stroke_get_miter_limit (stroke));
+        dash = gsk_stroke_get_dash (stroke, &n_dash);
+        binary_append_uint (str, n_dash);
+        binary_append_floats (str, dash, n_dash);
+        binary_append_float (str, gsk_stroke_get_dash_offset (stroke));
+        binary_printer_append_node (self, gsk_stroke_node_get_child (node));
+      }
+      break;
+
+    case GSK_SUBSURFACE_NODE:
+      binary_printer_append_node (self, gsk_subsurface_node_get_child (node));
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_error ("Unhandled node: %s", g_type_name_from_instance ((GTypeInstance *) node));
+      break;
+    }
+
+  if (shared)
+    binary_printer_remember (self->nodes, gsk_render_node_ref (node));
+}
+
+/**
+ * gsk_render_node_serialize_binary:
+ * @node: a `GskRenderNode`
+ *
+ * Serializes the @node into a binary format for later deserialization
+ * via gsk_render_node_deserialize(), which detects the format
+ * automatically.
+ *
+ * Compared to gsk_render_node_serialize(), the binary format is much
+ * faster to write and to read and more compact for large trees, because
+ * nodes, textures, fonts and glyphs that are used multiple times are
+ * only written once. It is not human-readable.
+ *
+ * The same restrictions as for gsk_render_node_serialize() apply: The
+ * result can only be deserialized by the same version of GTK. It can
+ * also only be deserialized on a machine with the same byte order.
+ *
+ * Returns: a `GBytes` representing the node.
+ *
+ * Since: 4.16
+ **/
+GBytes *
+gsk_render_node_serialize_binary (GskRenderNode *node)
+{
+  BinaryPrinter self;
+  GBytes *res;
+
+  g_return_val_if_fail (GSK_IS_RENDER_NODE (node), NULL);
+
+  binary_printer_init (&self, node);
+
+  g_string_append_len (self.printer.str, BINARY_MAGIC, BINARY_MAGIC_SIZE);
+  binary_append_uint (self.printer.str, BINARY_VERSION);
+  binary_append_uint (self.printer.str, BINARY_BYTE_ORDER_MARK);
+
+  binary_printer_append_node (&self, node);
+
+  res = g_string_free_to_bytes (g_steal_pointer (&self.printer.str));
+
+  binary_printer_clear (&self);
+
+  return res;
+}
+
+typedef struct
+{
+  GBytes *bytes;
+  const guchar *data;
+  gsize size;
+  gsize pos;
+  GError *error;
+  gsize error_pos;
+  Context context;
+  GPtrArray *nodes;
+  GPtrArray *textures;
+  GPtrArray *fonts;
+  GPtrArray *glyph_runs;
+  guint n_faces;
+} BinaryReader;
+
+static void
+binary_reader_init (BinaryReader *self,
+                    GBytes       *bytes)
+{
+  memset (self, 0, sizeof (BinaryReader));
+
+  if (bytes)
+    {
+      self->bytes = g_bytes_ref (bytes);
+      self->data = g_bytes_get_data (bytes, &self->size);
+      self->pos = BINARY_MAGIC_SIZE;
+    }
+  context_init (&self->context);
+  self->nodes = g_ptr_array_new_with_free_func ((GDestroyNotify) gsk_render_node_unref);
+  self->textures = g_ptr_array_new_with_free_func (g_object_unref);
+  self->fonts = g_ptr_array_new_with_free_func (g_object_unref);
+  self->glyph_runs = g_ptr_array_new_with_free_func ((GDestroyNotify) pango_glyph_string_free);
+}
+
+static void
+binary_reader_finish (BinaryReader *self)
+{
+  g_ptr_array_unref (self->nodes);
+  g_ptr_array_unref (self->textures);
+  g_ptr_array_unref (self->fonts);
+  g_ptr_array_unref (self->glyph_runs);
+  context_finish (&self->context);
+  g_clear_error (&self->error);
+  g_clear_pointer (&self->bytes, g_bytes_unref);
+}
+
+static void
+binary_reader_take_error (BinaryReader *self,
+                          GError       *error)
+{
+  if (self->error)
+    {
+      g_error_free (error);
+      return;
+    }
+
+  self->error = error;
+  self->error_pos = self->pos;
+}
+
+static void
+binary_reader_error (BinaryReader *self,
+                     const char   *format,
+                     ...) G_GNUC_PRINTF (2, 3);
+
+static void
+binary_reader_error (BinaryReader *self,
+                     const char   *format,
+                     ...)
+{
+  va_list args;
+
+  if (self->error)
+    return;
+
+  va_start (args, format);
+  binary_reader_take_error (self,
+                            g_error_new_valist (GTK_CSS_PARSER_ERROR,
+                                                GTK_CSS_PARSER_ERROR_FAILED,
+                                                format, args));
+  va_end (args);
+}
+
+static gboolean
+binary_reader_has (BinaryReader *self,
+                   gsize         size)
+{
+  if (self->error)
+    return FALSE;
+
+  if (size > self->size - self->pos)
+    {
+      binary_reader_error (self, "Unexpected end of data");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static guint32
+binary_reader_read_uint (BinaryReader *self)
+{
+  guint32 value;
+
+  if (!binary_reader_has (self, sizeof (value)))
+    return 0;
+
+  memcpy (&value, self->data + self->pos, sizeof (value));
+  self->pos += sizeof (value);
+
+  return value;
+}
+
+static gint32
+binary_reader_read_int (BinaryReader *self)
+{
+  return (gint32) binary_reader_read_uint (self);
+}
+
+static guint8
+binary_reader_read_byte (BinaryReader *self)
+{
+  if (!binary_reader_has (self, 1))
+    return 0;
+
+  return self->data[self->pos++];
+}
+
+static guint
+binary_reader_read_enum (BinaryReader *self,
+                         guint         max)
+{
+  guint value = binary_reader_read_byte (self);
+
+  if (value > max)
+    {
+      binary_reader_error (self, "Invalid enum value %u", value);
+      return 0;
+    }
+
+  return value;
+}
+
+static float
+binary_reader_read_float (BinaryReader *self)
+{
+  float value;
+
+  if (!binary_reader_has (self, sizeof (value)))
+    return 0;
+
+  memcpy (&value, self->data + self->pos, sizeof (value));
+  self->pos += sizeof (value);
+
+  return value;
+}
+
+static void
+binary_reader_read_floats (BinaryReader *self,
+                           float        *values,
+                           gsize         n_values)
+{
+  if (!binary_reader_has (self, n_values * sizeof (float)))
+    {
+      memset (values, 0, n_values * sizeof (float));
+      return;
+    }
+
+  memcpy (values, self->data + self->pos, n_values * sizeof (float));
+  self->pos += n_values * sizeof (float);
+}
+
+/* Reads the number of elements that follow and checks that they fit */
+static gsize
+binary_reader_read_count (BinaryReader *self,
+                          gsize         element_size)
+{
+  guint32 n = binary_reader_read_uint (self);
+
+  if (self->error)
+    return 0;
+
+  if (n > (self->size - self->pos) / element_size)
+    {
+      binary_reader_error (self, "Unexpected end of data");
+      return 0;
+    }
+
+  return n;
+}
+
+static void
+binary_reader_read_point (BinaryReader     *self,
+                          graphene_point_t *point)
+{
+  point->x = binary_reader_read_float (self);
+  point->y = binary_reader_read_float (self);
+}
+
+static void
+binary_reader_read_rect (BinaryReader    *self,
+                         graphene_rect_t *rect)
+{
+  rect->origin.x = binary_reader_read_float (self);
+  rect->origin.y = binary_reader_read_float (self);
+  rect->size.width = binary_reader_read_float (self);
+  rect->size.height = binary_reader_read_float (self);
+}
+
+static void
+binary_reader_read_rounded_rect (BinaryReader   *self,
+                                 GskRoundedRect *rect)
+{
+  binary_reader_read_rect (self, &rect->bounds);
+  for (guint i = 0; i < 4; i++)
+    {
+      rect->corner[i].width = binary_reader_read_float (self);
+      rect->corner[i].height = binary_reader_read_float (self);
+    }
+}
+
+static void
+binary_reader_read_rgba (BinaryReader *self,
+                         GdkRGBA      *rgba)
+{
+  rgba->red = binary_reader_read_float (self);
+  rgba->green = binary_reader_read_float (self);
+  rgba->blue = binary_reader_read_float (self);
+  rgba->alpha = binary_reader_read_float (self);
+}
+
+static char *
+binary_reader_read_string (BinaryReader *self)
+{
+  guint32 len;
+  char *s;
+
+  len = binary_reader_read_uint (self);
+  if (len == 0 || !binary_reader_has (self, len - 1))
+    return NULL;
+
+  s = g_strndup ((const char *) self->data + self->pos, len - 1);
+  self->pos += len - 1;
+
+  return s;
+}
+
+/* Returns a slice of the input, without copying it */
+static GBytes *
+binary_reader_read_bytes (BinaryReader *self)
+{
+  guint32 size;
+  gsize pos;
+  GBytes *bytes;
+
+  size = binary_reader_read_uint (self);
+  if (self->error)
+    return NULL;
+
+  pos = (self->pos + BINARY_DATA_ALIGNMENT - 1) & ~((gsize) BINARY_DATA_ALIGNMENT - 1);
+  if (pos > self->size)
+    {
+      binary_reader_error (self, "Unexpected end of data");
+      return NULL;
+    }
+  self->pos = pos;
+
+  if (!binary_reader_has (self, size))
+    return NULL;
+
+  bytes = g_bytes_new_from_bytes (self->bytes, self->pos, size);
+  self->pos += size;
+
+  return bytes;
+}
+
+static GskColorStop *
+binary_reader_read_stops (BinaryReader *self,
+                          gsize        *out_n_stops)
+{
+  GskColorStop *stops;
+  gsize i, n;
+
+  *out_n_stops = 0;
+
+  n = binary_reader_read_count (self, 5 * sizeof (float));
+  if (self->error)
+    return NULL;
+
+  if (n < 2)
+    {
+      binary_reader_error (self, "Gradients need at least 2 color stops");
+      return NULL;
+    }
+
+  stops = g_new (GskColorStop, n);
+  for (i = 0; i < n; i++)
+    {
+      stops[i].offset = binary_reader_read_float (self);
+      binary_reader_read_rgba (self, &stops[i].color);
+
+      if (stops[i].offset < (i > 0 ? stops[i - 1].offset : 0) ||
+          stops[i].offset > 1)
+        binary_reader_error (self, "Color stop offsets must be increasing and between 0 and 1");
+    }
+
+  *out_n_stops = n;
+
+  return stops;
+}
+
+static GskPath *
+binary_reader_read_path (BinaryReader *self)
+{
+  GskPathBuilder *builder;
+  graphene_point_t pts[3];
+  float weight;
+  guint8 op;
+
+  builder = gsk_path_builder_new ();
+
+  while (TRUE)
+    {
+      op = binary_reader_read_byte (self);
+      if (self->error || op == BINARY_PATH_END)
+        break;
+
+      switch (op)
+        {
+        case GSK_PATH_MOVE:
+          binary_reader_read_point (self, &pts[0]);
+          gsk_path_builder_move_to (builder, pts[0].x, pts[0].y);
+          break;
+
+        case GSK_PATH_CLOSE:
+          gsk_path_builder_close (builder);
+          break;
+
+        case GSK_PATH_LINE:
+          binary_reader_read_point (self, &pts[0]);
+          gsk_path_builder_line_to (builder, pts[0].x, pts[0].y);
+          break;
+
+        case GSK_PATH_QUAD:
+          binary_reader_read_point (self, &pts[0]);
+          binary_reader_read_point (self, &pts[1]);
+          gsk_path_builder_quad_to (builder, pts[0].x, pts[0].y, pts[1].x, pts[1].y);
+          break;
+
+        case GSK_PATH_CUBIC:
+          binary_reader_read_point (self, &pts[0]);
+          binary_reader_read_point (self, &pts[1]);
+          binary_reader_read_point (self, &pts[2]);
+          gsk_path_builder_cubic_to (builder,
+                                     pts[0].x, pts[0].y,
+                                     pts[1].x, pts[1].y,
+                                     pts[2].x, pts[2].y);
+          break;
+
+        case GSK_PATH_CONIC:
+          binary_reader_read_point (self, &pts[0]);
+          binary_reader_read_point (self, &pts[1]);
+          weight = binary_reader_read_float (self);
+          if (weight > 0)
+            gsk_path_builder_conic_to (builder, pts[0].x, pts[0].y, pts[1].x, pts[1].y, weight);
+          else
+            binary_reader_error (self, "Conic weight must be positive");
+          break;
+
+        default:
+          binary_reader_error (self, "Invalid path operation %u", op);
+          break;
+        }
+    }
+
+  return gsk_path_builder_free_to_path (builder);
+}
+
+static GskTransform *
+binary_reader_read_transform (BinaryReader *self)
+{
+  GskTransform *transform = NULL;
+  graphene_point_t offset;
+  char *s;
+
+  switch (binary_reader_read_byte (self))
+    {
+    case BINARY_TRANSFORM_IDENTITY:
+      break;
+
+    case BINARY_TRANSFORM_TRANSLATE:
+      binary_reader_read_point (self, &offset);
+      transform = gsk_transform_translate (NULL, &offset);
+      break;
+
+    case BINARY_TRANSFORM_STRING:
+      s = binary_reader_read_string (self);
+      if (s == NULL || !gsk_transform_parse (s, &transform))
+        binary_reader_error (self, "Invalid transform");
+      g_free (s);
+      break;
+
+    default:
+      binary_reader_error (self, "Invalid transform");
+      break;
+    }
+
+  return transform;
+}
+
+/* Returns a new reference */
+static GdkTexture *
+binary_reader_read_texture (BinaryReader *self)
+{
+  GdkTexture *texture;
+  GBytes *bytes;
+  guint32 tag, width, height, format, stride;
+  gsize bpp;
+
+  tag = binary_reader_read_uint (self);
+  if (self->error)
+    return NULL;
+
+  if (tag > 0)
+    {
+      if (tag > self->textures->len)
+        {
+          binary_reader_error (self, "Invalid texture reference %u", tag);
+          return NULL;
+        }
+
+      return g_object_ref (g_ptr_array_index (self->textures, tag - 1));
+    }
+
+  width = binary_reader_read_uint (self);
+  height = binary_reader_read_uint (self);
+  format = binary_reader_read_uint (self);
+  stride = binary_reader_read_uint (self);
+  bytes = binary_reader_read_bytes (self);
+  if (bytes == NULL)
+    return NULL;
+
+  if (width == 0 || height == 0 || format >= GDK_MEMORY_N_FORMATS)
+    {
+      binary_reader_error (self, "Invalid texture");
+      g_bytes_unref (bytes);
+      return NULL;
+    }
+
+  bpp = gdk_memory_format_bytes_per_pixel (format);
+  if (stride < width * bpp ||
+      g_bytes_get_size (bytes) < (gsize) stride * (height - 1) + width * bpp)
+    {
+      binary_reader_error (self, "Not enough data for %ux%u texture", width, height);
+      g_bytes_unref (bytes);
+      return NULL;
+    }
+
+  texture = gdk_memory_texture_new (width, height, format, bytes, stride);
+  g_bytes_unref (bytes);
+
+  g_ptr_array_add (self->textures, g_object_ref (texture));
+
+  return texture;
+}
+
+/* Returns a font owned by the reader */
+static PangoFont *
+binary_reader_read_font (BinaryReader *self)
+{
+  PangoFont *font = NULL;
+  PangoFont *hinted;
+  cairo_hint_style_t hint_style;
+  cairo_antialias_t antialias;
+  cairo_hint_metrics_t hint_metrics;
+  guint32 tag, face;
+  char *desc;
+
+  tag = binary_reader_read_uint (self);
+  if (self->error)
+    return NULL;
+
+  if (tag > 0)
+    {
+      if (tag > self->fonts->len)
+        {
+          binary_reader_error (self, "Invalid font reference %u", tag);
+          return NULL;
+        }
+
+      return g_ptr_array_index (self->fonts, tag - 1);
+    }
+
+  face = binary_reader_read_uint (self);
+  if (face == BINARY_FACE_INLINE)
+    {
+      GBytes *bytes = binary_reader_read_bytes (self);
+
+      if (bytes)
+        {
+          GError *error = NULL;
+
+          if (!add_font_from_bytes (&self->context, bytes, &error))
+            binary_reader_take_error (self, error);
+
+          self->n_faces++;
+          g_bytes_unref (bytes);
+        }
+    }
+  else if (face > BINARY_FACE_INLINE && face - BINARY_FACE_INLINE > self->n_faces)
+    {
+      binary_reader_error (self, "Invalid font face reference %u", face);
+    }
+
+  desc = binary_reader_read_string (self);
+  hint_style = binary_reader_read_byte (self);
+  antialias = binary_reader_read_byte (self);
+  hint_metrics = binary_reader_read_byte (self);
+
+  if (desc == NULL)
+    binary_reader_error (self, "Missing font description");
+
+  if (self->error)
+    {
+      g_free (desc);
+      return NULL;
+    }
+
+  if (self->context.fontmap)
+    font = font_from_string (self->context.fontmap, desc, FALSE);
+
+  if (font == NULL && face == BINARY_FACE_SYSTEM)
+    font = font_from_string (pango_cairo_font_map_get_default (), desc, TRUE);
+
+  if (font == NULL)
+    {
+      binary_reader_error (self, "The font \"%s\" does not exist", desc);
+      g_free (desc);
+      return NULL;
+    }
+
+  g_free (desc);
+
+  hinted = gsk_reload_font (font, 1.0, hint_metrics, hint_style, antialias);
+  g_object_unref (font);
+
+  g_ptr_array_add (self->fonts, hinted);
+
+  return hinted;
+}
+
+/* Returns glyphs owned by the reader */
+static PangoGlyphString *
+binary_reader_read_glyphs (BinaryReader *self)
+{
+  PangoGlyphString *glyphs;
+  guint32 tag;
+  gsize i, n;
+
+  tag = binary_reader_read_uint (self);
+  if (self->error)
+    return NULL;
+
+  if (tag > 0)
+    {
+      if (tag > self->glyph_runs->len)
+        {
+          binary_reader_error (self, "Invalid glyphs reference %u", tag);
+          return NULL;
+        }
+
+      return g_ptr_array_index (self->glyph_runs, tag - 1);
+    }
+
+  n = binary_reader_read_count (self, 4 * sizeof (guint32) + 1);
+  if (self->error)
+    return NULL;
+
+  glyphs = pango_glyph_string_new ();
+  pango_glyph_string_set_size (glyphs, n);
+
+  for (i = 0; i < n; i++)
+    {
+      PangoGlyphInfo gi = { 0, { 0, 0, 0}, { 1 } };
+      guint8 flags;
+
+      gi.glyph = binary_reader_read_uint (self);
+      gi.geometry.width = binary_reader_read_int (self);
+      gi.geometry.x_offset = binary_reader_read_int (self);
+      gi.geometry.y_offset = binary_reader_read_int (self);
+      flags = binary_reader_read_byte (self);
+      gi.attr.is_cluster_start = flags & 1;
+      gi.attr.is_color = (flags >> 1) & 1;
+
+      glyphs->glyphs[i] = gi;
+    }
+
+  g_ptr_array_add (self->glyph_runs, glyphs);
+
+  return glyphs;
+}
+
+static GskRenderNode *
+binary_reader_read_node (BinaryReader *self);
+
+static GskRenderNode *
+binary_reader_read_node_data (BinaryReader *self)
+{
+  GskRenderNode *node = NULL;
+  GskRenderNodeType type;
+
+  type = binary_reader_read_byte (self);
+  if (self->error)
+    return NULL;
+
+  switch (type)
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        GPtrArray *children;
+        gsize i, n;
+
+        n = binary_reader_read_count (self, sizeof (guint32));
+        children = g_ptr_array_new_full (n, (GDestroyNotify) gsk_render_node_unref);
+        for (i = 0; i < n && !self->error; i++)
+          {
+            GskRenderNode *child = binary_reader_read_node (self);
+
+            if (child)
+              g_ptr_array_add (children, child);
+          }
+
+        if (!self->error)
+          node = gsk_container_node_new ((GskRenderNode **) children->pdata, children->len);
+
+        g_ptr_array_unref (children);
+      }
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        graphene_rect_t bounds;
+        GBytes *bytes;
+
+        binary_reader_read_rect (self, &bounds);
+        bytes = binary_reader_read_bytes (self);
+        if (bytes == NULL)
+          break;
+
+        node = gsk_cairo_node_new (&bounds);
+
+        if (g_bytes_get_size (bytes) > 0)
+          {
+            GdkTexture *pixels;
+            GError *error = NULL;
+
+            pixels = gdk_texture_new_from_bytes (bytes, &error);
+            if (pixels)
+              {
+                cairo_t *cr = gsk_cairo_node_get_draw_context (node);
+                cairo_surface_t *surface = gdk_texture_download_surface (pixels);
+
+                cairo_set_source_surface (cr, surface, 0, 0);
+                cairo_paint (cr);
+                cairo_destroy (cr);
+
+                cairo_surface_destroy (surface);
+                g_object_unref (pixels);
+              }
+            else
+              {
+                binary_reader_take_error (self, error);
+                g_clear_pointer (&node, gsk_render_node_unref);
+              }
+          }
+
+        g_bytes_unref (bytes);
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkRGBA color;
+
+        binary_reader_read_rect (self, &bounds);
+        binary_reader_read_rgba (self, &color);
+
+        if (!self->error)
+          node = gsk_color_node_new (&color, &bounds);
+      }
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t start, end;
+        GskColorStop *stops;
+        gsize n_stops;
+
+        binary_reader_read_rect (self, &bounds);
+        binary_reader_read_point (self, &start);
+        binary_reader_read_point (self, &end);
+        stops = binary_reader_read_stops (self, &n_stops);
+
+        if (!self->error)
+          {
+            if (type == GSK_REPEATING_LINEAR_GRADIENT_NODE)
+              node = gsk_repeating_linear_gradient_node_new (&bounds, &start, &end, stops, n_stops);
+            else
+              node = gsk_linear_gradient_node_new (&bounds, &start, &end, stops, n_stops);
+          }
+
+        g_free (stops);
+      }
+      break;
+
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t center;
+        float hradius, vradius, start, end;
+        GskColorStop *stops;
+        gsize n_stops;
+
+        binary_reader_read_rect (self, &bounds);
+        binary_reader_read_point (self, &center);
+        hradius = binary_reader_read_float (self);
+        vradius = binary_reader_read_float (self);
+        start = binary_reader_read_float (self);
+        end = binary_reader_read_float (self);
+        stops = binary_reader_read_stops (self, &n_stops);
+
+        if (!self->error)
+          {
+            if (type == GSK_REPEATING_RADIAL_GRADIENT_NODE)
+              node = gsk_repeating_radial_gradient_node_new (&bounds, &center, hradius, vradius, start, end, stops, n_stops);
+            else
+              node = gsk_radial_gradient_node_new (&bounds, &center, hradius, vradius, start, end, stops, n_stops);
+          }
+
+        g_free (stops);
+      }
+      break;
+
+    case GSK_CONIC_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t center;
+        float rotation;
+        GskColorStop *stops;
+        gsize n_stops;
+
+        binary_reader_read_rect (self, &bounds);
+        binary_reader_read_point (self, &center);
+        rotation = binary_reader_read_float (self);
+        stops = binary_reader_read_stops (self, &n_stops);
+
+        if (!self->error)
+          node = gsk_conic_gradient_node_new (&bounds, &center, rotation, stops, n_stops);
+
+        g_free (stops);
+      }
+      break;
+
+    case GSK_BORDER_NODE:
+      {
+        GskRoundedRect outline;
+        float widths[4];
+        GdkRGBA colors[4];
+
+        binary_reader_read_rounded_rect (self, &outline);
+        binary_reader_read_floats (self, widths, 4);
+        for (guint i = 0; i < 4; i++)
+          binary_reader_read_rgba (self, &colors[i]);
+
+        if (!self->error)
+          node = gsk_border_node_new (&outline, widths, colors);
+      }
+      break;
+
+    case GSK_TEXTURE_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkTexture *texture;
+
+        binary_reader_read_rect (self, &bounds);
+        texture = binary_reader_read_texture (self);
+
+        if (!self->error)
+          node = gsk_texture_node_new (texture, &bounds);
+
+        g_clear_object (&texture);
+      }
+      break;
+
+    case GSK_TEXTURE_SCALE_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkTexture *texture;
+        GskScalingFilter filter;
+
+        binary_reader_read_rect (self, &bounds);
+        texture = binary_reader_read_texture (self);
+        filter = binary_reader_read_enum (self, GSK_SCALING_FILTER_TRILINEAR);
+
+        if (!self->error)
+          node = gsk_texture_scale_node_new (texture, &bounds, filter);
+
+        g_clear_object (&texture);
+      }
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+      {
+        GskRoundedRect outline;
+        GdkRGBA color;
+        float dx, dy, spread, blur;
+
+        binary_reader_read_rounded_rect (self, &outline);
+        binary_reader_read_rgba (self, &color);
+        dx = binary_reader_read_float (self);
+        dy = binary_reader_read_float (self);
+        spread = binary_reader_read_float (self);
+        blur = binary_reader_read_float (self);
+
+        if (!self->error)
+          {
+            if (type == GSK_INSET_SHADOW_NODE)
+              node = gsk_inset_shadow_node_new (&outline, &color, dx, dy, spread, blur);
+            else
+              node = gsk_outset_shadow_node_new (&outline, &color, dx, dy, spread, blur);
+          }
+      }
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      {
+        GskTransform *transform;
+        GskRenderNode *child;
+
+        transform = binary_reader_read_transform (self);
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_transform_node_new (child, transform);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+        g_clear_pointer (&transform, gsk_transform_unref);
+      }
+      break;
+
+    case GSK_OPACITY_NODE:
+      {
+        GskRenderNode *child;
+        float opacity;
+
+        opacity = binary_reader_read_float (self);
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_opacity_node_new (child, opacity);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        GskRenderNode *child;
+        float values[16];
+        graphene_matrix_t matrix;
+        graphene_vec4_t offset;
+
+        binary_reader_read_floats (self, values, 16);
+        graphene_matrix_init_from_float (&matrix, values);
+        binary_reader_read_floats (self, values, 4);
+        graphene_vec4_init_from_float (&offset, values);
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_color_matrix_node_new (child, &matrix, &offset);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      {
+        GskRenderNode *child;
+        graphene_rect_t bounds, child_bounds;
+
+        binary_reader_read_rect (self, &bounds);
+        binary_reader_read_rect (self, &child_bounds);
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_repeat_node_new (&bounds, child, &child_bounds);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_CLIP_NODE:
+      {
+        GskRenderNode *child;
+        graphene_rect_t clip;
+
+        binary_reader_read_rect (self, &clip);
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_clip_node_new (child, &clip);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      {
+        GskRenderNode *child;
+        GskRoundedRect clip;
+
+        binary_reader_read_rounded_rect (self, &clip);
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_rounded_clip_node_new (child, &clip);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_SHADOW_NODE:
+      {
+        GskRenderNode *child;
+        GskShadow *shadows;
+        gsize i, n;
+
+        n = binary_reader_read_count (self, 7 * sizeof (float));
+        if (n == 0)
+          {
+            binary_reader_error (self, "Shadow nodes need at least 1 shadow");
+            break;
+          }
+
+        shadows = g_new (GskShadow, n);
+        for (i = 0; i < n; i++)
+          {
+            binary_reader_read_rgba (self, &shadows[i].color);
+            shadows[i].dx = binary_reader_read_float (self);
+            shadows[i].dy = binary_reader_read_float (self);
+            shadows[i].radius = binary_reader_read_float (self);
+          }
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_shadow_node_new (child, shadows, n);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+        g_free (shadows);
+      }
+      break;
+
+    case GSK_BLEND_NODE:
+      {
+        GskRenderNode *bottom, *top;
+        GskBlendMode mode;
+
+        mode = binary_reader_read_enum (self, GSK_BLEND_MODE_LUMINOSITY);
+        bottom = binary_reader_read_node (self);
+        top = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_blend_node_new (bottom, top, mode);
+
+        g_clear_pointer (&bottom, gsk_render_node_unref);
+        g_clear_pointer (&top, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        GskRenderNode *start, *end;
+        float progress;
+
+        progress = binary_reader_read_float (self);
+        start = binary_reader_read_node (self);
+        end = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_cross_fade_node_new (start, end, progress);
+
+        g_clear_pointer (&start, gsk_render_node_unref);
+        g_clear_pointer (&end, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_TEXT_NODE:
+      {
+        PangoFont *font;
+        PangoGlyphString *glyphs;
+        GdkRGBA color;
+        graphene_point_t offset;
+
+        font = binary_reader_read_font (self);
+        glyphs = binary_reader_read_glyphs (self);
+        binary_reader_read_rgba (self, &color);
+        binary_reader_read_point (self, &offset);
+
+        if (!self->error)
+          node = gsk_text_node_new (font, glyphs, &color, &offset);
+      }
+      break;
+
+    case GSK_BLUR_NODE:
+      {
+        GskRenderNode *child;
+        float radius;
+
+        radius = binary_reader_read_float (self);
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_blur_node_new (child, radius);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_DEBUG_NODE:
+      {
+        GskRenderNode *child;
+        char *message;
+
+        message = binary_reader_read_string (self);
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_debug_node_new (child, g_steal_pointer (&message));
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+        g_free (message);
+      }
+      break;
+
+    case GSK_GL_SHADER_NODE:
+      {
+        GskRenderNode *children[4] = { NULL, };
+        GskGLShader *shader;
+        GBytes *source, *args;
+        graphene_rect_t bounds;
+        guint i, n;
+
+        binary_reader_read_rect (self, &bounds);
+        source = binary_reader_read_bytes (self);
+        args = binary_reader_read_bytes (self);
+        n = binary_reader_read_uint (self);
+        if (n > G_N_ELEMENTS (children))
+          binary_reader_error (self, "Too many children for a GL shader");
+
+        for (i = 0; i < n && !self->error; i++)
+          children[i] = binary_reader_read_node (self);
+
+        if (!self->error)
+          {
+            shader = gsk_gl_shader_new_from_bytes (source);
+
+            if (g_bytes_get_size (args) != gsk_gl_shader_get_args_size (shader) ||
+                (n > 0 && n != gsk_gl_shader_get_n_textures (shader)))
+              binary_reader_error (self, "Arguments don't match the GL shader");
+            else
+              node = gsk_gl_shader_node_new (shader, &bounds, args, n > 0 ? children : NULL, n);
+
+            g_object_unref (shader);
+          }
+
+        for (i = 0; i < G_N_ELEMENTS (children); i++)
+          g_clear_pointer (&children[i], gsk_render_node_unref);
+        g_clear_pointer (&source, g_bytes_unref);
+        g_clear_pointer (&args, g_bytes_unref);
+      }
+      break;
+
+    case GSK_MASK_NODE:
+      {
+        GskRenderNode *source, *mask;
+        GskMaskMode mode;
+
+        mode = binary_reader_read_enum (self, GSK_MASK_MODE_INVERTED_LUMINANCE);
+        source = binary_reader_read_node (self);
+        mask = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_mask_node_new (source, mask, mode);
+
+        g_clear_pointer (&source, gsk_render_node_unref);
+        g_clear_pointer (&mask, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_FILL_NODE:
+      {
+        GskRenderNode *child;
+        GskPath *path;
+        GskFillRule rule;
+
+        path = binary_reader_read_path (self);
+        rule = binary_reader_read_enum (self, GSK_FILL_RULE_EVEN_ODD);
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_fill_node_new (child, path, rule);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+        gsk_path_unref (path);
+      }
+      break;
+
+    case GSK_STROKE_NODE:
+      {
+        GskRenderNode *child;
+        GskPath *path;
+        GskStroke *stroke;
+        float line_width, miter_limit, dash_offset;
+        GskLineCap line_cap;
+        GskLineJoin line_join;
+        float *dash;
+        gsize n_dash;
+
+        path = binary_reader_read_path (self);
+        line_width = binary_reader_read_float (self);
+        line_cap = binary_reader_read_enum (self, GSK_LINE_CAP_SQUARE);
+        line_join = binary_reader_read_enum (self, GSK_LINE_JOIN_BEVEL);
+        miter_limit = binary_reader_read_float (self);
+        n_dash = binary_reader_read_count (self, sizeof (float));
+        dash = g_new (float, n_dash);
+        binary_reader_read_floats (self, dash, n_dash);
+        dash_offset = binary_reader_read_float (self);
+        child = binary_reader_read_node (self);
+
+        if (!self->error && !(line_width > 0 && miter_limit >= 0))
+          binary_reader_error (self, "Invalid stroke parameters");
+
+        if (!self->error)
+          {
+            stroke = gsk_stroke_new (line_width);
+            gsk_stroke_set_line_cap (stroke, line_cap);
+            gsk_stroke_set_line_join (stroke, line_join);
+            gsk_stroke_set_miter_limit (stroke, miter_limit);
+            gsk_stroke_set_dash (stroke, dash, n_dash);
+            gsk_stroke_set_dash_offset (stroke, dash_offset);
+
+            node = gsk_stroke_node_new (child, path, stroke);
+
+            gsk_stroke_free (stroke);
+          }
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+        g_free (dash);
+        gsk_path_unref (path);
+      }
+      break;
+
+    case GSK_SUBSURFACE_NODE:
+      {
+        GskRenderNode *child;
+
+        child = binary_reader_read_node (self);
+
+        if (!self->error)
+          node = gsk_subsurface_node_new (child, NULL);
+
+        g_clear_pointer (&child, gsk_render_node_unref);
+      }
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      binary_reader_error (self, "Invalid node type %u", (guint) type);
+      break;
+    }
+
+  if (node == NULL)
+    binary_reader_error (self, "Invalid node data");
+
+  return node;
+}
+
+static GskRenderNode *
+binary_reader_read_node (BinaryReader *self)
+{
+  GskRenderNode *node;
+  guint32 tag;
+
+  tag = binary_reader_read_uint (self);
+  if (self->error)
+    return NULL;
+
+  if (tag >= BINARY_NODE_REFERENCE)
+    {
+      if (tag - BINARY_NODE_REFERENCE >= self->nodes->len)
+        {
+          binary_reader_error (self, "Invalid node reference %u", tag);
+          return NULL;
+        }
+
+      return gsk_render_node_ref (g_ptr_array_index (self->nodes, tag - BINARY_NODE_REFERENCE));
+    }
+
+  node = binary_reader_read_node_data (self);
+
+  if (node && tag == BINARY_NODE_SHARED)
+    g_ptr_array_add (self->nodes, gsk_render_node_ref (node));
+
+  return node;
+}
+
+gboolean
+gsk_render_node_data_is_binary (GBytes *bytes)
+{
+  return g_bytes_get_size (bytes) >= BINARY_MAGIC_SIZE &&
+         memcmp (g_bytes_get_data (bytes, NULL), BINARY_MAGIC, BINARY_MAGIC_SIZE) == 0;
+}
+
+GskRenderNode *
+gsk_render_node_deserialize_from_binary (GBytes            *bytes,
+                                         GskParseErrorFunc  error_func,
+                                         gpointer           user_data)
+{
+  BinaryReader self;
+  GskRenderNode *root = NULL;
+  guint32 version, byte_order;
+
+  binary_reader_init (&self, bytes);
+
+  version = binary_reader_read_uint (&self);
+  byte_order = binary_reader_read_uint (&self);
+
+  if (self.error)
+    {
+      /* too short, error is set already */
+    }
+  else if (byte_order != BINARY_BYTE_ORDER_MARK)
+    {
+      binary_reader_error (&self, "The data was written on a machine with a different byte order");
+    }
+  else if (version != BINARY_VERSION)
+    {
+      binary_reader_error (&self, "Unsupported version %u of the binary format", version);
+    }
+  else
+    {
+      root = binary_reader_read_node (&self);
+    }
+
+  if (!self.error && self.pos != self.size)
+    binary_reader_error (&self, "Unexpected data after the root node");
+
+  if (self.error)
+    {
+      GskParseLocation location = {
+        .bytes = self.error_pos,
+        .chars = self.error_pos,
+        .lines = 0,
+        .line_bytes = self.error_pos,
+        .line_chars = self.error_pos,
+      };
+
+      if (error_func)
+        error_func (&location, &location, self.error, user_data);
+
+      g_clear_pointer (&root, gsk_render_node_unref);
+    }
+
+  binary_reader_finish (&self);
+
+  return root;
+}
+
+struct _GskRenderNodeEncoder
+{
+  BinaryPrinter printer;
+};
+
+/*
+ * gsk_render_node_encoder_new:
+ *
+ * Creates an encoder for writing a sequence of nodes in the binary
+ * format, such as the frames of a recording.
+ *
+ * Everything the encoder has written is remembered until it is reset,
+ * so every node, texture and font only needs to be written once. That
+ * makes encoding a frame that reuses most of the previous frame's nodes
+ * cheap, and the result small.
+ *
+ * The encoder can be used from any thread, but it must be reset and
+ * freed on the main thread, since it holds references to the nodes.
+ *
+ * Returns: (transfer full): a new encoder
+ */
+GskRenderNodeEncoder *
+gsk_render_node_encoder_new (void)
+{
+  GskRenderNodeEncoder *self;
+
+  self = g_new0 (GskRenderNodeEncoder, 1);
+  binary_printer_init (&self->printer, NULL);
+  self->printer.remember_all = TRUE;
+
+  return self;
+}
+
+void
+gsk_render_node_encoder_free (GskRenderNodeEncoder *self)
+{
+  binary_printer_clear (&self->printer);
+  g_free (self);
+}
+
+/*
+ * gsk_render_node_encoder_reset:
+ * @self: an encoder
+ *
+ * Forgets everything that was written, so the next node is written
+ * in full and can be decoded by a new or reset decoder.
+ */
+void
+gsk_render_node_encoder_reset (GskRenderNodeEncoder *self)
+{
+  binary_printer_clear (&self->printer);
+  binary_printer_init (&self->printer, NULL);
+  self->printer.remember_all = TRUE;
+}
+
+/*
+ * gsk_render_node_encoder_encode:
+ * @self: an encoder
+ * @node: the node to encode
+ *
+ * Encodes @node. The result can only be decoded by a decoder that has
+ * decoded everything this encoder wrote since it was created or reset.
+ *
+ * Returns: (transfer full): the encoded node
+ */
+GBytes *
+gsk_render_node_encoder_encode (GskRenderNodeEncoder *self,
+                                GskRenderNode        *node)
+{
+  if (self->printer.printer.str == NULL)
+    self->printer.printer.str = g_string_new (NULL);
+
+  binary_printer_append_node (&self->printer, node);
+
+  return g_string_free_to_bytes (g_steal_pointer (&self->printer.printer.str));
+}
+
+struct _GskRenderNodeDecoder
+{
+  BinaryReader reader;
+};
+
+/*
+ * gsk_render_node_decoder_new:
+ *
+ * Creates a decoder for the output of a `GskRenderNodeEncoder`.
+ *
+ * Returns: (transfer full): a new decoder
+ */
+GskRenderNodeDecoder *
+gsk_render_node_decoder_new (void)
+{
+  GskRenderNodeDecoder *self;
+
+  self = g_new0 (GskRenderNodeDecoder, 1);
+  binary_reader_init (&self->reader, NULL);
+
+  return self;
+}
+
+void
+gsk_render_node_decoder_free (GskRenderNodeDecoder *self)
+{
+  binary_reader_finish (&self->reader);
+  g_free (self);
+}
+
+/*
+ * gsk_render_node_decoder_reset:
+ * @self: a decoder
+ *
+ * Forgets everything that was decoded, to start decoding from a point
+ * where the encoder was reset.
+ */
+void
+gsk_render_node_decoder_reset (GskRenderNodeDecoder *self)
+{
+  binary_reader_finish (&self->reader);
+  binary_reader_init (&self->reader, NULL);
+}
+
+/*
+ * gsk_render_node_decoder_decode:
+ * @self: a decoder
+ * @bytes: data returned by gsk_render_node_encoder_encode()
+ * @error: return location for an error
+ *
+ * Decodes the next node. After an error, the decoder must be reset
+ * before it can be used again.
+ *
+ * Returns: (transfer full) (nullable): the decoded node
+ */
+GskRenderNode *
+gsk_render_node_decoder_decode (GskRenderNodeDecoder  *self,
+                                GBytes                *bytes,
+                                GError               **error)
+{
+  BinaryReader *reader = &self->reader;
+  GskRenderNode *node;
+
+  if (reader->error)
+    {
+      g_set_error_literal (error, GTK_CSS_PARSER_ERROR, GTK_CSS_PARSER_ERROR_FAILED,
+                           "The decoder needs to be reset after an error");
+      return NULL;
+    }
+
+  g_clear_pointer (&reader->bytes, g_bytes_unref);
+  reader->bytes = g_bytes_ref (bytes);
+  reader->data = g_bytes_get_data (bytes, &reader->size);
+  reader->pos = 0;
+
+  node = binary_reader_read_node (reader);
+
+  if (!reader->error && reader->pos != reader->size)
+    binary_reader_error (reader, "Unexpected data after the root node");
+
+  if (reader->error)
+    {
+      g_clear_pointer (&node, gsk_render_node_unref);
+      if (error)
+        *error = g_error_copy (reader->error);
+    }
+
+  return node;
+}
@@ -6,3 +6,25 @@
 GskRenderNode * gsk_render_node_deserialize_from_bytes  (GBytes            *bytes,
                                                          GskParseErrorFunc  error_func,
                                                          gpointer           user_data);
+
+gboolean        gsk_render_node_data_is_binary           (GBytes            *bytes);
+GskRenderNode * gsk_render_node_deserialize_from_binary  (GBytes            *bytes,
+                                                          GskParseErrorFunc  error_func,
+                                                          gpointer           user_data);
+
+typedef struct _GskRenderNodeEncoder GskRenderNodeEncoder;
+
+GskRenderNodeEncoder *  gsk_render_node_encoder_new     (void);
+void                    gsk_render_node_encoder_free    (GskRenderNodeEncoder  *self);
+void                    gsk_render_node_encoder_reset   (GskRenderNodeEncoder  *self);
+GBytes *                gsk_render_node_encoder_encode  (GskRenderNodeEncoder  *self,
+                                                         GskRenderNode         *node);
+
+typedef struct _GskRenderNodeDecoder GskRenderNodeDecoder;
+
+GskRenderNodeDecoder *  gsk_render_node_decoder_new     (void);
+void                    gsk_render_node_decoder_free    (GskRenderNodeDecoder  *self);
+void                    gsk_render_node_decoder_reset   (GskRenderNodeDecoder  *self);
+GskRenderNode *         gsk_render_node_decoder_decode  (GskRenderNodeDecoder  *self,
+                                                         GBytes                *bytes,
+                                                         GError               **error);
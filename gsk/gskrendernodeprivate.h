@@ -8,6 +8,7 @@
 G_BEGIN_DECLS
 
 typedef struct _GskRenderNodeClass GskRenderNodeClass;
+typedef struct _GskRenderNodeChunk GskRenderNodeChunk;
 
 /* Keep this in sync with the GskRenderNodeType enumeration.
  *
@@ -34,6 +35,13 @@ struct _GskRenderNode
 
   guint preferred_depth : 2;
   guint offscreen_for_opacity : 1;
+
+  /* lazily computed by gsk_render_node_get_hash(), accessed atomically */
+  int hash_state;
+  guint64 hash;
+
+  /* the arena chunk the node lives in or NULL if it was allocated on its own */
+  GskRenderNodeChunk *chunk;
 };
 
 typedef struct
@@ -56,6 +64,8 @@ struct _GskRenderNodeClass
   void            (* diff)        (GskRenderNode  *node1,
                                    GskRenderNode  *node2,
                                    GskDiffData    *data);
+  gboolean        (* hash)        (GskRenderNode  *node,
+                                   guint64        *hash);
 };
 
 void            gsk_render_node_init_types              (void);
@@ -65,6 +75,8 @@ GType           gsk_render_node_type_register_static    (const char
                                                          GClassInitFunc               class_init);
 
 gpointer        gsk_render_node_alloc                   (GskRenderNodeType            node_type);
+void            gsk_render_node_arena_begin             (void);
+void            gsk_render_node_arena_end               (void);
 
 void            _gsk_render_node_unref                  (GskRenderNode               *node);
 
@@ -73,6 +85,10 @@ gboolean        gsk_render_node_can_diff                (const GskRenderNode
 void            gsk_render_node_diff                    (GskRenderNode               *node1,
                                                          GskRenderNode               *node2,
                                                          GskDiffData                 *data);
+gboolean        gsk_render_node_get_hash                (GskRenderNode               *node,
+                                                         guint64                     *hash);
+gboolean        gsk_render_node_hash_equal              (GskRenderNode               *node1,
+                                                         GskRenderNode               *node2);
 void            gsk_render_node_diff_impossible         (GskRenderNode               *node1,
                                                          GskRenderNode               *node2,
                                                          GskDiffData                 *data);
@@ -100,6 +116,37 @@ gboolean        gsk_container_node_is_disjoint          (const GskRenderNode
 
 gboolean        gsk_render_node_use_offscreen_for_opacity (const GskRenderNode       *node) G_GNUC_PURE;
 
+/* FNV-1a, used for the structural hashes of nodes */
+static inline guint64
+gsk_render_node_hash_bytes (guint64       hash,
+                            gconstpointer data,
+                            gsize         size)
+{
+  const guchar *bytes = data;
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    {
+      hash ^= bytes[i];
+      hash *= G_GUINT64_CONSTANT (0x100000001b3);
+    }
+
+  return hash;
+}
+
+static inline gboolean
+gsk_render_node_hash_child (guint64       *hash,
+                            GskRenderNode *child)
+{
+  guint64 child_hash;
+
+  if (!gsk_render_node_get_hash (child, &child_hash))
+    return FALSE;
+
+  *hash = gsk_render_node_hash_bytes (*hash, &child_hash, sizeof (guint64));
+  return TRUE;
+}
+
 #define gsk_render_node_ref(node)   _gsk_render_node_ref(node)
 #define gsk_render_node_unref(node) _gsk_render_node_unref(node)
 
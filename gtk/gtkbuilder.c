@@ -426,6 +426,7 @@ typedef struct
   gboolean allow_template_parents;
   GObject *current_object;
   GtkBuilderScope *scope;
+  GHashTable *value_cache;
 } GtkBuilderPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (GtkBuilder, gtk_builder, G_TYPE_OBJECT)
@@ -529,6 +530,7 @@ gtk_builder_finalize (GObject *object)
   g_hash_table_destroy (priv->objects);
   if (priv->signals)
     g_ptr_array_free (priv->signals, TRUE);
+  g_clear_pointer (&priv->value_cache, g_hash_table_unref);
 
   G_OBJECT_CLASS (gtk_builder_parent_class)->finalize (object);
 }
@@ -666,6 +668,150 @@ object_properties_get_value (const ObjectProperties *self,
   return &g_array_index (self->values, GValue, idx);
 }
 
+/* Widget templates set the same properties to the same values every
+ * time they are instantiated, so they keep a cache of parsed values
+ * that all their builders share. Only values that don't depend on the
+ * builder's state and that are cheaper to copy than to parse are kept.
+ */
+typedef struct
+{
+  GParamSpec *pspec;
+  char *string;
+  GValue value;
+} CachedValue;
+
+static guint
+cached_value_hash (gconstpointer data)
+{
+  const CachedValue *cached = data;
+
+  return g_direct_hash (cached->pspec) ^ g_str_hash (cached->string);
+}
+
+static gboolean
+cached_value_equal (gconstpointer a,
+                    gconstpointer b)
+{
+  const CachedValue *cached1 = a;
+  const CachedValue *cached2 = b;
+
+  return cached1->pspec == cached2->pspec &&
+         strcmp (cached1->string, cached2->string) == 0;
+}
+
+static void
+cached_value_free (gpointer data)
+{
+  CachedValue *cached = data;
+
+  g_free (cached->string);
+  g_value_unset (&cached->value);
+  g_free (cached);
+}
+
+static gboolean
+value_is_cacheable (GParamSpec *pspec)
+{
+  GType type = G_PARAM_SPEC_VALUE_TYPE (pspec);
+
+  switch (G_TYPE_FUNDAMENTAL (type))
+    {
+    case G_TYPE_CHAR:
+    case G_TYPE_UCHAR:
+    case G_TYPE_BOOLEAN:
+    case G_TYPE_INT:
+    case G_TYPE_UINT:
+    case G_TYPE_LONG:
+    case G_TYPE_ULONG:
+    case G_TYPE_INT64:
+    case G_TYPE_UINT64:
+    case G_TYPE_FLOAT:
+    case G_TYPE_DOUBLE:
+    case G_TYPE_ENUM:
+    case G_TYPE_FLAGS:
+      return TRUE;
+
+    case G_TYPE_BOXED:
+      return type == GDK_TYPE_RGBA;
+
+    default:
+      return FALSE;
+    }
+}
+
+/*< private >
+ * gtk_builder_value_cache_new:
+ *
+ * Creates a cache for gtk_builder_set_value_cache().
+ *
+ * Returns: (transfer full): a new value cache
+ */
+GHashTable *
+gtk_builder_value_cache_new (void)
+{
+  return g_hash_table_new_full (cached_value_hash, cached_value_equal, cached_value_free, NULL);
+}
+
+/*< private >
+ * gtk_builder_set_value_cache:
+ * @builder: a `GtkBuilder`
+ * @cache: (nullable): a cache from gtk_builder_value_cache_new()
+ *
+ * Makes @builder look up property values in @cache before parsing
+ * them, and add the values it parses. Builders that create the same
+ * objects over and over, like the ones for widget templates, should
+ * share a cache.
+ */
+void
+gtk_builder_set_value_cache (GtkBuilder *builder,
+                             GHashTable *cache)
+{
+  GtkBuilderPrivate *priv = gtk_builder_get_instance_private (builder);
+
+  if (cache)
+    g_hash_table_ref (cache);
+  g_clear_pointer (&priv->value_cache, g_hash_table_unref);
+  priv->value_cache = cache;
+}
+
+static gboolean
+gtk_builder_value_from_string_cached (GtkBuilder  *builder,
+                                      GParamSpec  *pspec,
+                                      const char  *string,
+                                      GValue      *value,
+                                      GError     **error)
+{
+  GtkBuilderPrivate *priv = gtk_builder_get_instance_private (builder);
+  CachedValue *cached;
+
+  if (priv->value_cache == NULL || !value_is_cacheable (pspec))
+    return gtk_builder_value_from_string (builder, pspec, string, value, error);
+
+  cached = g_hash_table_lookup (priv->value_cache, &(CachedValue) { pspec, (char *) string, });
+  if (cached == NULL)
+    {
+      GValue parsed = G_VALUE_INIT;
+
+      if (!gtk_builder_value_from_string (builder, pspec, string, &parsed, error))
+        {
+          if (G_IS_VALUE (&parsed))
+            g_value_unset (&parsed);
+          return FALSE;
+        }
+
+      cached = g_new (CachedValue, 1);
+      cached->pspec = pspec;
+      cached->string = g_strdup (string);
+      cached->value = parsed;
+      g_hash_table_add (priv->value_cache, cached);
+    }
+
+  g_value_init (value, G_VALUE_TYPE (&cached->value));
+  g_value_copy (&cached->value, value);
+
+  return TRUE;
+}
+
 static void
 gtk_builder_get_parameters (GtkBuilder         *builder,
                             GType               object_type,
@@ -756,10 +902,10 @@ gtk_builder_get_parameters (GtkBuilder         *builder,
               continue;
             }
         }
-      else if (!gtk_builder_value_from_string (builder, prop->pspec,
-                                               prop->text->str,
-                                               &property_value,
-                                               &error))
+      else if (!gtk_builder_value_from_string_cached (builder, prop->pspec,
+                                                      prop->text->str,
+                                                      &property_value,
+                                                      &error))
         {
           g_warning ("Failed to set property %s.%s to %s: %s",
                      g_type_name (object_type), prop->pspec->name, prop->text->str,
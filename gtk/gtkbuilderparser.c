@@ -856,6 +856,51 @@ free_child_info (ChildInfo *info)
   g_free (info);
 }
 
+/* Finding a property walks the pspec pool for every ancestor of the
+ * class. Templates look up the same properties each time a widget is
+ * created, so remember the results per class.
+ *
+ * Classes of dynamic types can go away, so they are not cached.
+ */
+G_LOCK_DEFINE_STATIC (builder_pspecs);
+
+static GParamSpec *
+builder_find_property (GObjectClass *oclass,
+                       const char   *name)
+{
+  static GQuark quark_pspecs = 0;
+  GType type = G_OBJECT_CLASS_TYPE (oclass);
+  GHashTable *pspecs;
+  GParamSpec *pspec;
+
+  if (g_type_get_plugin (type) != NULL)
+    return g_object_class_find_property (oclass, name);
+
+  if (G_UNLIKELY (quark_pspecs == 0))
+    quark_pspecs = g_quark_from_static_string ("gtk-builder-pspecs");
+
+  G_LOCK (builder_pspecs);
+
+  pspecs = g_type_get_qdata (type, quark_pspecs);
+  if (pspecs == NULL)
+    {
+      pspecs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      g_type_set_qdata (type, quark_pspecs, pspecs);
+    }
+
+  pspec = g_hash_table_lookup (pspecs, name);
+  if (pspec == NULL)
+    {
+      pspec = g_object_class_find_property (oclass, name);
+      if (pspec)
+        g_hash_table_insert (pspecs, g_strdup (name), pspec);
+    }
+
+  G_UNLOCK (builder_pspecs);
+
+  return pspec;
+}
+
 static void
 parse_property (ParserData   *data,
                 const char   *element_name,
@@ -898,7 +943,7 @@ parse_property (ParserData   *data,
       return;
     }
 
-  pspec = g_object_class_find_property (object_info->oclass, name);
+  pspec = builder_find_property (object_info->oclass, name);
 
   if (!pspec)
     {
@@ -990,7 +1035,7 @@ parse_binding (ParserData   *data,
       return;
     }
 
-  pspec = g_object_class_find_property (object_info->oclass, name);
+  pspec = builder_find_property (object_info->oclass, name);
 
   if (!pspec)
     {
@@ -268,6 +268,9 @@ GType     gtk_builder_get_template_type (GtkBuilder *builder,
                                          gboolean *out_allow_parents);
 void      gtk_builder_set_allow_template_parents (GtkBuilder *builder,
                                                   gboolean    allow_parents);
+GHashTable *gtk_builder_value_cache_new   (void);
+void        gtk_builder_set_value_cache   (GtkBuilder *builder,
+                                           GHashTable *cache);
 
 void     _gtk_builder_prefix_error        (GtkBuilder                *builder,
                                            GtkBuildableParseContext  *context,
@@ -167,6 +167,8 @@ struct _GtkBuilderCScopePrivate
 {
   GModule *module;
   GHashTable *callbacks;
+  GHashTable *module_symbols;
+  GHashTable *types;
 };
 
 static void gtk_builder_cscope_scope_init (GtkBuilderScopeInterface *iface);
@@ -264,18 +266,36 @@ gtk_builder_cscope_get_type_from_name (GtkBuilderScope *scope,
                                        const char      *type_name)
 {
   GtkBuilderCScope *self = GTK_BUILDER_CSCOPE (scope);
+  GtkBuilderCScopePrivate *priv = gtk_builder_cscope_get_instance_private (self);
   GType type;
 
+  /* Types are never unregistered, so once a name resolved it can be
+   * reused by every builder that shares this scope.
+   */
+  if (priv->types)
+    {
+      type = GPOINTER_TO_SIZE (g_hash_table_lookup (priv->types, type_name));
+      if (type != G_TYPE_INVALID)
+        return type;
+    }
+
   type = g_type_from_name (type_name);
-  if (type != G_TYPE_INVALID)
-    return type;
+  if (type == G_TYPE_INVALID)
+    type = gtk_builder_cscope_resolve_type_lazily (self, type_name);
+
+  if (type == G_TYPE_INVALID)
+    {
+      gtk_test_register_all_types ();
+      type = g_type_from_name (type_name);
+    }
 
-  type = gtk_builder_cscope_resolve_type_lazily (self, type_name);
   if (type != G_TYPE_INVALID)
-    return type;
+    {
+      if (priv->types == NULL)
+        priv->types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
-  gtk_test_register_all_types ();
-  type = g_type_from_name (type_name);
+      g_hash_table_insert (priv->types, g_strdup (type_name), GSIZE_TO_POINTER (type));
+    }
 
   return type;
 }
@@ -285,6 +305,7 @@ gtk_builder_cscope_get_callback (GtkBuilderCScope  *self,
                                  const char        *function_name,
                                  GError           **error)
 {
+  GtkBuilderCScopePrivate *priv = gtk_builder_cscope_get_instance_private (self);
   GModule *module;
   GCallback func;
 
@@ -292,6 +313,16 @@ gtk_builder_cscope_get_callback (GtkBuilderCScope  *self,
   if (func)
     return func;
 
+  /* Scopes are shared between all instances of a widget template,
+   * so only look up each symbol in the module once.
+   */
+  if (priv->module_symbols)
+    {
+      func = g_hash_table_lookup (priv->module_symbols, function_name);
+      if (func)
+        return func;
+    }
+
   module = gtk_builder_cscope_get_module (self);
   if (module == NULL)
     {
@@ -313,6 +344,11 @@ gtk_builder_cscope_get_callback (GtkBuilderCScope  *self,
       return NULL;
     }
 
+  if (priv->module_symbols == NULL)
+    priv->module_symbols = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  g_hash_table_insert (priv->module_symbols, g_strdup (function_name), func);
+
   return func;
 }
 
@@ -397,6 +433,8 @@ gtk_builder_cscope_finalize (GObject *object)
   GtkBuilderCScopePrivate *priv = gtk_builder_cscope_get_instance_private (self);
 
   g_clear_pointer (&priv->callbacks, g_hash_table_destroy);
+  g_clear_pointer (&priv->module_symbols, g_hash_table_destroy);
+  g_clear_pointer (&priv->types, g_hash_table_destroy);
   g_clear_pointer (&priv->module, g_module_close);
 
   G_OBJECT_CLASS (gtk_builder_cscope_parent_class)->finalize (object);
@@ -22,6 +22,7 @@
 #include "gtkcssanimationprivate.h"
 
 #include "gtkcsseasevalueprivate.h"
+#include "gtkcssstyleprivate.h"
 #include "gtkprogresstrackerprivate.h"
 
 #include <math.h>
@@ -74,6 +75,93 @@ gtk_css_animation_get_progress (GtkCssAnimation *animation)
   return gtk_progress_tracker_get_progress (&animation->tracker, reverse);
 }
 
+static void
+gtk_css_animation_clear_resolved_keyframes (GtkCssAnimation *animation)
+{
+  g_clear_pointer (&animation->resolved_keyframes, _gtk_css_keyframes_unref);
+  g_clear_object (&animation->resolved_provider);
+  g_clear_object (&animation->resolved_style);
+  g_clear_object (&animation->resolved_parent_style);
+}
+
+/* The parent style is only used for inherited values, currentColor,
+ * font-relative lengths and relative font weights. When the parent is
+ * itself animated, it is a new style every frame, but usually none of
+ * those values change, so compare them instead of the styles.
+ */
+static gboolean
+gtk_css_animation_parent_style_matches (GtkCssAnimation *animation,
+                                        GtkCssStyle     *parent_style)
+{
+  static const guint parent_properties[] = {
+    GTK_CSS_PROPERTY_COLOR,
+    GTK_CSS_PROPERTY_FONT_SIZE,
+    GTK_CSS_PROPERTY_FONT_WEIGHT,
+  };
+  GtkCssStyle *resolved = animation->resolved_parent_style;
+  guint i;
+
+  if (resolved == parent_style)
+    return TRUE;
+
+  if (resolved == NULL || parent_style == NULL)
+    return FALSE;
+
+  for (i = 0; i < G_N_ELEMENTS (parent_properties); i++)
+    {
+      if (!gtk_css_value_equal (gtk_css_style_get_value (resolved, parent_properties[i]),
+                                gtk_css_style_get_value (parent_style, parent_properties[i])))
+        return FALSE;
+    }
+
+  for (i = 0; i < _gtk_css_keyframes_get_n_properties (animation->resolved_keyframes); i++)
+    {
+      guint id = _gtk_css_keyframes_get_property_id (animation->resolved_keyframes, i);
+
+      if (!gtk_css_value_equal (gtk_css_style_get_value (resolved, id),
+                                gtk_css_style_get_value (parent_style, id)))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Computing the keyframes is expensive and the result only depends on
+ * the styles, so keep the result around for as long as the animation
+ * is applied to the same styles. That is the common case for spinners
+ * and other infinite animations, where only the progress changes
+ * between frames.
+ */
+static GtkCssKeyframes *
+gtk_css_animation_get_resolved_keyframes (GtkCssAnimation  *animation,
+                                          GtkStyleProvider *provider,
+                                          GtkCssStyle      *base_style,
+                                          GtkCssStyle      *parent_style)
+{
+  if (animation->resolved_keyframes != NULL &&
+      animation->resolved_provider == provider &&
+      animation->resolved_style == base_style &&
+      gtk_css_animation_parent_style_matches (animation, parent_style))
+    {
+      /* Don't keep the parent of an earlier frame alive */
+      g_set_object (&animation->resolved_parent_style, parent_style);
+      return animation->resolved_keyframes;
+    }
+
+  gtk_css_animation_clear_resolved_keyframes (animation);
+
+  animation->resolved_keyframes = _gtk_css_keyframes_compute (animation->keyframes,
+                                                              provider,
+                                                              base_style,
+                                                              parent_style);
+  animation->resolved_provider = g_object_ref (provider);
+  animation->resolved_style = g_object_ref (base_style);
+  if (parent_style)
+    animation->resolved_parent_style = g_object_ref (parent_style);
+
+  return animation->resolved_keyframes;
+}
+
 static GtkStyleAnimation *
 gtk_css_animation_advance (GtkStyleAnimation    *style_animation,
                            gint64                timestamp)
@@ -106,10 +194,10 @@ gtk_css_animation_apply_values (GtkStyleAnimation    *style_animation,
   base_style = gtk_css_animated_style_get_base_style (style);
   parent_style = gtk_css_animated_style_get_parent_style (style);
   provider = gtk_css_animated_style_get_provider (style);
-  resolved_keyframes = _gtk_css_keyframes_compute (animation->keyframes,
-                                                   provider,
-                                                   base_style,
-                                                   parent_style);
+  resolved_keyframes = gtk_css_animation_get_resolved_keyframes (animation,
+                                                                 provider,
+                                                                 base_style,
+                                                                 parent_style);
 
   for (i = 0; i < _gtk_css_keyframes_get_n_variables (resolved_keyframes); i++)
     {
@@ -151,8 +239,6 @@ gtk_css_animation_apply_values (GtkStyleAnimation    *style_animation,
 
   if (change != 0)
     gtk_css_animated_style_recompute (style, change);
-
-  _gtk_css_keyframes_unref (resolved_keyframes);
 }
 
 static gboolean
@@ -180,6 +266,7 @@ gtk_css_animation_free (GtkStyleAnimation *animation)
   g_free (self->name);
   _gtk_css_keyframes_unref (self->keyframes);
   gtk_css_value_unref (self->ease);
+  gtk_css_animation_clear_resolved_keyframes (self);
 
   g_free (self);
 }
@@ -223,6 +310,10 @@ _gtk_css_animation_new (const char      *name,
   animation->direction = direction;
   animation->play_state = play_state;
   animation->fill_mode = fill_mode;
+  animation->resolved_keyframes = NULL;
+  animation->resolved_provider = NULL;
+  animation->resolved_style = NULL;
+  animation->resolved_parent_style = NULL;
 
   gtk_progress_tracker_start (&animation->tracker, duration_us, delay_us, iteration_count);
   if (animation->play_state == GTK_CSS_PLAY_STATE_PAUSED)
@@ -255,6 +346,21 @@ _gtk_css_animation_advance_with_play_state (GtkCssAnimation *source,
   animation->play_state = play_state;
   animation->fill_mode = source->fill_mode;
 
+  if (source->resolved_keyframes)
+    {
+      animation->resolved_keyframes = _gtk_css_keyframes_ref (source->resolved_keyframes);
+      animation->resolved_provider = g_object_ref (source->resolved_provider);
+      animation->resolved_style = g_object_ref (source->resolved_style);
+      animation->resolved_parent_style = source->resolved_parent_style ? g_object_ref (source->resolved_parent_style) : NULL;
+    }
+  else
+    {
+      animation->resolved_keyframes = NULL;
+      animation->resolved_provider = NULL;
+      animation->resolved_style = NULL;
+      animation->resolved_parent_style = NULL;
+    }
+
   gtk_progress_tracker_init_copy (&source->tracker, &animation->tracker);
   if (animation->play_state == GTK_CSS_PLAY_STATE_PAUSED)
     gtk_progress_tracker_skip_frame (&animation->tracker, timestamp);
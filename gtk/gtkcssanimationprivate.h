@@ -40,6 +40,12 @@ struct _GtkCssAnimation
   GtkCssPlayState  play_state;
   GtkCssFillMode   fill_mode;
   GtkProgressTracker tracker;
+
+  /* keyframes computed for the given styles, kept across frames */
+  GtkCssKeyframes *resolved_keyframes;
+  GtkStyleProvider *resolved_provider;
+  GtkCssStyle     *resolved_style;
+  GtkCssStyle     *resolved_parent_style;
 };
 
 struct _GtkCssAnimationClass
@@ -123,13 +123,34 @@ gtk_css_node_get_style_provider_or_null (GtkCssNode *cssnode)
 
 static int invalidated_nodes;
 static int created_styles;
+static int restyled_nodes;
 static guint invalidated_nodes_counter;
 static guint created_styles_counter;
+static guint restyled_nodes_counter;
+static guint allocated_values_counter;
+
+static void
+gtk_css_node_reset_subtree_change (GtkCssNode *node)
+{
+  /* We don't know what the subtree will depend on until it has been
+   * validated again, so be conservative when propagating changes.
+   */
+  for (; node; node = node->parent)
+    {
+      if ((node->subtree_change & GTK_CSS_CHANGE_ANY) == GTK_CSS_CHANGE_ANY)
+        break;
+
+      node->subtree_change = GTK_CSS_CHANGE_ANY;
+    }
+}
 
 static void
 gtk_css_node_set_invalid (GtkCssNode *node,
                           gboolean    invalid)
 {
+  if (invalid)
+    gtk_css_node_reset_subtree_change (node);
+
   if (node->invalid == invalid)
     return;
 
@@ -608,6 +629,8 @@ gtk_css_node_class_init (GtkCssNodeClass *klass)
     {
       invalidated_nodes_counter = gdk_profiler_define_int_counter ("invalidated-nodes", "CSS Node Invalidations");
       created_styles_counter = gdk_profiler_define_int_counter ("created-styles", "CSS Style Creations");
+      restyled_nodes_counter = gdk_profiler_define_int_counter ("restyled-nodes", "CSS Node Restyles");
+      allocated_values_counter = gdk_profiler_define_int_counter ("allocated-values", "CSS Value Allocations");
     }
 }
 
@@ -617,6 +640,7 @@ gtk_css_node_init (GtkCssNode *cssnode)
   cssnode->decl = gtk_css_node_declaration_new ();
 
   cssnode->style = g_object_ref (gtk_css_static_style_get_default ());
+  cssnode->subtree_change = GTK_CSS_CHANGE_ANY;
 
   cssnode->visible = TRUE;
 }
@@ -905,6 +929,35 @@ gtk_css_node_set_style (GtkCssNode  *cssnode,
   return style_changed;
 }
 
+/* Changes to ancestors only need to reach a child if the styles of that
+ * child or one of its descendants depend on them. Everything else (parent
+ * style, sources, animations, ...) is always propagated.
+ */
+#define GTK_CSS_CHANGE_ANY_ANCESTOR (GTK_CSS_CHANGE_ANY_PARENT | GTK_CSS_CHANGE_ANY_PARENT_SIBLING)
+
+static inline GtkCssChange
+gtk_css_node_filter_change_for_subtree (GtkCssNode   *cssnode,
+                                        GtkCssChange  change)
+{
+  return change & (~GTK_CSS_CHANGE_ANY_ANCESTOR | cssnode->subtree_change);
+}
+
+static void
+gtk_css_node_update_subtree_change (GtkCssNode *cssnode)
+{
+  GtkCssChange change;
+  GtkCssNode *child;
+
+  change = gtk_css_static_style_get_change (gtk_css_style_get_static_style (cssnode->style));
+
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    change |= child->subtree_change;
+
+  cssnode->subtree_change = change;
+}
+
 static void
 gtk_css_node_propagate_pending_changes (GtkCssNode *cssnode,
                                         gboolean    style_changed)
@@ -924,7 +977,7 @@ gtk_css_node_propagate_pending_changes (GtkCssNode *cssnode,
        child = gtk_css_node_get_next_sibling (child))
     {
       child_change = child->pending_changes;
-      gtk_css_node_invalidate (child, change);
+      gtk_css_node_invalidate (child, gtk_css_node_filter_change_for_subtree (child, change));
       if (child->visible)
         change |= _gtk_css_change_for_sibling (child_change);
     }
@@ -949,6 +1002,8 @@ gtk_css_node_do_ensure_style (GtkCssNode                   *cssnode,
     {
       GtkCssStyle *new_style;
 
+      restyled_nodes++;
+
       g_clear_pointer (&cssnode->cache, gtk_css_node_style_cache_unref);
 
       new_style = GTK_CSS_NODE_GET_CLASS (cssnode)->update_style (cssnode,
@@ -1347,6 +1402,8 @@ gtk_css_node_validate_internal (GtkCssNode             *cssnode,
 
   if (bloomed)
     gtk_css_node_declaration_remove_bloom_hashes (cssnode->decl, filter);
+
+  gtk_css_node_update_subtree_change (cssnode);
 }
 
 void
@@ -1355,8 +1412,10 @@ gtk_css_node_validate (GtkCssNode *cssnode)
   GtkCountingBloomFilter filter = GTK_COUNTING_BLOOM_FILTER_INIT;
   gint64 timestamp;
   gint64 before G_GNUC_UNUSED;
+  guint allocated_values_before G_GNUC_UNUSED;
 
   before = GDK_PROFILER_CURRENT_TIME;
+  allocated_values_before = gtk_css_value_get_n_allocated ();
 
   g_assert (cssnode->parent == NULL);
 
@@ -1369,8 +1428,11 @@ gtk_css_node_validate (GtkCssNode *cssnode)
       gdk_profiler_end_mark (before,  "Validate CSS", "");
       gdk_profiler_set_int_counter (invalidated_nodes_counter, invalidated_nodes);
       gdk_profiler_set_int_counter (created_styles_counter, created_styles);
+      gdk_profiler_set_int_counter (restyled_nodes_counter, restyled_nodes);
+      gdk_profiler_set_int_counter (allocated_values_counter, gtk_css_value_get_n_allocated () - allocated_values_before);
       invalidated_nodes = 0;
       created_styles = 0;
+      restyled_nodes = 0;
     }
 }
 
@@ -53,6 +53,7 @@ struct _GtkCssNode
   GtkCssNodeStyleCache  *cache;                 /* cache for children to look up styles */
 
   GtkCssChange           pending_changes;       /* changes that accumulated since the style was last computed */
+  GtkCssChange           subtree_change;        /* union of the style changes of this node and all its descendants */
 
   guint                  visible :1;            /* node will be skipped when validating or computing styles */
   guint                  invalid :1;            /* node or a child needs to be validated (even if just for animation) */
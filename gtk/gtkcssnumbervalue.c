@@ -632,6 +632,37 @@ gtk_css_calc_value_alloc (guint n_terms)
   return result;
 }
 
+#define PX_CACHE_SIZE 64
+
+/* Computing em, pt or calc() values produces the same few px values
+ * over and over again, once per node and property. Keep the most
+ * recently created ones around so they can be shared instead of
+ * allocating a new value every time.
+ */
+static GtkCssValue *
+gtk_css_px_value_new_cached (double value)
+{
+  static GtkCssValue *px_cache[PX_CACHE_SIZE];
+  GtkCssValue *result;
+  guint i;
+
+  i = g_double_hash (&value) % PX_CACHE_SIZE;
+
+  if (px_cache[i] != NULL && px_cache[i]->dimension.value == value)
+    return gtk_css_value_ref (px_cache[i]);
+
+  result = gtk_css_value_new (GtkCssValue, &GTK_CSS_VALUE_NUMBER);
+  result->type = TYPE_DIMENSION;
+  result->dimension.unit = GTK_CSS_PX;
+  result->dimension.value = value;
+  result->is_computed = TRUE;
+
+  g_clear_pointer (&px_cache[i], gtk_css_value_unref);
+  px_cache[i] = gtk_css_value_ref (result);
+
+  return result;
+}
+
 GtkCssValue *
 gtk_css_dimension_value_new (double     value,
                              GtkCssUnit unit)
@@ -729,6 +760,9 @@ gtk_css_dimension_value_new (double     value,
       ;
     }
 
+  if (unit == GTK_CSS_PX)
+    return gtk_css_px_value_new_cached (value);
+
   result = gtk_css_value_new (GtkCssValue, &GTK_CSS_VALUE_NUMBER);
   result->type = TYPE_DIMENSION;
   result->dimension.unit = unit;
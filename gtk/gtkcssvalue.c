@@ -136,6 +136,8 @@ get_accounting_data (const char *class)
 }
 #endif
 
+static guint n_allocated_values;
+
 GtkCssValue *
 gtk_css_value_alloc (const GtkCssValueClass *klass,
                      gsize                   size)
@@ -143,6 +145,7 @@ gtk_css_value_alloc (const GtkCssValueClass *klass,
   GtkCssValue *value;
 
   value = g_malloc0 (size);
+  n_allocated_values++;
 
   value->class = klass;
   value->ref_count = 1;
@@ -160,6 +163,20 @@ gtk_css_value_alloc (const GtkCssValueClass *klass,
   return value;
 }
 
+/*
+ * gtk_css_value_get_n_allocated:
+ *
+ * Returns the number of values that have been allocated so far.
+ * This is meant for profiling and wraps around eventually.
+ *
+ * Returns: the number of allocated values
+ */
+guint
+gtk_css_value_get_n_allocated (void)
+{
+  return n_allocated_values;
+}
+
 GtkCssValue *
 (gtk_css_value_ref) (GtkCssValue *value)
 {
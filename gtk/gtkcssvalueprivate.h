@@ -74,6 +74,7 @@ GType         gtk_css_value_get_type                  (void) G_GNUC_CONST;
 GtkCssValue * gtk_css_value_alloc                     (const GtkCssValueClass     *klass,
                                                        gsize                       size);
 #define gtk_css_value_new(name, klass) ((name *) gtk_css_value_alloc ((klass), sizeof (name)))
+guint         gtk_css_value_get_n_allocated           (void);
 
 GtkCssValue * (gtk_css_value_ref)                     (GtkCssValue                *value);
 void          (gtk_css_value_unref)                   (GtkCssValue                *value);
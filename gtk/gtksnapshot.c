@@ -28,6 +28,7 @@
 
 #include "gdk/gdkrgbaprivate.h"
 
+#include "gsk/gskrectprivate.h"
 #include "gsk/gskrendernodeprivate.h"
 #include "gsk/gskroundedrectprivate.h"
 #include "gsk/gskstrokeprivate.h"
@@ -365,7 +366,20 @@ gtk_snapshot_collect_autopush_transform (GtkSnapshot      *snapshot,
   if (node == NULL)
     return NULL;
 
-  transform_node = gsk_transform_node_new (node, previous_state->transform);
+  /* Merge nested transforms into one node */
+  if (gsk_render_node_get_node_type (node) == GSK_TRANSFORM_NODE)
+    {
+      GskTransform *transform;
+
+      transform = gsk_transform_transform (gsk_transform_ref (previous_state->transform),
+                                           gsk_transform_node_get_transform (node));
+      transform_node = gsk_transform_node_new (gsk_transform_node_get_child (node), transform);
+      gsk_transform_unref (transform);
+    }
+  else
+    {
+      transform_node = gsk_transform_node_new (node, previous_state->transform);
+    }
 
   gsk_render_node_unref (node);
 
@@ -482,6 +496,21 @@ gtk_snapshot_collect_opacity (GtkSnapshot      *snapshot,
       opacity_node = gsk_color_node_new (&color, &bounds);
       gsk_render_node_unref (node);
     }
+  else if (gsk_render_node_get_node_type (node) == GSK_OPACITY_NODE)
+    {
+      /* Merge nested opacities into one node */
+      opacity_node = gsk_opacity_node_new (gsk_opacity_node_get_child (node),
+                                           state->data.opacity.opacity * gsk_opacity_node_get_opacity (node));
+      gsk_render_node_unref (node);
+    }
+  else if (gsk_render_node_get_node_type (node) == GSK_COLOR_NODE)
+    {
+      GdkRGBA color = *gsk_color_node_get_color (node);
+
+      color.alpha *= state->data.opacity.opacity;
+      opacity_node = gsk_color_node_new (&color, &node->bounds);
+      gsk_render_node_unref (node);
+    }
   else
     {
       opacity_node = gsk_opacity_node_new (node, state->data.opacity.opacity);
@@ -884,7 +913,36 @@ gtk_snapshot_collect_clip (GtkSnapshot      *snapshot,
       state->data.clip.bounds.size.height == 0)
     return NULL;
 
-  clip_node = gsk_clip_node_new (node, &state->data.clip.bounds);
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CLIP_NODE:
+      {
+        /* Merge nested clips into one node */
+        graphene_rect_t clip;
+
+        if (gsk_rect_intersection (&state->data.clip.bounds, gsk_clip_node_get_clip (node), &clip))
+          clip_node = gsk_clip_node_new (gsk_clip_node_get_child (node), &clip);
+        else
+          clip_node = NULL;
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      {
+        /* A clipped color is just a smaller color */
+        graphene_rect_t bounds;
+
+        if (gsk_rect_intersection (&state->data.clip.bounds, &node->bounds, &bounds))
+          clip_node = gsk_color_node_new (gsk_color_node_get_color (node), &bounds);
+        else
+          clip_node = NULL;
+      }
+      break;
+
+    default:
+      clip_node = gsk_clip_node_new (node, &state->data.clip.bounds);
+      break;
+    }
 
   gsk_render_node_unref (node);
 
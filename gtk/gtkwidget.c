@@ -1955,7 +1955,8 @@ gtk_widget_base_class_finalize (GtkWidgetClass *klass)
       g_bytes_unref (template_data->data);
       g_slist_free_full (template_data->children, (GDestroyNotify)template_child_class_free);
 
-      g_object_unref (template_data->scope);
+      g_clear_object (&template_data->scope);
+      g_clear_pointer (&template_data->values, g_hash_table_unref);
 
       g_free (template_data);
     }
@@ -11212,8 +11213,19 @@ gtk_widget_init_template (GtkWidget *widget)
 
   builder = gtk_builder_new ();
 
-  if (template->scope)
-    gtk_builder_set_scope (builder, template->scope);
+  /* Share one scope between all instances, so that symbols and
+   * types only need to be resolved once per class.
+   */
+  if (template->scope == NULL)
+    template->scope = gtk_builder_cscope_new ();
+
+  gtk_builder_set_scope (builder, template->scope);
+
+  /* Likewise, property values only need to be parsed once */
+  if (template->values == NULL)
+    template->values = gtk_builder_value_cache_new ();
+
+  gtk_builder_set_value_cache (builder, template->values);
 
   gtk_builder_set_current_object (builder, object);
 
@@ -11973,11 +11985,13 @@ gtk_widget_render (GtkWidget            *widget,
   if (renderer == NULL)
     return;
 
+  gsk_render_node_arena_begin ();
   snapshot = gtk_snapshot_new ();
   gtk_native_get_surface_transform (GTK_NATIVE (widget), &x, &y);
   gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (x, y));
   gtk_widget_snapshot (widget, snapshot);
   root = gtk_snapshot_free_to_node (snapshot);
+  gsk_render_node_arena_end ();
 
   if (GDK_PROFILER_IS_RUNNING)
     {
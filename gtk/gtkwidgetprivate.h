@@ -205,6 +205,7 @@ typedef struct
   GBytes *data;
   GSList *children;
   GtkBuilderScope *scope;
+  GHashTable *values;
 } GtkWidgetTemplate;
 
 struct _GtkWidgetClassPrivate
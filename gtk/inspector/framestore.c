@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "framestore.h"
+
+#include "gsk/gskrecordingprivate.h"
+#include "gdk/gdkprivate.h"
+
+/* The frame store writes every recorded frame to a temporary file, as
+ * a recording that gtk4-rendernode-tool can replay. Encoding and writing
+ * happen on a worker thread, so recording doesn't slow down the
+ * application. Frames share most of their nodes, so the file only grows
+ * by what changed.
+ *
+ * The file stays open until the store is freed and is deleted after
+ * that, since open files can't be deleted on all platforms.
+ */
+struct _GtkInspectorFrameStore
+{
+  GFile *file;
+  GFileIOStream *stream;
+  GskRecordingWriter *writer;
+  GThreadPool *worker;
+  GskRecordingReader *reader;
+
+  guint n_frames;
+  int n_written; /* atomic */
+
+  GMutex error_lock;
+  GError *error;
+};
+
+typedef struct
+{
+  gint64 timestamp;
+  GdkRectangle area;
+  cairo_region_t *clip_region;
+  GskRenderNode *node;
+} Frame;
+
+static gboolean
+frame_free (gpointer data)
+{
+  Frame *frame = data;
+
+  cairo_region_destroy (frame->clip_region);
+  gsk_render_node_unref (frame->node);
+  g_free (frame);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+write_frame (gpointer data,
+             gpointer user_data)
+{
+  GtkInspectorFrameStore *store = user_data;
+  Frame *frame = data;
+  GError *error = NULL;
+
+  if (!gsk_recording_writer_add_frame (store->writer,
+                                       frame->timestamp,
+                                       &frame->area,
+                                       frame->clip_region,
+                                       frame->node,
+                                       &error))
+    {
+      g_mutex_lock (&store->error_lock);
+      if (store->error == NULL)
+        store->error = g_steal_pointer (&error);
+      g_mutex_unlock (&store->error_lock);
+      g_clear_error (&error);
+    }
+
+  /* The node may hold the last reference to fonts and textures,
+   * which must not be freed on this thread */
+  gdk_main_thread_invoke (frame_free, frame);
+
+  g_atomic_int_inc (&store->n_written);
+  gdk_main_thread_wakeup ();
+}
+
+GtkInspectorFrameStore *
+gtk_inspector_frame_store_new (GError **error)
+{
+  GtkInspectorFrameStore *store;
+  GFileIOStream *stream;
+  GskRecordingWriter *writer;
+  GFile *file;
+
+  file = g_file_new_tmp ("gtk-inspector-XXXXXX.recording", &stream, error);
+  if (file == NULL)
+    return NULL;
+
+  writer = gsk_recording_writer_new (g_io_stream_get_output_stream (G_IO_STREAM (stream)), error);
+  if (writer == NULL)
+    {
+      g_io_stream_close (G_IO_STREAM (stream), NULL, NULL);
+      g_object_unref (stream);
+      g_file_delete (file, NULL, NULL);
+      g_object_unref (file);
+      return NULL;
+    }
+
+  store = g_new0 (GtkInspectorFrameStore, 1);
+  store->file = file;
+  store->stream = stream;
+  store->writer = writer;
+  /* a single thread, so frames are written in order */
+  store->worker = g_thread_pool_new (write_frame, store, 1, FALSE, NULL);
+  g_mutex_init (&store->error_lock);
+
+  return store;
+}
+
+typedef struct
+{
+  GtkInspectorFrameStore *store;
+  guint n_frames;
+} WaitData;
+
+static gboolean
+frames_written (gpointer data)
+{
+  WaitData *wait = data;
+
+  return g_atomic_int_get (&wait->store->n_written) >= wait->n_frames;
+}
+
+static void
+gtk_inspector_frame_store_wait (GtkInspectorFrameStore *store,
+                                guint                   n_frames)
+{
+  WaitData wait = { store, n_frames };
+
+  gdk_main_thread_wait_until (frames_written, &wait);
+}
+
+static gboolean
+gtk_inspector_frame_store_get_error (GtkInspectorFrameStore  *store,
+                                     GError                 **error)
+{
+  gboolean failed;
+
+  g_mutex_lock (&store->error_lock);
+  failed = store->error != NULL;
+  if (failed && error)
+    *error = g_error_copy (store->error);
+  g_mutex_unlock (&store->error_lock);
+
+  return failed;
+}
+
+void
+gtk_inspector_frame_store_free (GtkInspectorFrameStore *store)
+{
+  gtk_inspector_frame_store_wait (store, store->n_frames);
+  g_thread_pool_free (store->worker, FALSE, TRUE);
+
+  g_clear_pointer (&store->reader, gsk_recording_reader_free);
+  gsk_recording_writer_free (store->writer);
+
+  g_io_stream_close (G_IO_STREAM (store->stream), NULL, NULL);
+  g_object_unref (store->stream);
+  g_file_delete (store->file, NULL, NULL);
+  g_object_unref (store->file);
+
+  g_clear_error (&store->error);
+  g_mutex_clear (&store->error_lock);
+
+  g_free (store);
+}
+
+/* Queues the frame for writing and returns its number,
+ * for gtk_inspector_frame_store_load().
+ */
+guint
+gtk_inspector_frame_store_add (GtkInspectorFrameStore *store,
+                               gint64                  timestamp,
+                               const GdkRectangle     *area,
+                               const cairo_region_t   *clip_region,
+                               GskRenderNode          *node)
+{
+  Frame *frame;
+
+  frame = g_new (Frame, 1);
+  frame->timestamp = timestamp;
+  frame->area = *area;
+  frame->clip_region = cairo_region_copy (clip_region);
+  frame->node = gsk_render_node_ref (node);
+
+  g_thread_pool_push (store->worker, frame, NULL);
+
+  return store->n_frames++;
+}
+
+/* Reads a frame back, waiting for it to be written if necessary.
+ * Reading frames in order is fast, seeking backwards has to decode
+ * from the last keyframe.
+ */
+GskRenderNode *
+gtk_inspector_frame_store_load (GtkInspectorFrameStore  *store,
+                                guint                    frame,
+                                GError                 **error)
+{
+  if (frame >= store->n_frames)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "There is no frame %u", frame);
+      return NULL;
+    }
+
+  gtk_inspector_frame_store_wait (store, frame + 1);
+
+  if (store->reader == NULL)
+    {
+      GFileInputStream *stream;
+
+      stream = g_file_read (store->file, NULL, error);
+      if (stream == NULL)
+        return NULL;
+
+      store->reader = gsk_recording_reader_new (G_INPUT_STREAM (stream), error);
+      g_object_unref (stream);
+      if (store->reader == NULL)
+        return NULL;
+    }
+
+  if (frame >= gsk_recording_reader_get_n_frames (store->reader) &&
+      gtk_inspector_frame_store_get_error (store, error))
+    return NULL;
+
+  return gsk_recording_reader_get_frame (store->reader, frame, NULL, error);
+}
+
+/* Waits until all frames are written and returns the file
+ * containing them, for saving it.
+ */
+GFile *
+gtk_inspector_frame_store_flush (GtkInspectorFrameStore  *store,
+                                 GError                 **error)
+{
+  gtk_inspector_frame_store_wait (store, store->n_frames);
+
+  if (gtk_inspector_frame_store_get_error (store, error))
+    return NULL;
+
+  return g_object_ref (store->file);
+}
+
+// vim: set et sw=2 ts=2:
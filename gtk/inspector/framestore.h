@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <gsk/gsk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtkInspectorFrameStore GtkInspectorFrameStore;
+
+GtkInspectorFrameStore *
+                gtk_inspector_frame_store_new           (GError                 **error);
+void            gtk_inspector_frame_store_free          (GtkInspectorFrameStore  *store);
+
+guint           gtk_inspector_frame_store_add           (GtkInspectorFrameStore  *store,
+                                                         gint64                   timestamp,
+                                                         const GdkRectangle      *area,
+                                                         const cairo_region_t    *clip_region,
+                                                         GskRenderNode           *node);
+GskRenderNode * gtk_inspector_frame_store_load          (GtkInspectorFrameStore  *store,
+                                                         guint                    frame,
+                                                         GError                 **error);
+GFile *         gtk_inspector_frame_store_flush         (GtkInspectorFrameStore  *store,
+                                                         GError                 **error);
+
+G_END_DECLS
+
+// vim: set et sw=2 ts=2:
@@ -209,6 +209,12 @@ struct _GtkInspectorRecorder
   GtkInspectorRecording *recording; /* start recording if recording or NULL if not */
   gint64 start_time;
 
+  /* render recordings that keep their node in memory, oldest first */
+  GQueue resident_frames;
+  /* all recorded frames, so they can be unloaded and saved */
+  GtkInspectorFrameStore *frame_store;
+  gboolean frame_store_failed;
+
   gboolean debug_nodes;
   gboolean highlight_sequences;
 
@@ -385,11 +391,83 @@ create_list_model_for_render_node_paintable (gpointer paintable,
   return create_list_model_for_render_node (node);
 }
 
+/* Keep this many frames in memory, older ones are loaded
+ * from the frame store when they are looked at again.
+ */
+#define MAX_RESIDENT_FRAMES 100
+
+static GtkInspectorFrameStore *
+gtk_inspector_recorder_get_frame_store (GtkInspectorRecorder *recorder)
+{
+  GError *error = NULL;
+
+  if (recorder->frame_store == NULL && !recorder->frame_store_failed)
+    {
+      recorder->frame_store = gtk_inspector_frame_store_new (&error);
+      if (recorder->frame_store == NULL)
+        {
+          g_warning ("Failed to create file for recorded frames: %s", error->message);
+          g_error_free (error);
+          recorder->frame_store_failed = TRUE;
+        }
+    }
+
+  return recorder->frame_store;
+}
+
+static void
+gtk_inspector_recorder_make_resident (GtkInspectorRecorder        *recorder,
+                                      GtkInspectorRenderRecording *recording)
+{
+  GList *l;
+
+  l = g_queue_find (&recorder->resident_frames, recording);
+  if (l)
+    {
+      g_queue_unlink (&recorder->resident_frames, l);
+      g_queue_push_tail_link (&recorder->resident_frames, l);
+      return;
+    }
+
+  g_queue_push_tail (&recorder->resident_frames, g_object_ref (recording));
+
+  if (g_queue_get_length (&recorder->resident_frames) <= MAX_RESIDENT_FRAMES)
+    return;
+
+  recording = g_queue_pop_head (&recorder->resident_frames);
+  gtk_inspector_render_recording_unload (recording);
+  g_object_unref (recording);
+}
+
+/* Returns the node of the recording, loading it from the frame
+ * store if necessary, or NULL if that fails.
+ */
+static GskRenderNode *
+gtk_inspector_recorder_get_frame_node (GtkInspectorRecorder        *recorder,
+                                       GtkInspectorRenderRecording *recording)
+{
+  if (!gtk_inspector_render_recording_load (recording, recorder->frame_store))
+    return NULL;
+
+  gtk_inspector_recorder_make_resident (recorder, recording);
+
+  return gtk_inspector_render_recording_get_node (recording);
+}
+
+static void
+gtk_inspector_recorder_clear_resident_frames (GtkInspectorRecorder *recorder)
+{
+  g_queue_clear_full (&recorder->resident_frames, g_object_unref);
+  g_clear_pointer (&recorder->frame_store, gtk_inspector_frame_store_free);
+  recorder->frame_store_failed = FALSE;
+}
+
 static void
 recordings_clear_all (GtkButton            *button,
                       GtkInspectorRecorder *recorder)
 {
   g_list_store_remove_all (G_LIST_STORE (recorder->recordings));
+  gtk_inspector_recorder_clear_resident_frames (recorder);
 }
 
 static const char *
@@ -726,6 +804,15 @@ show_event (GtkInspectorRecorder *recorder,
 static void populate_event_properties (GListStore *store,
                                        GdkEvent   *event);
 
+static void
+show_no_data (GtkInspectorRecorder *recorder)
+{
+  gtk_stack_set_visible_child_name (GTK_STACK (recorder->recording_data_stack), "no_data");
+
+  gtk_picture_set_paintable (GTK_PICTURE (recorder->render_node_view), NULL);
+  g_list_store_remove_all (recorder->render_node_root_model);
+}
+
 static void
 recording_selected (GtkSingleSelection   *selection,
                     GParamSpec           *pspec,
@@ -746,9 +833,15 @@ recording_selected (GtkSingleSelection   *selection,
     {
       GskRenderNode *node;
 
-      gtk_stack_set_visible_child_name (GTK_STACK (recorder->recording_data_stack), "frame_data");
+      node = gtk_inspector_recorder_get_frame_node (recorder, GTK_INSPECTOR_RENDER_RECORDING (recording));
+      if (node == NULL)
+        {
+          show_no_data (recorder);
+          gtk_inspector_recorder_set_selected_sequence (recorder, NULL);
+          return;
+        }
 
-      node = gtk_inspector_render_recording_get_node (GTK_INSPECTOR_RENDER_RECORDING (recording));
+      gtk_stack_set_visible_child_name (GTK_STACK (recorder->recording_data_stack), "frame_data");
       show_render_node (recorder, node);
     }
   else if (GTK_INSPECTOR_IS_EVENT_RECORDING (recording))
@@ -768,7 +861,14 @@ recording_selected (GtkSingleSelection   *selection,
             {
               GskRenderNode *node;
 
-              node = gtk_inspector_render_recording_get_node (GTK_INSPECTOR_RENDER_RECORDING (item));
+              node = gtk_inspector_recorder_get_frame_node (recorder, GTK_INSPECTOR_RENDER_RECORDING (item));
+              if (node == NULL)
+                {
+                  show_no_data (recorder);
+                  gtk_inspector_recorder_set_selected_sequence (recorder, NULL);
+                  return;
+                }
+
               show_event (recorder, node, event);
               break;
             }
@@ -781,10 +881,7 @@ recording_selected (GtkSingleSelection   *selection,
     }
   else
     {
-      gtk_stack_set_visible_child_name (GTK_STACK (recorder->recording_data_stack), "no_data");
-
-      gtk_picture_set_paintable (GTK_PICTURE (recorder->render_node_view), NULL);
-      g_list_store_remove_all (recorder->render_node_root_model);
+      show_no_data (recorder);
     }
 
   gtk_inspector_recorder_set_selected_sequence (recorder, selected_sequence);
@@ -1991,6 +2088,103 @@ render_node_save (GtkButton            *button,
   g_free (nodename);
 }
 
+static void
+recordings_save_failed (GtkInspectorRecorder *recorder,
+                        GError               *error)
+{
+  GtkAlertDialog *alert;
+
+  alert = gtk_alert_dialog_new (_("Saving recorded frames failed"));
+  gtk_alert_dialog_set_detail (alert, error->message);
+  gtk_alert_dialog_show (alert, GTK_WINDOW (gtk_widget_get_root (GTK_WIDGET (recorder))));
+  g_object_unref (alert);
+}
+
+static void
+recordings_save_copied (GObject      *source,
+                        GAsyncResult *result,
+                        gpointer      data)
+{
+  GtkInspectorRecorder *recorder = data;
+  GError *error = NULL;
+
+  if (!g_file_copy_finish (G_FILE (source), result, &error))
+    {
+      recordings_save_failed (recorder, error);
+      g_error_free (error);
+    }
+
+  g_object_unref (recorder);
+}
+
+static void
+recordings_save_response (GObject      *source,
+                          GAsyncResult *result,
+                          gpointer      data)
+{
+  GtkFileDialog *dialog = GTK_FILE_DIALOG (source);
+  GtkInspectorRecorder *recorder = data;
+  GFile *file, *frames;
+  GError *error = NULL;
+
+  file = gtk_file_dialog_save_finish (dialog, result, &error);
+  if (file == NULL)
+    {
+      g_print ("Error saving frames: %s\n", error->message);
+      g_error_free (error);
+      g_object_unref (recorder);
+      return;
+    }
+
+  if (recorder->frame_store == NULL)
+    {
+      g_object_unref (file);
+      g_object_unref (recorder);
+      return;
+    }
+
+  /* Frames recorded while copying may end up incomplete at the end
+   * of the copy, readers ignore those.
+   */
+  frames = gtk_inspector_frame_store_flush (recorder->frame_store, &error);
+  if (frames == NULL)
+    {
+      recordings_save_failed (recorder, error);
+      g_error_free (error);
+      g_object_unref (file);
+      g_object_unref (recorder);
+      return;
+    }
+
+  g_file_copy_async (frames, file,
+                     G_FILE_COPY_OVERWRITE,
+                     G_PRIORITY_DEFAULT,
+                     NULL,
+                     NULL, NULL,
+                     recordings_save_copied, recorder);
+
+  g_object_unref (frames);
+  g_object_unref (file);
+}
+
+static void
+recordings_save (GtkButton            *button,
+                 GtkInspectorRecorder *recorder)
+{
+  GtkFileDialog *dialog;
+
+  if (recorder->frame_store == NULL)
+    return;
+
+  dialog = gtk_file_dialog_new ();
+  gtk_file_dialog_set_initial_name (dialog, "frames.recording");
+  gtk_file_dialog_save (dialog,
+                        GTK_WINDOW (gtk_widget_get_root (GTK_WIDGET (recorder))),
+                        NULL,
+                        recordings_save_response, g_object_ref (recorder));
+  g_object_unref (dialog);
+}
+
 static void
 render_node_clip (GtkButton            *button,
                   GtkInspectorRecorder *recorder)
@@ -2258,6 +2452,7 @@ gtk_inspector_recorder_dispose (GObject *object)
   g_clear_object (&recorder->render_node_model);
   g_clear_object (&recorder->render_node_root_model);
   g_clear_object (&recorder->render_node_selection);
+  gtk_inspector_recorder_clear_resident_frames (recorder);
 
   gtk_widget_dispose_template (GTK_WIDGET (recorder), GTK_TYPE_INSPECTOR_RECORDER);
 
@@ -2303,6 +2498,7 @@ gtk_inspector_recorder_class_init (GtkInspectorRecorderClass *klass)
   gtk_widget_class_bind_template_child (widget_class, GtkInspectorRecorder, event_property_tree);
 
   gtk_widget_class_bind_template_callback (widget_class, recordings_clear_all);
+  gtk_widget_class_bind_template_callback (widget_class, recordings_save);
   gtk_widget_class_bind_template_callback (widget_class, recording_selected);
   gtk_widget_class_bind_template_callback (widget_class, render_node_save);
   gtk_widget_class_bind_template_callback (widget_class, render_node_clip);
@@ -2466,6 +2662,9 @@ gtk_inspector_recorder_record_render (GtkInspectorRecorder *recorder,
                                                   region,
                                                   node);
   gtk_inspector_recorder_add_recording (recorder, recording);
+  if (gtk_inspector_recorder_get_frame_store (recorder))
+    gtk_inspector_render_recording_store (GTK_INSPECTOR_RENDER_RECORDING (recording), recorder->frame_store);
+  gtk_inspector_recorder_make_resident (recorder, GTK_INSPECTOR_RENDER_RECORDING (recording));
   g_object_unref (recording);
 }
 
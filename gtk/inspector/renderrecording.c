@@ -80,12 +80,68 @@ gtk_inspector_render_recording_new (gint64                timestamp,
   return GTK_INSPECTOR_RECORDING (recording);
 }
 
+/* Returns the node, or NULL if it was unloaded by
+ * gtk_inspector_render_recording_unload(). Use
+ * gtk_inspector_render_recording_load() to get it back.
+ */
 GskRenderNode *
 gtk_inspector_render_recording_get_node (GtkInspectorRenderRecording *recording)
 {
   return recording->node;
 }
 
+/* Queues the node for writing to @store, so it can be
+ * unloaded when it isn't needed.
+ */
+void
+gtk_inspector_render_recording_store (GtkInspectorRenderRecording *recording,
+                                      GtkInspectorFrameStore      *store)
+{
+  if (recording->stored || recording->node == NULL)
+    return;
+
+  recording->frame = gtk_inspector_frame_store_add (store,
+                                                    gtk_inspector_recording_get_timestamp (GTK_INSPECTOR_RECORDING (recording)),
+                                                    &recording->area,
+                                                    recording->clip_region,
+                                                    recording->node);
+  recording->stored = TRUE;
+}
+
+/* Drops the node from memory if it can be loaded again */
+void
+gtk_inspector_render_recording_unload (GtkInspectorRenderRecording *recording)
+{
+  if (recording->stored)
+    g_clear_pointer (&recording->node, gsk_render_node_unref);
+}
+
+/* Loads the node again if it was unloaded.
+ * Returns FALSE if that failed.
+ */
+gboolean
+gtk_inspector_render_recording_load (GtkInspectorRenderRecording *recording,
+                                     GtkInspectorFrameStore      *store)
+{
+  GError *error = NULL;
+
+  if (recording->node != NULL)
+    return TRUE;
+
+  if (!recording->stored || store == NULL)
+    return FALSE;
+
+  recording->node = gtk_inspector_frame_store_load (store, recording->frame, &error);
+  if (recording->node == NULL)
+    {
+      g_warning ("Failed to load recorded frame: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 const cairo_region_t *
 gtk_inspector_render_recording_get_clip_region (GtkInspectorRenderRecording *recording)
 {
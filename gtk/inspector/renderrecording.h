@@ -22,6 +22,7 @@
 #include "gsk/gskprofilerprivate.h"
 
 #include "inspector/recording.h"
+#include "inspector/framestore.h"
 
 G_BEGIN_DECLS
 
@@ -43,6 +44,10 @@ typedef struct _GtkInspectorRenderRecording
   cairo_region_t *clip_region;
   GskRenderNode *node;
   char *profiler_info;
+
+  /* The number of the frame in the frame store, if it was written there */
+  gboolean stored;
+  guint frame;
 } GtkInspectorRenderRecording;
 
 typedef struct _GtkInspectorRenderRecordingClass
@@ -60,6 +65,11 @@ GtkInspectorRecording *
                                                               GskRenderNode                     *node);
 
 GskRenderNode * gtk_inspector_render_recording_get_node      (GtkInspectorRenderRecording       *recording);
+void            gtk_inspector_render_recording_store         (GtkInspectorRenderRecording       *recording,
+                                                              GtkInspectorFrameStore            *store);
+void            gtk_inspector_render_recording_unload        (GtkInspectorRenderRecording       *recording);
+gboolean        gtk_inspector_render_recording_load          (GtkInspectorRenderRecording       *recording,
+                                                              GtkInspectorFrameStore            *store);
 const cairo_region_t *
                 gtk_inspector_render_recording_get_clip_region (GtkInspectorRenderRecording     *recording);
 const cairo_rectangle_int_t *
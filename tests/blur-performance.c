@@ -16,39 +16,57 @@ init_surface (cairo_t *cr)
   cairo_fill (cr);
 }
 
-int
-main (int argc, char **argv)
+static void
+run_benchmark (int          size,
+               GskBlurFlags flags,
+               const char  *name)
 {
   cairo_surface_t *surface;
   cairo_t *cr;
   GTimer *timer;
   double msec;
   int i, j;
-  int size;
 
   timer = g_timer_new ();
 
-  size = 2000;
-
   surface = cairo_image_surface_create (CAIRO_FORMAT_A8, size, size);
 
   cr = cairo_create (surface);
 
+  g_print ("%dx%d, %s:\n", size, size, name);
+
   /* We do everything three times, first two as warmup */
-  for (j = 0; j < 2; j++)
+  for (j = 0; j < 3; j++)
     {
       for (i = 1; i < 16; i++)
 	{
 	  init_surface (cr);
 	  g_timer_start (timer);
-	  gsk_cairo_blur_surface (surface, i, GSK_BLUR_X | GSK_BLUR_Y);
+	  gsk_cairo_blur_surface (surface, i, flags);
 	  msec = g_timer_elapsed (timer, NULL) * 1000;
-	  if (j == 1)
-	    g_print ("Radius %2d: %.2f msec, %.2f kpixels/msec:\n", i, msec, size*size/(msec*1000));
+	  if (j == 2)
+	    g_print ("Radius %2d: %.2f msec, %.2f kpixels/msec\n", i, msec, size*size/(msec*1000));
 	}
     }
 
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
   g_timer_destroy (timer);
+}
+
+int
+main (int argc, char **argv)
+{
+  /* A shadow of a popover, of a dialog and of a fullscreen window */
+  const int sizes[] = { 200, 800, 2000 };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      run_benchmark (sizes[i], GSK_BLUR_X, "horizontal");
+      run_benchmark (sizes[i], GSK_BLUR_Y, "vertical");
+      run_benchmark (sizes[i], GSK_BLUR_X | GSK_BLUR_Y, "both");
+    }
 
   return 0;
 }
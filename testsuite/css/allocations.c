@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2024 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+#include "gtk/gtkcssvalueprivate.h"
+#include "gtk/gtkcssnumbervalueprivate.h"
+#include "gtk/gtkcssnodeprivate.h"
+#include "gtk/gtkwidgetprivate.h"
+
+static void
+test_px_cache (void)
+{
+  GtkCssValue *a, *b, *c;
+  guint before;
+
+  a = gtk_css_dimension_value_new (12.5, GTK_CSS_PX);
+
+  /* The same px value is shared instead of allocated again */
+  before = gtk_css_value_get_n_allocated ();
+  b = gtk_css_dimension_value_new (12.5, GTK_CSS_PX);
+  g_assert_cmpuint (gtk_css_value_get_n_allocated (), ==, before);
+  g_assert_true (a == b);
+  gtk_css_value_unref (b);
+
+  c = gtk_css_dimension_value_new (13.5, GTK_CSS_PX);
+  g_assert_true (c != a);
+  g_assert_cmpfloat (gtk_css_number_value_get (c, 100), ==, 13.5);
+  gtk_css_value_unref (c);
+
+  /* Other units are not shared */
+  b = gtk_css_dimension_value_new (12.5, GTK_CSS_EM);
+  c = gtk_css_dimension_value_new (12.5, GTK_CSS_EM);
+  g_assert_true (b != c);
+  gtk_css_value_unref (b);
+  gtk_css_value_unref (c);
+
+  /* Evicting values from the cache keeps them alive for their users */
+  for (guint i = 0; i < 1000; i++)
+    {
+      b = gtk_css_dimension_value_new (i + 0.25, GTK_CSS_PX);
+      g_assert_cmpfloat (gtk_css_number_value_get (b, 100), ==, i + 0.25);
+      gtk_css_value_unref (b);
+    }
+
+  g_assert_cmpfloat (gtk_css_number_value_get (a, 100), ==, 12.5);
+  g_assert_true (gtk_css_value_is_computed (a));
+  gtk_css_value_unref (a);
+}
+
+static guint
+count_nodes (GtkCssNode *node)
+{
+  GtkCssNode *child;
+  guint n = 1;
+
+  for (child = gtk_css_node_get_first_child (node);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    n += count_nodes (child);
+
+  return n;
+}
+
+/* Switching the theme restyles every node, so this shows how many
+ * values a restyle allocates per node. The numbers are only printed,
+ * since they depend on the theme.
+ */
+static void
+test_theme_switch (void)
+{
+  const char *themes[] = { "Default-dark", "Default", "Default-hc", "Default" };
+  GtkCssProvider *provider;
+  GtkSettings *settings;
+  GtkWidget *window, *box;
+  GtkCssNode *root;
+  char *theme_name;
+  guint n_nodes;
+
+  settings = gtk_settings_get_default ();
+  g_object_get (settings, "gtk-theme-name", &theme_name, NULL);
+
+  /* em, pt and calc() all compute to px */
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_string (provider,
+                                     "label { margin: 0.5em; padding: 3pt; }\n"
+                                     "button { min-height: calc(1em + 6px); }\n");
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  window = gtk_window_new ();
+  box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  gtk_window_set_child (GTK_WINDOW (window), box);
+
+  for (guint i = 0; i < 200; i++)
+    {
+      GtkWidget *row = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+
+      gtk_box_append (GTK_BOX (row), gtk_label_new ("Label"));
+      gtk_box_append (GTK_BOX (row), gtk_button_new_with_label ("Button"));
+      gtk_box_append (GTK_BOX (row), gtk_entry_new ());
+      gtk_box_append (GTK_BOX (box), row);
+    }
+
+  root = gtk_widget_get_css_node (window);
+  gtk_css_node_validate (root);
+  n_nodes = count_nodes (root);
+
+  for (guint i = 0; i < G_N_ELEMENTS (themes); i++)
+    {
+      guint before, allocated;
+
+      /* Loading the theme allocates values too, don't count those */
+      g_object_set (settings, "gtk-theme-name", themes[i], NULL);
+
+      before = gtk_css_value_get_n_allocated ();
+      gtk_css_node_validate (root);
+      allocated = gtk_css_value_get_n_allocated () - before;
+
+      g_test_message ("%s: %u values for %u nodes, %.1f per node",
+                      themes[i], allocated, n_nodes, (double) allocated / n_nodes);
+    }
+
+  gtk_window_destroy (GTK_WINDOW (window));
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (provider);
+
+  g_object_set (settings, "gtk-theme-name", theme_name, NULL);
+  g_free (theme_name);
+}
+
+int
+main (int argc, char **argv)
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/css/allocations/px-cache", test_px_cache);
+  g_test_add_func ("/css/allocations/theme-switch", test_theme_switch);
+
+  return g_test_run ();
+}
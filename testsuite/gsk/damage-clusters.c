@@ -0,0 +1,224 @@
+#include <gtk/gtk.h>
+#include "gsk/gpu/gskgpuframeprivate.h"
+
+static gsize
+count_pixels (const cairo_rectangle_int_t *clusters,
+              gsize                        n_clusters)
+{
+  gsize i, pixels;
+
+  pixels = 0;
+  for (i = 0; i < n_clusters; i++)
+    pixels += (gsize) clusters[i].width * clusters[i].height;
+
+  return pixels;
+}
+
+static gsize
+count_region_pixels (const cairo_region_t *region)
+{
+  gsize pixels;
+  int i;
+
+  pixels = 0;
+  for (i = 0; i < cairo_region_num_rectangles (region); i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (region, i, &rect);
+      pixels += (gsize) rect.width * rect.height;
+    }
+
+  return pixels;
+}
+
+static void
+assert_clusters_valid (const cairo_region_t        *region,
+                       const cairo_rectangle_int_t *clusters,
+                       gsize                        n_clusters)
+{
+  cairo_region_t *covered;
+  gsize i, j;
+
+  g_assert_cmpuint (n_clusters, <=, GSK_GPU_FRAME_MAX_CLUSTERS);
+
+  /* every pixel gets drawn exactly once */
+  for (i = 0; i < n_clusters; i++)
+    {
+      for (j = i + 1; j < n_clusters; j++)
+        g_assert_false (gdk_rectangle_intersect (&clusters[i], &clusters[j], NULL));
+    }
+
+  covered = cairo_region_create ();
+  for (i = 0; i < n_clusters; i++)
+    cairo_region_union_rectangle (covered, &clusters[i]);
+  cairo_region_subtract (covered, region);
+  g_assert_cmpuint (count_pixels (clusters, n_clusters), ==,
+                    count_region_pixels (region) + count_region_pixels (covered));
+  cairo_region_destroy (covered);
+
+  covered = cairo_region_copy (region);
+  for (i = 0; i < n_clusters; i++)
+    cairo_region_subtract_rectangle (covered, &clusters[i]);
+  g_assert_true (cairo_region_is_empty (covered));
+  cairo_region_destroy (covered);
+}
+
+static void
+test_clusters_empty (void)
+{
+  cairo_rectangle_int_t clusters[GSK_GPU_FRAME_MAX_CLUSTERS];
+  cairo_region_t *region;
+
+  region = cairo_region_create ();
+  g_assert_cmpuint (gsk_gpu_frame_cluster_region (region, clusters), ==, 0);
+  cairo_region_destroy (region);
+}
+
+static void
+test_clusters_scattered (void)
+{
+  cairo_rectangle_int_t clusters[GSK_GPU_FRAME_MAX_CLUSTERS];
+  cairo_region_t *region;
+  gsize n_clusters;
+
+  /* a cursor, a clock and a spinner */
+  region = cairo_region_create ();
+  cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { 100, 100, 2, 20 });
+  cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { 1800, 10, 60, 20 });
+  cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { 900, 500, 16, 16 });
+
+  n_clusters = gsk_gpu_frame_cluster_region (region, clusters);
+
+  assert_clusters_valid (region, clusters, n_clusters);
+  g_assert_cmpuint (n_clusters, ==, 3);
+  g_assert_cmpuint (count_pixels (clusters, n_clusters), ==, count_region_pixels (region));
+
+  cairo_region_destroy (region);
+}
+
+static void
+test_clusters_adjacent (void)
+{
+  cairo_rectangle_int_t clusters[GSK_GPU_FRAME_MAX_CLUSTERS];
+  cairo_region_t *region;
+  gsize n_clusters;
+
+  /* cairo splits this into 3 rectangles, but one pass is enough */
+  region = cairo_region_create ();
+  cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { 0, 0, 100, 100 });
+  cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { 50, 50, 100, 100 });
+
+  n_clusters = gsk_gpu_frame_cluster_region (region, clusters);
+
+  assert_clusters_valid (region, clusters, n_clusters);
+  g_assert_cmpuint (n_clusters, ==, 1);
+  g_assert_cmpuint (count_pixels (clusters, n_clusters), ==, 150 * 150);
+
+  cairo_region_destroy (region);
+}
+
+static void
+test_clusters_many (void)
+{
+  cairo_rectangle_int_t clusters[GSK_GPU_FRAME_MAX_CLUSTERS];
+  cairo_region_t *region;
+  gsize n_clusters;
+  int x, y;
+
+  /* 4 groups of 16 small rectangles each in the corners of a large window */
+  region = cairo_region_create ();
+  for (y = 0; y < 4; y++)
+    {
+      for (x = 0; x < 4; x++)
+        {
+          cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { x * 20, y * 20, 10, 10 });
+          cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { 3000 + x * 20, y * 20, 10, 10 });
+          cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { x * 20, 2000 + y * 20, 10, 10 });
+          cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { 3000 + x * 20, 2000 + y * 20, 10, 10 });
+        }
+    }
+
+  n_clusters = gsk_gpu_frame_cluster_region (region, clusters);
+
+  assert_clusters_valid (region, clusters, n_clusters);
+  /* each group ends up in its own pass and the window isn't redrawn */
+  g_assert_cmpuint (n_clusters, ==, 4);
+  g_assert_cmpuint (count_pixels (clusters, n_clusters), ==, 4 * 70 * 70);
+
+  cairo_region_destroy (region);
+}
+
+static void
+test_clusters_huge (void)
+{
+  cairo_rectangle_int_t clusters[GSK_GPU_FRAME_MAX_CLUSTERS];
+  cairo_region_t *region;
+  gsize n_clusters;
+  int x, y;
+
+  /* a grid of 5000 dots, which is too many to merge pair by pair */
+  region = cairo_region_create ();
+  for (y = 0; y < 250; y++)
+    {
+      for (x = 0; x < 20; x++)
+        cairo_region_union_rectangle (region, &(cairo_rectangle_int_t) { x * 4, y * 4, 2, 2 });
+    }
+  g_assert_cmpint (cairo_region_num_rectangles (region), ==, 5000);
+
+  n_clusters = gsk_gpu_frame_cluster_region (region, clusters);
+
+  assert_clusters_valid (region, clusters, n_clusters);
+  g_assert_cmpuint (count_pixels (clusters, n_clusters), <=, 78 * 998);
+
+  cairo_region_destroy (region);
+}
+
+static void
+test_clusters_random (void)
+{
+  cairo_rectangle_int_t clusters[GSK_GPU_FRAME_MAX_CLUSTERS];
+  cairo_region_t *region;
+  cairo_rectangle_int_t extents;
+  gsize n_clusters;
+  guint i, n, run;
+
+  for (run = 0; run < 100; run++)
+    {
+      region = cairo_region_create ();
+      n = g_test_rand_int_range (1, 40);
+      for (i = 0; i < n; i++)
+        {
+          cairo_region_union_rectangle (region,
+                                        &(cairo_rectangle_int_t) {
+                                          g_test_rand_int_range (0, 2000),
+                                          g_test_rand_int_range (0, 1000),
+                                          g_test_rand_int_range (1, 200),
+                                          g_test_rand_int_range (1, 200)
+                                        });
+        }
+
+      n_clusters = gsk_gpu_frame_cluster_region (region, clusters);
+
+      assert_clusters_valid (region, clusters, n_clusters);
+      cairo_region_get_extents (region, &extents);
+      g_assert_cmpuint (count_pixels (clusters, n_clusters), <=, (gsize) extents.width * extents.height);
+
+      cairo_region_destroy (region);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/gpu/damage-clusters/empty", test_clusters_empty);
+  g_test_add_func ("/gpu/damage-clusters/scattered", test_clusters_scattered);
+  g_test_add_func ("/gpu/damage-clusters/adjacent", test_clusters_adjacent);
+  g_test_add_func ("/gpu/damage-clusters/many", test_clusters_many);
+  g_test_add_func ("/gpu/damage-clusters/huge", test_clusters_huge);
+  g_test_add_func ("/gpu/damage-clusters/random", test_clusters_random);
+
+  return g_test_run ();
+}
@@ -95,6 +95,196 @@ test_can_diff_transform (void)
   gsk_transform_unref (t2);
 }
 
+static void
+test_hash_basic (void)
+{
+  GskRenderNode *color1, *color2, *color3;
+  GskRenderNode *container1, *container2;
+  GskRenderNode *cairo;
+  guint64 hash;
+
+  color1 = gsk_color_node_new (&(GdkRGBA){0, 1, 0, 1 }, &GRAPHENE_RECT_INIT (0, 0, 10, 10));
+  color2 = gsk_color_node_new (&(GdkRGBA){0, 1, 0, 1 }, &GRAPHENE_RECT_INIT (0, 0, 10, 10));
+  color3 = gsk_color_node_new (&(GdkRGBA){1, 1, 0, 1 }, &GRAPHENE_RECT_INIT (0, 0, 10, 10));
+
+  container1 = gsk_container_node_new ((GskRenderNode *[]) { color1, color3 }, 2);
+  container2 = gsk_container_node_new ((GskRenderNode *[]) { color2, color3 }, 2);
+
+  cairo = gsk_cairo_node_new (&GRAPHENE_RECT_INIT (0, 0, 10, 10));
+
+  /* Equal nodes have equal hashes */
+  g_assert_true (gsk_render_node_hash_equal (color1, color2));
+  g_assert_true (gsk_render_node_hash_equal (container1, container2));
+  /* Different ones don't */
+  g_assert_false (gsk_render_node_hash_equal (color1, color3));
+  g_assert_false (gsk_render_node_hash_equal (color1, container1));
+  /* Cairo nodes can't be hashed */
+  g_assert_false (gsk_render_node_get_hash (cairo, &hash));
+  g_assert_true (gsk_render_node_hash_equal (cairo, cairo));
+
+  gsk_render_node_unref (color1);
+  gsk_render_node_unref (color2);
+  gsk_render_node_unref (color3);
+  gsk_render_node_unref (container1);
+  gsk_render_node_unref (container2);
+  gsk_render_node_unref (cairo);
+}
+
+#define N_CHILDREN 2000
+
+static GskRenderNode *
+create_grid (guint first_changed)
+{
+  GskRenderNode *children[N_CHILDREN];
+  GskRenderNode *container;
+  guint i;
+
+  for (i = 0; i < N_CHILDREN; i++)
+    {
+      children[i] = gsk_color_node_new (i >= first_changed ? &(GdkRGBA) { 1, 0, 0, 1 }
+                                                           : &(GdkRGBA) { 0, 0, 1, 1 },
+                                        &GRAPHENE_RECT_INIT (i % 50 * 20, i / 50 * 20, 20, 20));
+    }
+
+  container = gsk_container_node_new (children, N_CHILDREN);
+
+  for (i = 0; i < N_CHILDREN; i++)
+    gsk_render_node_unref (children[i]);
+
+  return container;
+}
+
+static void
+test_diff_large_container (void)
+{
+  GskRenderNode *node1, *node2;
+  cairo_region_t *region;
+  cairo_rectangle_int_t rect;
+
+  node1 = create_grid (N_CHILDREN);
+  node2 = create_grid (N_CHILDREN / 2);
+
+  /* Enough children changed to compare them on multiple threads */
+  region = cairo_region_create ();
+  gsk_render_node_diff (node1, node2, &(GskDiffData) { region, NULL });
+
+  g_assert_cmpint (cairo_region_num_rectangles (region), ==, 1);
+  cairo_region_get_rectangle (region, 0, &rect);
+  g_assert_cmpint (rect.x, ==, 0);
+  g_assert_cmpint (rect.y, ==, 400);
+  g_assert_cmpint (rect.width, ==, 1000);
+  g_assert_cmpint (rect.height, ==, 400);
+
+  /* An identical copy is skipped by comparing hashes */
+  cairo_region_destroy (region);
+  gsk_render_node_unref (node2);
+  node2 = create_grid (N_CHILDREN);
+  region = cairo_region_create ();
+  gsk_render_node_diff (node1, node2, &(GskDiffData) { region, NULL });
+  g_assert_true (cairo_region_is_empty (region));
+
+  cairo_region_destroy (region);
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static GskRenderNode *
+load_node (const char *filename)
+{
+  GskRenderNode *node;
+  GError *error = NULL;
+  char *contents;
+  gsize length;
+  GBytes *bytes;
+
+  g_file_get_contents (filename, &contents, &length, &error);
+  g_assert_no_error (error);
+
+  bytes = g_bytes_new_take (contents, length);
+  node = gsk_render_node_deserialize (bytes, NULL, NULL);
+  g_bytes_unref (bytes);
+
+  return node;
+}
+
+#define N_RUNS 20
+
+/* Diffs each node file against a separately loaded copy of itself,
+ * which is the worst case for pointer comparisons.
+ */
+static void
+test_diff_benchmark (void)
+{
+  const char *name;
+  GError *error = NULL;
+  GDir *dir;
+  char *path;
+  guint i, n_files;
+  gint64 start, first, rest;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("only run in performance mode");
+      return;
+    }
+
+  path = g_test_build_filename (G_TEST_DIST, "compare", NULL);
+  dir = g_dir_open (path, 0, &error);
+  g_assert_no_error (error);
+
+  n_files = 0;
+  first = 0;
+  rest = 0;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      GskRenderNode *node1, *node2;
+      cairo_region_t *region;
+      char *filename;
+
+      if (!g_str_has_suffix (name, ".node"))
+        continue;
+
+      filename = g_build_filename (path, name, NULL);
+      node1 = load_node (filename);
+      node2 = load_node (filename);
+      g_free (filename);
+
+      if (node1 == NULL || node2 == NULL)
+        {
+          g_clear_pointer (&node1, gsk_render_node_unref);
+          g_clear_pointer (&node2, gsk_render_node_unref);
+          continue;
+        }
+
+      region = cairo_region_create ();
+
+      /* The first diff also computes the hashes */
+      start = g_get_monotonic_time ();
+      gsk_render_node_diff (node1, node2, &(GskDiffData) { region, NULL });
+      first += g_get_monotonic_time () - start;
+
+      start = g_get_monotonic_time ();
+      for (i = 0; i < N_RUNS; i++)
+        gsk_render_node_diff (node1, node2, &(GskDiffData) { region, NULL });
+      rest += g_get_monotonic_time () - start;
+
+      cairo_region_destroy (region);
+      gsk_render_node_unref (node1);
+      gsk_render_node_unref (node2);
+      n_files++;
+    }
+
+  g_dir_close (dir);
+  g_free (path);
+
+  g_test_message ("diffed %u files", n_files);
+  g_test_minimized_result ((double) first / G_USEC_PER_SEC,
+                           "first diff: %.3f ms", (double) first / 1000);
+  g_test_minimized_result ((double) rest / N_RUNS / G_USEC_PER_SEC,
+                           "repeated diff: %.3f ms", (double) rest / N_RUNS / 1000);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -103,6 +293,9 @@ main (int   argc,
 
   g_test_add_func ("/node/can-diff/basic", test_can_diff_basic);
   g_test_add_func ("/node/can-diff/transform", test_can_diff_transform);
+  g_test_add_func ("/node/hash/basic", test_hash_basic);
+  g_test_add_func ("/node/diff/large-container", test_diff_large_container);
+  g_test_add_func ("/node/diff/benchmark", test_diff_benchmark);
 
   return g_test_run ();
 }
@@ -243,6 +243,40 @@ test_renderer (GskRenderer *renderer)
   gdk_display_close (display);
 }
 
+static void
+test_node_arena (void)
+{
+  GskRenderNode *nodes[1000];
+  GskRenderNode *kept, *container;
+  guint i;
+
+  /* make sure the class exists, the first node of a type isn't in the arena */
+  kept = gsk_color_node_new (&(GdkRGBA) { 1, 0, 0, 1 }, &GRAPHENE_RECT_INIT (0, 0, 10, 10));
+  gsk_render_node_unref (kept);
+
+  gsk_render_node_arena_begin ();
+
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    nodes[i] = gsk_color_node_new (&(GdkRGBA) { 1, 0, 0, 1 }, &GRAPHENE_RECT_INIT (i, 0, 10, 10));
+  container = gsk_container_node_new (nodes, G_N_ELEMENTS (nodes));
+
+  gsk_render_node_arena_end ();
+
+  g_assert_true (GSK_IS_RENDER_NODE (nodes[0]));
+  g_assert_cmpint (gsk_render_node_get_node_type (nodes[0]), ==, GSK_COLOR_NODE);
+
+  /* a node outliving the others keeps working */
+  kept = gsk_render_node_ref (nodes[500]);
+
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    gsk_render_node_unref (nodes[i]);
+  gsk_render_node_unref (container);
+
+  g_assert_cmpint (gsk_render_node_get_node_type (kept), ==, GSK_COLOR_NODE);
+  g_assert_cmpfloat (kept->bounds.origin.x, ==, 500);
+  gsk_render_node_unref (kept);
+}
+
 static void
 test_cairo_renderer (void)
 {
@@ -278,6 +312,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/rendernode/border/uniform", test_bordernode_uniform);
   g_test_add_func ("/rendernode/conic-gradient/angle", test_conic_gradient_angle);
   g_test_add_func ("/rendernode/container/disjoint", test_container_disjoint);
+  g_test_add_func ("/rendernode/arena", test_node_arena);
   g_test_add_func ("/renderer/cairo", test_cairo_renderer);
   g_test_add_func ("/renderer/gl", test_gl_renderer);
 
@@ -156,6 +156,44 @@ deserialize_error_func (const GskParseLocation *start,
   g_string_append_c (errors, '\n');
 }
 
+static gboolean
+check_binary_roundtrip (GskRenderNode *node,
+                        GBytes        *text)
+{
+  GskRenderNode *copy;
+  GBytes *binary, *copy_text;
+  GString *errors;
+  gboolean result = TRUE;
+
+  binary = gsk_render_node_serialize_binary (node);
+  errors = g_string_new ("");
+  copy = gsk_render_node_deserialize (binary, deserialize_error_func, errors);
+  g_bytes_unref (binary);
+
+  if (errors->str[0])
+    {
+      g_print ("Errors loading the binary format:\n%s\n", errors->str);
+      result = FALSE;
+    }
+  g_string_free (errors, TRUE);
+
+  if (copy == NULL)
+    return FALSE;
+
+  copy_text = gsk_render_node_serialize (copy);
+  if (!g_bytes_equal (text, copy_text))
+    {
+      g_print ("Binary format doesn't round-trip, got:\n%s\n",
+               (const char *) g_bytes_get_data (copy_text, NULL));
+      result = FALSE;
+    }
+
+  g_bytes_unref (copy_text);
+  gsk_render_node_unref (copy);
+
+  return result;
+}
+
 static gboolean
 parse_node_file (GFile *file, gboolean generate)
 {
@@ -180,16 +218,20 @@ parse_node_file (GFile *file, gboolean generate)
   node = gsk_render_node_deserialize (bytes, deserialize_error_func, errors);
   g_bytes_unref (bytes);
   bytes = gsk_render_node_serialize (node);
-  gsk_render_node_unref (node);
 
   if (generate)
     {
       g_print ("%s", (char *) g_bytes_get_data (bytes, NULL));
       g_bytes_unref (bytes);
       g_string_free (errors, TRUE);
+      gsk_render_node_unref (node);
       return TRUE;
     }
 
+  if (!check_binary_roundtrip (node, bytes))
+    result = FALSE;
+  gsk_render_node_unref (node);
+
   node_file = g_file_get_path (file);
   reference_file = test_get_reference_file (node_file);
 
@@ -762,6 +762,156 @@ test_segment (void)
     }
 }
 
+static float
+segment_distance (const graphene_point_t *p,
+                  const graphene_point_t *a,
+                  const graphene_point_t *b)
+{
+  float dx = b->x - a->x;
+  float dy = b->y - a->y;
+  float t;
+
+  t = ((p->x - a->x) * dx + (p->y - a->y) * dy) / (dx * dx + dy * dy);
+  t = CLAMP (t, 0, 1);
+
+  return graphene_point_distance (p, &GRAPHENE_POINT_INIT (a->x + t * dx, a->y + t * dy), NULL, NULL);
+}
+
+/* Long contours take shortcuts for in-fill and closest-point,
+ * so compare them to brute force.
+ */
+static void
+test_long_contour (void)
+{
+#define N_POINTS 1000
+  graphene_point_t points[N_POINTS];
+  GskPathBuilder *builder;
+  GskPath *path;
+  guint i, j;
+
+  builder = gsk_path_builder_new ();
+  for (i = 0; i < N_POINTS; i++)
+    {
+      float angle = 2 * G_PI * i / N_POINTS;
+      float radius = g_test_rand_double_range (200, 500);
+
+      points[i] = GRAPHENE_POINT_INIT (radius * cos (angle), radius * sin (angle));
+      if (i == 0)
+        gsk_path_builder_move_to (builder, points[i].x, points[i].y);
+      else
+        gsk_path_builder_line_to (builder, points[i].x, points[i].y);
+    }
+  gsk_path_builder_close (builder);
+  path = gsk_path_builder_free_to_path (builder);
+
+  for (i = 0; i < 1000; i++)
+    {
+      graphene_point_t p = GRAPHENE_POINT_INIT (g_test_rand_double_range (-600, 600),
+                                                g_test_rand_double_range (-600, 600));
+      GskPathPoint point;
+      gboolean inside = FALSE;
+      float distance, expected = INFINITY;
+
+      for (j = 0; j < N_POINTS; j++)
+        {
+          const graphene_point_t *a = &points[j];
+          const graphene_point_t *b = &points[(j + 1) % N_POINTS];
+
+          if ((a->y > p.y) != (b->y > p.y) &&
+              p.x < (b->x - a->x) * (p.y - a->y) / (b->y - a->y) + a->x)
+            inside = !inside;
+
+          expected = MIN (expected, segment_distance (&p, a, b));
+        }
+
+      g_assert_cmpint (gsk_path_in_fill (path, &p, GSK_FILL_RULE_EVEN_ODD), ==, inside);
+
+      g_assert_true (gsk_path_get_closest_point (path, &p, INFINITY, &point, &distance));
+      g_assert_cmpfloat_with_epsilon (distance, expected, 0.01);
+
+      if (expected < 50)
+        g_assert_true (gsk_path_get_closest_point (path, &p, 50, &point, &distance));
+      else
+        g_assert_false (gsk_path_get_closest_point (path, &p, expected - 0.5, &point, &distance));
+    }
+
+  gsk_path_unref (path);
+#undef N_POINTS
+}
+
+static void
+test_long_contour_benchmark (void)
+{
+#define N_POINTS 50000
+#define N_QUERIES 10000
+  GskPathBuilder *builder;
+  GskPath *path;
+  graphene_point_t *queries;
+  GskPathPoint point;
+  float distance;
+  guint i, n_inside, n_found;
+  double elapsed;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("only run in performance mode");
+      return;
+    }
+
+  g_test_timer_start ();
+
+  builder = gsk_path_builder_new ();
+  for (i = 0; i < N_POINTS; i++)
+    {
+      float angle = 2 * G_PI * i / N_POINTS;
+      float radius = g_test_rand_double_range (200, 500);
+
+      if (i == 0)
+        gsk_path_builder_move_to (builder, radius * cos (angle), radius * sin (angle));
+      else
+        gsk_path_builder_line_to (builder, radius * cos (angle), radius * sin (angle));
+    }
+  gsk_path_builder_close (builder);
+  path = gsk_path_builder_free_to_path (builder);
+
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed, "create with %u segments: %.3f ms", N_POINTS, elapsed * 1000);
+
+  queries = g_new (graphene_point_t, N_QUERIES);
+  for (i = 0; i < N_QUERIES; i++)
+    queries[i] = GRAPHENE_POINT_INIT (g_test_rand_double_range (-600, 600),
+                                      g_test_rand_double_range (-600, 600));
+
+  g_test_timer_start ();
+  n_inside = 0;
+  for (i = 0; i < N_QUERIES; i++)
+    n_inside += gsk_path_in_fill (path, &queries[i], GSK_FILL_RULE_WINDING);
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed / N_QUERIES, "in-fill: %.3f us", elapsed * G_USEC_PER_SEC / N_QUERIES);
+
+  g_test_timer_start ();
+  n_found = 0;
+  for (i = 0; i < N_QUERIES; i++)
+    n_found += gsk_path_get_closest_point (path, &queries[i], INFINITY, &point, &distance);
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed / N_QUERIES, "closest point: %.3f us", elapsed * G_USEC_PER_SEC / N_QUERIES);
+
+  /* Hit testing a stroke, most points are too far away */
+  g_test_timer_start ();
+  for (i = 0; i < N_QUERIES; i++)
+    gsk_path_get_closest_point (path, &queries[i], 5, &point, &distance);
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed / N_QUERIES, "closest point within 5: %.3f us", elapsed * G_USEC_PER_SEC / N_QUERIES);
+
+  g_test_message ("%u of %u points inside", n_inside, N_QUERIES);
+  g_assert_cmpuint (n_found, ==, N_QUERIES);
+
+  g_free (queries);
+  gsk_path_unref (path);
+#undef N_QUERIES
+#undef N_POINTS
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -772,6 +922,8 @@ main (int   argc,
   g_test_add_func ("/path/parse", test_parse);
   g_test_add_func ("/path/in-fill-union", test_in_fill_union);
   g_test_add_func ("/path/in-fill-rotated", test_in_fill_rotated);
+  g_test_add_func ("/path/long-contour", test_long_contour);
+  g_test_add_func ("/path/long-contour/benchmark", test_long_contour_benchmark);
   g_test_add_func ("/path/measure/split", test_split);
   g_test_add_func ("/path/measure/roundtrip", test_roundtrip);
   g_test_add_func ("/path/measure/segment", test_segment);
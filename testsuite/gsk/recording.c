@@ -0,0 +1,271 @@
+/*
+ * Copyright © 2024 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include "gsk/gskrecordingprivate.h"
+
+#define N_FRAMES 150
+
+static GdkTexture *
+create_texture (void)
+{
+  guchar data[4 * 4 * 4];
+  GBytes *bytes;
+  GdkTexture *texture;
+
+  for (gsize i = 0; i < sizeof (data); i++)
+    data[i] = i;
+
+  bytes = g_bytes_new (data, sizeof (data));
+  texture = gdk_memory_texture_new (4, 4, GDK_MEMORY_DEFAULT, bytes, 16);
+  g_bytes_unref (bytes);
+
+  return texture;
+}
+
+/* Every frame shares a large subtree with the others, and has its own
+ * texture with the same pixels and its own color node.
+ */
+static GPtrArray *
+create_frames (void)
+{
+  GPtrArray *frames;
+  GskRenderNode *children[50];
+  GskRenderNode *shared;
+
+  for (guint i = 0; i < G_N_ELEMENTS (children); i++)
+    children[i] = gsk_color_node_new (&(GdkRGBA) { i / 50., 0, 1, 1 },
+                                      &GRAPHENE_RECT_INIT (i * 10, 0, 10, 10));
+  shared = gsk_container_node_new (children, G_N_ELEMENTS (children));
+  for (guint i = 0; i < G_N_ELEMENTS (children); i++)
+    gsk_render_node_unref (children[i]);
+
+  frames = g_ptr_array_new_with_free_func ((GDestroyNotify) gsk_render_node_unref);
+
+  for (guint i = 0; i < N_FRAMES; i++)
+    {
+      GskRenderNode *nodes[3];
+      GdkTexture *texture;
+
+      texture = create_texture ();
+
+      nodes[0] = gsk_render_node_ref (shared);
+      nodes[1] = gsk_texture_node_new (texture, &GRAPHENE_RECT_INIT (0, 20, 4, 4));
+      nodes[2] = gsk_color_node_new (&(GdkRGBA) { 1, 0, 0, 1 },
+                                     &GRAPHENE_RECT_INIT (i, 30, 10, 10));
+
+      g_ptr_array_add (frames, gsk_container_node_new (nodes, G_N_ELEMENTS (nodes)));
+
+      for (guint j = 0; j < G_N_ELEMENTS (nodes); j++)
+        gsk_render_node_unref (nodes[j]);
+      g_object_unref (texture);
+    }
+
+  gsk_render_node_unref (shared);
+
+  return frames;
+}
+
+static GBytes *
+write_recording (GPtrArray *frames)
+{
+  GOutputStream *stream;
+  GskRecordingWriter *writer;
+  GError *error = NULL;
+  GBytes *bytes;
+
+  stream = g_memory_output_stream_new_resizable ();
+  writer = gsk_recording_writer_new (stream, &error);
+  g_assert_no_error (error);
+
+  for (guint i = 0; i < frames->len; i++)
+    {
+      cairo_region_t *clip;
+
+      clip = cairo_region_create_rectangle (&(cairo_rectangle_int_t) { i, 0, 10, 10 });
+      gsk_recording_writer_add_frame (writer,
+                                      i * 16667,
+                                      &(cairo_rectangle_int_t) { 0, 0, 500, 50 },
+                                      clip,
+                                      g_ptr_array_index (frames, i),
+                                      &error);
+      g_assert_no_error (error);
+      cairo_region_destroy (clip);
+    }
+
+  gsk_recording_writer_free (writer);
+
+  g_output_stream_close (stream, NULL, &error);
+  g_assert_no_error (error);
+  bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (stream));
+  g_object_unref (stream);
+
+  return bytes;
+}
+
+static GskRecordingReader *
+create_reader (GBytes *bytes)
+{
+  GInputStream *stream;
+  GskRecordingReader *reader;
+  GError *error = NULL;
+
+  stream = g_memory_input_stream_new_from_bytes (bytes);
+  reader = gsk_recording_reader_new (stream, &error);
+  g_assert_no_error (error);
+  g_object_unref (stream);
+
+  return reader;
+}
+
+static void
+assert_frame (GskRecordingReader *reader,
+              GPtrArray          *frames,
+              guint               i)
+{
+  GskRenderNode *node;
+  cairo_region_t *clip;
+  cairo_rectangle_int_t rect;
+  GBytes *expected, *result;
+  GError *error = NULL;
+
+  node = gsk_recording_reader_get_frame (reader, i, &clip, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (node);
+
+  g_assert_cmpint (gsk_recording_reader_get_timestamp (reader, i), ==, i * 16667);
+  cairo_region_get_extents (clip, &rect);
+  g_assert_cmpint (rect.x, ==, i);
+  g_assert_cmpint (rect.width, ==, 10);
+
+  expected = gsk_render_node_serialize (g_ptr_array_index (frames, i));
+  result = gsk_render_node_serialize (node);
+  g_assert_true (g_bytes_equal (expected, result));
+
+  g_bytes_unref (expected);
+  g_bytes_unref (result);
+  cairo_region_destroy (clip);
+  gsk_render_node_unref (node);
+}
+
+static void
+test_recording_roundtrip (void)
+{
+  GPtrArray *frames;
+  GskRecordingReader *reader;
+  GBytes *bytes;
+
+  frames = create_frames ();
+  bytes = write_recording (frames);
+  reader = create_reader (bytes);
+
+  g_assert_cmpuint (gsk_recording_reader_get_n_frames (reader), ==, N_FRAMES);
+
+  for (guint i = 0; i < N_FRAMES; i++)
+    assert_frame (reader, frames, i);
+
+  /* seek backwards and across keyframes */
+  assert_frame (reader, frames, 3);
+  assert_frame (reader, frames, 140);
+  assert_frame (reader, frames, 70);
+  assert_frame (reader, frames, 69);
+  assert_frame (reader, frames, 0);
+
+  gsk_recording_reader_free (reader);
+  g_bytes_unref (bytes);
+  g_ptr_array_unref (frames);
+}
+
+static void
+test_recording_delta (void)
+{
+  GPtrArray *frames;
+  GskRecordingReader *reader;
+  GBytes *bytes;
+  gsize keyframe_size;
+
+  frames = create_frames ();
+  bytes = write_recording (frames);
+  reader = create_reader (bytes);
+
+  g_assert_true (gsk_recording_reader_is_keyframe (reader, 0));
+  keyframe_size = gsk_recording_reader_get_size (reader, 0);
+
+  /* Later frames refer to the shared subtree and the texture
+   * with the same pixels instead of writing them again */
+  for (guint i = 1; i < 10; i++)
+    {
+      g_assert_false (gsk_recording_reader_is_keyframe (reader, i));
+      g_assert_cmpuint (gsk_recording_reader_get_size (reader, i) * 8, <, keyframe_size);
+    }
+
+  gsk_recording_reader_free (reader);
+  g_bytes_unref (bytes);
+  g_ptr_array_unref (frames);
+}
+
+static void
+test_recording_truncated (void)
+{
+  GPtrArray *frames;
+  GskRecordingReader *reader;
+  GBytes *bytes, *truncated;
+
+  frames = create_frames ();
+  bytes = write_recording (frames);
+  truncated = g_bytes_new_from_bytes (bytes, 0, g_bytes_get_size (bytes) - 1);
+  reader = create_reader (truncated);
+
+  /* The last frame is incomplete, everything before it can be read */
+  g_assert_cmpuint (gsk_recording_reader_get_n_frames (reader), ==, N_FRAMES - 1);
+  assert_frame (reader, frames, N_FRAMES - 2);
+
+  gsk_recording_reader_free (reader);
+  g_bytes_unref (truncated);
+  g_bytes_unref (bytes);
+  g_ptr_array_unref (frames);
+}
+
+static void
+test_recording_not_a_recording (void)
+{
+  GInputStream *stream;
+  GskRecordingReader *reader;
+  GError *error = NULL;
+
+  stream = g_memory_input_stream_new_from_data ("color { }", -1, NULL);
+  reader = gsk_recording_reader_new (stream, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+  g_assert_null (reader);
+
+  g_error_free (error);
+  g_object_unref (stream);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/recording/roundtrip", test_recording_roundtrip);
+  g_test_add_func ("/recording/delta", test_recording_delta);
+  g_test_add_func ("/recording/truncated", test_recording_truncated);
+  g_test_add_func ("/recording/not-a-recording", test_recording_not_a_recording);
+
+  return g_test_run ();
+}
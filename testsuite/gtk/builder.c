@@ -2421,6 +2421,9 @@ test_property_bindings (void)
     <child>\n\
      <object class=\"GtkLabel\" id=\"label\">\n\
        <property name=\"visible\">True</property>\n\
+       <property name=\"xalign\">0.25</property>\n\
+       <property name=\"justify\">center</property>\n\
+       <property name=\"halign\">end</property>\n\
      </object>\n\
   </child>\n\
  </template>\n\
@@ -2490,6 +2493,28 @@ test_template (void)
   g_object_unref (my_gtk_grid);
 }
 
+/* Templates share parsed property values between instances */
+static void
+test_template_values (void)
+{
+  for (guint i = 0; i < 3; i++)
+    {
+      MyGtkGrid *my_gtk_grid;
+
+      my_gtk_grid = g_object_new (MY_TYPE_GTK_GRID, NULL);
+      g_object_ref_sink (my_gtk_grid);
+
+      g_assert_cmpfloat (gtk_label_get_xalign (my_gtk_grid->label), ==, 0.25);
+      g_assert_cmpint (gtk_label_get_justify (my_gtk_grid->label), ==, GTK_JUSTIFY_CENTER);
+      g_assert_cmpint (gtk_widget_get_halign (GTK_WIDGET (my_gtk_grid->label)), ==, GTK_ALIGN_END);
+
+      /* Changing one instance must not affect the next one */
+      gtk_label_set_xalign (my_gtk_grid->label, 1.0);
+
+      g_object_unref (my_gtk_grid);
+    }
+}
+
 _BUILDER_TEST_EXPORT void
 on_cellrenderertoggle1_toggled (GtkCellRendererToggle *cell)
 {
@@ -2957,6 +2982,7 @@ main (int argc, char **argv)
   g_test_add_func ("/Builder/LevelBar", test_level_bar);
   g_test_add_func ("/Builder/Expose Object", test_expose_object);
   g_test_add_func ("/Builder/Template", test_template);
+  g_test_add_func ("/Builder/Template Values", test_template_values);
   g_test_add_func ("/Builder/No IDs", test_no_ids);
   g_test_add_func ("/Builder/Property Bindings", test_property_bindings);
   g_test_add_func ("/Builder/anaconda-signal", test_anaconda_signal);
@@ -0,0 +1,548 @@
+/*  Copyright 2024 Red Hat, Inc.
+ *
+ * GTK is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * GTK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GTK; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib/gi18n-lib.h>
+#include <glib/gprintf.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "gtk-builder-tool.h"
+
+/* {{{ Scope */
+
+/* A scope that doesn't need the callbacks to exist, and keeps
+ * track of how much time is spent creating closures for them.
+ */
+
+#define BENCHMARK_TYPE_SCOPE (benchmark_scope_get_type ())
+G_DECLARE_FINAL_TYPE (BenchmarkScope, benchmark_scope, BENCHMARK, SCOPE, GtkBuilderCScope)
+
+struct _BenchmarkScope
+{
+  GtkBuilderCScope parent;
+
+  guint n_closures;
+  gint64 closure_time;
+};
+
+static void
+dummy_cb (void)
+{
+}
+
+static GClosure *
+benchmark_scope_create_closure (GtkBuilderScope         *scope,
+                                GtkBuilder              *builder,
+                                const char              *function_name,
+                                GtkBuilderClosureFlags   flags,
+                                GObject                 *object,
+                                GError                 **error)
+{
+  BenchmarkScope *self = BENCHMARK_SCOPE (scope);
+  GClosure *closure;
+  gboolean swapped = flags & GTK_BUILDER_CLOSURE_SWAPPED;
+  gint64 start_time;
+
+  start_time = g_get_monotonic_time ();
+
+  if (object == NULL)
+    object = gtk_builder_get_current_object (builder);
+
+  if (object)
+    {
+      if (swapped)
+        closure = g_cclosure_new_object_swap (dummy_cb, object);
+      else
+        closure = g_cclosure_new_object (dummy_cb, object);
+    }
+  else
+    {
+      if (swapped)
+        closure = g_cclosure_new_swap (dummy_cb, NULL, NULL);
+      else
+        closure = g_cclosure_new (dummy_cb, NULL, NULL);
+    }
+
+  self->closure_time += g_get_monotonic_time () - start_time;
+  self->n_closures++;
+
+  return closure;
+}
+
+static void
+benchmark_scope_scope_init (GtkBuilderScopeInterface *iface)
+{
+  iface->create_closure = benchmark_scope_create_closure;
+}
+
+G_DEFINE_TYPE_WITH_CODE (BenchmarkScope, benchmark_scope, GTK_TYPE_BUILDER_CSCOPE,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_BUILDER_SCOPE,
+                                                benchmark_scope_scope_init))
+
+static void
+benchmark_scope_init (BenchmarkScope *self)
+{
+}
+
+static void
+benchmark_scope_class_init (BenchmarkScopeClass *class)
+{
+}
+
+static void
+benchmark_scope_reset (BenchmarkScope *self)
+{
+  self->n_closures = 0;
+  self->closure_time = 0;
+}
+
+/* }}} */
+/* {{{ Template type */
+
+static GBytes *template_bytes;
+static BenchmarkScope *template_scope;
+static gboolean init_template;
+
+static void
+template_class_init (gpointer g_class,
+                     gpointer class_data)
+{
+  if (!GTK_IS_WIDGET_CLASS (g_class))
+    return;
+
+  gtk_widget_class_set_template (GTK_WIDGET_CLASS (g_class), template_bytes);
+  gtk_widget_class_set_template_scope (GTK_WIDGET_CLASS (g_class), GTK_BUILDER_SCOPE (template_scope));
+}
+
+static void
+template_instance_init (GTypeInstance *instance,
+                        gpointer       g_class)
+{
+  if (init_template)
+    gtk_widget_init_template (GTK_WIDGET (instance));
+}
+
+static GType
+make_template_type (const char *type_name,
+                    const char *parent_name)
+{
+  GType parent_type;
+  GTypeQuery query;
+  GTypeInfo info = { 0, };
+
+  if (g_type_from_name (type_name) != G_TYPE_INVALID)
+    {
+      g_printerr (_("Can’t benchmark the template of existing type %s\n"), type_name);
+      exit (1);
+    }
+
+  parent_type = g_type_from_name (parent_name);
+  if (parent_type == G_TYPE_INVALID)
+    {
+      g_printerr (_("Failed to lookup template parent type %s\n"), parent_name);
+      exit (1);
+    }
+
+  g_type_query (parent_type, &query);
+
+  info.class_size = query.class_size;
+  info.class_init = template_class_init;
+  info.instance_size = query.instance_size;
+  info.instance_init = template_instance_init;
+
+  return g_type_register_static (parent_type, type_name, &info, 0);
+}
+
+/* }}} */
+/* {{{ Instantiation */
+
+static void
+destroy_object (GObject *object)
+{
+  g_object_ref_sink (object);
+
+  if (GTK_IS_WINDOW (object))
+    gtk_window_destroy (GTK_WINDOW (object));
+
+  g_object_unref (object);
+}
+
+static void
+destroy_builder (GtkBuilder *builder)
+{
+  GSList *objects, *l;
+
+  objects = gtk_builder_get_objects (builder);
+  for (l = objects; l; l = l->next)
+    {
+      if (GTK_IS_WINDOW (l->data))
+        gtk_window_destroy (GTK_WINDOW (l->data));
+    }
+  g_slist_free (objects);
+
+  g_object_unref (builder);
+}
+
+/* Instantiates the file once and returns the time it took.
+ * If @out_builder is not NULL, the builder that was used is
+ * returned in it, so the created objects can be inspected.
+ */
+static gint64
+instantiate (GBytes          *bytes,
+             GType            template_type,
+             gboolean         precompiled,
+             BenchmarkScope  *scope,
+             GtkBuilder     **out_builder)
+{
+  GtkBuilder *builder = NULL;
+  GObject *object = NULL;
+  GError *error = NULL;
+  gint64 start_time, end_time;
+
+  if (precompiled)
+    {
+      init_template = TRUE;
+
+      start_time = g_get_monotonic_time ();
+      object = g_object_new (template_type, NULL);
+      end_time = g_get_monotonic_time ();
+
+      init_template = FALSE;
+    }
+  else
+    {
+      gboolean ret;
+
+      builder = gtk_builder_new ();
+      gtk_builder_set_scope (builder, GTK_BUILDER_SCOPE (scope));
+
+      start_time = g_get_monotonic_time ();
+      if (template_type != G_TYPE_INVALID)
+        {
+          object = g_object_new (template_type, NULL);
+          ret = gtk_builder_extend_with_template (builder, object, template_type,
+                                                  g_bytes_get_data (bytes, NULL),
+                                                  g_bytes_get_size (bytes),
+                                                  &error);
+        }
+      else
+        {
+          ret = gtk_builder_add_from_string (builder,
+                                             g_bytes_get_data (bytes, NULL),
+                                             g_bytes_get_size (bytes),
+                                             &error);
+        }
+      end_time = g_get_monotonic_time ();
+
+      if (!ret)
+        {
+          g_printerr ("%s\n", error->message);
+          exit (1);
+        }
+    }
+
+  if (out_builder && builder)
+    *out_builder = g_object_ref (builder);
+
+  if (object)
+    destroy_object (object);
+  if (builder)
+    destroy_builder (builder);
+
+  return end_time - start_time;
+}
+
+/* }}} */
+/* {{{ Reporting */
+
+typedef struct {
+  GType type;
+  guint count;
+  gint64 time;
+} TypeInfo;
+
+static int
+compare_type_info (gconstpointer a,
+                   gconstpointer b)
+{
+  const TypeInfo *ta = a;
+  const TypeInfo *tb = b;
+  gint64 cost_a = ta->count * ta->time;
+  gint64 cost_b = tb->count * tb->time;
+
+  return (cost_a < cost_b) - (cost_a > cost_b);
+}
+
+/* Measures the cost of creating plain instances of the object
+ * types in the file, without any properties or children.
+ */
+static GArray *
+measure_object_types (GtkBuilder *builder,
+                      GType       template_type,
+                      guint       runs)
+{
+  GHashTable *counts;
+  GHashTableIter iter;
+  gpointer key, value;
+  GSList *objects, *l;
+  GArray *types;
+
+  counts = g_hash_table_new (NULL, NULL);
+
+  objects = gtk_builder_get_objects (builder);
+  for (l = objects; l; l = l->next)
+    {
+      GType type = G_OBJECT_TYPE (l->data);
+
+      if (type == template_type)
+        continue;
+
+      g_hash_table_insert (counts,
+                           GSIZE_TO_POINTER (type),
+                           GUINT_TO_POINTER (GPOINTER_TO_UINT (g_hash_table_lookup (counts, GSIZE_TO_POINTER (type))) + 1));
+    }
+  g_slist_free (objects);
+
+  types = g_array_new (FALSE, FALSE, sizeof (TypeInfo));
+
+  g_hash_table_iter_init (&iter, counts);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      TypeInfo info;
+      gint64 start_time;
+      guint i;
+
+      info.type = GPOINTER_TO_SIZE (key);
+      info.count = GPOINTER_TO_UINT (value);
+
+      start_time = g_get_monotonic_time ();
+      for (i = 0; i < runs; i++)
+        destroy_object (g_object_new (info.type, NULL));
+      info.time = (g_get_monotonic_time () - start_time) / runs;
+
+      g_array_append_val (types, info);
+    }
+
+  g_hash_table_unref (counts);
+
+  g_array_sort (types, compare_type_info);
+
+  return types;
+}
+
+static void
+print_time (const char *name,
+            gint64      total,
+            guint       runs)
+{
+  g_print ("%-24s %10.3f ms %10.1f µs\n",
+           name,
+           total / 1000.0,
+           (double) total / runs);
+}
+
+/* }}} */
+
+static void
+benchmark_file (const char *filename,
+                guint       runs,
+                gboolean    compare)
+{
+  GError *error = NULL;
+  GBytes *bytes;
+  char *contents;
+  gsize length;
+  GtkBuilder *builder = NULL;
+  GType template_type = G_TYPE_INVALID;
+  BenchmarkScope *scope;
+  GArray *types;
+  gint64 total, closure_time, creation_time;
+  guint n_closures, n_objects;
+  guint i;
+
+  if (!g_file_get_contents (filename, &contents, &length, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      exit (1);
+    }
+
+  bytes = g_bytes_new_take (contents, length);
+  scope = g_object_new (BENCHMARK_TYPE_SCOPE, NULL);
+
+  /* Figure out if this is a template, the same way validate does */
+  builder = gtk_builder_new ();
+  gtk_builder_set_scope (builder, GTK_BUILDER_SCOPE (scope));
+  if (!gtk_builder_add_from_string (builder, contents, length, &error))
+    {
+      char *class_name = NULL;
+      char *parent_name = NULL;
+
+      if (!g_error_matches (error, GTK_BUILDER_ERROR, GTK_BUILDER_ERROR_UNHANDLED_TAG) ||
+          !parse_template_error (error->message, &class_name, &parent_name))
+        {
+          g_printerr ("%s\n", error->message);
+          exit (1);
+        }
+
+      g_clear_error (&error);
+
+      template_bytes = bytes;
+      template_scope = scope;
+      template_type = make_template_type (class_name, parent_name);
+
+      g_free (class_name);
+      g_free (parent_name);
+    }
+  destroy_builder (builder);
+  builder = NULL;
+
+  if (compare && !g_type_is_a (template_type, GTK_TYPE_WIDGET))
+    {
+      g_printerr (_("Only widget templates can be compared with precompiled templates\n"));
+      exit (1);
+    }
+
+  /* Warm up caches and collect the objects */
+  instantiate (bytes, template_type, FALSE, scope, &builder);
+  benchmark_scope_reset (scope);
+
+  total = 0;
+  for (i = 0; i < runs; i++)
+    total += instantiate (bytes, template_type, FALSE, scope, NULL);
+
+  closure_time = scope->closure_time;
+  n_closures = scope->n_closures / runs;
+
+  types = measure_object_types (builder, template_type, runs);
+
+  creation_time = 0;
+  n_objects = 0;
+  for (i = 0; i < types->len; i++)
+    {
+      TypeInfo *info = &g_array_index (types, TypeInfo, i);
+
+      creation_time += info->count * info->time;
+      n_objects += info->count;
+    }
+
+  g_print ("%s: %u runs, %u objects, %u signal handlers\n\n",
+           filename, runs, n_objects, n_closures);
+
+  g_print ("%-24s %13s %13s\n", "", "total", "per run");
+  print_time ("XML", total, runs);
+
+  if (compare)
+    {
+      gint64 precompiled_total;
+
+      instantiate (bytes, template_type, TRUE, scope, NULL);
+
+      precompiled_total = 0;
+      for (i = 0; i < runs; i++)
+        precompiled_total += instantiate (bytes, template_type, TRUE, scope, NULL);
+
+      print_time ("precompiled", precompiled_total, runs);
+    }
+
+  g_print ("\n");
+  print_time ("object creation", creation_time * runs, runs);
+  print_time ("signal closures", closure_time, runs);
+  print_time ("parsing and properties", MAX (total - creation_time * runs - closure_time, 0), runs);
+
+  g_print ("\n%-24s %6s %13s %13s\n", "type", "count", "per object", "per run");
+  for (i = 0; i < types->len; i++)
+    {
+      TypeInfo *info = &g_array_index (types, TypeInfo, i);
+
+      g_print ("%-24s %6u %10.1f µs %10.1f µs\n",
+               g_type_name (info->type),
+               info->count,
+               (double) info->time,
+               (double) info->count * info->time);
+    }
+
+  g_array_unref (types);
+  g_object_unref (builder);
+  g_bytes_unref (bytes);
+}
+
+void
+do_benchmark (int          *argc,
+              const char ***argv)
+{
+  GOptionContext *context;
+  char **filenames = NULL;
+  gboolean compare = FALSE;
+  int runs = 100;
+  const GOptionEntry entries[] = {
+    { "runs", 0, 0, G_OPTION_ARG_INT, &runs, N_("Number of times to instantiate the file"), N_("RUNS") },
+    { "compare", 0, 0, G_OPTION_ARG_NONE, &compare, N_("Compare with a precompiled template"), NULL },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL, N_("FILE") },
+    { NULL, }
+  };
+  GError *error = NULL;
+
+  if (gdk_display_get_default () == NULL)
+    {
+      g_printerr (_("Could not initialize windowing system\n"));
+      exit (1);
+    }
+
+  g_set_prgname ("gtk4-builder-tool benchmark");
+  context = g_option_context_new (NULL);
+  g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_set_summary (context, _("Benchmark instantiating the file."));
+
+  if (!g_option_context_parse (context, argc, (char ***)argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      exit (1);
+    }
+
+  g_option_context_free (context);
+
+  if (filenames == NULL)
+    {
+      g_printerr (_("No .ui file specified\n"));
+      exit (1);
+    }
+
+  if (g_strv_length (filenames) > 1)
+    {
+      g_printerr (_("Can only benchmark a single .ui file\n"));
+      exit (1);
+    }
+
+  if (runs < 1)
+    {
+      g_printerr (_("Number of runs must be positive\n"));
+      exit (1);
+    }
+
+  benchmark_file (filenames[0], runs, compare);
+
+  g_strfreev (filenames);
+}
+
+/* vim:set foldmethod=marker expandtab: */
@@ -184,7 +184,7 @@ validate_template (const char *filename,
   return ret;
 }
 
-static gboolean
+gboolean
 parse_template_error (const char   *message,
                       char        **class_name,
                       char        **parent_name)
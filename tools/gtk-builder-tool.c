@@ -45,6 +45,7 @@ usage (void)
              "  preview      Preview the file\n"
              "  render       Take a screenshot of the file\n"
              "  screenshot   Take a screenshot of the file\n"
+             "  benchmark    Benchmark instantiating the file\n"
              "\n"));
   exit (1);
 }
@@ -122,6 +123,8 @@ main (int argc, const char *argv[])
   else if (strcmp (argv[0], "render") == 0 ||
            strcmp (argv[0], "screenshot") == 0)
     do_screenshot (&argc, &argv);
+  else if (strcmp (argv[0], "benchmark") == 0)
+    do_benchmark (&argc, &argv);
   else
     usage ();
 
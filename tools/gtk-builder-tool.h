@@ -5,3 +5,8 @@ void do_validate   (int *argc, const char ***argv);
 void do_enumerate  (int *argc, const char ***argv);
 void do_preview    (int *argc, const char ***argv);
 void do_screenshot (int *argc, const char ***argv);
+void do_benchmark  (int *argc, const char ***argv);
+
+gboolean parse_template_error (const char  *message,
+                               char       **class_name,
+                               char       **parent_name);
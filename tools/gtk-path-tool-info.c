@@ -83,14 +83,17 @@ do_info (int *argc, const char ***argv)
 {
   GError *error = NULL;
   char **args = NULL;
+  gboolean timings = FALSE;
   GOptionContext *context;
   GOptionEntry entries[] = {
+    { "timings", 0, 0, G_OPTION_ARG_NONE, &timings, N_("Show how long measuring takes"), NULL },
     { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &args, NULL, N_("PATH") },
     { NULL, },
   };
   GskPath *path;
   GskPathMeasure *measure;
   graphene_rect_t bounds;
+  gint64 start, end;
 
   g_set_prgname ("gtk4-path-tool info");
 
@@ -115,7 +118,10 @@ do_info (int *argc, const char ***argv)
     }
 
   path = get_path (args[0]);
+
+  start = g_get_monotonic_time ();
   measure = gsk_path_measure_new (path);
+  end = g_get_monotonic_time ();
 
   if (gsk_path_is_empty (path))
     g_print ("%s\n", _("Path is empty."));
@@ -160,4 +166,13 @@ do_info (int *argc, const char ***argv)
           g_print ("\n");
         }
     }
+
+  if (timings)
+    {
+      g_print (_("Measuring took %.3f ms"), (end - start) / 1000.);
+      g_print ("\n");
+    }
+
+  gsk_path_measure_unref (measure);
+  gsk_path_unref (path);
 }
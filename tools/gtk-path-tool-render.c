@@ -103,6 +103,7 @@ do_render (int          *argc,
   gboolean do_stroke = FALSE;
   gboolean show_points = FALSE;
   gboolean show_controls = FALSE;
+  gboolean timings = FALSE;
   double line_width = 1;
   const char *cap = "butt";
   const char *join = "miter";
@@ -119,6 +120,7 @@ do_render (int          *argc,
     { "points", 0, 0, G_OPTION_ARG_NONE, &show_points, N_("Show path points"), NULL },
     { "controls", 0, 0, G_OPTION_ARG_NONE, &show_controls, N_("Show control points"), NULL },
     { "output", 0, 0, G_OPTION_ARG_FILENAME, &output_file, N_("The output file"), N_("FILE") },
+    { "timings", 0, 0, G_OPTION_ARG_NONE, &timings, N_("Show how long rendering takes"), NULL },
     { "fg-color", 0, 0, G_OPTION_ARG_STRING, &fg_color, N_("Foreground color"), N_("COLOR") },
     { "bg-color", 0, 0, G_OPTION_ARG_STRING, &bg_color, N_("Background color"), N_("COLOR") },
     { "point-color", 0, 0, G_OPTION_ARG_STRING, &point_color, N_("Point color"), N_("COLOR") },
@@ -154,6 +156,7 @@ do_render (int          *argc,
   GskLineJoin line_join;
   GskStroke *stroke;
   GskPathBuilder *builders[3] = { NULL, NULL, NULL };
+  gint64 start, end;
   int i;
 
   if (gdk_display_get_default () == NULL)
@@ -302,7 +305,15 @@ do_render (int          *argc,
   surface = gdk_surface_new_toplevel (gdk_display_get_default ());
   renderer = gsk_renderer_new_for_surface (surface);
 
+  start = g_get_monotonic_time ();
   texture = gsk_renderer_render_texture (renderer, node, &bounds);
+  end = g_get_monotonic_time ();
+
+  if (timings)
+    {
+      g_print (_("Rendering took %.3f ms"), (end - start) / 1000.);
+      g_print ("\n");
+    }
 
   filename = output_file ? output_file : "path.png";
   if (!gdk_texture_save_to_png (texture, filename))
@@ -28,6 +28,320 @@
 #include <glib/gstdio.h>
 #include <gtk/gtk.h>
 #include "gtk-rendernode-tool.h"
+#include "gsk/gskrendererprivate.h"
+
+/* Returns the best time of all runs. If @upload_bytes is given,
+ * it is set to the fewest bytes uploaded in a run, which excludes
+ * whatever the renderer could cache from earlier runs.
+ */
+static gint64
+time_render (GskRenderer   *renderer,
+             GskRenderNode *node,
+             guint          runs,
+             gboolean       download,
+             gsize         *upload_bytes)
+{
+  gint64 best = G_MAXINT64;
+  gsize fewest_bytes = G_MAXSIZE;
+  guint i;
+
+  for (i = 0; i < MAX (runs, 1); i++)
+    {
+      GdkTexture *texture;
+      gint64 start_time;
+      gsize start_bytes;
+
+      start_bytes = gsk_renderer_get_upload_bytes (renderer);
+      start_time = g_get_monotonic_time ();
+
+      texture = gsk_renderer_render_texture (renderer, node, NULL);
+      if (download)
+        {
+          GdkTextureDownloader *downloader;
+          GBytes *bytes;
+          gsize stride;
+
+          downloader = gdk_texture_downloader_new (texture);
+          bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+          g_bytes_unref (bytes);
+          gdk_texture_downloader_free (downloader);
+        }
+
+      best = MIN (best, g_get_monotonic_time () - start_time);
+      fewest_bytes = MIN (fewest_bytes, gsk_renderer_get_upload_bytes (renderer) - start_bytes);
+      g_object_unref (texture);
+    }
+
+  if (upload_bytes)
+    *upload_bytes = fewest_bytes;
+
+  return best;
+}
+
+static void
+get_children (GskRenderNode *node,
+              GPtrArray     *children)
+{
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      for (guint i = 0; i < gsk_container_node_get_n_children (node); i++)
+        g_ptr_array_add (children, gsk_container_node_get_child (node, i));
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      g_ptr_array_add (children, gsk_transform_node_get_child (node));
+      break;
+
+    case GSK_OPACITY_NODE:
+      g_ptr_array_add (children, gsk_opacity_node_get_child (node));
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      g_ptr_array_add (children, gsk_color_matrix_node_get_child (node));
+      break;
+
+    case GSK_REPEAT_NODE:
+      g_ptr_array_add (children, gsk_repeat_node_get_child (node));
+      break;
+
+    case GSK_CLIP_NODE:
+      g_ptr_array_add (children, gsk_clip_node_get_child (node));
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      g_ptr_array_add (children, gsk_rounded_clip_node_get_child (node));
+      break;
+
+    case GSK_SHADOW_NODE:
+      g_ptr_array_add (children, gsk_shadow_node_get_child (node));
+      break;
+
+    case GSK_BLEND_NODE:
+      g_ptr_array_add (children, gsk_blend_node_get_bottom_child (node));
+      g_ptr_array_add (children, gsk_blend_node_get_top_child (node));
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      g_ptr_array_add (children, gsk_cross_fade_node_get_start_child (node));
+      g_ptr_array_add (children, gsk_cross_fade_node_get_end_child (node));
+      break;
+
+    case GSK_BLUR_NODE:
+      g_ptr_array_add (children, gsk_blur_node_get_child (node));
+      break;
+
+    case GSK_DEBUG_NODE:
+      g_ptr_array_add (children, gsk_debug_node_get_child (node));
+      break;
+
+    case GSK_GL_SHADER_NODE:
+      for (guint i = 0; i < gsk_gl_shader_node_get_n_children (node); i++)
+        g_ptr_array_add (children, gsk_gl_shader_node_get_child (node, i));
+      break;
+
+    case GSK_MASK_NODE:
+      g_ptr_array_add (children, gsk_mask_node_get_source (node));
+      g_ptr_array_add (children, gsk_mask_node_get_mask (node));
+      break;
+
+    case GSK_FILL_NODE:
+      g_ptr_array_add (children, gsk_fill_node_get_child (node));
+      break;
+
+    case GSK_STROKE_NODE:
+      g_ptr_array_add (children, gsk_stroke_node_get_child (node));
+      break;
+
+    case GSK_SUBSURFACE_NODE:
+      g_ptr_array_add (children, gsk_subsurface_node_get_child (node));
+      break;
+
+    case GSK_CAIRO_NODE:
+    case GSK_COLOR_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_RADIAL_GRADIENT_NODE:
+    case GSK_REPEATING_RADIAL_GRADIENT_NODE:
+    case GSK_CONIC_GRADIENT_NODE:
+    case GSK_BORDER_NODE:
+    case GSK_TEXTURE_NODE:
+    case GSK_TEXTURE_SCALE_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+    case GSK_TEXT_NODE:
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+typedef struct
+{
+  char *path;
+  gint64 total;
+  gsize upload_bytes;
+} Subtree;
+
+static void
+subtree_clear (gpointer data)
+{
+  Subtree *subtree = data;
+
+  g_free (subtree->path);
+}
+
+static int
+subtree_compare (gconstpointer a,
+                 gconstpointer b)
+{
+  const Subtree *sa = a;
+  const Subtree *sb = b;
+
+  return sb->total < sa->total ? -1 : sb->total > sa->total;
+}
+
+/* Renders every subtree on its own and returns the time it took,
+ * minus the time it takes to render a transparent node of the same
+ * size. The difference to the sum of the children is attributed to
+ * the node itself. The bytes uploaded to the GPU are attributed the
+ * same way.
+ */
+static gint64
+profile_subtree (GskRenderer   *renderer,
+                 GskRenderNode *node,
+                 const char    *path,
+                 guint          runs,
+                 gboolean       download,
+                 gint64        *self_times,
+                 gsize         *self_bytes,
+                 guint         *counts,
+                 GArray        *subtrees,
+                 gsize         *upload_bytes)
+{
+  GskRenderNode *empty;
+  GPtrArray *children;
+  graphene_rect_t bounds;
+  gint64 total, baseline, children_total;
+  gsize total_bytes, baseline_bytes, children_bytes;
+  Subtree subtree;
+
+  *upload_bytes = 0;
+
+  gsk_render_node_get_bounds (node, &bounds);
+  if (bounds.size.width <= 0 || bounds.size.height <= 0)
+    return 0;
+
+  empty = gsk_color_node_new (&(GdkRGBA) { 0, 0, 0, 0 }, &bounds);
+  baseline = time_render (renderer, empty, runs, download, &baseline_bytes);
+  gsk_render_node_unref (empty);
+
+  total = MAX (0, time_render (renderer, node, runs, download, &total_bytes) - baseline);
+  total_bytes = total_bytes > baseline_bytes ? total_bytes - baseline_bytes : 0;
+
+  children = g_ptr_array_new ();
+  get_children (node, children);
+
+  children_total = 0;
+  children_bytes = 0;
+  for (guint i = 0; i < children->len; i++)
+    {
+      GskRenderNode *child = g_ptr_array_index (children, i);
+      char *child_path;
+      gsize child_bytes;
+
+      child_path = g_strdup_printf ("%s/%s[%u]", path, get_node_name (gsk_render_node_get_node_type (child)), i);
+      children_total += profile_subtree (renderer, child, child_path, runs, download, self_times, self_bytes, counts, subtrees, &child_bytes);
+      children_bytes += child_bytes;
+      g_free (child_path);
+    }
+
+  g_ptr_array_unref (children);
+
+  self_times[gsk_render_node_get_node_type (node)] += MAX (0, total - children_total);
+  if (total_bytes > children_bytes)
+    self_bytes[gsk_render_node_get_node_type (node)] += total_bytes - children_bytes;
+  counts[gsk_render_node_get_node_type (node)] += 1;
+
+  subtree.path = g_strdup (path);
+  subtree.total = total;
+  subtree.upload_bytes = total_bytes;
+  g_array_append_val (subtrees, subtree);
+
+  *upload_bytes = total_bytes;
+
+  return total;
+}
+
+static void
+profile_node (GskRenderNode *node,
+              const char    *renderer_name,
+              guint          runs,
+              gboolean       download,
+              guint          top)
+{
+  GError *error = NULL;
+  GskRenderer *renderer;
+  gint64 self_times[GSK_SUBSURFACE_NODE + 1] = { 0, };
+  gsize self_bytes[GSK_SUBSURFACE_NODE + 1] = { 0, };
+  guint counts[GSK_SUBSURFACE_NODE + 1] = { 0, };
+  GArray *subtrees;
+  gsize upload_bytes;
+  guint i;
+
+  renderer = create_renderer (renderer_name, &error);
+  if (renderer == NULL)
+    {
+      g_printerr ("Could not benchmark renderer \"%s\": %s\n", renderer_name, error->message);
+      g_clear_error (&error);
+      return;
+    }
+
+  subtrees = g_array_new (FALSE, FALSE, sizeof (Subtree));
+  g_array_set_clear_func (subtrees, subtree_clear);
+
+  /* Warm up the caches, so the first subtree doesn't pay for them */
+  time_render (renderer, node, 1, download, NULL);
+
+  profile_subtree (renderer,
+                   node,
+                   get_node_name (gsk_render_node_get_node_type (node)),
+                   runs, download,
+                   self_times, self_bytes, counts,
+                   subtrees,
+                   &upload_bytes);
+
+  g_print ("%s\n", renderer_name);
+  g_print ("  %s\n", _("Time and uploads per node type:"));
+  for (i = 0; i < G_N_ELEMENTS (self_times); i++)
+    {
+      if (counts[i] == 0)
+        continue;
+
+      g_print ("    %-34s %8.3fms %10.1fkB  (%u)\n",
+               get_node_name (i),
+               self_times[i] / 1000.,
+               self_bytes[i] / 1024.,
+               counts[i]);
+    }
+
+  g_array_sort (subtrees, subtree_compare);
+
+  g_print ("  %s\n", _("Most expensive subtrees:"));
+  for (i = 0; i < MIN (top, subtrees->len); i++)
+    {
+      Subtree *subtree = &g_array_index (subtrees, Subtree, i);
+
+      g_print ("    %8.3fms %10.1fkB  %s\n", subtree->total / 1000., subtree->upload_bytes / 1024., subtree->path);
+    }
+
+  g_array_unref (subtrees);
+
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
 
 static void
 benchmark_node (GskRenderNode *node,
@@ -81,6 +395,83 @@ benchmark_node (GskRenderNode *node,
   g_object_unref (renderer);
 }
 
+/* Renders every frame of a recording in order, the way the
+ * application drew them, and reports which ones were slow.
+ */
+static void
+benchmark_recording (GskRecordingReader *reader,
+                     const char         *renderer_name,
+                     guint               runs,
+                     gboolean            download)
+{
+  GError *error = NULL;
+  GskRenderer *renderer;
+  guint n_frames, n_slow, slowest;
+  gint64 decode_time, render_time, max_render_time;
+  gsize size;
+
+  renderer = create_renderer (renderer_name, &error);
+  if (renderer == NULL)
+    {
+      g_printerr ("Could not benchmark renderer \"%s\": %s\n", renderer_name, error->message);
+      g_clear_error (&error);
+      return;
+    }
+
+  n_frames = gsk_recording_reader_get_n_frames (reader);
+  n_slow = 0;
+  slowest = 0;
+  decode_time = 0;
+  render_time = 0;
+  max_render_time = 0;
+  size = 0;
+
+  for (guint i = 0; i < n_frames; i++)
+    {
+      GskRenderNode *node;
+      gint64 start_time, duration;
+
+      start_time = g_get_monotonic_time ();
+      node = gsk_recording_reader_get_frame (reader, i, NULL, &error);
+      decode_time += g_get_monotonic_time () - start_time;
+
+      if (node == NULL)
+        {
+          g_printerr (_("Failed to load frame %u: %s\n"), i, error->message);
+          g_clear_error (&error);
+          n_frames = i;
+          break;
+        }
+
+      size += gsk_recording_reader_get_size (reader, i);
+
+      duration = time_render (renderer, node, runs, download, NULL);
+      render_time += duration;
+      if (duration > max_render_time)
+        {
+          max_render_time = duration;
+          slowest = i;
+        }
+      if (duration > G_USEC_PER_SEC / 60)
+        n_slow++;
+
+      gsk_render_node_unref (node);
+    }
+
+  if (n_frames > 0)
+    {
+      g_print ("%s\n", renderer_name);
+      g_print ("  %-34s %u (%" G_GSIZE_FORMAT " bytes)\n", _("Frames:"), n_frames, size);
+      g_print ("  %-34s %8.3fms\n", _("Decoding per frame:"), decode_time / 1000. / n_frames);
+      g_print ("  %-34s %8.3fms\n", _("Rendering per frame:"), render_time / 1000. / n_frames);
+      g_print ("  %-34s %8.3fms  (%u)\n", _("Slowest frame:"), max_render_time / 1000., slowest);
+      g_print ("  %-34s %u\n", _("Frames slower than 60fps:"), n_slow);
+    }
+
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+}
+
 void
 do_benchmark (int          *argc,
               const char ***argv)
@@ -89,14 +480,21 @@ do_benchmark (int          *argc,
   char **filenames = NULL;
   char **renderers = NULL;
   gboolean nodownload = FALSE;
+  gboolean profile = FALSE;
   int runs = 3;
+  int top = 10;
+  int frame = -1;
   const GOptionEntry entries[] = {
     { "renderer", 0, 0, G_OPTION_ARG_STRING_ARRAY, &renderers, N_("Add renderer to benchmark"), N_("RENDERER") },
     { "runs", 0, 0, G_OPTION_ARG_INT, &runs, N_("Number of runs with each renderer"), N_("RUNS") },
     { "no-download", 0, 0, G_OPTION_ARG_NONE, &nodownload, N_("Don’t download result/wait for GPU to finish"), NULL },
+    { "profile", 0, 0, G_OPTION_ARG_NONE, &profile, N_("Attribute rendering time to nodes"), NULL },
+    { "top", 0, 0, G_OPTION_ARG_INT, &top, N_("Number of subtrees to list when profiling"), N_("COUNT") },
+    { "frame", 0, 0, G_OPTION_ARG_INT, &frame, N_("Only benchmark this frame of a recording"), N_("FRAME") },
     { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL, N_("FILE…") },
     { NULL, }
   };
+  GskRecordingReader *reader;
   GskRenderNode *node;
   GError *error = NULL;
   gsize i;
@@ -111,7 +509,14 @@ do_benchmark (int          *argc,
   context = g_option_context_new (NULL);
   g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
   g_option_context_add_main_entries (context, entries, NULL);
-  g_option_context_set_summary (context, _("Benchmark rendering of a .node file."));
+  g_option_context_set_summary (context, _("Benchmark rendering of a .node file or recording.\n"
+                                           "\n"
+                                           "All frames of a recording are rendered in order, unless --frame is given.\n"
+                                           "\n"
+                                           "--profile renders every subtree on its own, so it takes as many renders\n"
+                                           "as there are nodes, times the number of runs. Each subtree is measured\n"
+                                           "out of context, without the batching and occlusion culling it gets as\n"
+                                           "part of the full frame."));
 
   if (!g_option_context_parse (context, argc, (char ***)argv, &error))
     {
@@ -137,11 +542,44 @@ do_benchmark (int          *argc,
   if (renderers == NULL || renderers[0] == NULL)
     renderers = g_strdupv ((char **) (const char *[]) { "gl", "ngl", "vulkan", "cairo", NULL });
   
-  node = load_node_file (filenames[0]);
+  reader = load_recording_file (filenames[0]);
+  if (reader != NULL && frame < 0)
+    {
+      if (profile)
+        {
+          g_printerr (_("Profiling a recording needs --frame\n"));
+          exit (1);
+        }
+
+      for (i = 0; renderers[i] != NULL; i++)
+        benchmark_recording (reader, renderers[i], runs, !nodownload);
+
+      gsk_recording_reader_free (reader);
+      g_strfreev (filenames);
+      g_strfreev (renderers);
+      return;
+    }
+  else if (reader != NULL)
+    {
+      node = gsk_recording_reader_get_frame (reader, frame, NULL, &error);
+      if (node == NULL)
+        {
+          g_printerr (_("Failed to load frame %d: %s\n"), frame, error->message);
+          exit (1);
+        }
+      gsk_recording_reader_free (reader);
+    }
+  else
+    {
+      node = load_node_file (filenames[0]);
+    }
 
   for (i = 0; renderers[i] != NULL; i++)
     {
-      benchmark_node (node, renderers[i], runs, !nodownload);
+      if (profile)
+        profile_node (node, renderers[i], runs, !nodownload, MAX (top, 0));
+      else
+        benchmark_node (node, renderers[i], runs, !nodownload);
     }
 
   gsk_render_node_unref (node);
@@ -0,0 +1,114 @@
+/*  Copyright 2024 Red Hat, Inc.
+ *
+ * GTK is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * GTK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GTK; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib/gi18n-lib.h>
+#include <glib/gprintf.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "gtk-rendernode-tool.h"
+
+static void
+convert_file (const char *filename,
+              gboolean    binary,
+              const char *save_file)
+{
+  GskRenderNode *node;
+  GBytes *bytes;
+  GError *error = NULL;
+
+  node = load_node_file (filename);
+  if (node == NULL)
+    exit (1);
+
+  if (binary)
+    bytes = gsk_render_node_serialize_binary (node);
+  else
+    bytes = gsk_render_node_serialize (node);
+
+  if (save_file == NULL)
+    {
+      if (fwrite (g_bytes_get_data (bytes, NULL), 1, g_bytes_get_size (bytes), stdout) != g_bytes_get_size (bytes))
+        {
+          g_printerr (_("Failed to write output: %s\n"), g_strerror (errno));
+          exit (1);
+        }
+    }
+  else if (!g_file_set_contents (save_file,
+                                 g_bytes_get_data (bytes, NULL),
+                                 g_bytes_get_size (bytes),
+                                 &error))
+    {
+      g_printerr (_("Failed to save %s: %s\n"), save_file, error->message);
+      exit (1);
+    }
+
+  g_bytes_unref (bytes);
+  gsk_render_node_unref (node);
+}
+
+void
+do_convert (int          *argc,
+            const char ***argv)
+{
+  GOptionContext *context;
+  char **filenames = NULL;
+  gboolean binary = FALSE;
+  const GOptionEntry entries[] = {
+    { "binary", 0, 0, G_OPTION_ARG_NONE, &binary, N_("Write the binary format"), NULL },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL, N_("FILE…") },
+    { NULL, }
+  };
+  GError *error = NULL;
+
+  g_set_prgname ("gtk4-rendernode-tool convert");
+  context = g_option_context_new (NULL);
+  g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_set_summary (context, _("Convert a .node file between the text and binary formats."));
+
+  if (!g_option_context_parse (context, argc, (char ***)argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      exit (1);
+    }
+
+  g_option_context_free (context);
+
+  if (filenames == NULL)
+    {
+      g_printerr (_("No .node file specified\n"));
+      exit (1);
+    }
+
+  if (g_strv_length (filenames) > 2)
+    {
+      g_printerr (_("Can only convert a single .node file to a single output file\n"));
+      exit (1);
+    }
+
+  convert_file (filenames[0], binary, filenames[1]);
+
+  g_strfreev (filenames);
+}
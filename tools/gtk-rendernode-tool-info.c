@@ -152,21 +152,6 @@ count_nodes (GskRenderNode *node,
   *depth = d + 1;
 }
 
-static const char *
-get_node_name (GskRenderNodeType type)
-{
-  GEnumClass *class;
-  GEnumValue *value;
-  const char *name;
-
-  class = g_type_class_ref (GSK_TYPE_RENDER_NODE_TYPE);
-  value = g_enum_get_value (class, type);
-  name = value->value_nick;
-  g_type_class_unref (class);
-
-  return name;
-}
-
 static void
 file_info (const char *filename)
 {
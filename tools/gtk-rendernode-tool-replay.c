@@ -0,0 +1,313 @@
+/*  Copyright 2024 Red Hat, Inc.
+ *
+ * GTK is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * GTK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GTK; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib/gi18n-lib.h>
+#include <glib/gprintf.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "gtk-rendernode-tool.h"
+
+typedef struct
+{
+  GskRecordingReader *reader;
+  char *name;
+  guint n_frames;
+  guint frame;
+  double speed;
+
+  gboolean playing;
+  /* frame clock time and timestamp of the frame playback started at */
+  gint64 start_time;
+  gint64 start_timestamp;
+
+  GtkWidget *window;
+  GtkWidget *picture;
+} Replay;
+
+static void
+replay_show_frame (Replay *replay,
+                   guint   frame)
+{
+  GskRenderNode *node;
+  GtkSnapshot *snapshot;
+  GdkPaintable *paintable;
+  GError *error = NULL;
+  char *title;
+
+  node = gsk_recording_reader_get_frame (replay->reader, frame, NULL, &error);
+  if (node == NULL)
+    {
+      g_printerr (_("Failed to load frame %u: %s\n"), frame, error->message);
+      g_clear_error (&error);
+      replay->playing = FALSE;
+      return;
+    }
+
+  snapshot = gtk_snapshot_new ();
+  gtk_snapshot_append_node (snapshot, node);
+  paintable = gtk_snapshot_free_to_paintable (snapshot, NULL);
+  gtk_picture_set_paintable (GTK_PICTURE (replay->picture), paintable);
+  g_clear_object (&paintable);
+  gsk_render_node_unref (node);
+
+  replay->frame = frame;
+
+  title = g_strdup_printf ("%s (%u/%u)", replay->name, frame + 1, replay->n_frames);
+  gtk_window_set_title (GTK_WINDOW (replay->window), title);
+  g_free (title);
+}
+
+static void
+replay_set_playing (Replay   *replay,
+                    gboolean  playing)
+{
+  /* start over when playing at the end */
+  if (playing && replay->frame + 1 >= replay->n_frames)
+    replay_show_frame (replay, 0);
+
+  replay->playing = playing;
+  replay->start_time = 0;
+}
+
+static gboolean
+replay_tick (GtkWidget     *widget,
+             GdkFrameClock *frame_clock,
+             gpointer       data)
+{
+  Replay *replay = data;
+  gint64 now, target;
+  guint next;
+
+  if (!replay->playing)
+    return G_SOURCE_CONTINUE;
+
+  now = gdk_frame_clock_get_frame_time (frame_clock);
+  if (replay->start_time == 0)
+    {
+      replay->start_time = now;
+      replay->start_timestamp = gsk_recording_reader_get_timestamp (replay->reader, replay->frame);
+    }
+
+  /* Skip frames we're too late for, like the application would have */
+  target = replay->start_timestamp + (now - replay->start_time) * replay->speed;
+  next = replay->frame;
+  while (next + 1 < replay->n_frames &&
+         gsk_recording_reader_get_timestamp (replay->reader, next + 1) <= target)
+    next++;
+
+  if (next != replay->frame)
+    replay_show_frame (replay, next);
+
+  if (replay->frame + 1 >= replay->n_frames)
+    replay->playing = FALSE;
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+replay_key_pressed (GtkEventControllerKey *controller,
+                    guint                  keyval,
+                    guint                  keycode,
+                    GdkModifierType        state,
+                    gpointer               data)
+{
+  Replay *replay = data;
+
+  switch (keyval)
+    {
+    case GDK_KEY_space:
+      replay_set_playing (replay, !replay->playing);
+      return TRUE;
+
+    case GDK_KEY_Left:
+      replay_set_playing (replay, FALSE);
+      if (replay->frame > 0)
+        replay_show_frame (replay, replay->frame - 1);
+      return TRUE;
+
+    case GDK_KEY_Right:
+      replay_set_playing (replay, FALSE);
+      if (replay->frame + 1 < replay->n_frames)
+        replay_show_frame (replay, replay->frame + 1);
+      return TRUE;
+
+    case GDK_KEY_Home:
+      replay_show_frame (replay, 0);
+      replay->start_time = 0;
+      return TRUE;
+
+    case GDK_KEY_End:
+      replay_set_playing (replay, FALSE);
+      replay_show_frame (replay, replay->n_frames - 1);
+      return TRUE;
+
+    default:
+      return FALSE;
+    }
+}
+
+static void
+quit_cb (GtkWidget *widget,
+         gpointer   user_data)
+{
+  gboolean *is_done = user_data;
+
+  *is_done = TRUE;
+
+  g_main_context_wakeup (NULL);
+}
+
+static void
+replay_file (const char *filename,
+             int         frame,
+             double      speed,
+             gboolean    paused,
+             gboolean    decorated)
+{
+  Replay replay = { 0, };
+  GtkEventController *controller;
+  GtkWidget *sw;
+  gboolean done = FALSE;
+
+  replay.reader = load_recording_file (filename);
+  if (replay.reader == NULL)
+    {
+      g_printerr (_("%s is not a recording\n"), filename);
+      exit (1);
+    }
+
+  replay.n_frames = gsk_recording_reader_get_n_frames (replay.reader);
+  if (replay.n_frames == 0)
+    {
+      g_printerr (_("The recording contains no frames\n"));
+      exit (1);
+    }
+
+  if (frame < 0 || (guint) frame >= replay.n_frames)
+    {
+      g_printerr (_("The recording only contains %u frames\n"), replay.n_frames);
+      exit (1);
+    }
+
+  replay.name = g_path_get_basename (filename);
+  replay.speed = speed;
+
+  replay.picture = gtk_picture_new ();
+  gtk_picture_set_can_shrink (GTK_PICTURE (replay.picture), FALSE);
+  gtk_picture_set_content_fit (GTK_PICTURE (replay.picture), GTK_CONTENT_FIT_SCALE_DOWN);
+
+  sw = gtk_scrolled_window_new ();
+  gtk_scrolled_window_set_propagate_natural_width (GTK_SCROLLED_WINDOW (sw), TRUE);
+  gtk_scrolled_window_set_propagate_natural_height (GTK_SCROLLED_WINDOW (sw), TRUE);
+  gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (sw), replay.picture);
+
+  replay.window = gtk_window_new ();
+  gtk_window_set_decorated (GTK_WINDOW (replay.window), decorated);
+  gtk_window_set_child (GTK_WINDOW (replay.window), sw);
+
+  controller = gtk_event_controller_key_new ();
+  g_signal_connect (controller, "key-pressed", G_CALLBACK (replay_key_pressed), &replay);
+  gtk_widget_add_controller (replay.window, controller);
+
+  gtk_widget_add_tick_callback (replay.picture, replay_tick, &replay, NULL);
+
+  replay_show_frame (&replay, frame);
+  replay_set_playing (&replay, !paused);
+
+  gtk_window_present (GTK_WINDOW (replay.window));
+  g_signal_connect (replay.window, "destroy", G_CALLBACK (quit_cb), &done);
+
+  while (!done)
+    g_main_context_iteration (NULL, TRUE);
+
+  gsk_recording_reader_free (replay.reader);
+  g_free (replay.name);
+}
+
+void
+do_replay (int          *argc,
+           const char ***argv)
+{
+  GOptionContext *context;
+  char **filenames = NULL;
+  gboolean decorated = TRUE;
+  gboolean paused = FALSE;
+  int frame = 0;
+  double speed = 1.0;
+  const GOptionEntry entries[] = {
+    { "frame", 0, 0, G_OPTION_ARG_INT, &frame, N_("Start at this frame"), N_("FRAME") },
+    { "speed", 0, 0, G_OPTION_ARG_DOUBLE, &speed, N_("Playback speed"), N_("FACTOR") },
+    { "paused", 0, 0, G_OPTION_ARG_NONE, &paused, N_("Don't start playing"), NULL },
+    { "undecorated", 0, G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &decorated, N_("Don't add a titlebar"), NULL },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL, N_("FILE") },
+    { NULL, }
+  };
+  GError *error = NULL;
+
+  if (gdk_display_get_default () == NULL)
+    {
+      g_printerr (_("Could not initialize windowing system\n"));
+      exit (1);
+    }
+
+  g_set_prgname ("gtk4-rendernode-tool replay");
+  context = g_option_context_new (NULL);
+  g_option_context_set_translation_domain (context, GETTEXT_PACKAGE);
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_set_summary (context,
+                                _("Replay a recording made with the inspector.\n"
+                                  "\n"
+                                  "Space pauses and resumes playback, Left and Right step\n"
+                                  "through frames, Home and End go to the first and last one."));
+
+  if (!g_option_context_parse (context, argc, (char ***)argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      exit (1);
+    }
+
+  g_option_context_free (context);
+
+  if (filenames == NULL)
+    {
+      g_printerr (_("No recording specified\n"));
+      exit (1);
+    }
+
+  if (g_strv_length (filenames) > 1)
+    {
+      g_printerr (_("Can only replay a single recording\n"));
+      exit (1);
+    }
+
+  if (speed <= 0)
+    {
+      g_printerr (_("The speed must be positive\n"));
+      exit (1);
+    }
+
+  replay_file (filenames[0], frame, speed, paused, decorated);
+
+  g_strfreev (filenames);
+}
@@ -77,6 +77,42 @@ load_node_file (const char *filename)
   return gsk_render_node_deserialize (bytes, deserialize_error_func, NULL);
 }
 
+/* Returns NULL if the file is not a recording */
+GskRecordingReader *
+load_recording_file (const char *filename)
+{
+  GFile *file;
+  GFileInputStream *stream;
+  GskRecordingReader *reader;
+  GError *error = NULL;
+
+  file = g_file_new_for_commandline_arg (filename);
+  stream = g_file_read (file, NULL, NULL);
+  g_object_unref (file);
+
+  /* let load_node_file() report the error */
+  if (stream == NULL)
+    return NULL;
+
+  reader = gsk_recording_reader_new (G_INPUT_STREAM (stream), &error);
+  g_object_unref (stream);
+
+  if (reader == NULL)
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED))
+        {
+          g_clear_error (&error);
+          return NULL;
+        }
+
+      g_printerr (_("Failed to load recording: %s\n"), error->message);
+      g_clear_error (&error);
+      exit (1);
+    }
+
+  return reader;
+}
+
 /* keep in sync with gsk/gskrenderer.c */
 static GskRenderer *
 get_renderer_for_name (const char *renderer_name)
@@ -135,3 +171,18 @@ create_renderer (const char *name, GError **error)
 
   return renderer;
 }
+
+const char *
+get_node_name (GskRenderNodeType type)
+{
+  GEnumClass *class;
+  GEnumValue *value;
+  const char *name;
+
+  class = g_type_class_ref (GSK_TYPE_RENDER_NODE_TYPE);
+  value = g_enum_get_value (class, type);
+  name = value->value_nick;
+  g_type_class_unref (class);
+
+  return name;
+}
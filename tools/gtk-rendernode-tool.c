@@ -40,10 +40,12 @@ usage (void)
              "Commands:\n"
              "  benchmark    Benchmark rendering of a node\n"
              "  compare      Compare nodes or images\n"
+             "  convert      Convert between text and binary formats\n"
              "  extract      Extract data urls\n"
              "  info         Provide information about the node\n"
              "  show         Show the node\n"
              "  render       Take a screenshot of the node\n"
+             "  replay       Replay a recording\n"
              "\n"));
   exit (1);
 }
@@ -114,6 +116,8 @@ main (int argc, const char *argv[])
     do_show (&argc, &argv);
   else if (strcmp (argv[0], "render") == 0)
     do_render (&argc, &argv);
+  else if (strcmp (argv[0], "replay") == 0)
+    do_replay (&argc, &argv);
   else if (strcmp (argv[0], "info") == 0)
     do_info (&argc, &argv);
   else if (strcmp (argv[0], "benchmark") == 0)
@@ -122,6 +126,8 @@ main (int argc, const char *argv[])
     do_compare (&argc, &argv);
   else if (strcmp (argv[0], "extract") == 0)
     do_extract (&argc, &argv);
+  else if (strcmp (argv[0], "convert") == 0)
+    do_convert (&argc, &argv);
   else
     usage ();
 